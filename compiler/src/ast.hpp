@@ -38,11 +38,15 @@ class ast_node : public base_visitable<ast_node>
     }
 };
 
-#define IDENTIFIER_TYPE_ENUMERATION(op)              \
-    op(undefined)     /* undefined */                \
-        op(variable)  /* identifier for variables */ \
-        op(function)  /* identifier for functions */ \
-        op(parameter) /* identifier for parameters */
+#define IDENTIFIER_TYPE_ENUMERATION(op)                               \
+    op(undefined)         /* undefined */                             \
+        op(variable)      /* identifier for variables */              \
+        op(function)      /* identifier for functions */              \
+        op(parameter)     /* identifier for parameters */             \
+        op(type)          /* identifier for user types */             \
+        op(member)        /* identifier for type members */           \
+        op(method)        /* identifier for member functions */       \
+        op(static_method) /* identifier for static member functions */
 
 #define op(x) x,
 enum class identifier_type
@@ -71,7 +75,8 @@ static std::string to_string(identifier_type id_type)
         op(eq) op(neq) op(lt) op(gt) op(lte) op(gte) op(lnot) op(land) op(lor)             /* conditional expressions */ \
         op(assign) op(ret) op(branch) op(loop) op(cast) op(function_call) op(array_access) /* statements */              \
         op(type_name) op(array_type_name) op(function_type_name)                           /* type names */              \
-        op(declaration) op(compound)                                                       /* blocks */
+        op(member_access) op(scope_access) op(instantiation) op(field_init)                /* user types */              \
+        op(declaration) op(type_declaration) op(compound)                                  /* blocks */
 
 #define op(x) x,
 enum class expression_type
@@ -124,7 +129,9 @@ static expression_type operator_token_type_to_expression_type(token_type op)
     case token_type::keyword_as:
         return expression_type::cast;
     case token_type::double_colon:
+        return expression_type::scope_access;
     case token_type::point:
+        return expression_type::member_access;
     default:
         return expression_type::compound;
     }
@@ -158,10 +165,12 @@ class expression : public ast_node
     virtual unique_ptr<expression> deep_copy()
     {
         unique_ptr<expression> ret = std::make_unique<expression>(source_position, expr_type);
+        ret->type                  = type;
 
         for (auto& expr : expressions)
         {
-            ret->expressions.push_back(std::move(expr->deep_copy()));
+            // unary operators have no left operand
+            ret->expressions.push_back(expr ? std::move(expr->deep_copy()) : nullptr);
         }
 
         return ret;
@@ -169,38 +178,26 @@ class expression : public ast_node
 
     expression_type expr_type;
 
+    // id in the type_table, set by the type_checker
+    int32_t type = -1;
+
     // program -> compound, expressions { all global expressions }
     // global_variable_declaration -> compound, expressions { type_name, identifier }
     // function_declaration -> compound, expressions { compound (function_type_name), identifier, compound (block) }
     // function_type_name -> compound, expressions { compound (parameter_declaration), type_name (return))}
     // block -> compound, expressions { all expressions in block }
-    // function call -> function_call, expressions { args }
+    // function call -> function_call, expressions { callee, args }
     // return -> ret, expressions { return expression }
     // if(a){b}else{c} -> branch, expressions {condition, block, (optional else block)}
     // while -> loop, expressions { guard, block }
+    // type_declaration -> type_declaration, expressions { identifier, identifier (base) or nullptr, compound (members) }
+    // a.b -> member_access, expressions { object, identifier }
+    // a::b -> scope_access, expressions { identifier (type), identifier }
+    // a{b: c, d} -> instantiation, expressions { identifier (type), field_init or expression for every argument }
+    // b: c -> field_init, expressions { identifier (member), expression }
 
     expression_vector expressions;
 
-    bool is_pure() const
-    {
-        for (const auto& e : expressions)
-            if (!e->is_pure())
-                return false;
-        switch (expr_type)
-        {
-        case expression_type::function_call: // not pure for now
-            return false;
-        case expression_type::assign: // not pure
-            return false;
-        case expression_type::ret: // not pure, does not evaluate into value
-            return false;
-        case expression_type::loop: // not pure, might be infinite
-            return false;
-        default:
-            return true;
-        }
-    }
-
     std::string to_string() override
     {
         switch (expr_type)
@@ -257,6 +254,16 @@ class expression : public ast_node
             return "[]";
         case expression_type::function_type_name:
             return "->";
+        case expression_type::member_access:
+            return ".";
+        case expression_type::scope_access:
+            return "::";
+        case expression_type::instantiation:
+            return "{}";
+        case expression_type::field_init:
+            return ":";
+        case expression_type::type_declaration:
+            return "type";
         case expression_type::nop:
         case expression_type::str_lit:
         case expression_type::i32_lit:
@@ -286,11 +293,18 @@ class identifier : public expression
 
     std::string name;
     identifier_type id_type;
+    // bound by the name_resolver, -1 if unresolved
+    int32_t symbol = -1;
+    // members and methods declared after pub:
+    bool is_public = false;
 
     unique_ptr<expression> deep_copy() override
     {
         std::string copy           = name;
-        unique_ptr<expression> ret = std::make_unique<identifier>(source_position, std::move(copy), id_type);
+        unique_ptr<identifier> ret = std::make_unique<identifier>(source_position, std::move(copy), id_type);
+        ret->symbol                = symbol;
+        ret->type                  = type;
+        ret->is_public             = is_public;
         return ret;
     }
 
@@ -313,11 +327,15 @@ class type_name : public expression
     DEFINE_VISITABLE()
 
     std::string string_representation;
+    // bound by the name_resolver for user types, -1 for primitive types
+    int32_t symbol = -1;
 
     unique_ptr<expression> deep_copy() override
     {
-        std::string copy           = string_representation;
-        unique_ptr<expression> ret = std::make_unique<type_name>(source_position, std::move(copy));
+        std::string copy          = string_representation;
+        unique_ptr<type_name> ret = std::make_unique<type_name>(source_position, std::move(copy));
+        ret->symbol               = symbol;
+        ret->type                 = type;
         return ret;
     }
 
@@ -344,6 +362,7 @@ class integer_literal : public expression
     unique_ptr<expression> deep_copy() override
     {
         unique_ptr<expression> ret = std::make_unique<integer_literal>(source_position, value);
+        ret->type                  = type;
         return ret;
     }
 
@@ -370,6 +389,7 @@ class floating_point_literal : public expression
     unique_ptr<expression> deep_copy() override
     {
         unique_ptr<expression> ret = std::make_unique<floating_point_literal>(source_position, value);
+        ret->type                  = type;
         return ret;
     }
 
@@ -383,7 +403,7 @@ class string_literal : public expression
 {
   public:
     string_literal(const source_code_position& position, std::string&& value)
-        : expression(position, expression_type::f32_lit)
+        : expression(position, expression_type::str_lit)
         , value(std::move(value))
     {
     }
@@ -397,6 +417,7 @@ class string_literal : public expression
     {
         std::string copy           = value;
         unique_ptr<expression> ret = std::make_unique<string_literal>(source_position, std::move(copy));
+        ret->type                  = type;
         return ret;
     }
 
@@ -410,7 +431,7 @@ class boolean_literal : public expression
 {
   public:
     boolean_literal(const source_code_position& position, bool value)
-        : expression(position, expression_type::f32_lit)
+        : expression(position, expression_type::bool_lit)
         , value(value)
     {
     }
@@ -423,6 +444,7 @@ class boolean_literal : public expression
     unique_ptr<expression> deep_copy() override
     {
         unique_ptr<expression> ret = std::make_unique<boolean_literal>(source_position, value);
+        ret->type                  = type;
         return ret;
     }
 
@@ -432,14 +454,14 @@ class boolean_literal : public expression
     }
 };
 
-class dot_visitor : public base_visitor<ast_node, void, int32_t&>
+// node names are paths of child indices from the root, so the graph does not depend on the order of the visit
+class dot_visitor : public base_visitor<ast_node, void, const std::string&>
 {
   public:
     dot_visitor(const std::string& out_file_name)
         : file(out_file_name)
     {
         DEFINE_VISITOR_AND_VISITABLES(dot_visitor, ast_node, expression);
-        node_counter = 0;
         file << "\ndigraph G {\n";
         file << "\n  graph[ordering=\"out\"];\n";
     }
@@ -448,38 +470,35 @@ class dot_visitor : public base_visitor<ast_node, void, int32_t&>
         file << "}\n";
     };
 
-    void visit(ast_node& node, int32_t& param)
+    void visit(ast_node& node, const std::string& node_id)
     {
-        int32_t node_id = insert_node(node.to_string());
-        param           = node_id;
+        insert_node(node_id, node.to_string());
     }
 
-    void visit(expression& expr, int32_t& param)
+    void visit(expression& expr, const std::string& node_id)
     {
-        int32_t node_id = insert_node(expr.to_string());
-        visit_children(expr.expressions, node_id, param);
-        param = node_id;
+        insert_node(node_id, expr.to_string());
+        visit_children(expr.expressions, node_id);
     }
 
   private:
-    int32_t insert_node(const std::string& label)
+    void insert_node(const std::string& node_id, const std::string& label)
     {
-        int32_t node_id = node_counter++;
-        file << "\n  node_" << node_id << " [label=\"" << label << "\"];\n";
-        return node_id;
+        file << "\n  " << node_id << " [label=\"" << label << "\"];\n";
     }
-    void visit_children(expression_vector& expressions, int32_t node_id, int32_t& param)
+    void visit_children(expression_vector& expressions, const std::string& node_id)
     {
-        for (auto& child_expr : expressions)
+        // empty children keep their index, the names of their siblings stay the same
+        for (size_t i = 0; i < expressions.size(); ++i)
         {
-            if (!child_expr)
+            if (!expressions[i])
                 continue;
-            (*this)(*child_expr, param);
-            file << "\n  node_" << node_id << " -> node_" << param << "\n";
+            std::string child_id = node_id + "_" + std::to_string(i);
+            (*this)(*expressions[i], child_id);
+            file << "\n  " << node_id << " -> " << child_id << "\n";
         }
     }
 
-    int32_t node_counter;
     std::ofstream file;
 };
 
@@ -577,8 +596,12 @@ class pretty_printer : public base_visitor<ast_node, void, std::string>
         case expression_type::function_call:
             visit_child(expr.expressions[0], "");
             file << "(";
-            if (expr.expressions.size() > 1)
-                visit_child(expr.expressions[1], ", ");
+            for (size_t i = 1; i < expr.expressions.size(); ++i)
+            {
+                if (i > 1)
+                    file << ", ";
+                visit_child(expr.expressions[i], "");
+            }
             file << ")";
             break;
         case expression_type::array_access:
@@ -633,10 +656,67 @@ class pretty_printer : public base_visitor<ast_node, void, std::string>
                 file << "}\n";
             }
             break;
+        case expression_type::member_access:
+        case expression_type::scope_access:
+            visit_child(expr.expressions[0], "");
+            file << expr.to_string();
+            visit_child(expr.expressions[1], "");
+            break;
+        case expression_type::instantiation:
+        {
+            visit_child(expr.expressions[0], "");
+            file << "{ ";
+            for (size_t i = 1; i < expr.expressions.size(); ++i)
+            {
+                if (i > 1)
+                    file << ", ";
+                visit_child(expr.expressions[i], "");
+            }
+            file << " }";
+            break;
+        }
+        case expression_type::field_init:
+            visit_child(expr.expressions[0], "");
+            file << ": ";
+            visit_child(expr.expressions[1], "");
+            break;
+        case expression_type::type_declaration:
+            file << "type ";
+            visit_child(expr.expressions[0], "");
+            if (expr.expressions[1])
+            {
+                file << " extends ";
+                visit_child(expr.expressions[1], "");
+            }
+            file << " =\n{\n";
+            print_members(*expr.expressions[2]);
+            file << "};\n";
+            break;
         };
     }
 
   private:
+    void print_members(expression& members)
+    {
+        bool in_public = false;
+        for (auto& member : members.expressions)
+        {
+            if (!member || member->expressions.size() < 2)
+                continue;
+
+            const identifier& name = static_cast<const identifier&>(*member->expressions[1]);
+            if (name.is_public && !in_public)
+                file << "pub:\n";
+            in_public = name.is_public;
+
+            if (name.id_type == identifier_type::static_method)
+                file << "static ";
+            (*this)(*member, "");
+            if (member->expressions.size() < 3)
+                file << ";\n";
+        }
+    }
+
     void visit_children(expression_vector& expressions, std::string param)
     {
         for (auto& child_expr : expressions)
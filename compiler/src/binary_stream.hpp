@@ -0,0 +1,178 @@
+//! \file      binary_stream.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef BINARY_STREAM_HPP
+#define BINARY_STREAM_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <string>
+
+// 64 bit FNV-1a, stable across runs and platforms, unlike std::hash
+inline uint64_t stable_hash(const char* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t stable_hash(const std::string& bytes, uint64_t hash = 14695981039346656037ull)
+{
+    return stable_hash(bytes.data(), bytes.size(), hash);
+}
+
+// Little endian encoding of the interface and bytecode files, strings are u32 length + bytes.
+class binary_writer
+{
+  public:
+    void write_u8(uint8_t value)
+    {
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    void write_u32(uint32_t value)
+    {
+        for (int32_t shift = 0; shift < 32; shift += 8)
+            bytes.push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+
+    void write_i32(int32_t value)
+    {
+        write_u32(static_cast<uint32_t>(value));
+    }
+
+    void write_u64(uint64_t value)
+    {
+        write_u32(static_cast<uint32_t>(value));
+        write_u32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void write_f32(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        write_u32(bits);
+    }
+
+    void write_string(const std::string& text)
+    {
+        write_u32(static_cast<uint32_t>(text.size()));
+        bytes.append(text);
+    }
+
+    void write_to(std::ostream& out) const
+    {
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    std::string bytes;
+};
+
+// Reads what binary_writer wrote, reading past the end fails the reader and returns zeros.
+class binary_reader
+{
+  public:
+    explicit binary_reader(std::string&& data)
+        : bytes(std::move(data))
+    {
+    }
+
+    explicit binary_reader(std::istream& in)
+        : bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>())
+    {
+    }
+
+    uint8_t read_u8()
+    {
+        if (!available(1))
+            return 0;
+        return static_cast<uint8_t>(bytes[offset++]);
+    }
+
+    uint32_t read_u32()
+    {
+        if (!available(4))
+            return 0;
+        uint32_t value = 0;
+        for (int32_t shift = 0; shift < 32; shift += 8)
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[offset++])) << shift;
+        return value;
+    }
+
+    int32_t read_i32()
+    {
+        return static_cast<int32_t>(read_u32());
+    }
+
+    uint64_t read_u64()
+    {
+        uint64_t low = read_u32();
+        return low | static_cast<uint64_t>(read_u32()) << 32;
+    }
+
+    float read_f32()
+    {
+        uint32_t bits = read_u32();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string read_string()
+    {
+        uint32_t length = read_u32();
+        if (!available(length))
+            return std::string();
+        std::string text = bytes.substr(offset, length);
+        offset += length;
+        return text;
+    }
+
+    // counts are checked against the remaining bytes, so a broken file can not request huge allocations
+    uint32_t read_count(size_t bytes_per_element = 1)
+    {
+        uint32_t count = read_u32();
+        if (!available(static_cast<size_t>(count) * bytes_per_element))
+            return 0;
+        return count;
+    }
+
+    bool failed() const
+    {
+        return fail;
+    }
+
+    size_t position() const
+    {
+        return offset;
+    }
+
+    const std::string& data() const
+    {
+        return bytes;
+    }
+
+  private:
+    bool available(size_t size)
+    {
+        if (!fail && bytes.size() - offset >= size)
+            return true;
+        fail = true;
+        return false;
+    }
+
+    std::string bytes;
+    size_t offset = 0;
+    bool fail     = false;
+};
+
+#endif BINARY_STREAM_HPP
@@ -0,0 +1,237 @@
+//! \file      block_layout.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "block_layout.hpp"
+#include <algorithm>
+
+// probabilities of the static heuristics, taken from studies of branch behaviour
+static const double loop_stay_probability    = 0.88;
+static const double return_taken_probability = 0.28;
+static const double loop_header_scale        = 8.0; // estimated iterations of loops without a profile
+
+static bool ends_in(const ir_function& function, block_id block, ir_opcode opcode)
+{
+    const ir_instruction* terminator = function.terminator(block);
+    return terminator && terminator->opcode == opcode;
+}
+
+// probability that block continues with the first target of its branch
+static double first_target_probability(const ir_function& function, const loop_analysis& loops, block_id block)
+{
+    const ir_block& b                = function.blocks[block];
+    const ir_instruction& terminator = *function.terminator(block);
+    if (b.count > 0 && b.taken >= 0)
+        return static_cast<double>(b.taken) / static_cast<double>(b.count);
+
+    block_id first  = terminator.targets[0];
+    block_id second = terminator.targets[1];
+
+    // error paths end in unreachable
+    bool first_cold  = ends_in(function, first, ir_opcode::unreachable);
+    bool second_cold = ends_in(function, second, ir_opcode::unreachable);
+    if (first_cold != second_cold)
+        return first_cold ? 0.0 : 1.0;
+
+    // loops usually run another iteration
+    int32_t loop = loops.loop_of(block);
+    if (loop != -1)
+    {
+        bool first_inside  = loops.contains(loop, first);
+        bool second_inside = loops.contains(loop, second);
+        if (first_inside != second_inside)
+            return first_inside ? loop_stay_probability : 1.0 - loop_stay_probability;
+    }
+
+    // early returns are the rarer case
+    bool first_returns  = ends_in(function, first, ir_opcode::ret);
+    bool second_returns = ends_in(function, second, ir_opcode::ret);
+    if (first_returns != second_returns)
+        return first_returns ? return_taken_probability : 1.0 - return_taken_probability;
+
+    return 0.5;
+}
+
+// probability of each successor in the order of the targets
+static void successor_probabilities(const ir_function& function, const loop_analysis& loops, block_id block, double probabilities[2])
+{
+    const ir_instruction* terminator = function.terminator(block);
+    probabilities[0]                 = 0.0;
+    probabilities[1]                 = 0.0;
+    if (!terminator)
+        return;
+
+    if (terminator->opcode == ir_opcode::jump)
+    {
+        probabilities[0] = 1.0;
+    }
+    else if (terminator->opcode == ir_opcode::branch)
+    {
+        probabilities[0] = first_target_probability(function, loops, block);
+        probabilities[1] = 1.0 - probabilities[0];
+    }
+}
+
+std::vector<double> block_frequencies(const ir_function& function, const dominator_tree& dominators, const loop_analysis& loops)
+{
+    std::vector<double> frequencies(function.blocks.size(), 0.0);
+    std::vector<bool> is_header(function.blocks.size(), false);
+    for (const ir_loop& loop : loops.loops())
+        is_header[loop.header] = true;
+
+    for (block_id block : dominators.reverse_postorder())
+    {
+        const ir_block& b = function.blocks[block];
+        if (b.count >= 0)
+        {
+            frequencies[block] = static_cast<double>(b.count);
+            continue;
+        }
+        if (block == 0)
+        {
+            frequencies[block] = 1.0;
+            continue;
+        }
+
+        // back edges come from blocks not visited yet, the header scale stands in for them
+        double frequency = 0.0;
+        for (block_id pred : b.predecessors)
+        {
+            if (is_header[block] && loops.contains(loops.loop_of(block), pred))
+                continue;
+
+            double probabilities[2];
+            successor_probabilities(function, loops, pred, probabilities);
+            const ir_instruction* terminator = function.terminator(pred);
+            for (size_t i = 0; i < 2; ++i)
+            {
+                if (terminator && terminator->targets[i] == block)
+                    frequency += frequencies[pred] * probabilities[i];
+            }
+        }
+        frequencies[block] = is_header[block] ? frequency * loop_header_scale : frequency;
+    }
+    return frequencies;
+}
+
+// flips the condition of the branch in block, false if that would need another instruction
+static bool invert_branch(ir_function& function, block_id block, const std::vector<int32_t>& uses)
+{
+    ir_instruction& branch    = function.values[function.blocks[block].instructions.back()];
+    value_id condition        = branch.operands[0];
+    ir_instruction& compare   = function.values[condition];
+    bool integer_operands     = !compare.operands.empty() && function.values[compare.operands[0]].type != ir_type::f32;
+    if (uses[condition] != 1)
+        return false;
+
+    // inverting an ordered f32 comparison is wrong for nan
+    switch (compare.opcode)
+    {
+    case ir_opcode::eq:
+        compare.opcode = ir_opcode::ne;
+        break;
+    case ir_opcode::ne:
+        compare.opcode = ir_opcode::eq;
+        break;
+    case ir_opcode::lt:
+    case ir_opcode::gt:
+    case ir_opcode::le:
+    case ir_opcode::ge:
+        if (!integer_operands)
+            return false;
+        compare.opcode = compare.opcode == ir_opcode::lt ? ir_opcode::ge : compare.opcode == ir_opcode::gt ? ir_opcode::le : compare.opcode == ir_opcode::le ? ir_opcode::gt : ir_opcode::lt;
+        break;
+    case ir_opcode::lnot:
+        branch.operands[0] = compare.operands[0];
+        function.remove(condition);
+        break;
+    default:
+        return false;
+    }
+
+    std::swap(branch.targets[0], branch.targets[1]);
+    ir_block& b = function.blocks[block];
+    if (b.count >= 0 && b.taken >= 0)
+        b.taken = b.count - b.taken;
+    return true;
+}
+
+size_t layout_blocks(ir_function& function, const dominator_tree& dominators, const loop_analysis& loops)
+{
+    std::vector<double> frequencies = block_frequencies(function, dominators, loops);
+
+    struct edge
+    {
+        block_id from;
+        block_id to;
+        double weight;
+    };
+    std::vector<edge> edges;
+    for (block_id block : dominators.reverse_postorder())
+    {
+        double probabilities[2];
+        successor_probabilities(function, loops, block, probabilities);
+        const ir_instruction* terminator = function.terminator(block);
+        for (size_t i = 0; i < 2; ++i)
+        {
+            double weight = frequencies[block] * probabilities[i];
+            if (weight > 0.0 && terminator->targets[i] != 0)
+                edges.push_back({ block, terminator->targets[i], weight });
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const edge& a, const edge& b) { return a.weight > b.weight; });
+
+    // the heaviest edges join chains first, an edge joins the end of one chain to the start of another
+    std::vector<std::vector<block_id>> chains(function.blocks.size());
+    std::vector<size_t> chain_of(function.blocks.size());
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        chains[block].push_back(block);
+        chain_of[block] = block;
+    }
+    for (const edge& e : edges)
+    {
+        size_t from = chain_of[e.from];
+        size_t to   = chain_of[e.to];
+        if (from == to || chains[from].back() != e.from || chains[to].front() != e.to)
+            continue;
+        for (block_id block : chains[to])
+            chain_of[block] = from;
+        chains[from].insert(chains[from].end(), chains[to].begin(), chains[to].end());
+        chains[to].clear();
+    }
+
+    // the entry chain first, then the others from hot to cold
+    std::vector<size_t> order;
+    for (size_t chain = 1; chain < chains.size(); ++chain)
+    {
+        if (!chains[chain].empty())
+            order.push_back(chain);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return frequencies[chains[a].front()] > frequencies[chains[b].front()]; });
+    order.insert(order.begin(), 0);
+
+    std::vector<block_id> layout;
+    for (size_t chain : order)
+        layout.insert(layout.end(), chains[chain].begin(), chains[chain].end());
+
+    size_t changed = 0;
+    for (size_t i = 0; i < layout.size(); ++i)
+    {
+        if (layout[i] != static_cast<block_id>(i))
+            ++changed;
+    }
+    if (changed > 0)
+        function.reorder_blocks(layout);
+
+    std::vector<int32_t> uses = function.use_counts();
+    for (block_id block = 0; block + 1 < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const ir_instruction* terminator = function.terminator(block);
+        if (terminator && terminator->opcode == ir_opcode::branch && terminator->targets[0] == block + 1 && terminator->targets[1] != block + 1 && invert_branch(function, block, uses))
+            ++changed;
+    }
+    return changed;
+}
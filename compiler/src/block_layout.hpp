@@ -0,0 +1,25 @@
+//! \file      block_layout.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef BLOCK_LAYOUT_HPP
+#define BLOCK_LAYOUT_HPP
+
+#include "dominator_tree.hpp"
+#include "ir.hpp"
+#include "loop_analysis.hpp"
+
+// A code generator emits the blocks in order, jumps to the next block are free
+// and a branch jumps to its first target and falls through to the second one.
+
+// estimated executions of every block, the counts of a profile where there are some
+std::vector<double> block_frequencies(const ir_function& function, const dominator_tree& dominators, const loop_analysis& loops);
+
+// Chains the blocks along their most frequent edges, so hot paths fall through and cold blocks end up last.
+// Branches whose first target follows them are inverted where the condition can be flipped.
+// Block ids change, returns the number of moved blocks and inverted branches.
+size_t layout_blocks(ir_function& function, const dominator_tree& dominators, const loop_analysis& loops);
+
+#endif BLOCK_LAYOUT_HPP
@@ -0,0 +1,224 @@
+//! \file      bytecode.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "bytecode.hpp"
+#include "binary_stream.hpp"
+
+static const uint32_t bytecode_version = 2;
+
+static void write_ids(binary_writer& writer, const std::vector<int32_t>& ids)
+{
+    writer.write_u32(static_cast<uint32_t>(ids.size()));
+    for (int32_t id : ids)
+        writer.write_i32(id);
+}
+
+static std::vector<int32_t> read_ids(binary_reader& reader)
+{
+    std::vector<int32_t> ids(reader.read_count(4));
+    for (int32_t& id : ids)
+        id = reader.read_i32();
+    return ids;
+}
+
+static void write_function(binary_writer& writer, const ir_function& function)
+{
+    writer.write_string(function.name);
+    writer.write_string(function.link_name);
+    writer.write_u8(function.is_external ? 1 : 0);
+    writer.write_u8(function.is_method ? 1 : 0);
+    writer.write_u32(static_cast<uint32_t>(function.parameters.size()));
+    for (ir_type parameter : function.parameters)
+        writer.write_u8(static_cast<uint8_t>(parameter));
+    writer.write_u8(static_cast<uint8_t>(function.result));
+    writer.write_i32(function.owner);
+    writer.write_i32(function.overrides);
+
+    writer.write_u32(static_cast<uint32_t>(function.blocks.size()));
+    for (const ir_block& block : function.blocks)
+    {
+        write_ids(writer, block.instructions);
+        write_ids(writer, block.predecessors);
+    }
+
+    writer.write_u32(static_cast<uint32_t>(function.values.size()));
+    for (const ir_instruction& instr : function.values)
+    {
+        writer.write_u8(static_cast<uint8_t>(instr.opcode));
+        writer.write_u8(static_cast<uint8_t>(instr.type));
+        write_ids(writer, instr.operands);
+        writer.write_i32(instr.immediate);
+        writer.write_i32(instr.aux);
+        writer.write_f32(instr.fimmediate);
+        writer.write_i32(instr.targets[0]);
+        writer.write_i32(instr.targets[1]);
+        writer.write_i32(instr.block);
+        writer.write_i32(instr.position.line);
+        writer.write_i32(instr.position.inline_offset);
+    }
+}
+
+static void read_function(binary_reader& reader, ir_function& function)
+{
+    function.name        = reader.read_string();
+    function.link_name   = reader.read_string();
+    function.is_external = reader.read_u8() != 0;
+    function.is_method   = reader.read_u8() != 0;
+    function.parameters.resize(reader.read_count());
+    for (ir_type& parameter : function.parameters)
+        parameter = static_cast<ir_type>(reader.read_u8());
+    function.result    = static_cast<ir_type>(reader.read_u8());
+    function.owner     = reader.read_i32();
+    function.overrides = reader.read_i32();
+
+    function.blocks.resize(reader.read_count(8));
+    for (ir_block& block : function.blocks)
+    {
+        block.instructions = read_ids(reader);
+        block.predecessors = read_ids(reader);
+    }
+
+    function.values.resize(reader.read_count(38));
+    for (ir_instruction& instr : function.values)
+    {
+        instr.opcode                 = static_cast<ir_opcode>(reader.read_u8());
+        instr.type                   = static_cast<ir_type>(reader.read_u8());
+        instr.operands               = read_ids(reader);
+        instr.immediate              = reader.read_i32();
+        instr.aux                    = reader.read_i32();
+        instr.fimmediate             = reader.read_f32();
+        instr.targets[0]             = reader.read_i32();
+        instr.targets[1]             = reader.read_i32();
+        instr.block                  = reader.read_i32();
+        instr.position.line          = reader.read_i32();
+        instr.position.inline_offset = reader.read_i32();
+    }
+}
+
+void write_bytecode(std::ostream& out, const ir_module& module)
+{
+    binary_writer writer;
+    writer.bytes.append("PPLB");
+    writer.write_u32(bytecode_version);
+    writer.write_i32(module.main);
+    writer.write_i32(module.init);
+
+    writer.write_u32(static_cast<uint32_t>(module.globals.size()));
+    for (size_t i = 0; i < module.globals.size(); ++i)
+    {
+        writer.write_string(module.globals[i].name);
+        writer.write_u8(static_cast<uint8_t>(module.globals[i].type));
+        writer.write_i32(module.global_arrays[i]);
+    }
+
+    writer.write_u32(static_cast<uint32_t>(module.arrays.size()));
+    for (const ir_array_type& array : module.arrays)
+    {
+        writer.write_u8(static_cast<uint8_t>(array.element));
+        writer.write_i32(array.length);
+        writer.write_i32(array.element_array);
+    }
+
+    writer.write_u32(static_cast<uint32_t>(module.classes.size()));
+    for (const ir_class& cls : module.classes)
+    {
+        writer.write_string(cls.name);
+        writer.write_i32(cls.base);
+        writer.write_u32(static_cast<uint32_t>(cls.field_names.size()));
+        for (size_t i = 0; i < cls.field_names.size(); ++i)
+        {
+            writer.write_string(cls.field_names[i]);
+            writer.write_u8(static_cast<uint8_t>(cls.field_types[i]));
+            writer.write_i32(cls.field_arrays[i]);
+        }
+        write_ids(writer, cls.methods);
+    }
+
+    writer.write_u32(static_cast<uint32_t>(module.strings.size()));
+    for (const std::string& str : module.strings)
+        writer.write_string(str);
+
+    writer.write_u32(static_cast<uint32_t>(module.formats.size()));
+    for (const ir_format& format : module.formats)
+    {
+        writer.write_i32(format.text);
+        writer.write_u32(static_cast<uint32_t>(format.segments.size()));
+        for (const std::string& segment : format.segments)
+            writer.write_string(segment);
+    }
+
+    writer.write_u32(static_cast<uint32_t>(module.functions.size()));
+    for (const ir_function& function : module.functions)
+        write_function(writer, function);
+
+    writer.write_to(out);
+}
+
+bool read_bytecode(std::istream& in, ir_module& module)
+{
+    binary_reader reader(in);
+    if (reader.data().compare(0, 4, "PPLB") != 0)
+        return false;
+    reader.read_u32(); // magic
+    if (reader.read_u32() != bytecode_version)
+        return false;
+
+    module      = ir_module();
+    module.main = reader.read_i32();
+    module.init = reader.read_i32();
+
+    uint32_t globals = reader.read_count(9);
+    for (uint32_t i = 0; i < globals; ++i)
+    {
+        ir_global global;
+        global.name = reader.read_string();
+        global.type = static_cast<ir_type>(reader.read_u8());
+        module.globals.push_back(std::move(global));
+        module.global_arrays.push_back(reader.read_i32());
+    }
+
+    module.arrays.resize(reader.read_count(9));
+    for (ir_array_type& array : module.arrays)
+    {
+        array.element       = static_cast<ir_type>(reader.read_u8());
+        array.length        = reader.read_i32();
+        array.element_array = reader.read_i32();
+    }
+
+    module.classes.resize(reader.read_count(12));
+    for (ir_class& cls : module.classes)
+    {
+        cls.name        = reader.read_string();
+        cls.base        = reader.read_i32();
+        uint32_t fields = reader.read_count(9);
+        for (uint32_t i = 0; i < fields; ++i)
+        {
+            cls.field_names.push_back(reader.read_string());
+            cls.field_types.push_back(static_cast<ir_type>(reader.read_u8()));
+            cls.field_arrays.push_back(reader.read_i32());
+        }
+        cls.methods = read_ids(reader);
+    }
+
+    module.strings.resize(reader.read_count(4));
+    for (std::string& str : module.strings)
+        str = reader.read_string();
+
+    module.formats.resize(reader.read_count(8));
+    for (ir_format& format : module.formats)
+    {
+        format.text = reader.read_i32();
+        format.segments.resize(reader.read_count(4));
+        for (std::string& segment : format.segments)
+            segment = reader.read_string();
+    }
+
+    module.functions.resize(reader.read_count(20));
+    for (ir_function& function : module.functions)
+        read_function(reader, function);
+
+    return !reader.failed();
+}
@@ -0,0 +1,24 @@
+//! \file      bytecode.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "ir.hpp"
+#include <iostream>
+
+// Binary form of a module as the ir_builder left it, before instrumentation and before any pass.
+// Imported modules are stored like this and linked into the program, which is optimized as a whole.
+// Analysis results, registers and profile counts are not stored.
+//
+//   "PPLB", u32 version, i32 main, i32 init, the globals, array types, classes, strings, formats and functions,
+//   every list as u32 count and its elements, integers little endian, strings u32 length + bytes
+void write_bytecode(std::ostream& out, const ir_module& module);
+
+// returns false if the file is malformed or of another version
+bool read_bytecode(std::istream& in, ir_module& module);
+
+#endif BYTECODE_HPP
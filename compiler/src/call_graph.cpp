@@ -0,0 +1,98 @@
+//! \file      call_graph.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "call_graph.hpp"
+#include <algorithm>
+
+call_graph::call_graph(const ir_module& module)
+    : edges(module.functions.size())
+    , sites(module.functions.size(), 0)
+    , components(module.functions.size(), -1)
+    , recursive(module.functions.size(), false)
+    , index(module.functions.size(), -1)
+    , low_link(module.functions.size(), -1)
+    , on_stack(module.functions.size(), false)
+    , next_index(0)
+{
+    for (function_id caller = 0; caller < static_cast<function_id>(module.functions.size()); ++caller)
+    {
+        const ir_function& function = module.functions[caller];
+        for (const ir_block& block : function.blocks)
+        {
+            for (value_id value : block.instructions)
+            {
+                const ir_instruction& instr = function.values[value];
+                if (instr.opcode == ir_opcode::call)
+                {
+                    edges[caller].push_back(instr.immediate);
+                    ++sites[instr.immediate];
+                }
+                else if (instr.opcode == ir_opcode::call_method)
+                {
+                    // every override can be the target
+                    function_id root = module.root_method(instr.immediate);
+                    for (function_id callee = 0; callee < static_cast<function_id>(module.functions.size()); ++callee)
+                    {
+                        if (module.functions[callee].is_method && module.root_method(callee) == root)
+                            edges[caller].push_back(callee);
+                    }
+                }
+            }
+        }
+
+        std::sort(edges[caller].begin(), edges[caller].end());
+        edges[caller].erase(std::unique(edges[caller].begin(), edges[caller].end()), edges[caller].end());
+    }
+
+    for (function_id function = 0; function < static_cast<function_id>(edges.size()); ++function)
+    {
+        if (index[function] == -1)
+            strong_connect(function);
+    }
+}
+
+void call_graph::strong_connect(function_id function)
+{
+    index[function]    = next_index;
+    low_link[function] = next_index;
+    ++next_index;
+    stack.push_back(function);
+    on_stack[function] = true;
+
+    for (function_id callee : edges[function])
+    {
+        if (index[callee] == -1)
+        {
+            strong_connect(callee);
+            low_link[function] = std::min(low_link[function], low_link[callee]);
+        }
+        else if (on_stack[callee])
+        {
+            low_link[function] = std::min(low_link[function], index[callee]);
+        }
+    }
+
+    if (low_link[function] != index[function])
+        return;
+
+    // components are completed callees first
+    std::vector<function_id> component;
+    function_id member = -1;
+    do
+    {
+        member = stack.back();
+        stack.pop_back();
+        on_stack[member]   = false;
+        components[member] = static_cast<int32_t>(order.size());
+        component.push_back(member);
+    } while (member != function);
+
+    for (function_id f : component)
+    {
+        recursive[f] = component.size() > 1 || std::find(edges[f].begin(), edges[f].end(), f) != edges[f].end();
+    }
+    order.push_back(std::move(component));
+}
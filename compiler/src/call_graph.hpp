@@ -0,0 +1,65 @@
+//! \file      call_graph.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef CALL_GRAPH_HPP
+#define CALL_GRAPH_HPP
+
+#include "ir.hpp"
+
+// Calls between the functions of a module, virtual calls reach every implementation of the method.
+// Functions calling each other are grouped into strongly connected components.
+class call_graph
+{
+  public:
+    call_graph(const ir_module& module);
+    ~call_graph() = default;
+
+    const std::vector<function_id>& callees(function_id function) const
+    {
+        return edges[function];
+    }
+
+    // number of direct call instructions calling the function
+    int32_t call_sites(function_id function) const
+    {
+        return sites[function];
+    }
+
+    int32_t component(function_id function) const
+    {
+        return components[function];
+    }
+
+    // true if the function can call itself, directly or through other functions
+    bool is_recursive(function_id function) const
+    {
+        return recursive[function];
+    }
+
+    // components ordered bottom up, callees before their callers
+    const std::vector<std::vector<function_id>>& bottom_up() const
+    {
+        return order;
+    }
+
+  private:
+    void strong_connect(function_id function);
+
+    std::vector<std::vector<function_id>> edges;
+    std::vector<int32_t> sites;
+    std::vector<int32_t> components;
+    std::vector<bool> recursive;
+    std::vector<std::vector<function_id>> order;
+
+    // tarjan's algorithm
+    std::vector<int32_t> index;
+    std::vector<int32_t> low_link;
+    std::vector<bool> on_stack;
+    std::vector<function_id> stack;
+    int32_t next_index;
+};
+
+#endif CALL_GRAPH_HPP
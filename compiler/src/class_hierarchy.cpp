@@ -0,0 +1,180 @@
+//! \file      class_hierarchy.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "class_hierarchy.hpp"
+#include <algorithm>
+#include <set>
+
+static constexpr int32_t any_class = -2;
+
+class_hierarchy::class_hierarchy(const ir_module& module)
+    : module(module)
+    , subclasses(module.classes.size())
+{
+    for (int32_t cls = 0; cls < static_cast<int32_t>(module.classes.size()); ++cls)
+    {
+        if (module.classes[cls].base != -1)
+            subclasses[module.classes[cls].base].push_back(cls);
+    }
+}
+
+function_id class_hierarchy::resolve(function_id method, int32_t exact_class) const
+{
+    function_id root = module.root_method(method);
+    for (int32_t cls = exact_class; cls != -1; cls = module.classes[cls].base)
+    {
+        for (function_id candidate : module.classes[cls].methods)
+        {
+            if (module.root_method(candidate) == root)
+                return candidate;
+        }
+    }
+    return method;
+}
+
+std::vector<function_id> class_hierarchy::implementations(function_id method, int32_t static_class) const
+{
+    function_id root = module.root_method(method);
+
+    // the inherited implementation and every override below the static class
+    std::vector<function_id> result = { resolve(method, static_class) };
+    std::vector<int32_t> stack      = subclasses[static_class];
+    while (!stack.empty())
+    {
+        int32_t cls = stack.back();
+        stack.pop_back();
+
+        for (function_id candidate : module.classes[cls].methods)
+        {
+            if (module.root_method(candidate) == root && std::find(result.begin(), result.end(), candidate) == result.end())
+                result.push_back(candidate);
+        }
+        stack.insert(stack.end(), subclasses[cls].begin(), subclasses[cls].end());
+    }
+    return result;
+}
+
+// class of the objects a value can hold if it is always the same, -1 if unknown
+static int32_t exact_class(const ir_function& function, value_id value, std::vector<bool>& visiting)
+{
+    const ir_instruction& instr = function.values[value];
+    switch (instr.opcode)
+    {
+    case ir_opcode::new_object:
+        return instr.immediate;
+    case ir_opcode::copy:
+        return exact_class(function, instr.operands[0], visiting);
+    case ir_opcode::phi:
+    {
+        // a phi reached again in a loop does not add another class
+        if (visiting[value])
+            return any_class;
+        visiting[value] = true;
+
+        int32_t result = any_class;
+        for (value_id operand : instr.operands)
+        {
+            int32_t cls = exact_class(function, operand, visiting);
+            if (cls == any_class)
+                continue;
+            if (cls == -1 || (result != any_class && result != cls))
+            {
+                result = -1;
+                break;
+            }
+            result = cls;
+        }
+
+        visiting[value] = false;
+        return result;
+    }
+    default:
+        return -1;
+    }
+}
+
+size_t devirtualize(ir_module& module, const class_hierarchy& hierarchy)
+{
+    size_t devirtualized = 0;
+    for (ir_function& function : module.functions)
+    {
+        std::vector<bool> visiting(function.values.size(), false);
+        for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+        {
+            for (size_t i = 0; i < function.blocks[block].instructions.size(); ++i)
+            {
+                value_id value              = function.blocks[block].instructions[i];
+                const ir_instruction& instr = function.values[value];
+                if (instr.opcode != ir_opcode::call_method)
+                    continue;
+
+                function_id target = -1;
+                int32_t receiver   = exact_class(function, instr.operands[0], visiting);
+                if (receiver >= 0)
+                {
+                    target = hierarchy.resolve(instr.immediate, receiver);
+                }
+                else if (instr.aux >= 0)
+                {
+                    std::vector<function_id> targets = hierarchy.implementations(instr.immediate, instr.aux);
+                    if (targets.size() == 1)
+                        target = targets[0];
+                }
+                if (target == -1)
+                    continue;
+
+                // the virtual call traps on a null receiver, the direct call does not look at it
+                ir_instruction check;
+                check.opcode   = ir_opcode::check_null;
+                check.operands = { instr.operands[0] };
+                check.block    = block;
+                check.position = instr.position;
+                value_id id    = function.add_value(std::move(check));
+                function.blocks[block].instructions.insert(function.blocks[block].instructions.begin() + i++, id);
+
+                function.values[value].opcode    = ir_opcode::call;
+                function.values[value].immediate = target;
+                ++devirtualized;
+            }
+        }
+    }
+    return devirtualized;
+}
+
+void layout_vtables(ir_module& module, const class_hierarchy& hierarchy)
+{
+    std::set<function_id> virtual_roots;
+    for (ir_function& function : module.functions)
+    {
+        function.vtable_slot = -1;
+        for (const ir_block& block : function.blocks)
+        {
+            for (value_id value : block.instructions)
+            {
+                if (function.values[value].opcode == ir_opcode::call_method)
+                    virtual_roots.insert(module.root_method(function.values[value].immediate));
+            }
+        }
+    }
+
+    // bases are declared before derived classes, derived vtables extend the vtable of their base
+    for (int32_t cls = 0; cls < static_cast<int32_t>(module.classes.size()); ++cls)
+    {
+        ir_class& current = module.classes[cls];
+        current.vtable    = current.base != -1 ? module.classes[current.base].vtable : std::vector<function_id>{};
+        for (function_id& slot : current.vtable)
+            slot = hierarchy.resolve(slot, cls);
+
+        for (function_id method : current.methods)
+        {
+            if (virtual_roots.count(method))
+            {
+                module.functions[method].vtable_slot = static_cast<int32_t>(current.vtable.size());
+                current.vtable.push_back(method);
+            }
+        }
+    }
+}
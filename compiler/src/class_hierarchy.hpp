@@ -0,0 +1,37 @@
+//! \file      class_hierarchy.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef CLASS_HIERARCHY_HPP
+#define CLASS_HIERARCHY_HPP
+
+#include "ir.hpp"
+
+// Class hierarchy analysis, knows which implementations a method call can reach.
+// The whole program is visible, so a method without overrides below the static receiver class is called directly.
+class class_hierarchy
+{
+  public:
+    class_hierarchy(const ir_module& module);
+    ~class_hierarchy() = default;
+
+    // implementation of method for an object of exactly the given class
+    function_id resolve(function_id method, int32_t exact_class) const;
+
+    // every implementation a call of method on a receiver of static_class or one of its subclasses can reach
+    std::vector<function_id> implementations(function_id method, int32_t static_class) const;
+
+  private:
+    const ir_module& module;
+    std::vector<std::vector<int32_t>> subclasses; // direct subclasses of every class
+};
+
+// turns virtual calls with a single possible target into direct calls, returns the number of devirtualized calls
+size_t devirtualize(ir_module& module, const class_hierarchy& hierarchy);
+
+// builds compact vtables, only methods still called virtually get a slot
+void layout_vtables(ir_module& module, const class_hierarchy& hierarchy);
+
+#endif CLASS_HIERARCHY_HPP
@@ -7,6 +7,7 @@
 #ifndef COMMAND_LINE_PARSER_HPP
 #define COMMAND_LINE_PARSER_HPP
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -35,6 +36,22 @@ class command_line_parser
         return std::string();
     }
 
+    // options in the form -name=value
+    bool cmd_prefix_exists(const std::string& prefix)
+    {
+        return std::find_if(this->argv.begin(), this->argv.end(), [&](const std::string& arg) { return arg.compare(0, prefix.size(), prefix) == 0; }) != this->argv.end();
+    }
+
+    std::string get_cmd_prefix_value(const std::string& prefix)
+    {
+        auto iter = std::find_if(this->argv.begin(), this->argv.end(), [&](const std::string& arg) { return arg.compare(0, prefix.size(), prefix) == 0; });
+        if (iter != this->argv.end())
+        {
+            return iter->substr(prefix.size());
+        }
+        return std::string();
+    }
+
   private:
     std::vector<std::string> argv;
 };
@@ -0,0 +1,148 @@
+//! \file      dead_code.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "dead_code.hpp"
+#include <algorithm>
+
+bool remove_dead_values(ir_function& function, effect_analysis& effects)
+{
+    // allocations of unused objects have no observable effect
+    auto is_root = [&](value_id value) {
+        const ir_instruction& instr = function.values[value];
+        if (instr.opcode == ir_opcode::new_array || instr.opcode == ir_opcode::new_object)
+            return false;
+        return instr.is_terminator() || (effects.summary(value) & ~effect_reads_memory) != 0;
+    };
+
+    std::vector<bool> live(function.values.size(), false);
+    std::vector<value_id> worklist;
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            if (is_root(value))
+            {
+                live[value] = true;
+                worklist.push_back(value);
+            }
+        }
+    }
+
+    while (!worklist.empty())
+    {
+        value_id value = worklist.back();
+        worklist.pop_back();
+        for (value_id operand : function.values[value].operands)
+        {
+            if (!live[operand])
+            {
+                live[operand] = true;
+                worklist.push_back(operand);
+            }
+        }
+    }
+
+    bool changed = false;
+    for (ir_block& block : function.blocks)
+    {
+        for (value_id value : std::vector<value_id>(block.instructions))
+        {
+            if (live[value])
+                continue;
+            function.remove(value);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+size_t strip_dead_functions(ir_module& module)
+{
+    std::vector<bool> live(module.functions.size(), false);
+    std::vector<function_id> worklist;
+    auto reach = [&](function_id function) {
+        if (function != -1 && !live[function])
+        {
+            live[function] = true;
+            worklist.push_back(function);
+        }
+    };
+    reach(module.main);
+    reach(module.init);
+
+    while (!worklist.empty())
+    {
+        function_id caller = worklist.back();
+        worklist.pop_back();
+
+        // virtual calls look up the slot of the root method
+        reach(module.functions[caller].overrides);
+
+        const ir_function& function = module.functions[caller];
+        for (const ir_block& block : function.blocks)
+        {
+            for (value_id value : block.instructions)
+            {
+                const ir_instruction& instr = function.values[value];
+                if (instr.opcode == ir_opcode::call)
+                {
+                    reach(instr.immediate);
+                }
+                else if (instr.opcode == ir_opcode::call_method)
+                {
+                    reach(instr.immediate);
+                    function_id root = module.root_method(instr.immediate);
+                    for (function_id callee = 0; callee < static_cast<function_id>(module.functions.size()); ++callee)
+                    {
+                        if (module.functions[callee].is_method && module.root_method(callee) == root)
+                            reach(callee);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<function_id> renumbered(module.functions.size(), -1);
+    std::vector<ir_function> kept;
+    for (function_id id = 0; id < static_cast<function_id>(module.functions.size()); ++id)
+    {
+        if (!live[id])
+            continue;
+        renumbered[id] = static_cast<function_id>(kept.size());
+        kept.push_back(std::move(module.functions[id]));
+    }
+    size_t removed   = module.functions.size() - kept.size();
+    module.functions = std::move(kept);
+
+    for (ir_function& function : module.functions)
+    {
+        if (function.overrides != -1)
+            function.overrides = renumbered[function.overrides];
+        for (ir_instruction& instr : function.values)
+        {
+            if (instr.opcode == ir_opcode::call || instr.opcode == ir_opcode::call_method)
+                instr.immediate = renumbered[instr.immediate];
+        }
+    }
+
+    // dead slots are never dispatched
+    for (ir_class& cls : module.classes)
+    {
+        std::vector<function_id> methods;
+        for (function_id method : cls.methods)
+        {
+            if (renumbered[method] != -1)
+                methods.push_back(renumbered[method]);
+        }
+        cls.methods = std::move(methods);
+        for (function_id& slot : cls.vtable)
+            slot = slot == -1 ? -1 : renumbered[slot];
+    }
+
+    module.main = module.main == -1 ? -1 : renumbered[module.main];
+    module.init = module.init == -1 ? -1 : renumbered[module.init];
+    return removed;
+}
@@ -0,0 +1,22 @@
+//! \file      dead_code.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef DEAD_CODE_HPP
+#define DEAD_CODE_HPP
+
+#include "effect_analysis.hpp"
+#include "ir.hpp"
+
+// Removes every instruction no side effect, trap or terminator depends on.
+// Unlike remove_unused_values this also removes phis only used by each other across loop iterations.
+// Calls of functions that only read memory are removed like loads.
+bool remove_dead_values(ir_function& function, effect_analysis& effects);
+
+// Removes the functions neither main nor the init function can reach, virtual calls reach every override.
+// Function ids change, returns the number of removed functions.
+size_t strip_dead_functions(ir_module& module);
+
+#endif DEAD_CODE_HPP
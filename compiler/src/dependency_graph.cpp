@@ -0,0 +1,151 @@
+//! \file      dependency_graph.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "dependency_graph.hpp"
+#include "binary_stream.hpp"
+#include <algorithm>
+
+static const std::vector<std::string> no_uses;
+
+static const identifier* declared_name(const expression& global)
+{
+    const expression* decl = &global;
+    if (decl->expr_type == expression_type::assign)
+        decl = decl->expressions[0].get();
+    if (!decl)
+        return nullptr;
+
+    if (decl->expr_type == expression_type::type_declaration)
+        return static_cast<const identifier*>(decl->expressions[0].get());
+    if (decl->expr_type == expression_type::declaration && decl->expressions.size() > 1 && decl->expressions[1])
+        return static_cast<const identifier*>(decl->expressions[1].get());
+    return nullptr;
+}
+
+dependency_graph::dependency_graph(const expression& program, const symbol_table& symbols, const type_table& types)
+    : symbols(symbols)
+    , types(types)
+{
+    for (auto& global : program.expressions)
+    {
+        const identifier* name = global ? declared_name(*global) : nullptr;
+        if (!name)
+            continue;
+
+        std::unordered_set<std::string> uses;
+        collect_uses(global.get(), uses);
+
+        node n{ global.get(), name->name, std::vector<std::string>(uses.begin(), uses.end()) };
+        std::sort(n.uses.begin(), n.uses.end());
+        node_index[global.get()] = nodes.size();
+        nodes.push_back(std::move(n));
+    }
+}
+
+const std::vector<std::string>& dependency_graph::uses(const expression* declaration) const
+{
+    auto it = node_index.find(declaration);
+    return it != node_index.end() ? nodes[it->second].uses : no_uses;
+}
+
+uint64_t dependency_graph::interface_hash(const std::string& name) const
+{
+    symbol_id sym = symbols.lookup(symbols.global, name);
+    return sym != invalid_id ? symbol_hash(sym) : 0;
+}
+
+void dependency_graph::print(std::ostream& out, const std::unordered_set<const expression*>& skipped) const
+{
+    for (const node& n : nodes)
+    {
+        if (skipped.count(n.declaration))
+            continue;
+
+        out << n.name << " ->";
+        for (size_t i = 0; i < n.uses.size(); ++i)
+            out << (i > 0 ? ", " : " ") << n.uses[i];
+        out << "\n";
+    }
+}
+
+void dependency_graph::collect_uses(const expression* expr, std::unordered_set<std::string>& uses) const
+{
+    if (!expr)
+        return;
+
+    symbol_id sym = invalid_id;
+    if (expr->expr_type == expression_type::identifier)
+        sym = static_cast<const identifier*>(expr)->symbol;
+    else if (expr->expr_type == expression_type::type_name)
+        sym = static_cast<const type_name*>(expr)->symbol;
+
+    if (sym != invalid_id)
+    {
+        std::string name = used_name(sym);
+        if (!name.empty())
+            uses.insert(std::move(name));
+    }
+
+    for (auto& child : expr->expressions)
+        collect_uses(child.get(), uses);
+}
+
+std::string dependency_graph::used_name(symbol_id sym) const
+{
+    const symbol& info = symbols.get(sym);
+    switch (info.kind)
+    {
+    case symbol_kind::global_variable:
+    case symbol_kind::function:
+    case symbol_kind::user_type:
+        // functions declared in blocks belong to the declaration around them
+        return info.scope == symbols.global ? symbols.name(sym) : std::string();
+    case symbol_kind::member:
+    case symbol_kind::method:
+    case symbol_kind::static_method:
+        return info.owner != invalid_id ? symbols.name(info.owner) : std::string();
+    default:
+        return std::string();
+    }
+}
+
+uint64_t dependency_graph::symbol_hash(symbol_id sym) const
+{
+    auto it = hashes.find(sym);
+    if (it != hashes.end())
+        return it->second;
+
+    const symbol& info = symbols.get(sym);
+    std::string description = to_string(info.kind) + " " + symbols.name(sym);
+
+    if (info.kind == symbol_kind::user_type)
+    {
+        // a changed base changes the layout and the methods of derived types
+        if (info.base != invalid_id)
+            description += " extends " + std::to_string(symbol_hash(info.base));
+
+        const expression* members = info.declaration ? info.declaration->expressions[2].get() : nullptr;
+        for (size_t i = 0; members && i < members->expressions.size(); ++i)
+        {
+            const expression* member = members->expressions[i].get();
+            const identifier* name   = member ? declared_name(*member) : nullptr;
+            if (!name || name->symbol == invalid_id)
+                continue;
+            const symbol& member_info = symbols.get(name->symbol);
+            description += "; " + to_string(member_info.kind) + " " + name->name + " " + types.to_string(member_info.type, symbols);
+        }
+    }
+    else
+    {
+        // every overload, in declaration order
+        for (symbol_id overload = sym; overload != invalid_id; overload = symbols.get(overload).next_overload)
+            description += "; " + types.to_string(symbols.get(overload).type, symbols);
+    }
+
+    uint64_t hash = stable_hash(description);
+    hashes[sym]   = hash;
+    return hash;
+}
@@ -0,0 +1,57 @@
+//! \file      dependency_graph.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef DEPENDENCY_GRAPH_HPP
+#define DEPENDENCY_GRAPH_HPP
+
+#include "ast.hpp"
+#include "symbol_table.hpp"
+#include "type_table.hpp"
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+// The top level declarations of a checked program and the top level names each of them uses.
+// Fields and methods are uses of their type, and all functions with a name are one node, since adding an overload can
+// change which one a call resolves to. The code built for a declaration only depends on its own source and on the
+// interface hashes of the names it uses, so it only has to be built again if one of them changed.
+class dependency_graph
+{
+  public:
+    dependency_graph(const expression& program, const symbol_table& symbols, const type_table& types);
+    ~dependency_graph() = default;
+
+    // sorted top level names the declaration uses, empty for unknown declarations
+    const std::vector<std::string>& uses(const expression* declaration) const;
+
+    // hash of what users of the name see: the signatures of the functions, the fields, methods and base of the type
+    // or the type of the global variable, 0 for names without a top level declaration
+    uint64_t interface_hash(const std::string& name) const;
+
+    // "name -> used, names" for every declaration not in skipped
+    void print(std::ostream& out, const std::unordered_set<const expression*>& skipped) const;
+
+  private:
+    struct node
+    {
+        const expression* declaration;
+        std::string name;
+        std::vector<std::string> uses;
+    };
+
+    void collect_uses(const expression* expr, std::unordered_set<std::string>& uses) const;
+    std::string used_name(symbol_id sym) const;
+    uint64_t symbol_hash(symbol_id sym) const;
+
+    const symbol_table& symbols;
+    const type_table& types;
+    std::vector<node> nodes;                                  // in program order
+    std::unordered_map<const expression*, size_t> node_index; // of each declaration
+    mutable std::unordered_map<symbol_id, uint64_t> hashes;   // of types, bases are hashed once
+};
+
+#endif DEPENDENCY_GRAPH_HPP
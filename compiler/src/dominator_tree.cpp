@@ -0,0 +1,88 @@
+//! \file      dominator_tree.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "dominator_tree.hpp"
+#include <algorithm>
+
+dominator_tree::dominator_tree(const ir_function& function)
+    : idoms(function.blocks.size(), -1)
+    , rpo_number(function.blocks.size(), -1)
+{
+    // iterative depth first search for the postorder
+    std::vector<bool> visited(function.blocks.size(), false);
+    std::vector<std::pair<block_id, size_t>> stack = { { 0, 0 } };
+    visited[0]                                     = true;
+    while (!stack.empty())
+    {
+        block_id block                  = stack.back().first;
+        std::vector<block_id> successors = function.successors(block);
+        if (stack.back().second < successors.size())
+        {
+            block_id succ = successors[stack.back().second++];
+            if (!visited[succ])
+            {
+                visited[succ] = true;
+                stack.push_back({ succ, 0 });
+            }
+            continue;
+        }
+        order.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i)
+        rpo_number[order[i]] = static_cast<int32_t>(i);
+
+    auto intersect = [&](block_id a, block_id b) {
+        while (a != b)
+        {
+            while (rpo_number[a] > rpo_number[b])
+                a = idoms[a];
+            while (rpo_number[b] > rpo_number[a])
+                b = idoms[b];
+        }
+        return a;
+    };
+
+    // the entry is its own dominator while iterating
+    idoms[0]     = 0;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 1; i < order.size(); ++i)
+        {
+            block_id block    = order[i];
+            block_id new_idom = -1;
+            for (block_id pred : function.blocks[block].predecessors)
+            {
+                if (idoms[pred] == -1)
+                    continue;
+                new_idom = new_idom == -1 ? pred : intersect(pred, new_idom);
+            }
+            if (new_idom != idoms[block])
+            {
+                idoms[block] = new_idom;
+                changed      = true;
+            }
+        }
+    }
+    idoms[0] = -1;
+}
+
+bool dominator_tree::dominates(block_id a, block_id b) const
+{
+    if (!is_reachable(b))
+        return false;
+
+    while (b != -1)
+    {
+        if (a == b)
+            return true;
+        b = idoms[b];
+    }
+    return false;
+}
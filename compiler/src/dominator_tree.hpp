@@ -0,0 +1,46 @@
+//! \file      dominator_tree.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef DOMINATOR_TREE_HPP
+#define DOMINATOR_TREE_HPP
+
+#include "ir.hpp"
+
+// Immediate dominators of the blocks of a function.
+// Uses the iterative algorithm of Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+class dominator_tree
+{
+  public:
+    dominator_tree(const ir_function& function);
+    ~dominator_tree() = default;
+
+    // -1 for the entry block and unreachable blocks
+    block_id immediate_dominator(block_id block) const
+    {
+        return idoms[block];
+    }
+
+    bool is_reachable(block_id block) const
+    {
+        return block == 0 || idoms[block] != -1;
+    }
+
+    // true if every path from the entry to b passes a, blocks dominate themselves
+    bool dominates(block_id a, block_id b) const;
+
+    // reachable blocks in reverse postorder, definitions come before their uses except in phis
+    const std::vector<block_id>& reverse_postorder() const
+    {
+        return order;
+    }
+
+  private:
+    std::vector<block_id> idoms;
+    std::vector<int32_t> rpo_number;
+    std::vector<block_id> order;
+};
+
+#endif DOMINATOR_TREE_HPP
@@ -0,0 +1,109 @@
+//! \file      effect_analysis.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "effect_analysis.hpp"
+#include "call_graph.hpp"
+
+// a depth first search reaching a block that is still open found a back edge
+static bool has_loop(const ir_function& function)
+{
+    std::vector<int8_t> state(function.blocks.size(), 0); // 0 unvisited, 1 open, 2 done
+    std::vector<std::pair<block_id, std::vector<block_id>>> stack;
+    stack.emplace_back(0, function.successors(0));
+    state[0] = 1;
+    while (!stack.empty())
+    {
+        std::vector<block_id>& successors = stack.back().second;
+        if (successors.empty())
+        {
+            state[stack.back().first] = 2;
+            stack.pop_back();
+            continue;
+        }
+
+        block_id succ = successors.back();
+        successors.pop_back();
+        if (state[succ] == 1)
+            return true;
+        if (state[succ] == 0)
+        {
+            state[succ] = 1;
+            stack.emplace_back(succ, function.successors(succ));
+        }
+    }
+    return false;
+}
+
+static effect_summary body_effects(const ir_function& function, const std::vector<effect_summary>& summaries)
+{
+    if (function.blocks.empty())
+        return effect_calls_function | effect_reads_memory | effect_writes_memory;
+
+    effect_summary summary = has_loop(function) ? effect_may_not_terminate : effect_none;
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            const ir_instruction& instr = function.values[value];
+            if (instr.opcode == ir_opcode::call)
+                summary |= summaries[instr.immediate];
+            else if (instr.is_terminator() && instr.opcode != ir_opcode::unreachable)
+                continue;
+            else
+                summary |= instruction_effects(instr);
+        }
+    }
+    return summary;
+}
+
+function_effects::function_effects(const ir_module& module)
+    : summaries(module.functions.size(), effect_none)
+{
+    // callees are summarized first, calls inside a component are repeated until no summary grows
+    call_graph graph(module);
+    for (const std::vector<function_id>& component : graph.bottom_up())
+    {
+        bool grown = true;
+        while (grown)
+        {
+            grown = false;
+            for (function_id id : component)
+            {
+                effect_summary summary = summaries[id] | body_effects(module.functions[id], summaries);
+                if (graph.is_recursive(id))
+                    summary |= effect_may_not_terminate;
+                grown         = grown || summary != summaries[id];
+                summaries[id] = summary;
+            }
+        }
+    }
+}
+
+effect_analysis::effect_analysis(const ir_function& function, const function_effects& callees)
+    : function(function)
+    , callees(callees)
+    , cache(function.values.size(), effect_unknown)
+{
+}
+
+effect_summary effect_analysis::summary(value_id value)
+{
+    if (cache.size() < function.values.size())
+        cache.resize(function.values.size(), effect_unknown);
+
+    if (cache[value] == effect_unknown)
+    {
+        const ir_instruction& instr = function.values[value];
+        cache[value]                = instr.opcode == ir_opcode::call ? callees.of(instr.immediate) : instruction_effects(instr);
+    }
+    return cache[value];
+}
+
+void effect_analysis::invalidate(value_id value)
+{
+    if (value < static_cast<value_id>(cache.size()))
+        cache[value] = effect_unknown;
+}
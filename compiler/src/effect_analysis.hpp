@@ -0,0 +1,57 @@
+//! \file      effect_analysis.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef EFFECT_ANALYSIS_HPP
+#define EFFECT_ANALYSIS_HPP
+
+#include "effects.hpp"
+#include "ir.hpp"
+
+// Effect summaries of the function bodies of a module, a direct call has the effects of its callee.
+// Loops and recursion may not terminate, branches and returns only transfer control inside the function.
+// Virtual calls and calls of functions without a body count as effect_calls_function with every memory effect.
+// Function passes only remove or move effects, so the summaries stay conservative until a module pass changes the module.
+class function_effects
+{
+  public:
+    function_effects(const ir_module& module);
+    ~function_effects() = default;
+
+    effect_summary of(function_id function) const
+    {
+        return summaries[function];
+    }
+
+  private:
+    std::vector<effect_summary> summaries;
+};
+
+// Effect summaries of the values of one function, computed on first query and cached per value.
+// Values added after the analysis are computed when they are queried.
+// A pass changing an instruction in place calls invalidate() on its value.
+class effect_analysis
+{
+  public:
+    effect_analysis(const ir_function& function, const function_effects& callees);
+    ~effect_analysis() = default;
+
+    effect_summary summary(value_id value);
+
+    bool is_pure(value_id value)
+    {
+        return ::is_pure(summary(value));
+    }
+
+    // marks the cached summary of value as outdated
+    void invalidate(value_id value);
+
+  private:
+    const ir_function& function;
+    const function_effects& callees;
+    std::vector<effect_summary> cache; // effect_unknown if not computed yet
+};
+
+#endif EFFECT_ANALYSIS_HPP
@@ -0,0 +1,36 @@
+//! \file      effects.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef EFFECTS_HPP
+#define EFFECTS_HPP
+
+#include <cstdint>
+
+// Side effects a piece of code can have, combined as bit flags.
+// An empty summary (effect_none) means the code is pure.
+enum effect : uint32_t
+{
+    effect_none              = 0,
+    effect_reads_memory      = 1 << 0, // reads variables or array elements
+    effect_writes_memory     = 1 << 1, // assigns variables or array elements
+    effect_may_not_terminate = 1 << 2, // contains loops
+    effect_calls_function    = 1 << 3, // contains function calls (including dump)
+    effect_transfers_control = 1 << 4, // returns, branches or traps
+
+    effect_unknown = 1u << 31, // not computed yet
+};
+
+using effect_summary = uint32_t;
+
+// code without these effects can be evaluated any number of times (or not at all) without changing the program
+static constexpr effect_summary effect_impure_mask = effect_writes_memory | effect_may_not_terminate | effect_calls_function | effect_transfers_control;
+
+inline bool is_pure(effect_summary summary)
+{
+    return (summary & effect_impure_mask) == 0;
+}
+
+#endif EFFECTS_HPP
@@ -0,0 +1,265 @@
+//! \file      escape_analysis.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "escape_analysis.hpp"
+#include <algorithm>
+#include <map>
+
+// more accessed slots stay in memory, every slot needs a phi at each merge
+static const size_t max_scalar_slots = 16;
+
+static bool is_allocation(const ir_instruction& instr)
+{
+    return instr.opcode == ir_opcode::new_array || instr.opcode == ir_opcode::new_object;
+}
+
+// instructions using each value
+static std::vector<std::vector<value_id>> find_users(const ir_function& function)
+{
+    std::vector<std::vector<value_id>> users(function.values.size());
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            for (value_id operand : function.values[value].operands)
+            {
+                if (users[operand].empty() || users[operand].back() != value)
+                    users[operand].push_back(value);
+            }
+        }
+    }
+    return users;
+}
+
+// true if user only reads or writes the object of allocation
+static bool is_access(const ir_instruction& user, value_id allocation)
+{
+    switch (user.opcode)
+    {
+    case ir_opcode::load_field:
+    case ir_opcode::load_element:
+    case ir_opcode::load_vector:
+        return true;
+    case ir_opcode::store_field:
+    case ir_opcode::store_element:
+    case ir_opcode::store_vector:
+        // storing the reference itself lets it escape
+        return user.operands[0] == allocation && user.operands.back() != allocation;
+    default:
+        return false;
+    }
+}
+
+static bool escapes(const ir_function& function, value_id allocation, const std::vector<value_id>& users)
+{
+    for (value_id user : users)
+    {
+        const ir_instruction& instr = function.values[user];
+        if (is_access(instr, allocation) || instr.opcode == ir_opcode::eq || instr.opcode == ir_opcode::ne || instr.opcode == ir_opcode::dump || instr.opcode == ir_opcode::check_null)
+            continue;
+        return true;
+    }
+    return false;
+}
+
+static value_id zero_constant(ir_function& function, ir_type type, block_id block, source_code_position position)
+{
+    ir_instruction zero;
+    zero.opcode    = ir_opcode::constant;
+    zero.type      = type;
+    zero.immediate = type == ir_type::ref ? -1 : 0;
+    zero.block     = block;
+    zero.position  = position;
+    return function.add_value(std::move(zero));
+}
+
+// slot of a field or constant index access, -1 if the access needs the object in memory
+static int32_t slot_of(const ir_function& function, const ir_instruction& access, int32_t length)
+{
+    if (access.opcode == ir_opcode::load_field || access.opcode == ir_opcode::store_field)
+        return access.immediate;
+    if (access.opcode != ir_opcode::load_element && access.opcode != ir_opcode::store_element)
+        return -1;
+
+    const ir_instruction& index = function.values[access.operands[1]];
+    if (index.opcode != ir_opcode::constant || index.immediate < 0 || index.immediate >= length)
+        return -1;
+    return index.immediate;
+}
+
+// one variable per slot, built like the ssa form of local variables: phis at merges, loads read the current value
+static void replace_allocation(ir_function& function, const dominator_tree& dominators, value_id allocation, const std::map<int32_t, ir_type>& slots, const std::vector<value_id>& initial)
+{
+    block_id home = function.values[allocation].block;
+    std::vector<std::vector<value_id>> exits(function.blocks.size());
+    std::map<int32_t, size_t> slot_index;
+    for (const auto& slot : slots)
+        slot_index.emplace(slot.first, slot_index.size());
+
+    struct pending_phi
+    {
+        value_id phi;
+        size_t slot;
+    };
+    std::vector<pending_phi> pending;
+
+    for (block_id block : dominators.reverse_postorder())
+    {
+        if (!dominators.dominates(home, block))
+            continue;
+
+        std::vector<value_id> current = initial;
+        const ir_block& b             = function.blocks[block];
+        if (block != home && b.predecessors.size() == 1)
+        {
+            current = exits[b.predecessors[0]];
+        }
+        else if (block != home)
+        {
+            std::vector<value_id> phis;
+            for (const auto& slot : slots)
+            {
+                ir_instruction phi;
+                phi.opcode   = ir_opcode::phi;
+                phi.type     = slot.second;
+                phi.block    = block;
+                phi.position = function.values[allocation].position;
+
+                size_t index   = slot_index[slot.first];
+                current[index] = function.add_value(std::move(phi));
+                phis.push_back(current[index]);
+                pending.push_back({ current[index], index });
+            }
+            function.blocks[block].instructions.insert(function.blocks[block].instructions.begin(), phis.begin(), phis.end());
+        }
+
+        // the home block starts right after the allocation
+        const std::vector<value_id> instructions = function.blocks[block].instructions;
+        size_t first                             = 0;
+        if (block == home)
+            first = std::find(instructions.begin(), instructions.end(), allocation) - instructions.begin() + 1;
+
+        for (size_t i = first; i < instructions.size(); ++i)
+        {
+            value_id value        = instructions[i];
+            ir_instruction& instr = function.values[value];
+            if (instr.operands.empty() || instr.operands[0] != allocation)
+                continue;
+
+            size_t slot = slot_index[instr.opcode == ir_opcode::load_field || instr.opcode == ir_opcode::store_field ? instr.immediate : function.values[instr.operands[1]].immediate];
+            if (instr.opcode == ir_opcode::store_field || instr.opcode == ir_opcode::store_element)
+            {
+                current[slot] = instr.operands.back();
+            }
+            else
+            {
+                function.replace_all_uses(value, current[slot]);
+            }
+            function.remove(value);
+        }
+        exits[block] = current;
+    }
+
+    for (const pending_phi& entry : pending)
+    {
+        block_id block = function.values[entry.phi].block;
+        for (block_id predecessor : function.blocks[block].predecessors)
+        {
+            value_id incoming = exits[predecessor].empty() ? initial[entry.slot] : exits[predecessor][entry.slot];
+            function.values[entry.phi].operands.push_back(incoming);
+        }
+    }
+    function.remove(allocation);
+}
+
+size_t replace_aggregates(ir_function& function, const ir_module& module, const dominator_tree& dominators)
+{
+    std::vector<std::vector<value_id>> users = find_users(function);
+    size_t replaced                          = 0;
+
+    for (block_id block : dominators.reverse_postorder())
+    {
+        for (value_id allocation : std::vector<value_id>(function.blocks[block].instructions))
+        {
+            const ir_instruction& instr = function.values[allocation];
+            if (!is_allocation(instr))
+                continue;
+
+            // array fields and nested arrays are separate objects whose references can escape
+            int32_t length = 0;
+            if (instr.opcode == ir_opcode::new_array)
+            {
+                const ir_array_type& array = module.arrays[instr.immediate];
+                if (array.element_array != -1)
+                    continue;
+                length = array.length;
+            }
+            else
+            {
+                const ir_class& cls = module.classes[instr.immediate];
+                if (std::any_of(cls.field_arrays.begin(), cls.field_arrays.end(), [](int32_t array) { return array != -1; }))
+                    continue;
+            }
+
+            std::map<int32_t, ir_type> slots;
+            bool replaceable = true;
+            for (value_id user : users[allocation])
+            {
+                const ir_instruction& access = function.values[user];
+                int32_t slot                 = is_access(access, allocation) ? slot_of(function, access, length) : -1;
+                if (slot == -1)
+                {
+                    replaceable = false;
+                    break;
+                }
+                slots[slot] = instr.opcode == ir_opcode::new_array ? module.arrays[instr.immediate].element : module.classes[instr.immediate].field_types[slot];
+            }
+            if (!replaceable || slots.size() > max_scalar_slots)
+                continue;
+
+            // the fill of arrays initializes every element
+            std::vector<value_id> initial;
+            for (const auto& slot : slots)
+            {
+                const ir_instruction& allocated = function.values[allocation];
+                if (!allocated.operands.empty())
+                {
+                    initial.push_back(allocated.operands[0]);
+                    continue;
+                }
+                value_id zero                       = zero_constant(function, slot.second, block, allocated.position);
+                std::vector<value_id>& instructions = function.blocks[block].instructions;
+                instructions.insert(std::find(instructions.begin(), instructions.end(), allocation), zero);
+                initial.push_back(zero);
+            }
+
+            replace_allocation(function, dominators, allocation, slots, initial);
+            ++replaced;
+        }
+    }
+    return replaced;
+}
+
+size_t allocate_on_stack(ir_function& function, const loop_analysis& loops)
+{
+    std::vector<std::vector<value_id>> users = find_users(function);
+    size_t marked                            = 0;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        if (loops.loop_of(block) != -1)
+            continue;
+
+        for (value_id value : function.blocks[block].instructions)
+        {
+            ir_instruction& instr = function.values[value];
+            if (!is_allocation(instr) || escapes(function, value, users[value]))
+                continue;
+            instr.aux = stack_allocation;
+            ++marked;
+        }
+    }
+    return marked;
+}
@@ -0,0 +1,27 @@
+//! \file      escape_analysis.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef ESCAPE_ANALYSIS_HPP
+#define ESCAPE_ANALYSIS_HPP
+
+#include "dominator_tree.hpp"
+#include "ir.hpp"
+#include "loop_analysis.hpp"
+
+// Escape analysis of the objects and arrays a function allocates.
+// A reference escapes if it is stored, returned, passed to a call or merged by a phi or select.
+// Loads, stores, comparisons and dumps only use the object while the function runs.
+
+// Replaces allocations only accessed through fields and constant indices by one ssa value per accessed slot.
+// Returns the number of removed allocations.
+size_t replace_aggregates(ir_function& function, const ir_module& module, const dominator_tree& dominators);
+
+// Marks the remaining allocations that do not escape, the interpreter frees them when their frame returns.
+// Allocations in loops stay on the heap, the collector frees them while the frame would keep every iteration's object.
+// Returns the number of marked allocations.
+size_t allocate_on_stack(ir_function& function, const loop_analysis& loops);
+
+#endif ESCAPE_ANALYSIS_HPP
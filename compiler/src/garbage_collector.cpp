@@ -0,0 +1,198 @@
+//! \file      garbage_collector.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "garbage_collector.hpp"
+#include "runtime.hpp"
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+// the old generation may grow to this before the first major collection
+static const size_t minimum_major_threshold = 1024 * 1024;
+
+static size_t object_size(const runtime_object* object)
+{
+    size_t element = object->elements ? sizeof(runtime_value) : sizeof(int32_t);
+    return sizeof(runtime_object) + static_cast<size_t>(object->length) * element;
+}
+
+// calls f with every slot of object that holds a reference
+template <typename Function>
+static void for_each_reference(const ir_module& module, runtime_object* object, Function f)
+{
+    switch (object->kind)
+    {
+    case runtime_object_kind::array:
+        if (object->elements)
+        {
+            for (int32_t i = 0; i < object->length; ++i)
+                f(object->elements[i]);
+        }
+        break;
+    case runtime_object_kind::instance:
+    {
+        const ir_class& cls = module.classes[object->type];
+        for (int32_t i = 0; i < object->length; ++i)
+        {
+            if (cls.field_types[i] == ir_type::ref)
+                f(object->elements[i]);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+garbage_collector::garbage_collector(const ir_module& module, pool_allocator& pool, size_t nursery_size)
+    : module(module)
+    , pool(pool)
+    , nursery(new char[nursery_size])
+    , nursery_end(nursery.get() + nursery_size)
+    , next(nursery.get())
+    , large_object(nursery_size / 8)
+    , major_threshold(std::max(minimum_major_threshold, 4 * nursery_size))
+{
+}
+
+garbage_collector::~garbage_collector()
+{
+    for (runtime_object* object : tenured)
+    {
+        size_t size = object_size(object);
+        object->~runtime_object();
+        pool.free(object, size);
+    }
+}
+
+void* garbage_collector::allocate_old(size_t size)
+{
+    // the object is constructed in the block right after
+    void* block = pool.allocate(size);
+    tenured.push_back(static_cast<runtime_object*>(block));
+    return block;
+}
+
+void garbage_collector::remember(runtime_object* object)
+{
+    object->flags |= object_remembered;
+    remembered.push_back(object);
+}
+
+void garbage_collector::collect(const std::function<void()>& visit_roots)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // the surviving young objects are promoted, so the old objects pointing to them are no roots any more
+    running = collection::minor;
+    visit_roots();
+    for (runtime_object* object : remembered)
+    {
+        object->flags &= ~object_remembered;
+        visit_fields(object);
+    }
+    remembered.clear();
+    while (!worklist.empty())
+    {
+        runtime_object* object = worklist.back();
+        worklist.pop_back();
+        visit_fields(object);
+    }
+    next = nursery.get();
+    ++stats.minor_collections;
+
+    if (pool.statistics().live_bytes > major_threshold)
+    {
+        // the nursery is empty, every reachable object is old or on the stack
+        running = collection::major;
+        visit_roots();
+        while (!worklist.empty())
+        {
+            runtime_object* object = worklist.back();
+            worklist.pop_back();
+            visit_fields(object);
+        }
+        sweep();
+        major_threshold = std::max(minimum_major_threshold, 2 * pool.statistics().live_bytes);
+        ++stats.major_collections;
+    }
+    running = collection::none;
+
+    int64_t pause = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    stats.total_pause += pause;
+    stats.longest_pause = std::max(stats.longest_pause, pause);
+}
+
+void garbage_collector::visit(runtime_value& slot)
+{
+    runtime_object* object = slot.ref;
+    if (!object)
+        return;
+
+    if (running == collection::minor)
+    {
+        if (in_nursery(object))
+            slot.ref = promote(object);
+        return;
+    }
+
+    if ((object->flags & (object_on_stack | object_marked)) == 0)
+    {
+        object->flags |= object_marked;
+        worklist.push_back(object);
+    }
+}
+
+void garbage_collector::visit_fields(runtime_object* object)
+{
+    for_each_reference(module, object, [&](runtime_value& slot) { visit(slot); });
+}
+
+runtime_object* garbage_collector::promote(runtime_object* object)
+{
+    if (object->forward)
+        return object->forward;
+
+    size_t size          = object_size(object);
+    runtime_object* copy = new (allocate_old(size)) runtime_object();
+    copy->kind           = object->kind;
+    copy->type           = object->type;
+    copy->length         = object->length;
+    if (object->elements)
+    {
+        copy->elements = reinterpret_cast<runtime_value*>(copy + 1);
+        std::copy(object->elements, object->elements + object->length, copy->elements);
+    }
+    else if (object->words)
+    {
+        copy->words = reinterpret_cast<int32_t*>(copy + 1);
+        std::copy(object->words, object->words + object->length, copy->words);
+    }
+
+    object->forward = copy;
+    worklist.push_back(copy);
+    stats.promoted_bytes += size;
+    return copy;
+}
+
+void garbage_collector::sweep()
+{
+    size_t kept = 0;
+    for (runtime_object* object : tenured)
+    {
+        if (object->flags & object_marked)
+        {
+            object->flags &= ~object_marked;
+            tenured[kept++] = object;
+            continue;
+        }
+        size_t size = object_size(object);
+        stats.freed_bytes += size;
+        object->~runtime_object();
+        pool.free(object, size);
+    }
+    tenured.resize(kept);
+}
@@ -0,0 +1,119 @@
+//! \file      garbage_collector.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef GARBAGE_COLLECTOR_HPP
+#define GARBAGE_COLLECTOR_HPP
+
+#include "ir.hpp"
+#include "memory_pool.hpp"
+#include <functional>
+
+struct runtime_object;
+union runtime_value;
+
+// flags of runtime objects
+static constexpr uint32_t object_on_stack   = 1 << 0; // in a call region, neither moved nor freed by the collector
+static constexpr uint32_t object_remembered = 1 << 1; // old object in the remembered set
+static constexpr uint32_t object_marked     = 1 << 2; // reached by the running major collection
+
+struct collector_statistics
+{
+    size_t minor_collections = 0;
+    size_t major_collections = 0;
+    size_t promoted_bytes    = 0; // nursery objects copied into the old generation
+    size_t freed_bytes       = 0; // old objects freed by major collections
+    int64_t total_pause      = 0; // microseconds
+    int64_t longest_pause    = 0; // microseconds
+};
+
+// Precise generational collector of the runtime heap.
+// New objects are bump allocated in the nursery. A minor collection copies the ones reachable from the roots and
+// the remembered set into the old generation and empties the nursery, so dead young objects cost nothing to reclaim.
+// The old generation lives in the pool allocator and is collected by mark and sweep once it doubled since the last one.
+// Objects larger than an eighth of the nursery are allocated old. Nursery objects own no memory outside their block,
+// dead ones are dropped without running their destructor.
+class garbage_collector
+{
+  public:
+    garbage_collector(const ir_module& module, pool_allocator& pool, size_t nursery_size);
+    ~garbage_collector();
+
+    garbage_collector(const garbage_collector&)            = delete;
+    garbage_collector& operator=(const garbage_collector&) = delete;
+
+    // memory for an object, in the nursery if it fits, in the old generation otherwise
+    void* allocate(size_t size)
+    {
+        size_t aligned = align_object(size);
+        if (aligned <= large_object && aligned <= static_cast<size_t>(nursery_end - next))
+        {
+            void* block = next;
+            next += aligned;
+            return block;
+        }
+        return allocate_old(size);
+    }
+
+    void* allocate_old(size_t size);
+
+    // true if an object of size bytes should wait for a collection
+    bool needs_collection(size_t size) const
+    {
+        size_t aligned = align_object(size);
+        return (aligned <= large_object && aligned > static_cast<size_t>(nursery_end - next)) || pool.statistics().live_bytes > major_threshold;
+    }
+
+    bool in_nursery(const void* address) const
+    {
+        return address >= nursery.get() && address < nursery_end;
+    }
+
+    // old objects pointing into the nursery are roots of the next minor collection
+    void remember(runtime_object* object);
+
+    // visit_roots calls visit for every reference outside the heap and visit_fields for objects outside the heap
+    void collect(const std::function<void()>& visit_roots);
+
+    void visit(runtime_value& slot);
+    void visit_fields(runtime_object* object);
+
+    const collector_statistics& statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    enum class collection
+    {
+        none,
+        minor,
+        major,
+    };
+
+    // nursery objects are aligned like the blocks of the pool
+    static size_t align_object(size_t size)
+    {
+        return (size + 15) & ~size_t(15);
+    }
+
+    runtime_object* promote(runtime_object* object);
+    void sweep();
+
+    const ir_module& module;
+    pool_allocator& pool;
+    std::unique_ptr<char[]> nursery;
+    const char* nursery_end;
+    char* next;                              // first free byte of the nursery
+    size_t large_object;                     // objects larger than this are allocated old
+    size_t major_threshold;                  // old bytes that start a major collection
+    std::vector<runtime_object*> tenured;    // the old generation
+    std::vector<runtime_object*> remembered; // old objects pointing into the nursery
+    std::vector<runtime_object*> worklist;   // promoted or marked objects with unvisited fields
+    collection running = collection::none;
+    collector_statistics stats;
+};
+
+#endif GARBAGE_COLLECTOR_HPP
@@ -0,0 +1,250 @@
+//! \file      inliner.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "inliner.hpp"
+#include "ir_cleanup.hpp"
+#include <algorithm>
+
+inliner::inliner(ir_module& module, const inline_options& options)
+    : module(module)
+    , options(options)
+    , graph(module)
+    , callees(module)
+    , budget(options.budget)
+{
+    for (const ir_function& function : module.functions)
+    {
+        sizes.push_back(function_size(function));
+        for (const ir_block& block : function.blocks)
+            hottest = std::max(hottest, block.count);
+    }
+}
+
+size_t inliner::run()
+{
+    size_t inlined = 0;
+    for (const std::vector<function_id>& component : graph.bottom_up())
+    {
+        for (function_id caller : component)
+        {
+            // callees are cleaned up before their callers are visited, so their sizes do not count dead code
+            effect_analysis effects(module.functions[caller], callees);
+            if (cleanup_function(module.functions[caller], effects))
+                sizes[caller] = function_size(module.functions[caller]);
+
+            // calls copied in by inlining were already rejected in their callee
+            std::vector<value_id> calls;
+            for (const ir_block& block : module.functions[caller].blocks)
+            {
+                for (value_id value : block.instructions)
+                {
+                    if (module.functions[caller].values[value].opcode == ir_opcode::call)
+                        calls.push_back(value);
+                }
+            }
+
+            size_t inlined_here = 0;
+            for (value_id call : calls)
+            {
+                if (!should_inline(caller, call))
+                    continue;
+                inline_call(caller, call);
+                ++inlined_here;
+            }
+
+            if (inlined_here > 0)
+            {
+                cleanup_function(module.functions[caller], effects);
+                sizes[caller] = function_size(module.functions[caller]);
+                inlined += inlined_here;
+            }
+        }
+    }
+    return inlined;
+}
+
+int32_t inliner::function_size(const ir_function& function)
+{
+    int32_t size = 0;
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            ir_opcode opcode = function.values[value].opcode;
+            if (opcode != ir_opcode::param && opcode != ir_opcode::phi)
+                ++size;
+        }
+    }
+    return size;
+}
+
+int32_t inliner::cost(const ir_function& caller, const ir_instruction& call) const
+{
+    // the call, the return and passing the arguments disappear
+    int32_t benefit = 2 + static_cast<int32_t>(call.operands.size());
+
+    // constant arguments fold in the inlined body
+    for (value_id argument : call.operands)
+    {
+        if (caller.values[argument].opcode == ir_opcode::constant)
+            benefit += 3;
+    }
+
+    // the only caller, the callee is dead afterwards
+    if (graph.call_sites(call.immediate) == 1)
+        benefit += 10;
+
+    return sizes[call.immediate] - benefit;
+}
+
+bool inliner::should_inline(function_id caller, value_id call)
+{
+    const ir_instruction& instr = module.functions[caller].values[call];
+    function_id callee          = instr.immediate;
+
+    // recursion guard, bottom up order means the callee is already done unless it is in the same component
+    if (callee == caller || graph.component(callee) == graph.component(caller) || module.functions[callee].blocks.empty())
+        return false;
+
+    int32_t size = sizes[callee];
+    if (size > budget || sizes[caller] + size > options.max_function_size)
+        return false;
+    // a block that ran at least a twentieth as often as the hottest one is hot
+    int64_t count     = module.functions[caller].blocks[instr.block].count;
+    int32_t threshold = count == 0 ? options.always_inline_size : options.threshold;
+    if (count > 0 && count * 20 >= hottest)
+        threshold = options.hot_threshold;
+    if (size > options.always_inline_size && cost(module.functions[caller], instr) > threshold)
+        return false;
+
+    budget -= size;
+    sizes[caller] += size;
+    return true;
+}
+
+void inliner::inline_call(function_id caller_id, value_id call)
+{
+    ir_function& caller             = module.functions[caller_id];
+    const ir_function& callee       = module.functions[caller.values[call].immediate];
+    block_id call_block             = caller.values[call].block;
+    std::vector<value_id> arguments = caller.values[call].operands;
+    source_code_position position   = caller.values[call].position;
+
+    // the instructions after the call continue in a new block
+    block_id continuation               = caller.add_block();
+    std::vector<value_id>& instructions = caller.blocks[call_block].instructions;
+    auto at                             = std::find(instructions.begin(), instructions.end(), call);
+    caller.blocks[continuation].instructions.assign(at + 1, instructions.end());
+    instructions.erase(at, instructions.end());
+    for (value_id value : caller.blocks[continuation].instructions)
+        caller.values[value].block = continuation;
+    for (block_id succ : caller.successors(continuation))
+        std::replace(caller.blocks[succ].predecessors.begin(), caller.blocks[succ].predecessors.end(), call_block, continuation);
+    caller.blocks[continuation].count = caller.blocks[call_block].count;
+    caller.blocks[continuation].taken = caller.blocks[call_block].taken;
+    caller.blocks[call_block].taken   = -1;
+
+    // the counts of the callee are scaled to this call site
+    int64_t calls   = caller.blocks[call_block].count;
+    int64_t entered = callee.blocks[0].count;
+    auto scaled     = [&](int64_t count) { return count < 0 || calls < 0 ? -1 : entered > 0 ? count * calls / entered : 0; };
+
+    // parameters are replaced by the arguments
+    block_id first_block = static_cast<block_id>(caller.blocks.size());
+    std::vector<value_id> mapped(callee.values.size(), no_value);
+    for (block_id b = 0; b < static_cast<block_id>(callee.blocks.size()); ++b)
+    {
+        caller.add_block();
+        caller.blocks[first_block + b].count = scaled(callee.blocks[b].count);
+        caller.blocks[first_block + b].taken = scaled(callee.blocks[b].taken);
+        for (value_id value : callee.blocks[b].instructions)
+        {
+            const ir_instruction& instr = callee.values[value];
+            if (instr.opcode == ir_opcode::param)
+            {
+                mapped[value] = arguments[instr.immediate];
+                continue;
+            }
+
+            ir_instruction copy = instr;
+            copy.block          = first_block + b;
+            mapped[value]       = caller.add_value(std::move(copy));
+            caller.blocks[first_block + b].instructions.push_back(mapped[value]);
+        }
+    }
+
+    // returns jump to the continuation
+    std::vector<value_id> results;
+    for (block_id b = 0; b < static_cast<block_id>(callee.blocks.size()); ++b)
+    {
+        ir_block& block = caller.blocks[first_block + b];
+        for (block_id pred : callee.blocks[b].predecessors)
+            block.predecessors.push_back(first_block + pred);
+
+        for (value_id value : block.instructions)
+        {
+            ir_instruction& instr = caller.values[value];
+            for (value_id& operand : instr.operands)
+                operand = mapped[operand];
+            for (block_id& target : instr.targets)
+            {
+                if (target != -1)
+                    target += first_block;
+            }
+
+            if (instr.opcode == ir_opcode::ret)
+            {
+                results.push_back(instr.operands.empty() ? no_value : instr.operands[0]);
+                instr.opcode     = ir_opcode::jump;
+                instr.operands.clear();
+                instr.targets[0] = continuation;
+                caller.blocks[continuation].predecessors.push_back(first_block + b);
+            }
+        }
+    }
+
+    ir_instruction enter;
+    enter.opcode     = ir_opcode::jump;
+    enter.targets[0] = first_block;
+    enter.block      = call_block;
+    enter.position   = position;
+    caller.blocks[call_block].instructions.push_back(caller.add_value(std::move(enter)));
+    caller.blocks[first_block].predecessors.push_back(call_block);
+
+    // several returns are merged, the phi operands follow the order of the predecessors
+    value_id result = no_value;
+    if (caller.values[call].type != ir_type::unit)
+    {
+        ir_instruction merged;
+        merged.opcode   = results.size() == 1 ? ir_opcode::copy : ir_opcode::phi;
+        merged.type     = caller.values[call].type;
+        merged.operands = results;
+        merged.block    = continuation;
+        merged.position = position;
+        if (results.empty())
+        {
+            // the callee never returns, the result is never used
+            merged.opcode    = ir_opcode::constant;
+            merged.immediate = merged.type == ir_type::ref ? -1 : 0;
+        }
+
+        if (merged.opcode == ir_opcode::copy)
+        {
+            result = results[0];
+        }
+        else
+        {
+            result                           = caller.add_value(std::move(merged));
+            std::vector<value_id>& continued = caller.blocks[continuation].instructions;
+            continued.insert(continued.begin(), result);
+        }
+    }
+
+    caller.replace_all_uses(call, result);
+    caller.values[call].opcode = ir_opcode::nop;
+    caller.values[call].block  = -1;
+    caller.values[call].operands.clear();
+}
@@ -0,0 +1,59 @@
+//! \file      inliner.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include "call_graph.hpp"
+#include "effect_analysis.hpp"
+#include "ir.hpp"
+
+struct inline_options
+{
+    int32_t always_inline_size = 12;   // callees up to this size are always inlined
+    int32_t threshold          = 40;   // maximum callee size after subtracting the benefit
+    int32_t hot_threshold      = 120;  // threshold of calls in hot blocks of a profile
+    int32_t max_function_size  = 2000; // callers do not grow beyond this size
+    int32_t budget             = 1000; // instructions the whole module may grow by, counted before gvn shrinks them
+};
+
+// Inlines direct calls bottom up over the call graph, so callees have their own calls inlined and are cleaned up when
+// they are inlined. Value numbering and the loop passes run after inlining, a callee is copied before they optimize it.
+// Calls inside a strongly connected component are never inlined, that stops recursion.
+// With a profile, calls that never ran are only inlined if they are tiny and hot calls get a larger threshold.
+class inliner
+{
+  public:
+    inliner(ir_module& module, const inline_options& options);
+    ~inliner() = default;
+
+    // returns the number of inlined calls
+    size_t run();
+
+    int32_t remaining_budget() const
+    {
+        return budget;
+    }
+
+    // number of instructions that end up in generated code
+    static int32_t function_size(const ir_function& function);
+
+  private:
+    // size of the callee, grown by what was inlined into it, minus the expected savings at this call site
+    int32_t cost(const ir_function& caller, const ir_instruction& call) const;
+    bool should_inline(function_id caller, value_id call);
+    void inline_call(function_id caller, value_id call);
+
+    ir_module& module;
+    inline_options options;
+    call_graph graph;
+    function_effects callees; // inlining moves the effects of a callee into its callers, the summaries stay valid
+    std::vector<int32_t> sizes;
+    int32_t budget;
+    int64_t hottest = 0; // largest block count of the profile
+};
+
+#endif INLINER_HPP
@@ -0,0 +1,350 @@
+//! \file      instruction_selection.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "instruction_selection.hpp"
+#include "ir_cleanup.hpp"
+#include <algorithm>
+
+// what a rule expects at an operand of the matched instruction
+enum class operand_pattern
+{
+    none,
+    value,    // any value, computed into a register
+    constant, // i32 constant, becomes the immediate
+    power,    // i32 constant 2^k with 1 <= k <= 30, k becomes the immediate
+    scaled,   // multiplication of a value by 2, 4 or 8 in the same tree, the factor becomes the immediate
+    compare,  // comparison in the same tree, its opcode becomes the immediate
+};
+
+struct selection_rule
+{
+    ir_opcode root;
+    operand_pattern operands[2];
+    bool commutative;
+    ir_opcode selected;
+};
+
+// every rule selects one instruction, so covering more of a tree is cheaper
+static const selection_rule rules[] = {
+    { ir_opcode::add, { operand_pattern::value, operand_pattern::constant }, true, ir_opcode::add_imm },
+    { ir_opcode::sub, { operand_pattern::value, operand_pattern::constant }, false, ir_opcode::add_imm },
+    { ir_opcode::add, { operand_pattern::value, operand_pattern::scaled }, true, ir_opcode::scaled_add },
+    { ir_opcode::mul, { operand_pattern::value, operand_pattern::power }, true, ir_opcode::shl },
+    { ir_opcode::div, { operand_pattern::value, operand_pattern::power }, false, ir_opcode::div_pow2 },
+    { ir_opcode::mod, { operand_pattern::value, operand_pattern::power }, false, ir_opcode::mod_pow2 },
+    { ir_opcode::branch, { operand_pattern::compare, operand_pattern::none }, false, ir_opcode::compare_branch },
+};
+
+static const size_t no_rule = sizeof(rules) / sizeof(rules[0]);
+
+static bool is_compare(ir_opcode opcode)
+{
+    return opcode == ir_opcode::eq || opcode == ir_opcode::ne || opcode == ir_opcode::lt || opcode == ir_opcode::gt || opcode == ir_opcode::le || opcode == ir_opcode::ge;
+}
+
+static bool is_i32_constant(const ir_instruction& instr)
+{
+    return instr.opcode == ir_opcode::constant && instr.type == ir_type::i32;
+}
+
+// exponent of a power of two constant, -1 otherwise
+static int32_t power_of_two(const ir_instruction& instr)
+{
+    if (!is_i32_constant(instr) || instr.immediate < 2 || (instr.immediate & (instr.immediate - 1)) != 0)
+        return -1;
+    int32_t k = 0;
+    while ((1 << k) != instr.immediate)
+        ++k;
+    return k;
+}
+
+class instruction_selector
+{
+  public:
+    instruction_selector(ir_function& function)
+        : function(function)
+        , uses(function.use_counts())
+        , costs(function.values.size(), 0)
+        , chosen(function.values.size(), no_rule)
+        , swapped(function.values.size(), false)
+        , folded(function.values.size(), false)
+    {
+    }
+
+    size_t run()
+    {
+        // operands come before their users in a block, so the children are labeled first
+        for (const ir_block& block : function.blocks)
+        {
+            for (value_id value : block.instructions)
+                label(value);
+        }
+
+        // the roots decide which inner nodes they fold
+        for (const ir_block& block : function.blocks)
+        {
+            for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it)
+            {
+                if (!folded[*it] && chosen[*it] != no_rule)
+                    mark_folded(*it);
+            }
+        }
+
+        size_t selected = 0;
+        for (const ir_block& block : function.blocks)
+        {
+            for (value_id value : std::vector<value_id>(block.instructions))
+            {
+                if (folded[value] || chosen[value] == no_rule)
+                    continue;
+                rewrite(value);
+                ++selected;
+            }
+        }
+        return selected;
+    }
+
+  private:
+    // true if the value is an inner node of the tree of user
+    bool in_tree(value_id value, value_id user) const
+    {
+        const ir_instruction& instr = function.values[value];
+        return uses[value] == 1 && instr.block == function.values[user].block && instr.type != ir_type::vi32 && instr.type != ir_type::vf32 && instruction_effects(instr) == effect_none;
+    }
+
+    // instructions needed to compute value when it is an operand of user
+    int32_t operand_cost(value_id value, value_id user) const
+    {
+        return in_tree(value, user) ? costs[value] : 0;
+    }
+
+    // cost of operand under pattern, -1 if it does not match
+    int32_t match(operand_pattern pattern, value_id operand, value_id user) const
+    {
+        const ir_instruction& instr = function.values[operand];
+        switch (pattern)
+        {
+        case operand_pattern::value:
+            return operand_cost(operand, user);
+        case operand_pattern::constant:
+            return is_i32_constant(instr) ? 0 : -1;
+        case operand_pattern::power:
+            return power_of_two(instr) != -1 ? 0 : -1;
+        case operand_pattern::scaled:
+        {
+            if (!in_tree(operand, user) || instr.opcode != ir_opcode::mul || instr.type != ir_type::i32)
+                return -1;
+            for (size_t i = 0; i < 2; ++i)
+            {
+                int32_t k = power_of_two(function.values[instr.operands[1 - i]]);
+                if (k >= 1 && k <= 3)
+                    return operand_cost(instr.operands[i], operand);
+            }
+            return -1;
+        }
+        case operand_pattern::compare:
+            if (!in_tree(operand, user) || !is_compare(instr.opcode) || function.values[instr.operands[0]].type == ir_type::vi32 || function.values[instr.operands[0]].type == ir_type::vf32)
+                return -1;
+            return operand_cost(instr.operands[0], operand) + operand_cost(instr.operands[1], operand);
+        default:
+            return -1;
+        }
+    }
+
+    void label(value_id value)
+    {
+        const ir_instruction& instr = function.values[value];
+
+        // without a rule the instruction is selected as it is
+        costs[value] = 1;
+        for (value_id operand : instr.operands)
+            costs[value] += operand_cost(operand, value);
+
+        bool arithmetic = instr.type == ir_type::i32;
+        for (size_t r = 0; r < no_rule; ++r)
+        {
+            const selection_rule& rule = rules[r];
+            if (rule.root != instr.opcode || (!arithmetic && rule.root != ir_opcode::branch))
+                continue;
+
+            for (size_t order = 0; order < (rule.commutative ? 2u : 1u); ++order)
+            {
+                int32_t cost = 1;
+                for (size_t i = 0; i < instr.operands.size() && cost != -1; ++i)
+                {
+                    int32_t operand = match(rule.operands[order == 0 ? i : 1 - i], instr.operands[i], value);
+                    cost            = operand == -1 ? -1 : cost + operand;
+                }
+
+                // ties go to the rule, immediates need no register
+                if (cost != -1 && cost <= costs[value])
+                {
+                    costs[value]   = cost;
+                    chosen[value]  = r;
+                    swapped[value] = order == 1;
+                }
+            }
+        }
+    }
+
+    // index of the operand matched by the first pattern of the rule
+    size_t first_operand(value_id value) const
+    {
+        return swapped[value] ? 1 : 0;
+    }
+
+    void mark_folded(value_id value)
+    {
+        const ir_instruction& instr = function.values[value];
+        const selection_rule& rule  = rules[chosen[value]];
+        for (size_t i = 0; i < instr.operands.size(); ++i)
+        {
+            operand_pattern pattern = rule.operands[swapped[value] ? 1 - i : i];
+            if (pattern == operand_pattern::scaled || pattern == operand_pattern::compare)
+                folded[instr.operands[i]] = true;
+        }
+    }
+
+    void rewrite(value_id value)
+    {
+        ir_instruction& instr      = function.values[value];
+        const selection_rule& rule = rules[chosen[value]];
+        value_id first             = instr.operands[first_operand(value)];
+        value_id second            = instr.operands.size() > 1 ? instr.operands[1 - first_operand(value)] : no_value;
+
+        switch (rule.selected)
+        {
+        case ir_opcode::add_imm:
+        {
+            uint32_t constant = static_cast<uint32_t>(function.values[second].immediate);
+            instr.immediate   = static_cast<int32_t>(instr.opcode == ir_opcode::sub ? 0u - constant : constant);
+            instr.operands    = { first };
+            break;
+        }
+        case ir_opcode::shl:
+        case ir_opcode::div_pow2:
+        case ir_opcode::mod_pow2:
+            instr.immediate = power_of_two(function.values[second]);
+            instr.operands  = { first };
+            break;
+        case ir_opcode::scaled_add:
+        {
+            const ir_instruction& mul = function.values[second];
+            int32_t k                 = power_of_two(function.values[mul.operands[1]]);
+            size_t factor             = k >= 1 && k <= 3 ? 1 : 0;
+            instr.immediate           = function.values[mul.operands[factor]].immediate;
+            instr.operands            = { first, mul.operands[1 - factor] };
+            function.remove(second);
+            break;
+        }
+        case ir_opcode::compare_branch:
+        {
+            const ir_instruction& compare = function.values[first];
+            instr.immediate               = static_cast<int32_t>(compare.opcode);
+            instr.operands                = compare.operands;
+            function.remove(first);
+            break;
+        }
+        default:
+            break;
+        }
+        instr.opcode = rule.selected;
+    }
+
+    ir_function& function;
+    std::vector<int32_t> uses;
+    std::vector<int32_t> costs;   // instructions of the cheapest cover of the tree below each value
+    std::vector<size_t> chosen;   // rule of the cheapest cover, no_rule to keep the instruction
+    std::vector<bool> swapped;    // commutative rules matched with the operands swapped
+    std::vector<bool> folded;     // inner nodes folded into the instruction of their user
+};
+
+size_t select_instructions(ir_function& function)
+{
+    instruction_selector selector(function);
+    return selector.run();
+}
+
+// the operand of an element access or bounds check that is the index, -1 for other instructions
+static int32_t index_operand(const ir_instruction& instr)
+{
+    if (instr.opcode == ir_opcode::check_bounds)
+        return 0;
+    if (instr.opcode == ir_opcode::load_element || instr.opcode == ir_opcode::store_element)
+        return 1;
+    return -1;
+}
+
+size_t peephole(ir_function& function, effect_analysis& effects)
+{
+    size_t changes = 0;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        for (value_id value : std::vector<value_id>(function.blocks[block].instructions))
+        {
+            ir_instruction& instr = function.values[value];
+            if ((instr.opcode == ir_opcode::add_imm || instr.opcode == ir_opcode::shl) && instr.immediate == 0)
+            {
+                function.replace_all_uses(value, instr.operands[0]);
+                function.remove(value);
+                ++changes;
+            }
+            else if ((instr.opcode == ir_opcode::branch || instr.opcode == ir_opcode::compare_branch) && instr.targets[0] == instr.targets[1])
+            {
+                // a branch to one block has two edges to it
+                function.remove_edge(block, instr.targets[1]);
+                ir_instruction& jump = function.values[value];
+                jump.opcode          = ir_opcode::jump;
+                jump.operands.clear();
+                jump.targets[1] = -1;
+                ++changes;
+            }
+        }
+    }
+
+    // a[i + c] addresses a[i] with a displacement, the bounds check adds it as well
+    std::vector<std::vector<value_id>> users(function.values.size());
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            for (value_id operand : function.values[value].operands)
+                users[operand].push_back(value);
+        }
+    }
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            const ir_instruction& offset = function.values[value];
+            if (offset.opcode != ir_opcode::add_imm || users[value].empty())
+                continue;
+
+            bool only_indexes = std::all_of(users[value].begin(), users[value].end(), [&](value_id user) {
+                const ir_instruction& access = function.values[user];
+                int32_t index                = index_operand(access);
+                return index != -1 && std::count(access.operands.begin(), access.operands.end(), value) == 1 && access.operands[index] == value;
+            });
+            if (!only_indexes)
+                continue;
+
+            for (value_id user : users[value])
+            {
+                ir_instruction& access                 = function.values[user];
+                access.operands[index_operand(access)] = offset.operands[0];
+                access.immediate                       = static_cast<int32_t>(static_cast<uint32_t>(access.immediate) + static_cast<uint32_t>(offset.immediate));
+                users[offset.operands[0]].push_back(user);
+            }
+            users[value].clear();
+            ++changes;
+        }
+    }
+
+    // constants that became immediates and folded offsets are unused now
+    if (remove_unused_values(function, effects))
+        ++changes;
+    return changes;
+}
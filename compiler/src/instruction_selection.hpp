@@ -0,0 +1,26 @@
+//! \file      instruction_selection.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef INSTRUCTION_SELECTION_HPP
+#define INSTRUCTION_SELECTION_HPP
+
+#include "effect_analysis.hpp"
+#include "ir.hpp"
+
+// Bottom up rewrite instruction selection over the expression trees of each block.
+// Values used once in the block they are defined in are inner nodes of a tree, all other values are leaves.
+// A table of rules maps tree patterns to selected instructions, every tree gets the cover with the fewest instructions:
+// constants become immediates, multiplications by 2, 4 or 8 fold into an add, multiplications and divisions
+// by powers of two become shifts and masks and compares fold into their branch.
+// Returns the number of selected instructions.
+size_t select_instructions(ir_function& function);
+
+// Cleans up the selected code: constant index offsets fold into the element accesses and bounds checks,
+// adds of 0 and shifts by 0 are removed and branches to a single target become jumps.
+// Returns the number of changes.
+size_t peephole(ir_function& function, effect_analysis& effects);
+
+#endif INSTRUCTION_SELECTION_HPP
@@ -0,0 +1,141 @@
+//! \file      instrumentation.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <sstream>
+
+static value_id add_count(ir_function& function, block_id block, int32_t counter, source_code_position position)
+{
+    ir_instruction count;
+    count.opcode    = ir_opcode::count;
+    count.immediate = counter;
+    count.block     = block;
+    count.position  = position;
+    return function.add_value(std::move(count));
+}
+
+std::vector<function_counters> instrument_module(ir_module& module)
+{
+    std::vector<function_counters> layout;
+    int32_t next = 0;
+    for (ir_function& function : module.functions)
+    {
+        function_counters counters;
+        counters.name   = function.name;
+        counters.blocks = function.blocks.size();
+        counters.values = function.values.size();
+        counters.taken_counters.assign(counters.blocks, -1);
+
+        for (block_id block = 0; block < static_cast<block_id>(counters.blocks); ++block)
+        {
+            std::vector<value_id>& instructions = function.blocks[block].instructions;
+            auto first = std::find_if(instructions.begin(), instructions.end(), [&](value_id value) { return function.values[value].opcode != ir_opcode::phi; });
+            source_code_position position = first == instructions.end() ? source_code_position{ 0, 0 } : function.values[*first].position;
+
+            counters.block_counters.push_back(next);
+            instructions.insert(first, add_count(function, block, next++, position));
+        }
+
+        // the first edge gets a block of its own, the second edge is the block count minus the taken count
+        for (block_id block = 0; block < static_cast<block_id>(counters.blocks); ++block)
+        {
+            if (function.blocks[block].instructions.empty())
+                continue;
+            value_id branch = function.blocks[block].instructions.back();
+            if (function.values[branch].opcode != ir_opcode::branch)
+                continue;
+            block_id target = function.values[branch].targets[0];
+            if (target == function.values[branch].targets[1])
+                continue;
+
+            source_code_position position = function.values[branch].position;
+            block_id edge                 = function.add_block();
+            function.blocks[edge].instructions.push_back(add_count(function, edge, next, position));
+
+            ir_instruction jump;
+            jump.opcode     = ir_opcode::jump;
+            jump.targets[0] = target;
+            jump.block      = edge;
+            jump.position   = position;
+            function.blocks[edge].instructions.push_back(function.add_value(std::move(jump)));
+            function.blocks[edge].predecessors.push_back(block);
+
+            std::replace(function.blocks[target].predecessors.begin(), function.blocks[target].predecessors.end(), block, edge);
+            function.values[branch].targets[0] = edge;
+            counters.taken_counters[block]     = next++;
+        }
+        layout.push_back(std::move(counters));
+    }
+    return layout;
+}
+
+size_t counter_count(const std::vector<function_counters>& layout)
+{
+    size_t count = 0;
+    for (const function_counters& counters : layout)
+    {
+        count += counters.block_counters.size();
+        count += std::count_if(counters.taken_counters.begin(), counters.taken_counters.end(), [](int32_t counter) { return counter != -1; });
+    }
+    return count;
+}
+
+// function <name> <blocks> <values>
+// block <id> <count> <taken or -1>
+void write_profile(std::ostream& out, const std::vector<function_counters>& layout, const std::vector<int64_t>& counts)
+{
+    for (const function_counters& counters : layout)
+    {
+        out << "function " << counters.name << " " << counters.blocks << " " << counters.values << "\n";
+        for (size_t block = 0; block < counters.blocks; ++block)
+        {
+            int32_t taken = counters.taken_counters[block];
+            out << "block " << block << " " << counts[counters.block_counters[block]] << " " << (taken == -1 ? -1 : counts[taken]) << "\n";
+        }
+    }
+}
+
+bool apply_profile(std::istream& in, ir_module& module)
+{
+    ir_function* function = nullptr;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::stringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if (keyword == "function")
+        {
+            std::string name;
+            size_t blocks = 0, values = 0;
+            if (!(stream >> name >> blocks >> values))
+                return false;
+
+            // changed functions keep no profile
+            auto it  = std::find_if(module.functions.begin(), module.functions.end(), [&](const ir_function& f) { return f.name == name; });
+            function = it != module.functions.end() && it->blocks.size() == blocks && it->values.size() == values ? &*it : nullptr;
+        }
+        else if (keyword == "block")
+        {
+            size_t block  = 0;
+            int64_t count = 0, taken = 0;
+            if (!(stream >> block >> count >> taken))
+                return false;
+            if (!function)
+                continue;
+            if (block >= function->blocks.size())
+                return false;
+            function->blocks[block].count = count;
+            function->blocks[block].taken = taken;
+        }
+        else if (!keyword.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+//! \file      instrumentation.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include "ir.hpp"
+#include <iostream>
+
+// Counters of one function, the shape identifies the function when the profile is read back.
+struct function_counters
+{
+    std::string name;
+    size_t blocks = 0; // blocks and values before instrumenting
+    size_t values = 0;
+    std::vector<int32_t> block_counters; // counter of each block
+    std::vector<int32_t> taken_counters; // counter of the first edge of each branch, -1 for other blocks
+};
+
+// Inserts a count at the start of every block and on the first edge of every branch.
+// Calls are counted by the blocks they are in. Returns the counters of every function.
+std::vector<function_counters> instrument_module(ir_module& module);
+
+// number of counters the runtime needs
+size_t counter_count(const std::vector<function_counters>& layout);
+
+// writes the counts of an instrumented run
+void write_profile(std::ostream& out, const std::vector<function_counters>& layout, const std::vector<int64_t>& counts);
+
+// sets count and taken of the blocks of functions that did not change since the profile was written
+// returns false if the profile is malformed
+bool apply_profile(std::istream& in, ir_module& module);
+
+#endif INSTRUMENTATION_HPP
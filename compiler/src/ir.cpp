@@ -0,0 +1,380 @@
+//! \file      ir.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "ir.hpp"
+#include <algorithm>
+
+std::vector<block_id> ir_function::successors(block_id block) const
+{
+    const ir_instruction* term = terminator(block);
+    if (!term)
+        return {};
+
+    switch (term->opcode)
+    {
+    case ir_opcode::jump:
+        return { term->targets[0] };
+    case ir_opcode::branch:
+    case ir_opcode::compare_branch:
+        if (term->targets[0] == term->targets[1])
+            return { term->targets[0] };
+        return { term->targets[0], term->targets[1] };
+    default:
+        return {};
+    }
+}
+
+void ir_function::replace_all_uses(value_id old_value, value_id new_value)
+{
+    for (ir_instruction& instr : values)
+    {
+        for (value_id& operand : instr.operands)
+        {
+            if (operand == old_value)
+                operand = new_value;
+        }
+    }
+}
+
+void ir_function::remove(value_id value)
+{
+    ir_instruction& instr = values[value];
+    if (instr.block >= 0)
+    {
+        std::vector<value_id>& instructions = blocks[instr.block].instructions;
+        instructions.erase(std::remove(instructions.begin(), instructions.end(), value), instructions.end());
+    }
+
+    instr.opcode = ir_opcode::nop;
+    instr.block  = -1;
+    instr.operands.clear();
+}
+
+void ir_function::remove_edge(block_id from, block_id to)
+{
+    std::vector<block_id>& predecessors = blocks[to].predecessors;
+    auto it                             = std::find(predecessors.begin(), predecessors.end(), from);
+    if (it == predecessors.end())
+        return;
+
+    size_t index = it - predecessors.begin();
+    predecessors.erase(it);
+
+    for (value_id value : blocks[to].instructions)
+    {
+        ir_instruction& instr = values[value];
+        if (instr.opcode != ir_opcode::phi)
+            break;
+        instr.operands.erase(instr.operands.begin() + index);
+    }
+}
+
+std::vector<int32_t> ir_function::use_counts() const
+{
+    std::vector<int32_t> counts(values.size(), 0);
+    for (const ir_block& b : blocks)
+    {
+        for (value_id value : b.instructions)
+        {
+            for (value_id operand : values[value].operands)
+                ++counts[operand];
+        }
+    }
+    return counts;
+}
+
+void ir_function::compact_blocks()
+{
+    std::vector<block_id> renumbered(blocks.size(), -1);
+    block_id next = 0;
+    for (block_id b = 0; b < static_cast<block_id>(blocks.size()); ++b)
+    {
+        if (b == 0 || !blocks[b].instructions.empty())
+            renumbered[b] = next++;
+    }
+    if (next == static_cast<block_id>(blocks.size()))
+        return;
+
+    std::vector<ir_block> kept;
+    kept.reserve(next);
+    for (block_id b = 0; b < static_cast<block_id>(blocks.size()); ++b)
+    {
+        if (renumbered[b] == -1)
+            continue;
+
+        ir_block& block = blocks[b];
+        for (block_id& pred : block.predecessors)
+            pred = renumbered[pred];
+        for (value_id value : block.instructions)
+        {
+            ir_instruction& instr = values[value];
+            instr.block           = renumbered[b];
+            for (block_id& target : instr.targets)
+            {
+                if (target != -1)
+                    target = renumbered[target];
+            }
+        }
+        kept.push_back(std::move(block));
+    }
+    blocks = std::move(kept);
+}
+
+void ir_function::reorder_blocks(const std::vector<block_id>& order)
+{
+    std::vector<block_id> renumbered(blocks.size(), -1);
+    for (size_t i = 0; i < order.size(); ++i)
+        renumbered[order[i]] = static_cast<block_id>(i);
+
+    std::vector<ir_block> reordered;
+    reordered.reserve(blocks.size());
+    for (block_id b : order)
+    {
+        ir_block& block = blocks[b];
+        for (block_id& pred : block.predecessors)
+            pred = renumbered[pred];
+        for (value_id value : block.instructions)
+        {
+            ir_instruction& instr = values[value];
+            instr.block           = renumbered[b];
+            for (block_id& target : instr.targets)
+            {
+                if (target != -1)
+                    target = renumbered[target];
+            }
+        }
+        reordered.push_back(std::move(block));
+    }
+    blocks = std::move(reordered);
+}
+
+effect_summary instruction_effects(const ir_instruction& instr)
+{
+    switch (instr.opcode)
+    {
+    case ir_opcode::load_global:
+    case ir_opcode::load_element:
+    case ir_opcode::load_field:
+    case ir_opcode::load_vector:
+        return effect_reads_memory;
+    case ir_opcode::store_global:
+    case ir_opcode::store_element:
+    case ir_opcode::store_field:
+    case ir_opcode::store_vector:
+        return effect_writes_memory;
+    case ir_opcode::new_array:
+    case ir_opcode::new_object:
+        return effect_writes_memory;
+    case ir_opcode::check_bounds:
+    case ir_opcode::check_null:
+    case ir_opcode::div:
+    case ir_opcode::mod:
+        return effect_transfers_control; // traps
+    case ir_opcode::call:
+    case ir_opcode::call_method:
+        return effect_calls_function | effect_reads_memory | effect_writes_memory;
+    case ir_opcode::dump:
+        return effect_reads_memory | effect_writes_memory;
+    case ir_opcode::count:
+        return effect_writes_memory;
+    case ir_opcode::jump:
+    case ir_opcode::branch:
+    case ir_opcode::compare_branch:
+    case ir_opcode::ret:
+    case ir_opcode::unreachable:
+        return effect_transfers_control;
+    default:
+        return effect_none;
+    }
+}
+
+static std::string value_name(value_id value)
+{
+    return "%" + std::to_string(value);
+}
+
+static std::string block_name(block_id block)
+{
+    return "b" + std::to_string(block);
+}
+
+static std::string escape(const std::string& str)
+{
+    std::string result;
+    for (char c : str)
+    {
+        if (c == '\n')
+            result += "\\n";
+        else if (c == '"')
+            result += "\\\"";
+        else
+            result += c;
+    }
+    return result;
+}
+
+void print_ir(std::ostream& out, const ir_module& module, const ir_function& function)
+{
+    out << "function " << function.name << "(";
+    for (size_t i = 0; i < function.parameters.size(); ++i)
+        out << (i > 0 ? ", " : "") << to_string(function.parameters[i]);
+    out << ") -> " << to_string(function.result);
+    if (function.overrides != -1)
+        out << " overrides " << module.functions[function.overrides].name;
+    if (function.vtable_slot != -1)
+        out << " slot " << function.vtable_slot;
+    if (!function.registers.empty())
+        out << " frame " << function.frame_size;
+    out << std::endl;
+
+    for (block_id b = 0; b < static_cast<block_id>(function.blocks.size()); ++b)
+    {
+        const ir_block& block = function.blocks[b];
+        out << block_name(b) << ":";
+        if (!block.predecessors.empty())
+        {
+            out << " ; preds";
+            for (block_id pred : block.predecessors)
+                out << " " << block_name(pred);
+        }
+        if (block.count >= 0)
+            out << " ; count " << block.count;
+        if (block.taken >= 0)
+            out << " ; taken " << block.taken;
+        out << std::endl;
+
+        for (value_id value : block.instructions)
+        {
+            const ir_instruction& instr = function.values[value];
+            out << "    ";
+            if (instr.type != ir_type::unit)
+                out << value_name(value) << " = ";
+            out << to_string(instr.opcode);
+            if (instr.type != ir_type::unit)
+                out << "." << to_string(instr.type);
+
+            std::string immediate;
+            switch (instr.opcode)
+            {
+            case ir_opcode::constant:
+                if (instr.type == ir_type::f32)
+                    immediate = std::to_string(instr.fimmediate);
+                else if (instr.type == ir_type::boolean)
+                    immediate = instr.immediate ? "true" : "false";
+                else if (instr.type == ir_type::ref && instr.immediate >= 0)
+                    immediate = "\"" + escape(module.strings[instr.immediate]) + "\"";
+                else if (instr.type == ir_type::ref)
+                    immediate = "null";
+                else
+                    immediate = std::to_string(instr.immediate);
+                break;
+            case ir_opcode::param:
+                immediate = std::to_string(instr.immediate);
+                break;
+            case ir_opcode::load_global:
+            case ir_opcode::store_global:
+                immediate = "@" + module.globals[instr.immediate].name;
+                break;
+            case ir_opcode::new_array:
+            {
+                const ir_array_type& array = module.arrays[instr.immediate];
+                immediate                  = to_string(array.element) + "[" + std::to_string(array.length) + "]";
+                if (instr.aux == stack_allocation)
+                    immediate += " stack";
+                break;
+            }
+            case ir_opcode::check_bounds:
+                immediate = std::to_string(instr.aux);
+                if (instr.immediate != 0)
+                    immediate += " +" + std::to_string(instr.immediate);
+                break;
+            case ir_opcode::new_object:
+                immediate = module.classes[instr.immediate].name;
+                if (instr.aux == stack_allocation)
+                    immediate += " stack";
+                break;
+            case ir_opcode::load_field:
+            case ir_opcode::store_field:
+                immediate = "." + std::to_string(instr.immediate);
+                break;
+            case ir_opcode::call:
+            case ir_opcode::call_method:
+                immediate = module.functions[instr.immediate].name;
+                break;
+            case ir_opcode::count:
+                immediate = "#" + std::to_string(instr.immediate);
+                break;
+            case ir_opcode::add_imm:
+            case ir_opcode::shl:
+            case ir_opcode::div_pow2:
+            case ir_opcode::mod_pow2:
+            case ir_opcode::scaled_add:
+                immediate = std::to_string(instr.immediate);
+                break;
+            case ir_opcode::compare_branch:
+                immediate = to_string(static_cast<ir_opcode>(instr.immediate));
+                break;
+            case ir_opcode::load_element:
+            case ir_opcode::store_element:
+                if (instr.immediate != 0)
+                    immediate = "+" + std::to_string(instr.immediate);
+                break;
+            case ir_opcode::dump:
+                if (instr.immediate >= 0)
+                    immediate = "\"" + escape(module.strings[module.formats[instr.immediate].text]) + "\"";
+                break;
+            default:
+                break;
+            }
+
+            if (!immediate.empty())
+                out << " " << immediate;
+            for (size_t i = 0; i < instr.operands.size(); ++i)
+            {
+                out << (i > 0 || !immediate.empty() ? ", " : " ");
+                out << value_name(instr.operands[i]);
+                if (instr.opcode == ir_opcode::phi && i < block.predecessors.size())
+                    out << " " << block_name(block.predecessors[i]);
+            }
+
+            if (instr.opcode == ir_opcode::jump)
+                out << " " << block_name(instr.targets[0]);
+            else if (instr.opcode == ir_opcode::branch || instr.opcode == ir_opcode::compare_branch)
+                out << ", " << block_name(instr.targets[0]) << ", " << block_name(instr.targets[1]);
+
+            if (!function.registers.empty() && (instr.type == ir_type::vi32 || instr.type == ir_type::vf32))
+                out << " ; v" << instr.aux;
+            else if (!function.registers.empty() && instr.type != ir_type::unit)
+                out << " ; r" << function.registers[value];
+            out << std::endl;
+        }
+    }
+    out << std::endl;
+}
+
+void print_ir(std::ostream& out, const ir_module& module)
+{
+    for (const ir_class& cls : module.classes)
+    {
+        out << "class " << cls.name;
+        if (cls.base != -1)
+            out << " extends " << module.classes[cls.base].name;
+        out << std::endl;
+        for (size_t i = 0; i < cls.field_names.size(); ++i)
+            out << "    ." << i << " " << to_string(cls.field_types[i]) << " " << cls.field_names[i] << std::endl;
+        for (size_t i = 0; i < cls.vtable.size(); ++i)
+            out << "    vtable[" << i << "] " << module.functions[cls.vtable[i]].name << std::endl;
+        out << std::endl;
+    }
+
+    for (const ir_global& global : module.globals)
+        out << "global @" << global.name << " " << to_string(global.type) << std::endl;
+    if (!module.globals.empty())
+        out << std::endl;
+
+    for (const ir_function& function : module.functions)
+        print_ir(out, module, function);
+}
@@ -0,0 +1,248 @@
+//! \file      ir.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef IR_HPP
+#define IR_HPP
+
+#include "effects.hpp"
+#include "token.hpp"
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Intermediate representation in ssa form.
+// Every instruction defines one value, blocks hold instruction ids, phis first and the terminator last.
+
+using value_id    = int32_t;
+using block_id    = int32_t;
+using function_id = int32_t;
+
+static constexpr int32_t no_value = -1;
+
+static constexpr int32_t stack_allocation = 1; // aux of allocations freed when their function returns
+
+#define IR_TYPE_ENUMERATION(op) op(unit) op(i32) op(f32) op(boolean) op(ref) op(vi32) op(vf32) // vectors of ir_module::vector_width lanes
+
+#define op(x) x,
+enum class ir_type
+{
+    IR_TYPE_ENUMERATION(op)
+};
+#undef op
+
+#define op(x)        \
+    case ir_type::x: \
+        return #x;
+static std::string to_string(ir_type type)
+{
+    switch (type)
+    {
+        IR_TYPE_ENUMERATION(op)
+    default:
+        return "unknown";
+    }
+};
+#undef op
+
+#define IR_OPCODE_ENUMERATION(op)                                                                                                           \
+    op(nop) op(constant) op(param) op(phi) op(copy)                                        /* values */                                    \
+        op(add) op(sub) op(mul) op(div) op(mod) op(neg)                                    /* arithmetic */                                \
+        op(eq) op(ne) op(lt) op(gt) op(le) op(ge) op(lnot) op(convert) op(select)          /* compare, convert, condition ? a : b */       \
+        op(load_global) op(store_global)                                                   /* immediate: global */                         \
+        op(new_array) op(check_bounds) op(load_element) op(store_element)                  /* immediate: array type, aux: length */        \
+        op(new_object) op(check_null) op(load_field) op(store_field)                       /* immediate: class or field */                 \
+        op(splat) op(load_vector) op(store_vector)                                         /* aux: vector register */                      \
+        op(call) op(call_method) op(dump)                                                  /* immediate: function, selector or format */   \
+        op(count)                                                                          /* immediate: profile counter */                \
+        op(add_imm) op(shl) op(div_pow2) op(mod_pow2) op(scaled_add)                       /* selected: constant, shift or scale */        \
+        op(jump) op(branch) op(compare_branch) op(ret) op(unreachable)                     /* terminators, compare_branch immediate: compare */
+
+#define op(x) x,
+enum class ir_opcode
+{
+    IR_OPCODE_ENUMERATION(op)
+};
+#undef op
+
+#define op(x)          \
+    case ir_opcode::x: \
+        return #x;
+static std::string to_string(ir_opcode opcode)
+{
+    switch (opcode)
+    {
+        IR_OPCODE_ENUMERATION(op)
+    default:
+        return "unknown";
+    }
+};
+#undef op
+
+struct ir_instruction
+{
+    ir_opcode opcode = ir_opcode::nop;
+    ir_type type     = ir_type::unit; // result type
+    std::vector<value_id> operands;   // phi operands are in the order of the block predecessors
+    int32_t immediate = 0;            // constant, parameter, global, array type, class, field, function, selector, string or element offset
+    int32_t aux       = -1;           // array length for bounds checks, static receiver class for call_method, register of vectors, stack_allocation
+    float fimmediate  = 0.0f;         // f32 constants
+    block_id targets[2] = { -1, -1 }; // jump and branch targets
+    block_id block      = -1;
+    source_code_position position = { 0, 0 };
+
+    bool is_terminator() const
+    {
+        return opcode == ir_opcode::jump || opcode == ir_opcode::branch || opcode == ir_opcode::compare_branch || opcode == ir_opcode::ret || opcode == ir_opcode::unreachable;
+    }
+};
+
+struct ir_block
+{
+    std::vector<value_id> instructions;
+    std::vector<block_id> predecessors;
+    int64_t count = -1; // executions in a profile run, -1 without profile
+    int64_t taken = -1; // executions that branched to the first target
+    bool keeps_checks = false; // header of the checked loop of a versioned loop, it is not versioned again
+};
+
+struct ir_function
+{
+    std::string name;
+    std::string link_name;           // qualified name and signature, the same in every module declaring the function
+    bool is_external = false;        // declared by an imported interface, the linker replaces it by the definition
+    std::vector<ir_type> parameters; // the object is the first parameter of methods
+    ir_type result    = ir_type::unit;
+    int32_t owner     = -1;  // class of methods and static methods
+    bool is_method    = false;
+    int32_t signature = -1;  // function type in the type_table, equal signatures override
+    function_id overrides    = -1; // method of a base class this method overrides
+    int32_t vtable_slot      = -1; // slot of virtually called root methods
+    int32_t vector_registers = 0;  // vector values live in registers, numbered by their aux
+    int32_t frame_size       = 0;  // registers and spill slots after register allocation
+
+    std::vector<int32_t> registers;               // register or spill slot of every value, empty before register allocation
+    std::vector<std::vector<int32_t>> stack_maps; // registers holding live references at every allocation and call
+
+    std::vector<ir_block> blocks;
+    std::vector<ir_instruction> values;
+
+    value_id add_value(ir_instruction&& instr)
+    {
+        value_id id = static_cast<value_id>(values.size());
+        values.push_back(std::move(instr));
+        return id;
+    }
+
+    block_id add_block()
+    {
+        block_id id = static_cast<block_id>(blocks.size());
+        blocks.emplace_back();
+        return id;
+    }
+
+    const ir_instruction* terminator(block_id block) const
+    {
+        const ir_block& b = blocks[block];
+        if (b.instructions.empty() || !values[b.instructions.back()].is_terminator())
+            return nullptr;
+        return &values[b.instructions.back()];
+    }
+
+    std::vector<block_id> successors(block_id block) const;
+
+    // replaces every use of old_value, the old instruction stays in place
+    void replace_all_uses(value_id old_value, value_id new_value);
+
+    // removes the instruction from its block and turns it into a nop
+    void remove(value_id value);
+
+    // removes the edge from -> to, including the phi operands in to
+    void remove_edge(block_id from, block_id to);
+
+    // number of uses of every value
+    std::vector<int32_t> use_counts() const;
+
+    // drops empty blocks and renumbers the others, the entry block stays first
+    void compact_blocks();
+
+    // renumbers the blocks in the given order, which starts with the entry block and contains every block once
+    void reorder_blocks(const std::vector<block_id>& order);
+};
+
+struct ir_global
+{
+    std::string name;
+    ir_type type;
+};
+
+// fixed size array types, element_array for nested arrays
+struct ir_array_type
+{
+    ir_type element;
+    int32_t length;
+    int32_t element_array = -1;
+};
+
+struct ir_class
+{
+    std::string name;
+    int32_t base = -1;
+    std::vector<std::string> field_names; // fields of the bases first
+    std::vector<ir_type> field_types;
+    std::vector<int32_t> field_arrays;    // array type of array fields, -1 otherwise
+    std::vector<function_id> methods;     // methods declared in this class
+    std::vector<function_id> vtable;      // implementations of the virtually called methods
+};
+
+// literal format of a dump, split at its {} placeholders when the ir is built
+struct ir_format
+{
+    int32_t text = -1;                 // the whole format in the strings
+    std::vector<std::string> segments; // the text before every placeholder and after the last one
+};
+
+struct ir_module
+{
+    std::vector<ir_function> functions;
+    std::vector<ir_global> globals;
+    std::vector<int32_t> global_arrays; // array type of array globals, -1 otherwise
+    std::vector<ir_array_type> arrays;
+    std::vector<ir_class> classes;
+    std::vector<std::string> strings;
+    std::vector<ir_format> formats;
+    function_id main     = -1;
+    function_id init     = -1; // initializes the globals, runs before main
+    int32_t vector_width = 0;  // lanes of vi32 and vf32
+
+    // true if derived is base or derives from it
+    bool is_subclass(int32_t derived, int32_t base) const
+    {
+        while (derived != -1)
+        {
+            if (derived == base)
+                return true;
+            derived = classes[derived].base;
+        }
+        return false;
+    }
+
+    // first method in the override chain
+    function_id root_method(function_id method) const
+    {
+        while (functions[method].overrides != -1)
+            method = functions[method].overrides;
+        return method;
+    }
+};
+
+// effects of a single instruction
+effect_summary instruction_effects(const ir_instruction& instr);
+
+void print_ir(std::ostream& out, const ir_module& module);
+void print_ir(std::ostream& out, const ir_module& module, const ir_function& function);
+
+#endif IR_HPP
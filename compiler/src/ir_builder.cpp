@@ -0,0 +1,1235 @@
+//! \file      ir_builder.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "ir_builder.hpp"
+#include "profile.hpp"
+#include <algorithm>
+
+static bool is_function_declaration(const expression& decl)
+{
+    return decl.expr_type == expression_type::declaration && decl.expressions.size() > 2;
+}
+
+static symbol_id declared_symbol(const expression& decl)
+{
+    return static_cast<identifier&>(*decl.expressions[1]).symbol;
+}
+
+ir_builder::ir_builder(symbol_table& symbols, type_table& types)
+    : symbols(symbols)
+    , types(types)
+    , module(nullptr)
+    , declaring(nullptr)
+    , previous(nullptr)
+    , function(nullptr)
+    , current(-1)
+    , this_value(no_value)
+    , function_symbol(invalid_id)
+    , position{ 0, 0 }
+{
+}
+
+bool ir_builder::build(expression& program, ir_module& result)
+{
+    PROFILE_SCOPE("ir_builder::build");
+    module = &result;
+
+    declare_classes(program);
+    for (auto& global : program.expressions)
+    {
+        declaring = global.get();
+        if (global)
+            declare_functions(global.get(), -1);
+    }
+    link_overrides();
+
+    // the functions are not moved while building, so they can be referenced
+    module->init = static_cast<function_id>(module->functions.size());
+    module->functions.emplace_back();
+    module->functions.back().name = "$init";
+    function_declarations.push_back(nullptr);
+    top_level_declarations.push_back(nullptr);
+    if (previous)
+        map_previous_ids();
+
+    build_init(program);
+    for (function_id id = 0; id < module->init; ++id)
+    {
+        // imported functions have no body, they are defined by their module
+        if (!function_declarations[id]->expressions[2])
+            module->functions[id].is_external = true;
+        else if (!reuse_function(id))
+            build_function(*function_declarations[id]);
+    }
+
+    symbol_id main_symbol = symbols.lookup(symbols.global, "main");
+    if (main_symbol != invalid_id && function_ids.count(main_symbol))
+        module->main = function_ids[main_symbol];
+
+    for (const semantic_error& err : m_errors)
+    {
+        std::cerr << err.message << err.position << std::endl;
+    }
+
+    return m_errors.empty();
+}
+
+void ir_builder::reuse(const ir_module& previous, std::unordered_map<const expression*, int32_t> line_deltas)
+{
+    this->previous    = &previous;
+    this->line_deltas = std::move(line_deltas);
+}
+
+void ir_builder::declare_classes(expression& program)
+{
+    for (auto& global : program.expressions)
+    {
+        if (!global || global->expr_type != expression_type::type_declaration)
+            continue;
+
+        symbol_id type_sym = static_cast<identifier&>(*global->expressions[0]).symbol;
+        if (type_sym == invalid_id)
+            continue;
+
+        ir_class cls;
+        cls.name = symbols.name(type_sym);
+
+        // bases are declared before derived types
+        symbol_id base_sym = symbols.get(type_sym).base;
+        if (base_sym != invalid_id && class_ids.count(base_sym))
+            cls.base = class_ids[base_sym];
+
+        std::vector<symbol_id> fields = types.get(symbols.get(type_sym).type).fields;
+        for (symbol_id field : fields)
+        {
+            type_id field_type = symbols.get(field).type;
+            cls.field_names.push_back(symbols.name(field));
+            cls.field_types.push_back(to_ir_type(field_type));
+            cls.field_arrays.push_back(types.get(field_type).kind == type_kind::array ? array_type(field_type) : -1);
+        }
+
+        class_ids[type_sym] = static_cast<int32_t>(module->classes.size());
+        module->classes.push_back(std::move(cls));
+    }
+}
+
+void ir_builder::declare_functions(expression* expr, int32_t owner)
+{
+    if (!expr)
+        return;
+
+    switch (expr->expr_type)
+    {
+    case expression_type::declaration:
+        if (is_function_declaration(*expr))
+        {
+            declare_function(*expr, owner);
+            declare_functions(expr->expressions[2].get(), -1);
+        }
+        else if (declared_symbol(*expr) != invalid_id && symbols.get(declared_symbol(*expr)).kind == symbol_kind::global_variable)
+        {
+            declare_global(*expr);
+        }
+        break;
+    case expression_type::type_declaration:
+    {
+        symbol_id type_sym = static_cast<identifier&>(*expr->expressions[0]).symbol;
+        int32_t cls        = (type_sym != invalid_id && class_ids.count(type_sym)) ? class_ids[type_sym] : -1;
+        for (auto& member : expr->expressions[2]->expressions)
+        {
+            if (member && is_function_declaration(*member) && cls != -1)
+                declare_functions(member.get(), cls);
+        }
+        break;
+    }
+    default:
+        for (auto& child : expr->expressions)
+            declare_functions(child.get(), -1);
+        break;
+    }
+}
+
+void ir_builder::declare_function(expression& function_decl, int32_t owner)
+{
+    symbol_id sym = declared_symbol(function_decl);
+    if (sym == invalid_id || symbols.get(sym).type == invalid_id)
+        return;
+
+    const symbol& info = symbols.get(sym);
+    ir_function result;
+
+    // overloads are told apart by their parameters
+    result.name = symbols.name(sym);
+    if (owner != -1)
+        result.name = module->classes[owner].name + (info.kind == symbol_kind::static_method ? "::" : ".") + result.name;
+
+    // functions declared in blocks are not visible to other modules
+    scope_kind declared_in = symbols.get_scope(info.scope).kind;
+    if (declared_in == scope_kind::global || declared_in == scope_kind::type)
+        result.link_name = result.name + " " + types.to_string(info.type, symbols);
+
+    symbol_id first = symbols.lookup_local(info.scope, info.name);
+    if (first != sym || info.next_overload != invalid_id)
+    {
+        const std::vector<type_id>& parameters = types.get(info.type).parameters;
+        result.name += "(";
+        for (size_t i = 0; i < parameters.size(); ++i)
+            result.name += (i > 0 ? ", " : "") + types.to_string(parameters[i], symbols);
+        result.name += ")";
+    }
+
+    result.is_method = info.kind == symbol_kind::method;
+    if (result.is_method)
+        result.parameters.push_back(ir_type::ref);
+    for (type_id parameter : types.get(info.type).parameters)
+        result.parameters.push_back(to_ir_type(parameter));
+    result.result    = to_ir_type(types.get(info.type).result);
+    result.owner     = owner;
+    result.signature = info.type;
+
+    function_id id   = static_cast<function_id>(module->functions.size());
+    function_ids[sym] = id;
+    if (result.is_method)
+        module->classes[owner].methods.push_back(id);
+
+    module->functions.push_back(std::move(result));
+    function_declarations.push_back(&function_decl);
+    top_level_declarations.push_back(declaring);
+}
+
+void ir_builder::declare_global(expression& decl)
+{
+    symbol_id sym = declared_symbol(decl);
+    if (global_ids.count(sym))
+        return;
+
+    type_id type    = symbols.get(sym).type;
+    global_ids[sym] = static_cast<int32_t>(module->globals.size());
+    module->globals.push_back(ir_global{ symbols.name(sym), to_ir_type(type) });
+    module->global_arrays.push_back(type >= 0 && types.get(type).kind == type_kind::array ? array_type(type) : -1);
+}
+
+void ir_builder::link_overrides()
+{
+    // a method overrides the nearest base method with the same name and signature
+    for (function_id id = 0; id < static_cast<function_id>(module->functions.size()); ++id)
+    {
+        ir_function& method = module->functions[id];
+        if (!method.is_method)
+            continue;
+
+        name_id name = symbols.get(declared_symbol(*function_declarations[id])).name;
+        for (int32_t cls = module->classes[method.owner].base; cls != -1 && method.overrides == -1; cls = module->classes[cls].base)
+        {
+            for (function_id candidate : module->classes[cls].methods)
+            {
+                if (symbols.get(declared_symbol(*function_declarations[candidate])).name == name && module->functions[candidate].signature == method.signature)
+                {
+                    method.overrides = candidate;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void ir_builder::begin_function(function_id id, symbol_id sym)
+{
+    function        = &module->functions[id];
+    function_symbol = sym;
+    this_value      = no_value;
+    definitions.clear();
+    incomplete_phis.clear();
+    sealed.clear();
+    replacements.clear();
+
+    current = new_block();
+    seal_block(current);
+}
+
+void ir_builder::end_function()
+{
+    if (!is_terminated())
+    {
+        if (function->result == ir_type::unit)
+            emit(ir_opcode::ret, ir_type::unit);
+        else
+            emit(ir_opcode::unreachable, ir_type::unit); // missing return
+    }
+
+    // uses of removed trivial phis
+    for (ir_instruction& instr : function->values)
+    {
+        for (value_id& operand : instr.operands)
+            operand = resolve(operand);
+    }
+}
+
+void ir_builder::build_init(expression& program)
+{
+    begin_function(module->init, invalid_id);
+
+    for (auto& global : program.expressions)
+    {
+        if (!global)
+            continue;
+
+        expression* decl = global.get();
+        expression* init = nullptr;
+        if (decl->expr_type == expression_type::assign)
+        {
+            init = decl->expressions[1].get();
+            decl = decl->expressions[0].get();
+        }
+        if (!decl || decl->expr_type != expression_type::declaration || is_function_declaration(*decl))
+            continue;
+
+        symbol_id sym = declared_symbol(*decl);
+        if (sym == invalid_id || !global_ids.count(sym))
+            continue;
+
+        // globals start zeroed, only arrays and initialized globals need code
+        type_id type   = symbols.get(sym).type;
+        position       = decl->source_position;
+        value_id value = init ? lower_expression(init) : no_value;
+        if (types.get(type).kind == type_kind::array && (!init || types.get(init->type).kind != type_kind::array))
+            value = default_value(type, value);
+        if (value != no_value)
+            emit(ir_opcode::store_global, ir_type::unit, { value }, global_ids[sym]);
+    }
+
+    end_function();
+}
+
+void ir_builder::build_function(expression& function_decl)
+{
+    symbol_id sym = declared_symbol(function_decl);
+    begin_function(function_ids[sym], sym);
+    position = function_decl.source_position;
+
+    int32_t index = 0;
+    if (function->is_method)
+        this_value = emit(ir_opcode::param, ir_type::ref, {}, index++);
+
+    expression* function_tp_name = function_decl.expressions[0].get();
+    expression* parameters       = function_tp_name ? function_tp_name->expressions[0].get() : nullptr;
+    if (parameters && parameters->expr_type == expression_type::compound)
+    {
+        for (auto& parameter : parameters->expressions)
+        {
+            if (!parameter)
+                continue;
+            symbol_id parameter_sym = declared_symbol(*parameter);
+            value_id value          = emit(ir_opcode::param, to_ir_type(symbols.get(parameter_sym).type), {}, index++);
+            write_variable(parameter_sym, current, value);
+        }
+    }
+
+    lower_statement(function_decl.expressions[2].get());
+    end_function();
+}
+
+void ir_builder::map_previous_ids()
+{
+    // functions are the same if their link names are, classes and globals if their names are
+    std::unordered_map<std::string, function_id> functions;
+    for (function_id id = 0; id < module->init; ++id)
+    {
+        if (!module->functions[id].link_name.empty())
+            functions.emplace(module->functions[id].link_name, id);
+    }
+    previous_sources.assign(module->functions.size(), -1);
+    for (const ir_function& cached : previous->functions)
+    {
+        auto it = functions.find(cached.link_name);
+        previous_functions.push_back(!cached.link_name.empty() && it != functions.end() ? it->second : -1);
+        if (previous_functions.back() != -1)
+            previous_sources[previous_functions.back()] = static_cast<function_id>(previous_functions.size() - 1);
+    }
+
+    for (const ir_class& cls : previous->classes)
+    {
+        auto it = std::find_if(module->classes.begin(), module->classes.end(), [&cls](const ir_class& c) { return c.name == cls.name; });
+        previous_classes.push_back(it != module->classes.end() ? static_cast<int32_t>(it - module->classes.begin()) : -1);
+    }
+    for (const ir_global& global : previous->globals)
+    {
+        auto it = std::find_if(module->globals.begin(), module->globals.end(), [&global](const ir_global& g) { return g.name == global.name; });
+        previous_globals.push_back(it != module->globals.end() ? static_cast<int32_t>(it - module->globals.begin()) : -1);
+    }
+}
+
+bool ir_builder::reuse_function(function_id id)
+{
+    auto delta = line_deltas.find(top_level_declarations[id]);
+    if (!previous || delta == line_deltas.end())
+        return false;
+
+    if (previous_sources[id] == -1)
+        return false;
+    const ir_function& source = previous->functions[previous_sources[id]];
+    if (source.is_external || source.blocks.empty())
+        return false;
+
+    // everything the function refers to has to exist before anything is interned
+    for (const ir_instruction& instr : source.values)
+    {
+        bool declared = true;
+        switch (instr.opcode)
+        {
+        case ir_opcode::load_global:
+        case ir_opcode::store_global:
+            declared = previous_globals[instr.immediate] != -1;
+            break;
+        case ir_opcode::new_object:
+            declared = previous_classes[instr.immediate] != -1;
+            break;
+        case ir_opcode::call:
+            declared = previous_functions[instr.immediate] != -1;
+            break;
+        case ir_opcode::call_method:
+            declared = previous_functions[instr.immediate] != -1 && (instr.aux == -1 || previous_classes[instr.aux] != -1);
+            break;
+        default:
+            break;
+        }
+        if (!declared)
+            return false;
+    }
+
+    // strings, formats and arrays are interned in the order lowering the function would intern them
+    function         = &module->functions[id];
+    function->blocks = source.blocks;
+    function->values = source.values;
+    for (ir_instruction& instr : function->values)
+    {
+        if (instr.position.line > 0)
+            instr.position.line += delta->second;
+
+        switch (instr.opcode)
+        {
+        case ir_opcode::constant:
+            if (instr.type == ir_type::ref && instr.immediate >= 0)
+                instr.immediate = intern_string(previous->strings[instr.immediate]);
+            break;
+        case ir_opcode::load_global:
+        case ir_opcode::store_global:
+            instr.immediate = previous_globals[instr.immediate];
+            break;
+        case ir_opcode::new_array:
+            instr.immediate = reuse_array(instr.immediate);
+            break;
+        case ir_opcode::new_object:
+            instr.immediate = previous_classes[instr.immediate];
+            break;
+        case ir_opcode::call:
+            instr.immediate = previous_functions[instr.immediate];
+            break;
+        case ir_opcode::call_method:
+            instr.immediate = previous_functions[instr.immediate];
+            if (instr.aux != -1)
+                instr.aux = previous_classes[instr.aux];
+            break;
+        case ir_opcode::dump:
+            if (instr.immediate >= 0)
+                instr.immediate = intern_format(previous->strings[previous->formats[instr.immediate].text]);
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+void ir_builder::lower_statement(expression* expr)
+{
+    lower_expression(expr);
+}
+
+value_id ir_builder::lower_expression(expression* expr)
+{
+    if (!expr)
+        return no_value;
+
+    position = expr->source_position;
+
+    switch (expr->expr_type)
+    {
+    case expression_type::str_lit:
+        return emit(ir_opcode::constant, ir_type::ref, {}, intern_string(static_cast<string_literal*>(expr)->value));
+    case expression_type::i32_lit:
+        return constant_i32(static_cast<integer_literal*>(expr)->value);
+    case expression_type::f32_lit:
+        return constant_f32(static_cast<floating_point_literal*>(expr)->value);
+    case expression_type::bool_lit:
+        return constant_bool(static_cast<boolean_literal*>(expr)->value);
+    case expression_type::identifier:
+        return lower_identifier(static_cast<identifier&>(*expr));
+    case expression_type::neg:
+    case expression_type::add:
+    case expression_type::sub:
+    case expression_type::mult:
+    case expression_type::div:
+    case expression_type::mod:
+    case expression_type::eq:
+    case expression_type::neq:
+    case expression_type::lt:
+    case expression_type::gt:
+    case expression_type::lte:
+    case expression_type::gte:
+    case expression_type::lnot:
+        return lower_operator(*expr);
+    case expression_type::land:
+    case expression_type::lor:
+        return lower_short_circuit(*expr);
+    case expression_type::assign:
+        return lower_assign(*expr);
+    case expression_type::ret:
+    {
+        value_id value = expr->expressions.empty() ? no_value : lower_expression(expr->expressions[0].get());
+        if (value == no_value)
+            emit(ir_opcode::ret, ir_type::unit);
+        else
+            emit(ir_opcode::ret, ir_type::unit, { value });
+        return no_value;
+    }
+    case expression_type::branch:
+        lower_branch(*expr);
+        return no_value;
+    case expression_type::loop:
+        lower_loop(*expr);
+        return no_value;
+    case expression_type::cast:
+        return lower_cast(*expr);
+    case expression_type::function_call:
+        return lower_call(*expr);
+    case expression_type::array_access:
+    {
+        value_id array = no_value;
+        value_id index = no_value;
+        lower_array_access(*expr, array, index);
+        return emit(ir_opcode::load_element, to_ir_type(expr->type), { array, index });
+    }
+    case expression_type::member_access:
+    {
+        value_id object = lower_expression(expr->expressions[0].get());
+        symbol_id field = static_cast<identifier&>(*expr->expressions[1]).symbol;
+        return emit(ir_opcode::load_field, to_ir_type(expr->type), { object }, field_index(field));
+    }
+    case expression_type::instantiation:
+        return lower_instantiation(*expr);
+    case expression_type::declaration:
+        // nested functions are built on their own
+        if (!is_function_declaration(*expr))
+            lower_declaration(*expr, nullptr);
+        return no_value;
+    case expression_type::compound:
+        for (auto& statement : expr->expressions)
+            lower_statement(statement.get());
+        return no_value;
+    default:
+        return no_value;
+    }
+}
+
+value_id ir_builder::lower_identifier(identifier& ident)
+{
+    const symbol& sym = symbols.get(ident.symbol);
+    switch (sym.kind)
+    {
+    case symbol_kind::local_variable:
+    case symbol_kind::parameter:
+        if (symbols.get_scope(sym.scope).owner != function_symbol)
+        {
+            create_error(ident.source_position, "Nested functions can not use " + ident.name + " of the enclosing function");
+            return constant_of(to_ir_type(sym.type));
+        }
+        return read_variable(ident.symbol, current);
+    case symbol_kind::global_variable:
+        return emit(ir_opcode::load_global, to_ir_type(sym.type), {}, global_ids[ident.symbol]);
+    case symbol_kind::member:
+        return emit(ir_opcode::load_field, to_ir_type(sym.type), { this_value }, field_index(ident.symbol));
+    default:
+        return no_value;
+    }
+}
+
+value_id ir_builder::lower_assign(expression& assign)
+{
+    expression* target = assign.expressions[0].get();
+    expression* init   = assign.expressions[1].get();
+
+    switch (target->expr_type)
+    {
+    case expression_type::declaration:
+        return lower_declaration(*target, init);
+    case expression_type::identifier:
+    {
+        identifier& ident = static_cast<identifier&>(*target);
+        value_id value    = lower_expression(init);
+        const symbol& sym = symbols.get(ident.symbol);
+        position          = assign.source_position;
+        switch (sym.kind)
+        {
+        case symbol_kind::local_variable:
+        case symbol_kind::parameter:
+            if (symbols.get_scope(sym.scope).owner != function_symbol)
+                create_error(ident.source_position, "Nested functions can not use " + ident.name + " of the enclosing function");
+            else
+                write_variable(ident.symbol, current, value);
+            break;
+        case symbol_kind::global_variable:
+            emit(ir_opcode::store_global, ir_type::unit, { value }, global_ids[ident.symbol]);
+            break;
+        case symbol_kind::member:
+            emit(ir_opcode::store_field, ir_type::unit, { this_value, value }, field_index(ident.symbol));
+            break;
+        default:
+            break;
+        }
+        return value;
+    }
+    case expression_type::array_access:
+    {
+        value_id array = lower_expression(target->expressions[0].get());
+        value_id index = lower_expression(target->expressions[1].get());
+        value_id value = lower_expression(init);
+        position       = assign.source_position;
+        value_id check = emit(ir_opcode::check_bounds, ir_type::unit, { index });
+        function->values[check].aux = types.get(target->expressions[0]->type).length;
+        emit(ir_opcode::store_element, ir_type::unit, { array, index, value });
+        return value;
+    }
+    case expression_type::member_access:
+    {
+        value_id object = lower_expression(target->expressions[0].get());
+        value_id value  = lower_expression(init);
+        symbol_id field = static_cast<identifier&>(*target->expressions[1]).symbol;
+        position        = assign.source_position;
+        emit(ir_opcode::store_field, ir_type::unit, { object, value }, field_index(field));
+        return value;
+    }
+    default:
+        return lower_expression(init);
+    }
+}
+
+value_id ir_builder::lower_declaration(expression& decl, expression* init)
+{
+    symbol_id sym = declared_symbol(decl);
+    if (sym == invalid_id || symbols.get(sym).kind != symbol_kind::local_variable)
+        return no_value;
+
+    // arrays initialized with a single value are filled with it
+    type_id type   = symbols.get(sym).type;
+    value_id value = init ? lower_expression(init) : no_value;
+    if (types.get(type).kind == type_kind::array && (!init || types.get(init->type).kind != type_kind::array))
+        value = default_value(type, value);
+    else if (value == no_value)
+        value = default_value(type, no_value);
+
+    write_variable(sym, current, value);
+    return value;
+}
+
+value_id ir_builder::lower_operator(expression& expr)
+{
+    // prefix operators only have a right operand
+    if (!expr.expressions[0] || expr.expr_type == expression_type::neg)
+    {
+        expression* operand = expr.expressions.back().get();
+        value_id value      = lower_expression(operand);
+        position            = expr.source_position;
+        switch (expr.expr_type)
+        {
+        case expression_type::sub:
+        case expression_type::neg:
+            return emit(ir_opcode::neg, to_ir_type(expr.type), { value });
+        case expression_type::lnot:
+            return emit(ir_opcode::lnot, ir_type::boolean, { value });
+        default:
+            return value;
+        }
+    }
+
+    value_id lhs = lower_expression(expr.expressions[0].get());
+    value_id rhs = lower_expression(expr.expressions[1].get());
+    position     = expr.source_position;
+
+    ir_opcode opcode = ir_opcode::nop;
+    switch (expr.expr_type)
+    {
+    case expression_type::add:
+        opcode = ir_opcode::add;
+        break;
+    case expression_type::sub:
+        opcode = ir_opcode::sub;
+        break;
+    case expression_type::mult:
+        opcode = ir_opcode::mul;
+        break;
+    case expression_type::div:
+        opcode = ir_opcode::div;
+        break;
+    case expression_type::mod:
+        opcode = ir_opcode::mod;
+        break;
+    case expression_type::eq:
+        opcode = ir_opcode::eq;
+        break;
+    case expression_type::neq:
+        opcode = ir_opcode::ne;
+        break;
+    case expression_type::lt:
+        opcode = ir_opcode::lt;
+        break;
+    case expression_type::gt:
+        opcode = ir_opcode::gt;
+        break;
+    case expression_type::lte:
+        opcode = ir_opcode::le;
+        break;
+    case expression_type::gte:
+        opcode = ir_opcode::ge;
+        break;
+    default:
+        break;
+    }
+
+    return emit(opcode, to_ir_type(expr.type), { lhs, rhs });
+}
+
+value_id ir_builder::lower_short_circuit(expression& expr)
+{
+    bool is_and  = expr.expr_type == expression_type::land;
+    value_id lhs = lower_expression(expr.expressions[0].get());
+
+    // the result is known if the left operand is false for && and true for ||
+    position          = expr.source_position;
+    value_id shortcut = constant_bool(!is_and);
+    block_id from     = current;
+    block_id rhs_block = new_block();
+    block_id merge     = new_block();
+    if (is_and)
+        branch(lhs, rhs_block, merge);
+    else
+        branch(lhs, merge, rhs_block);
+    seal_block(rhs_block);
+
+    current      = rhs_block;
+    value_id rhs = lower_expression(expr.expressions[1].get());
+    jump(merge);
+    seal_block(merge);
+    current = merge;
+
+    value_id phi = new_phi(merge, ir_type::boolean);
+    for (block_id pred : function->blocks[merge].predecessors)
+        function->values[phi].operands.push_back(pred == from ? shortcut : rhs);
+    return phi;
+}
+
+value_id ir_builder::lower_cast(expression& cast)
+{
+    value_id value = lower_expression(cast.expressions[0].get());
+    ir_type from   = to_ir_type(cast.expressions[0]->type);
+    ir_type to     = to_ir_type(cast.type);
+
+    // upcasts of references are free
+    if (from == to)
+        return value;
+
+    position = cast.source_position;
+    return emit(ir_opcode::convert, to, { value });
+}
+
+value_id ir_builder::lower_call(expression& call)
+{
+    expression* callee = call.expressions[0].get();
+    identifier* name   = callee->expr_type == expression_type::identifier ? static_cast<identifier*>(callee) : static_cast<identifier*>(callee->expressions[1].get());
+    const symbol& sym  = symbols.get(name->symbol);
+
+    if (sym.kind == symbol_kind::builtin)
+        return lower_dump(call);
+
+    std::vector<value_id> operands;
+    int32_t receiver_class = -1;
+    if (sym.kind == symbol_kind::method)
+    {
+        if (callee->expr_type == expression_type::member_access)
+        {
+            operands.push_back(lower_expression(callee->expressions[0].get()));
+            receiver_class = class_ids[types.get(callee->expressions[0]->type).symbol];
+        }
+        else
+        {
+            operands.push_back(this_value);
+            receiver_class = function->owner;
+        }
+    }
+
+    for (size_t i = 1; i < call.expressions.size(); ++i)
+        operands.push_back(lower_expression(call.expressions[i].get()));
+
+    position = call.source_position;
+    if (sym.kind != symbol_kind::method)
+        return emit(ir_opcode::call, to_ir_type(call.type), std::move(operands), function_ids[name->symbol]);
+
+    // devirtualized by the class hierarchy analysis where possible
+    value_id result              = emit(ir_opcode::call_method, to_ir_type(call.type), std::move(operands), function_ids[name->symbol]);
+    function->values[result].aux = receiver_class;
+    return result;
+}
+
+value_id ir_builder::lower_dump(expression& call)
+{
+    // a literal format string is kept in the instruction, the arguments are operands
+    bool literal = call.expressions.size() > 1 && call.expressions[1]->expr_type == expression_type::str_lit;
+
+    std::vector<value_id> operands;
+    for (size_t i = literal ? 2 : 1; i < call.expressions.size(); ++i)
+        operands.push_back(lower_expression(call.expressions[i].get()));
+
+    // interned after the arguments, in the order of the values like reused ir is interned
+    int32_t format = literal ? intern_format(static_cast<string_literal&>(*call.expressions[1]).value) : -1;
+
+    position = call.source_position;
+    emit(ir_opcode::dump, ir_type::unit, std::move(operands), format);
+    return no_value;
+}
+
+value_id ir_builder::lower_instantiation(expression& inst)
+{
+    symbol_id type_sym = static_cast<identifier&>(*inst.expressions[0]).symbol;
+    position           = inst.source_position;
+
+    // fields are zeroed and array fields allocated by new_object
+    value_id object = emit(ir_opcode::new_object, ir_type::ref, {}, class_ids[type_sym]);
+    for (size_t i = 1; i < inst.expressions.size(); ++i)
+    {
+        expression& init = *inst.expressions[i];
+        value_id value   = lower_expression(init.expressions[1].get());
+        position         = init.source_position;
+        emit(ir_opcode::store_field, ir_type::unit, { object, value }, field_index(static_cast<identifier&>(*init.expressions[0]).symbol));
+    }
+    return object;
+}
+
+void ir_builder::lower_array_access(expression& access, value_id& array, value_id& index)
+{
+    array    = lower_expression(access.expressions[0].get());
+    index    = lower_expression(access.expressions[1].get());
+    position = access.source_position;
+
+    value_id check              = emit(ir_opcode::check_bounds, ir_type::unit, { index });
+    function->values[check].aux = types.get(access.expressions[0]->type).length;
+}
+
+void ir_builder::lower_branch(expression& expr)
+{
+    value_id condition  = lower_expression(expr.expressions[0].get());
+    bool has_else       = expr.expressions.size() > 2 && expr.expressions[2];
+    block_id then_block = new_block();
+    block_id merge      = new_block();
+    block_id else_block = has_else ? new_block() : merge;
+
+    branch(condition, then_block, else_block);
+    seal_block(then_block);
+    if (has_else)
+        seal_block(else_block);
+
+    current = then_block;
+    lower_statement(expr.expressions[1].get());
+    jump(merge);
+
+    if (has_else)
+    {
+        current = else_block;
+        lower_statement(expr.expressions[2].get());
+        jump(merge);
+    }
+
+    seal_block(merge);
+    current = merge;
+}
+
+void ir_builder::lower_loop(expression& expr)
+{
+    // the header is sealed once the back edge is known
+    block_id header = new_block();
+    jump(header);
+    current = header;
+
+    value_id condition = lower_expression(expr.expressions[0].get());
+    block_id body      = new_block();
+    block_id exit      = new_block();
+    branch(condition, body, exit);
+    seal_block(body);
+
+    current = body;
+    lower_statement(expr.expressions[1].get());
+    jump(header);
+
+    seal_block(header);
+    seal_block(exit);
+    current = exit;
+}
+
+value_id ir_builder::default_value(type_id type, value_id fill)
+{
+    if (type >= 0 && types.get(type).kind == type_kind::array)
+    {
+        // nested arrays are allocated with the outer one, fill initializes the innermost elements
+        std::vector<value_id> operands;
+        if (fill != no_value)
+            operands.push_back(fill);
+        return emit(ir_opcode::new_array, ir_type::ref, std::move(operands), array_type(type));
+    }
+    return constant_of(to_ir_type(type));
+}
+
+ir_type ir_builder::to_ir_type(type_id type) const
+{
+    if (type < 0)
+        return ir_type::unit;
+
+    switch (types.get(type).kind)
+    {
+    case type_kind::i32:
+        return ir_type::i32;
+    case type_kind::f32:
+        return ir_type::f32;
+    case type_kind::boolean:
+        return ir_type::boolean;
+    case type_kind::str:
+    case type_kind::array:
+    case type_kind::user:
+        return ir_type::ref;
+    default:
+        return ir_type::unit;
+    }
+}
+
+int32_t ir_builder::array_type(type_id type)
+{
+    auto it = array_ids.find(type);
+    if (it != array_ids.end())
+        return it->second;
+
+    type_id element = types.get(type).element;
+    ir_array_type array{ to_ir_type(element), types.get(type).length, -1 };
+    if (types.get(element).kind == type_kind::array)
+        array.element_array = array_type(element);
+
+    int32_t id      = intern_array(array);
+    array_ids[type] = id;
+    return id;
+}
+
+int32_t ir_builder::intern_array(const ir_array_type& array)
+{
+    auto layout = std::make_tuple(array.element, array.length, array.element_array);
+    auto it     = array_layouts.find(layout);
+    if (it != array_layouts.end())
+        return it->second;
+
+    int32_t id            = static_cast<int32_t>(module->arrays.size());
+    array_layouts[layout] = id;
+    module->arrays.push_back(array);
+    return id;
+}
+
+int32_t ir_builder::reuse_array(int32_t previous_array)
+{
+    ir_array_type array = previous->arrays[previous_array];
+    if (array.element_array != -1)
+        array.element_array = reuse_array(array.element_array);
+    return intern_array(array);
+}
+
+int32_t ir_builder::field_index(symbol_id member) const
+{
+    // fields of bases come first, so the index is the same in derived types
+    const std::vector<symbol_id>& fields = types.get(symbols.get(symbols.get(member).owner).type).fields;
+    return static_cast<int32_t>(std::find(fields.begin(), fields.end(), member) - fields.begin());
+}
+
+int32_t ir_builder::intern_string(const std::string& str)
+{
+    auto it = string_ids.find(str);
+    if (it != string_ids.end())
+        return it->second;
+
+    int32_t id      = static_cast<int32_t>(module->strings.size());
+    string_ids[str] = id;
+    module->strings.push_back(str);
+    return id;
+}
+
+int32_t ir_builder::intern_format(const std::string& str)
+{
+    int32_t text = intern_string(str);
+    auto it      = format_ids.find(text);
+    if (it != format_ids.end())
+        return it->second;
+
+    ir_format format;
+    format.text  = text;
+    size_t start = 0;
+    for (size_t pos = str.find("{}"); pos != std::string::npos; pos = str.find("{}", start))
+    {
+        format.segments.push_back(str.substr(start, pos - start));
+        start = pos + 2;
+    }
+    format.segments.push_back(str.substr(start));
+
+    int32_t id       = static_cast<int32_t>(module->formats.size());
+    format_ids[text] = id;
+    module->formats.push_back(std::move(format));
+    return id;
+}
+
+value_id ir_builder::emit(ir_opcode opcode, ir_type type, std::vector<value_id> operands, int32_t immediate)
+{
+    // code after a return is collected in an unreachable block
+    if (is_terminated())
+        start_dead_block();
+
+    ir_instruction instr;
+    instr.opcode    = opcode;
+    instr.type      = type;
+    instr.operands  = std::move(operands);
+    instr.immediate = immediate;
+    instr.block     = current;
+    instr.position  = position;
+
+    value_id id = function->add_value(std::move(instr));
+    function->blocks[current].instructions.push_back(id);
+    return id;
+}
+
+value_id ir_builder::constant_i32(int32_t value)
+{
+    return emit(ir_opcode::constant, ir_type::i32, {}, value);
+}
+
+value_id ir_builder::constant_f32(float value)
+{
+    value_id id                   = emit(ir_opcode::constant, ir_type::f32);
+    function->values[id].fimmediate = value;
+    return id;
+}
+
+value_id ir_builder::constant_bool(bool value)
+{
+    return emit(ir_opcode::constant, ir_type::boolean, {}, value ? 1 : 0);
+}
+
+value_id ir_builder::constant_of(ir_type type)
+{
+    switch (type)
+    {
+    case ir_type::f32:
+        return constant_f32(0.0f);
+    case ir_type::ref:
+        return emit(ir_opcode::constant, ir_type::ref, {}, -1); // null
+    case ir_type::unit:
+        return no_value;
+    default:
+        return emit(ir_opcode::constant, type, {}, 0);
+    }
+}
+
+void ir_builder::jump(block_id target)
+{
+    if (is_terminated())
+        return;
+
+    value_id id                      = emit(ir_opcode::jump, ir_type::unit);
+    function->values[id].targets[0] = target;
+    function->blocks[target].predecessors.push_back(current);
+}
+
+void ir_builder::branch(value_id condition, block_id on_true, block_id on_false)
+{
+    if (is_terminated())
+        return;
+
+    value_id id                      = emit(ir_opcode::branch, ir_type::unit, { condition });
+    function->values[id].targets[0] = on_true;
+    function->values[id].targets[1] = on_false;
+    function->blocks[on_true].predecessors.push_back(current);
+    function->blocks[on_false].predecessors.push_back(current);
+}
+
+bool ir_builder::is_terminated() const
+{
+    return function->terminator(current) != nullptr;
+}
+
+void ir_builder::start_dead_block()
+{
+    current = new_block();
+    seal_block(current);
+}
+
+void ir_builder::write_variable(symbol_id variable, block_id block, value_id value)
+{
+    definitions[block][variable] = value;
+}
+
+value_id ir_builder::read_variable(symbol_id variable, block_id block)
+{
+    auto it = definitions[block].find(variable);
+    if (it != definitions[block].end())
+        return resolve(it->second);
+    return read_variable_recursive(variable, block);
+}
+
+value_id ir_builder::read_variable_recursive(symbol_id variable, block_id block)
+{
+    ir_type type                           = to_ir_type(symbols.get(variable).type);
+    const std::vector<block_id>& predecessors = function->blocks[block].predecessors;
+
+    value_id value = no_value;
+    if (!sealed[block])
+    {
+        // operands are added once all predecessors are known
+        value                           = new_phi(block, type);
+        incomplete_phis[block][variable] = value;
+    }
+    else if (predecessors.size() == 1)
+    {
+        value = read_variable(variable, predecessors[0]);
+    }
+    else if (predecessors.empty())
+    {
+        value = undefined_value(block, type);
+    }
+    else
+    {
+        // breaks cycles through loops
+        value = new_phi(block, type);
+        write_variable(variable, block, value);
+        value = add_phi_operands(variable, value);
+    }
+
+    write_variable(variable, block, value);
+    return value;
+}
+
+value_id ir_builder::add_phi_operands(symbol_id variable, value_id phi)
+{
+    std::vector<block_id> predecessors = function->blocks[function->values[phi].block].predecessors;
+    for (block_id pred : predecessors)
+    {
+        value_id operand = read_variable(variable, pred);
+        function->values[phi].operands.push_back(operand);
+    }
+    return try_remove_trivial_phi(phi);
+}
+
+value_id ir_builder::try_remove_trivial_phi(value_id phi)
+{
+    value_id same = no_value;
+    for (value_id operand : function->values[phi].operands)
+    {
+        operand = resolve(operand);
+        if (operand == same || operand == phi)
+            continue;
+        if (same != no_value)
+            return phi; // merges at least two values
+        same = operand;
+    }
+
+    // unreachable or only self references
+    if (same == no_value)
+        same = undefined_value(function->values[phi].block, function->values[phi].type);
+
+    replacements.resize(function->values.size(), no_value);
+    replacements[phi] = same;
+    function->remove(phi);
+
+    // phis using this one might have become trivial, incomplete ones are skipped
+    for (value_id user = 0; user < static_cast<value_id>(function->values.size()); ++user)
+    {
+        const ir_instruction& instr = function->values[user];
+        if (instr.opcode != ir_opcode::phi || instr.operands.size() != function->blocks[instr.block].predecessors.size())
+            continue;
+        if (std::find(instr.operands.begin(), instr.operands.end(), phi) != instr.operands.end())
+            try_remove_trivial_phi(user);
+    }
+
+    return same;
+}
+
+value_id ir_builder::resolve(value_id value)
+{
+    while (value >= 0 && value < static_cast<value_id>(replacements.size()) && replacements[value] != no_value)
+        value = replacements[value];
+    return value;
+}
+
+value_id ir_builder::new_phi(block_id block, ir_type type)
+{
+    ir_instruction instr;
+    instr.opcode   = ir_opcode::phi;
+    instr.type     = type;
+    instr.block    = block;
+    instr.position = position;
+
+    // phis are kept at the start of their block
+    value_id id                        = function->add_value(std::move(instr));
+    std::vector<value_id>& instructions = function->blocks[block].instructions;
+    size_t at                          = 0;
+    while (at < instructions.size() && function->values[instructions[at]].opcode == ir_opcode::phi)
+        ++at;
+    instructions.insert(instructions.begin() + at, id);
+    return id;
+}
+
+value_id ir_builder::undefined_value(block_id block, ir_type type)
+{
+    if (type == ir_type::unit)
+        return no_value;
+
+    // the block can be terminated already, so the zero value is placed in front of its other instructions
+    ir_instruction instr;
+    instr.opcode     = ir_opcode::constant;
+    instr.type       = type;
+    instr.immediate  = type == ir_type::ref ? -1 : 0;
+    instr.block      = block;
+    instr.position   = position;
+    value_id value   = function->add_value(std::move(instr));
+
+    std::vector<value_id>& instructions = function->blocks[block].instructions;
+    size_t at                           = 0;
+    while (at < instructions.size() && function->values[instructions[at]].opcode == ir_opcode::phi)
+        ++at;
+    instructions.insert(instructions.begin() + at, value);
+    return value;
+}
+
+block_id ir_builder::new_block()
+{
+    definitions.emplace_back();
+    incomplete_phis.emplace_back();
+    sealed.push_back(false);
+    return function->add_block();
+}
+
+void ir_builder::seal_block(block_id block)
+{
+    std::unordered_map<symbol_id, value_id> phis = std::move(incomplete_phis[block]);
+    incomplete_phis[block].clear();
+    for (auto& entry : phis)
+        add_phi_operands(entry.first, entry.second);
+    sealed[block] = true;
+}
+
+void ir_builder::create_error(const source_code_position& position, const std::string& msg)
+{
+    m_errors.push_back(semantic_error{ position, msg });
+}
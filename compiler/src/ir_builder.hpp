@@ -0,0 +1,146 @@
+//! \file      ir_builder.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef IR_BUILDER_HPP
+#define IR_BUILDER_HPP
+
+#include "ast.hpp"
+#include "ir.hpp"
+#include "symbol_table.hpp"
+#include "type_table.hpp"
+#include <map>
+#include <tuple>
+
+// Lowers the type checked ast into the ssa ir.
+// Local variables are renamed on the fly with the algorithm of Braun et al., "Simple and Efficient Construction of Static Single Assignment Form".
+// Objects and arrays are references, every method call is lowered as call_method and devirtualized later.
+class ir_builder
+{
+  public:
+    ir_builder(symbol_table& symbols, type_table& types);
+    ~ir_builder() = default;
+
+    // returns false if the program uses something the ir can not express
+    bool build(expression& program, ir_module& module);
+
+    // takes the ir of the functions in the given top level declarations from the previous build of the program instead
+    // of lowering them again, their source positions are moved by the lines the declaration moved since
+    void reuse(const ir_module& previous, std::unordered_map<const expression*, int32_t> line_deltas);
+
+    const semantic_error_list& errors() const
+    {
+        return m_errors;
+    }
+
+  private:
+    void declare_classes(expression& program);
+    // walks the program for function declarations, owner is the class of members
+    void declare_functions(expression* expr, int32_t owner);
+    void declare_function(expression& function_decl, int32_t owner);
+    void declare_global(expression& decl);
+    void link_overrides();
+
+    void begin_function(function_id id, symbol_id sym);
+    void end_function();
+    void build_init(expression& program);
+    void build_function(expression& function_decl);
+    // ids of the previous functions, classes and globals in this build
+    void map_previous_ids();
+    // copies the previous ir of the function, returns false if it does not fit the program any more
+    bool reuse_function(function_id id);
+
+    void lower_statement(expression* expr);
+    value_id lower_expression(expression* expr);
+    value_id lower_identifier(identifier& ident);
+    value_id lower_assign(expression& assign);
+    value_id lower_declaration(expression& decl, expression* init);
+    value_id lower_operator(expression& expr);
+    value_id lower_short_circuit(expression& expr);
+    value_id lower_cast(expression& cast);
+    value_id lower_call(expression& call);
+    value_id lower_dump(expression& call);
+    value_id lower_instantiation(expression& inst);
+    // lowers array and index and checks the bounds
+    void lower_array_access(expression& access, value_id& array, value_id& index);
+    void lower_branch(expression& branch);
+    void lower_loop(expression& loop);
+
+    // default value of a variable, allocates arrays
+    value_id default_value(type_id type, value_id fill);
+
+    ir_type to_ir_type(type_id type) const;
+    int32_t array_type(type_id type);
+    int32_t intern_array(const ir_array_type& array);
+    int32_t reuse_array(int32_t previous_array);
+    int32_t field_index(symbol_id member) const;
+    int32_t intern_string(const std::string& str);
+
+    // splits a literal dump format at its placeholders once, so running the dump does not parse it
+    int32_t intern_format(const std::string& str);
+
+    // instruction creation in the current block
+    value_id emit(ir_opcode opcode, ir_type type, std::vector<value_id> operands = {}, int32_t immediate = 0);
+    value_id constant_i32(int32_t value);
+    value_id constant_f32(float value);
+    value_id constant_bool(bool value);
+    value_id constant_of(ir_type type);
+    void jump(block_id target);
+    void branch(value_id condition, block_id on_true, block_id on_false);
+    bool is_terminated() const;
+    // continues after a terminator in an unreachable block
+    void start_dead_block();
+
+    // ssa construction
+    void write_variable(symbol_id variable, block_id block, value_id value);
+    value_id read_variable(symbol_id variable, block_id block);
+    value_id read_variable_recursive(symbol_id variable, block_id block);
+    value_id add_phi_operands(symbol_id variable, value_id phi);
+    value_id try_remove_trivial_phi(value_id phi);
+    value_id resolve(value_id value);
+    value_id new_phi(block_id block, ir_type type);
+    value_id undefined_value(block_id block, ir_type type);
+    block_id new_block();
+    void seal_block(block_id block);
+
+    void create_error(const source_code_position& position, const std::string& msg);
+
+    symbol_table& symbols;
+    type_table& types;
+    ir_module* module;
+    semantic_error_list m_errors;
+
+    std::unordered_map<symbol_id, function_id> function_ids;
+    std::unordered_map<symbol_id, int32_t> global_ids;
+    std::unordered_map<symbol_id, int32_t> class_ids;
+    std::unordered_map<type_id, int32_t> array_ids;
+    std::map<std::tuple<ir_type, int32_t, int32_t>, int32_t> array_layouts; // types with the same layout share one array type
+    std::unordered_map<std::string, int32_t> string_ids;
+    std::unordered_map<int32_t, int32_t> format_ids; // format of each string
+    std::vector<expression*> function_declarations; // indexed by function id
+    std::vector<const expression*> top_level_declarations; // indexed by function id
+    const expression* declaring;                           // top level declaration walked by declare_functions
+
+    // the previous build, see reuse
+    const ir_module* previous;
+    std::unordered_map<const expression*, int32_t> line_deltas;
+    std::vector<function_id> previous_functions; // -1 if not declared any more
+    std::vector<function_id> previous_sources;   // previous function of each function, -1 for new ones
+    std::vector<int32_t> previous_classes;
+    std::vector<int32_t> previous_globals;
+
+    // state of the function being built
+    ir_function* function;
+    block_id current;
+    value_id this_value;
+    symbol_id function_symbol;
+    source_code_position position;
+    std::vector<std::unordered_map<symbol_id, value_id>> definitions;
+    std::vector<std::unordered_map<symbol_id, value_id>> incomplete_phis;
+    std::vector<bool> sealed;
+    std::vector<value_id> replacements;
+};
+
+#endif IR_BUILDER_HPP
@@ -0,0 +1,225 @@
+//! \file      ir_cleanup.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "ir_cleanup.hpp"
+#include <algorithm>
+
+bool cleanup_function(ir_function& function, effect_analysis& effects)
+{
+    bool changed = false;
+    while (true)
+    {
+        bool round = fold_constant_branches(function);
+        round      = remove_unreachable_blocks(function) || round;
+        round      = remove_trivial_phis(function) || round;
+        round      = merge_blocks(function) || round;
+        round      = remove_unused_values(function, effects) || round;
+        if (!round)
+            break;
+        changed = true;
+    }
+
+    function.compact_blocks();
+    return changed;
+}
+
+bool fold_constant_branches(ir_function& function)
+{
+    bool changed = false;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const ir_instruction* term = function.terminator(block);
+        if (!term || term->opcode != ir_opcode::branch)
+            continue;
+
+        const ir_instruction& condition = function.values[term->operands[0]];
+        if (condition.opcode != ir_opcode::constant && term->targets[0] != term->targets[1])
+            continue;
+
+        // the edge to the other target is removed with its phi operands, a branch to one block has two edges to it
+        value_id branch = function.blocks[block].instructions.back();
+        bool on_false   = condition.opcode == ir_opcode::constant && condition.immediate == 0;
+        block_id taken  = function.values[branch].targets[on_false ? 1 : 0];
+        function.remove_edge(block, function.values[branch].targets[on_false ? 0 : 1]);
+
+        ir_instruction& jump = function.values[branch];
+        jump.opcode          = ir_opcode::jump;
+        jump.operands.clear();
+        jump.targets[0] = taken;
+        jump.targets[1] = -1;
+        changed         = true;
+    }
+    return changed;
+}
+
+bool remove_unreachable_blocks(ir_function& function)
+{
+    std::vector<bool> reachable(function.blocks.size(), false);
+    std::vector<block_id> stack = { 0 };
+    reachable[0]                = true;
+    while (!stack.empty())
+    {
+        block_id block = stack.back();
+        stack.pop_back();
+        for (block_id succ : function.successors(block))
+        {
+            if (!reachable[succ])
+            {
+                reachable[succ] = true;
+                stack.push_back(succ);
+            }
+        }
+    }
+
+    bool changed = false;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        if (reachable[block] || function.blocks[block].instructions.empty())
+            continue;
+
+        for (block_id succ : function.successors(block))
+            function.remove_edge(block, succ);
+        changed = true;
+    }
+
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        if (reachable[block])
+            continue;
+
+        for (value_id value : function.blocks[block].instructions)
+        {
+            function.values[value].opcode = ir_opcode::nop;
+            function.values[value].block  = -1;
+            function.values[value].operands.clear();
+        }
+        function.blocks[block].instructions.clear();
+        function.blocks[block].predecessors.clear();
+    }
+
+    return changed;
+}
+
+bool remove_trivial_phis(ir_function& function)
+{
+    bool changed = false;
+    bool round   = true;
+    while (round)
+    {
+        round = false;
+        for (ir_block& block : function.blocks)
+        {
+            // copied, removing changes the instruction list
+            std::vector<value_id> instructions = block.instructions;
+            for (value_id phi : instructions)
+            {
+                if (function.values[phi].opcode != ir_opcode::phi)
+                    break;
+
+                value_id same = no_value;
+                bool trivial  = true;
+                for (value_id operand : function.values[phi].operands)
+                {
+                    if (operand == same || operand == phi)
+                        continue;
+                    if (same != no_value)
+                    {
+                        trivial = false;
+                        break;
+                    }
+                    same = operand;
+                }
+                if (!trivial || same == no_value)
+                    continue;
+
+                function.replace_all_uses(phi, same);
+                function.remove(phi);
+                round = changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool merge_blocks(ir_function& function)
+{
+    bool changed = false;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        while (true)
+        {
+            const ir_instruction* term = function.terminator(block);
+            if (!term || term->opcode != ir_opcode::jump)
+                break;
+
+            block_id next = term->targets[0];
+            if (next == block || next == 0 || function.blocks[next].predecessors.size() != 1)
+                break;
+
+            // phis with a single predecessor are copies
+            ir_block& successor = function.blocks[next];
+            while (!successor.instructions.empty() && function.values[successor.instructions.front()].opcode == ir_opcode::phi)
+            {
+                value_id phi = successor.instructions.front();
+                function.replace_all_uses(phi, function.values[phi].operands[0]);
+                function.remove(phi);
+            }
+
+            function.remove(function.blocks[block].instructions.back());
+            for (value_id value : successor.instructions)
+                function.values[value].block = block;
+            function.blocks[block].instructions.insert(function.blocks[block].instructions.end(), successor.instructions.begin(), successor.instructions.end());
+            successor.instructions.clear();
+            successor.predecessors.clear();
+
+            for (block_id succ : function.successors(block))
+                std::replace(function.blocks[succ].predecessors.begin(), function.blocks[succ].predecessors.end(), next, block);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool remove_unused_values(ir_function& function, effect_analysis& effects)
+{
+    std::vector<int32_t> uses = function.use_counts();
+
+    // reading memory has no observable effect
+    auto removable = [&](value_id value) {
+        const ir_instruction& instr = function.values[value];
+        return instr.block != -1 && uses[value] == 0 && !instr.is_terminator() && (effects.summary(value) & ~effect_reads_memory) == 0;
+    };
+
+    std::vector<value_id> worklist;
+    for (const ir_block& block : function.blocks)
+    {
+        for (value_id value : block.instructions)
+        {
+            if (removable(value))
+                worklist.push_back(value);
+        }
+    }
+
+    bool changed = false;
+    while (!worklist.empty())
+    {
+        value_id value = worklist.back();
+        worklist.pop_back();
+        if (!removable(value))
+            continue;
+
+        std::vector<value_id> operands = function.values[value].operands;
+        function.remove(value);
+        changed = true;
+
+        for (value_id operand : operands)
+        {
+            if (--uses[operand] == 0 && removable(operand))
+                worklist.push_back(operand);
+        }
+    }
+    return changed;
+}
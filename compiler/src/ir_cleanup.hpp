@@ -0,0 +1,25 @@
+//! \file      ir_cleanup.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef IR_CLEANUP_HPP
+#define IR_CLEANUP_HPP
+
+#include "effect_analysis.hpp"
+#include "ir.hpp"
+
+// Cheap simplifications run after transformations that leave redundant structure behind, like inlining.
+// Folds branches on constants, removes unreachable blocks and trivial phis, merges straight line blocks
+// and drops unused side effect free values.
+// Returns true if the function changed.
+bool cleanup_function(ir_function& function, effect_analysis& effects);
+
+bool fold_constant_branches(ir_function& function);
+bool remove_unreachable_blocks(ir_function& function);
+bool remove_trivial_phis(ir_function& function);
+bool merge_blocks(ir_function& function);
+bool remove_unused_values(ir_function& function, effect_analysis& effects);
+
+#endif IR_CLEANUP_HPP
@@ -0,0 +1,516 @@
+//! \file      ir_interpreter.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "ir_interpreter.hpp"
+#include "profile.hpp"
+#include "simd.hpp"
+#include "tail_calls.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const size_t max_call_depth = 100000;
+
+// i32 arithmetic wraps around
+static int32_t wrap(uint32_t value)
+{
+    return static_cast<int32_t>(value);
+}
+
+static int32_t to_i32(float value)
+{
+    if (std::isnan(value))
+        return 0;
+    if (value <= static_cast<float>(std::numeric_limits<int32_t>::min()))
+        return std::numeric_limits<int32_t>::min();
+    if (value >= static_cast<float>(std::numeric_limits<int32_t>::max()))
+        return std::numeric_limits<int32_t>::max();
+    return static_cast<int32_t>(value);
+}
+
+static bool equal_references(const runtime_object* a, const runtime_object* b)
+{
+    // strings compare by content, equal literals are one object
+    if (a == b)
+        return true;
+    return a && b && a->kind == runtime_object_kind::string && b->kind == runtime_object_kind::string && a->text == b->text;
+}
+
+// index plus the constant offset instruction selection folded into an access
+static int32_t displace(int32_t index, int32_t offset)
+{
+    return wrap(static_cast<uint32_t>(index) + static_cast<uint32_t>(offset));
+}
+
+// operands of the given type, ordered comparisons are only used on i32 and f32
+static bool compare(ir_opcode opcode, ir_type type, runtime_value a, runtime_value b)
+{
+    if (opcode == ir_opcode::eq || opcode == ir_opcode::ne)
+    {
+        bool equal = false;
+        if (type == ir_type::f32)
+            equal = a.f == b.f;
+        else if (type == ir_type::ref)
+            equal = equal_references(a.ref, b.ref);
+        else
+            equal = a.i == b.i;
+        return (opcode == ir_opcode::eq) == equal;
+    }
+
+    switch (opcode)
+    {
+    case ir_opcode::lt:
+        return type == ir_type::f32 ? a.f < b.f : a.i < b.i;
+    case ir_opcode::gt:
+        return type == ir_type::f32 ? a.f > b.f : a.i > b.i;
+    case ir_opcode::le:
+        return type == ir_type::f32 ? a.f <= b.f : a.i <= b.i;
+    default:
+        return type == ir_type::f32 ? a.f >= b.f : a.i >= b.i;
+    }
+}
+
+ir_interpreter::ir_interpreter(const ir_module& module, runtime& rt)
+    : module(module)
+    , rt(rt)
+{
+    // functions without register allocation keep one register per value
+    size_t values = 0;
+    for (const ir_function& function : module.functions)
+        values = std::max(values, function.values.size());
+    for (size_t value = 0; value < values; ++value)
+        identity.push_back(static_cast<int32_t>(value));
+    rt.set_roots(this);
+}
+
+ir_interpreter::~ir_interpreter()
+{
+    rt.set_roots(nullptr);
+}
+
+int32_t ir_interpreter::run()
+{
+    PROFILE_SCOPE("ir_interpreter::run");
+    frames.clear();
+    if (module.init != -1)
+        call(module.init, stack.size());
+
+    if (module.main == -1)
+        rt.trap("Missing main function", { 0, 0 });
+
+    runtime_value result = call(module.main, stack.size());
+    return module.functions[module.main].result == ir_type::i32 ? result.i : 0;
+}
+
+size_t ir_interpreter::push_arguments(const ir_instruction& instr, const int32_t* registers, size_t base, size_t first)
+{
+    size_t arguments = stack.size();
+    for (size_t i = first; i < instr.operands.size(); ++i)
+        stack.push_back(stack[base + registers[instr.operands[i]]]);
+    return arguments;
+}
+
+runtime_value ir_interpreter::call(function_id id, size_t arguments)
+{
+    size_t bottom = frames.size();
+    enter(id, arguments);
+
+    runtime_value returned;
+    returned.ref = nullptr;
+    while (frames.size() > bottom)
+    {
+        // a returning callee writes its result into the call it was called by
+        if (execute(returned) && frames.size() > bottom)
+        {
+            const frame_record& caller                               = frames.back();
+            stack[caller.base + caller.registers[caller.safepoint]] = returned;
+        }
+    }
+    return returned;
+}
+
+void ir_interpreter::enter(function_id id, size_t arguments)
+{
+    if (frames.size() >= max_call_depth)
+        rt.trap("Stack overflow in " + module.functions[id].name, { 0, 0 });
+
+    const ir_function& function = module.functions[id];
+    frame_record frame;
+    frame.function      = &function;
+    frame.registers     = function.registers.empty() ? identity.data() : function.registers.data();
+    frame.base          = stack.size();
+    frame.arguments     = arguments;
+    frame.safepoint     = no_value;
+    frame.stack_objects = rt.stack_mark();
+    frame.vector_base   = vector_lanes.size();
+    stack.resize(frame.base + (function.registers.empty() ? function.values.size() : function.frame_size));
+    vector_lanes.resize(frame.vector_base + function.vector_registers * module.vector_width);
+    frames.push_back(frame);
+}
+
+void ir_interpreter::visit_roots(garbage_collector& collector)
+{
+    for (const frame_record& frame : frames)
+    {
+        const ir_function& function = *frame.function;
+        for (size_t i = 0; i < function.parameters.size(); ++i)
+        {
+            if (function.parameters[i] == ir_type::ref)
+                collector.visit(stack[frame.arguments + i]);
+        }
+
+        if (!function.stack_maps.empty())
+        {
+            for (int32_t slot : function.stack_maps[frame.safepoint])
+                collector.visit(stack[frame.base + slot]);
+            continue;
+        }
+
+        // without register allocation every value has its own slot, zeroed until the value is computed
+        for (value_id value = 0; value < static_cast<value_id>(function.values.size()); ++value)
+        {
+            if (function.values[value].type == ir_type::ref)
+                collector.visit(stack[frame.base + frame.registers[value]]);
+        }
+    }
+}
+
+void ir_interpreter::suspend(value_id call, block_id block, block_id previous, size_t resume)
+{
+    frame_record& frame = frames.back();
+    frame.safepoint     = call;
+    frame.block         = block;
+    frame.previous      = previous;
+    frame.resume        = resume;
+}
+
+void ir_interpreter::replace_frame(const ir_instruction& instr, const int32_t* registers, size_t base, size_t arguments, size_t vector_base)
+{
+    size_t first = push_arguments(instr, registers, base, 0);
+    size_t count = stack.size() - first;
+    std::copy(stack.begin() + first, stack.end(), stack.begin() + arguments);
+    stack.resize(arguments + count);
+    vector_lanes.resize(vector_base);
+}
+
+bool ir_interpreter::execute(runtime_value& returned)
+{
+    const frame_record& top     = frames.back();
+    const ir_function& function = *top.function;
+    const int32_t* registers    = top.registers;
+    size_t base                 = top.base;
+    size_t arguments            = top.arguments;
+    size_t stack_objects        = top.stack_objects;
+    size_t vector_base          = top.vector_base;
+    block_id block              = top.block;
+    block_id previous           = top.previous;
+    size_t resume               = top.resume;
+    for (;;)
+    {
+        const ir_block& current = function.blocks[block];
+        size_t i                = resume;
+        resume                  = 0;
+
+        // phis read their operands before any of them is written
+        if (i == 0 && previous != -1)
+        {
+            size_t pred = std::find(current.predecessors.begin(), current.predecessors.end(), previous) - current.predecessors.begin();
+            phi_values.clear();
+            for (; i < current.instructions.size() && function.values[current.instructions[i]].opcode == ir_opcode::phi; ++i)
+                phi_values.push_back(stack[base + registers[function.values[current.instructions[i]].operands[pred]]]);
+            for (size_t p = 0; p < i; ++p)
+                stack[base + registers[current.instructions[p]]] = phi_values[p];
+        }
+
+        for (; i < current.instructions.size(); ++i)
+        {
+            value_id value              = current.instructions[i];
+            const ir_instruction& instr = function.values[value];
+            runtime_value* frame        = stack.data() + base;
+            runtime_value& result       = frame[registers[value]];
+            auto operand                = [&](size_t index) -> runtime_value& { return frame[registers[instr.operands[index]]]; };
+            ir_type operand_type        = instr.operands.empty() ? ir_type::unit : function.values[instr.operands[0]].type;
+
+            if (instr.type == ir_type::vi32 || instr.type == ir_type::vf32)
+            {
+                int32_t width = module.vector_width;
+                int32_t* out  = lanes(function, value, vector_base);
+                switch (instr.opcode)
+                {
+                case ir_opcode::splat:
+                    std::fill(out, out + width, operand(0).i);
+                    break;
+                case ir_opcode::load_vector:
+                {
+                    const runtime_object* array = operand(0).ref;
+                    if (!array)
+                        rt.trap("Null reference", instr.position);
+                    std::memcpy(out, array->words + operand(1).i, width * sizeof(int32_t));
+                    break;
+                }
+                case ir_opcode::neg:
+                case ir_opcode::convert:
+                    simd_unary(instr.opcode, instr.type, width, lanes(function, instr.operands[0], vector_base), out);
+                    break;
+                default:
+                    simd_binary(instr.opcode, instr.type, width, lanes(function, instr.operands[0], vector_base), lanes(function, instr.operands[1], vector_base), out);
+                    break;
+                }
+                continue;
+            }
+
+            switch (instr.opcode)
+            {
+            case ir_opcode::nop:
+            case ir_opcode::phi:
+                break;
+            case ir_opcode::splat:
+            case ir_opcode::load_vector:
+                break; // always vectors, executed above
+            case ir_opcode::constant:
+                if (instr.type == ir_type::f32)
+                    result.f = instr.fimmediate;
+                else if (instr.type == ir_type::ref)
+                    result.ref = instr.immediate == -1 ? nullptr : rt.string(instr.immediate);
+                else
+                    result.i = instr.immediate;
+                break;
+            case ir_opcode::param:
+                result = stack[arguments + instr.immediate];
+                break;
+            case ir_opcode::copy:
+                result = operand(0);
+                break;
+
+            case ir_opcode::add:
+                if (instr.type == ir_type::f32)
+                    result.f = operand(0).f + operand(1).f;
+                else
+                    result.i = wrap(static_cast<uint32_t>(operand(0).i) + static_cast<uint32_t>(operand(1).i));
+                break;
+            case ir_opcode::sub:
+                if (instr.type == ir_type::f32)
+                    result.f = operand(0).f - operand(1).f;
+                else
+                    result.i = wrap(static_cast<uint32_t>(operand(0).i) - static_cast<uint32_t>(operand(1).i));
+                break;
+            case ir_opcode::mul:
+                if (instr.type == ir_type::f32)
+                    result.f = operand(0).f * operand(1).f;
+                else
+                    result.i = wrap(static_cast<uint32_t>(operand(0).i) * static_cast<uint32_t>(operand(1).i));
+                break;
+            case ir_opcode::div:
+            case ir_opcode::mod:
+            {
+                bool is_div = instr.opcode == ir_opcode::div;
+                if (instr.type == ir_type::f32)
+                {
+                    result.f = is_div ? operand(0).f / operand(1).f : std::fmod(operand(0).f, operand(1).f);
+                    break;
+                }
+                int32_t a = operand(0).i;
+                int32_t b = operand(1).i;
+                if (b == 0)
+                    rt.trap("Division by zero", instr.position);
+                if (b == -1)
+                    result.i = is_div ? wrap(0u - static_cast<uint32_t>(a)) : 0;
+                else
+                    result.i = is_div ? a / b : a % b;
+                break;
+            }
+            case ir_opcode::neg:
+                if (instr.type == ir_type::f32)
+                    result.f = -operand(0).f;
+                else
+                    result.i = wrap(0u - static_cast<uint32_t>(operand(0).i));
+                break;
+
+            case ir_opcode::add_imm:
+                result.i = displace(operand(0).i, instr.immediate);
+                break;
+            case ir_opcode::shl:
+                result.i = wrap(static_cast<uint32_t>(operand(0).i) << instr.immediate);
+                break;
+            case ir_opcode::div_pow2:
+            case ir_opcode::mod_pow2:
+            {
+                // negative dividends are rounded towards zero by adding 2^k - 1 first
+                int32_t a    = operand(0).i;
+                int32_t mask = (1 << instr.immediate) - 1;
+                int32_t bias = (a >> 31) & mask;
+                result.i     = instr.opcode == ir_opcode::div_pow2 ? (a + bias) >> instr.immediate : ((a + bias) & mask) - bias;
+                break;
+            }
+            case ir_opcode::scaled_add:
+                result.i = wrap(static_cast<uint32_t>(operand(0).i) + static_cast<uint32_t>(operand(1).i) * static_cast<uint32_t>(instr.immediate));
+                break;
+
+            case ir_opcode::eq:
+            case ir_opcode::ne:
+            case ir_opcode::lt:
+            case ir_opcode::gt:
+            case ir_opcode::le:
+            case ir_opcode::ge:
+                result.i = compare(instr.opcode, operand_type, operand(0), operand(1)) ? 1 : 0;
+                break;
+            case ir_opcode::lnot:
+                result.i = operand(0).i ? 0 : 1;
+                break;
+            case ir_opcode::convert:
+                if (instr.type == operand_type)
+                    result = operand(0);
+                else if (instr.type == ir_type::f32)
+                    result.f = static_cast<float>(operand(0).i);
+                else if (instr.type == ir_type::i32)
+                    result.i = operand_type == ir_type::f32 ? to_i32(operand(0).f) : operand(0).i;
+                else if (instr.type == ir_type::boolean)
+                    result.i = operand_type == ir_type::f32 ? operand(0).f != 0.0f : operand(0).i != 0;
+                break;
+            case ir_opcode::select:
+                result = operand(0).i ? operand(1) : operand(2);
+                break;
+
+            case ir_opcode::load_global:
+                result = rt.global(instr.immediate);
+                break;
+            case ir_opcode::store_global:
+                rt.global(instr.immediate) = operand(0);
+                break;
+
+            case ir_opcode::new_array:
+                frames.back().safepoint = value;
+                result.ref = rt.new_array(instr.immediate, instr.operands.empty() ? nullptr : &operand(0), instr.aux == stack_allocation);
+                break;
+            case ir_opcode::check_bounds:
+            {
+                int32_t index = displace(operand(0).i, instr.immediate);
+                if (index < 0 || index >= instr.aux)
+                    rt.trap("Index " + std::to_string(index) + " out of bounds for length " + std::to_string(instr.aux), instr.position);
+                break;
+            }
+            case ir_opcode::load_element:
+                if (!operand(0).ref)
+                    rt.trap("Null reference", instr.position);
+                if (instr.type == ir_type::ref)
+                    result = operand(0).ref->elements[displace(operand(1).i, instr.immediate)];
+                else
+                    result.i = operand(0).ref->words[displace(operand(1).i, instr.immediate)];
+                break;
+            case ir_opcode::store_element:
+                if (!operand(0).ref)
+                    rt.trap("Null reference", instr.position);
+                if (function.values[instr.operands[2]].type == ir_type::ref)
+                {
+                    operand(0).ref->elements[displace(operand(1).i, instr.immediate)] = operand(2);
+                    rt.write_barrier(operand(0).ref, operand(2));
+                }
+                else
+                    operand(0).ref->words[displace(operand(1).i, instr.immediate)] = operand(2).i;
+                break;
+
+            case ir_opcode::store_vector:
+                if (!operand(0).ref)
+                    rt.trap("Null reference", instr.position);
+                std::memcpy(operand(0).ref->words + operand(1).i, lanes(function, instr.operands[2], vector_base), module.vector_width * sizeof(int32_t));
+                break;
+
+            case ir_opcode::new_object:
+                frames.back().safepoint = value;
+                result.ref = rt.new_instance(instr.immediate, instr.aux == stack_allocation);
+                break;
+            case ir_opcode::check_null:
+                if (!operand(0).ref)
+                    rt.trap("Null reference", instr.position);
+                break;
+            case ir_opcode::load_field:
+                if (!operand(0).ref)
+                    rt.trap("Null reference", instr.position);
+                result = operand(0).ref->elements[instr.immediate];
+                break;
+            case ir_opcode::store_field:
+                if (!operand(0).ref)
+                    rt.trap("Null reference", instr.position);
+                operand(0).ref->elements[instr.immediate] = operand(1);
+                if (function.values[instr.operands[1]].type == ir_type::ref)
+                    rt.write_barrier(operand(0).ref, operand(1));
+                break;
+
+            case ir_opcode::call:
+            {
+                // a call returned right away reuses the frame, mutually recursive tail calls run in constant stack
+                if (is_tail_call(function, value))
+                {
+                    replace_frame(instr, registers, base, arguments, vector_base);
+                    rt.release_stack(stack_objects);
+                    frames.pop_back();
+                    enter(instr.immediate, arguments);
+                    return false;
+                }
+                suspend(value, block, previous, i + 1);
+                enter(instr.immediate, push_arguments(instr, registers, base, 0));
+                return false;
+            }
+            case ir_opcode::call_method:
+            {
+                const runtime_object* object = operand(0).ref;
+                if (!object)
+                    rt.trap("Null reference", instr.position);
+                int32_t slot       = module.functions[module.root_method(instr.immediate)].vtable_slot;
+                function_id target = slot == -1 ? instr.immediate : module.classes[object->type].vtable[slot];
+                if (is_tail_call(function, value))
+                {
+                    replace_frame(instr, registers, base, arguments, vector_base);
+                    rt.release_stack(stack_objects);
+                    frames.pop_back();
+                    enter(target, arguments);
+                    return false;
+                }
+                suspend(value, block, previous, i + 1);
+                enter(target, push_arguments(instr, registers, base, 0));
+                return false;
+            }
+            case ir_opcode::dump:
+            {
+                dump_types.clear();
+                for (value_id arg : instr.operands)
+                    dump_types.push_back(function.values[arg].type);
+                size_t first = push_arguments(instr, registers, base, 0);
+                rt.dump(instr.immediate, dump_types, stack.data() + first);
+                stack.resize(first);
+                break;
+            }
+            case ir_opcode::count:
+                rt.count(instr.immediate);
+                break;
+
+            case ir_opcode::jump:
+                previous = block;
+                block    = instr.targets[0];
+                break;
+            case ir_opcode::branch:
+                previous = block;
+                block    = instr.targets[operand(0).i ? 0 : 1];
+                break;
+            case ir_opcode::compare_branch:
+                previous = block;
+                block    = instr.targets[compare(static_cast<ir_opcode>(instr.immediate), operand_type, operand(0), operand(1)) ? 0 : 1];
+                break;
+            case ir_opcode::ret:
+                if (!instr.operands.empty())
+                    returned = operand(0);
+                stack.resize(arguments);
+                vector_lanes.resize(vector_base);
+                rt.release_stack(stack_objects);
+                frames.pop_back();
+                return true;
+            case ir_opcode::unreachable:
+                rt.trap("Missing return in " + function.name, instr.position);
+            }
+        }
+    }
+}
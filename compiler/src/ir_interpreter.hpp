@@ -0,0 +1,77 @@
+//! \file      ir_interpreter.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef IR_INTERPRETER_HPP
+#define IR_INTERPRETER_HPP
+
+#include "ir.hpp"
+#include "runtime.hpp"
+
+// Executes the IR of a module directly, every call gets a frame with one slot per register.
+// The frames are the roots of the collector, it finds their references with the stack maps of the safepoints.
+class ir_interpreter : public root_set
+{
+  public:
+    ir_interpreter(const ir_module& module, runtime& rt);
+    ~ir_interpreter() override;
+
+    // runs the init function, then main, and returns the result of main
+    // throws a runtime_error if the program traps
+    int32_t run();
+
+    void visit_roots(garbage_collector& collector) override;
+
+  private:
+    struct frame_record
+    {
+        const ir_function* function;
+        const int32_t* registers;
+        size_t base;
+        size_t arguments;
+        value_id safepoint; // allocation or call the frame is in
+        size_t stack_objects;
+        size_t vector_base;
+        block_id block    = 0; // the instruction the frame continues at once its call returned
+        block_id previous = -1;
+        size_t resume     = 0;
+    };
+
+    // the arguments are on the top of the stack, starting at arguments
+    // calls push frames instead of recursing, so deep recursion only needs memory for the frames
+    runtime_value call(function_id id, size_t arguments);
+
+    // pushes the frame of id, traps if there are too many frames
+    void enter(function_id id, size_t arguments);
+
+    // runs the top frame until it calls, which pushes the frame of the callee, or returns, which returns true
+    bool execute(runtime_value& returned);
+
+    // remembers where the top frame continues after the call
+    void suspend(value_id call, block_id block, block_id previous, size_t resume);
+
+    // moves the arguments of the tail call instr over the ones of the frame at base
+    void replace_frame(const ir_instruction& instr, const int32_t* registers, size_t base, size_t arguments, size_t vector_base);
+
+    // pushes the operands from their registers in the frame at base
+    size_t push_arguments(const ir_instruction& instr, const int32_t* registers, size_t base, size_t first);
+
+    // lanes of the vector register of value in the frame at vector_base
+    int32_t* lanes(const ir_function& function, value_id value, size_t vector_base)
+    {
+        return vector_lanes.data() + vector_base + function.values[value].aux * module.vector_width;
+    }
+
+    const ir_module& module;
+    runtime& rt;
+    std::vector<runtime_value> stack;
+    std::vector<frame_record> frames;
+    std::vector<int32_t> vector_lanes; // vector registers of all frames
+    std::vector<runtime_value> phi_values;
+    std::vector<ir_type> dump_types;
+    std::vector<int32_t> identity; // registers of functions without register allocation
+};
+
+#endif IR_INTERPRETER_HPP
@@ -5,6 +5,7 @@
 //! \copyright Apache License 2.0
 
 #include "lexer.hpp"
+#include "profile.hpp"
 #include <iostream>
 
 lexer::lexer()
@@ -24,11 +25,13 @@ lexer::lexer()
     predefined["static"]  = token_type::keyword_static;
     predefined["type"]    = token_type::keyword_type;
     predefined["extends"] = token_type::keyword_extends;
+    predefined["import"]  = token_type::keyword_import;
     predefined["dump"]    = token_type::function_dump;
 }
 
 std::vector<token> lexer::parse(const std::string& source)
 {
+    PROFILE_SCOPE("lexer::parse");
     std::vector<token> token_list;
 
     token current;
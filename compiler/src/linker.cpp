@@ -0,0 +1,197 @@
+//! \file      linker.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "linker.hpp"
+#include "profile.hpp"
+#include <unordered_map>
+
+// new ids of the entities of one module in the linked program
+struct module_map
+{
+    std::vector<int32_t> globals;
+    std::vector<int32_t> arrays;
+    std::vector<int32_t> classes;
+    std::vector<int32_t> strings;
+    std::vector<int32_t> formats;
+    std::vector<function_id> functions;
+};
+
+static int32_t remap(const std::vector<int32_t>& ids, int32_t id)
+{
+    return id >= 0 ? ids[id] : id;
+}
+
+// only the opcodes the ir_builder emits reference the tables of the module
+static void remap_instruction(const module_map& map, ir_instruction& instr)
+{
+    switch (instr.opcode)
+    {
+    case ir_opcode::constant:
+        if (instr.type == ir_type::ref)
+            instr.immediate = remap(map.strings, instr.immediate);
+        break;
+    case ir_opcode::load_global:
+    case ir_opcode::store_global:
+        instr.immediate = remap(map.globals, instr.immediate);
+        break;
+    case ir_opcode::new_array:
+        instr.immediate = remap(map.arrays, instr.immediate);
+        break;
+    case ir_opcode::new_object:
+        instr.immediate = remap(map.classes, instr.immediate);
+        break;
+    case ir_opcode::call:
+        instr.immediate = remap(map.functions, instr.immediate);
+        break;
+    case ir_opcode::call_method:
+        instr.immediate = remap(map.functions, instr.immediate);
+        instr.aux       = remap(map.classes, instr.aux);
+        break;
+    case ir_opcode::dump:
+        instr.immediate = remap(map.formats, instr.immediate);
+        break;
+    default:
+        break;
+    }
+}
+
+bool link_modules(const std::vector<ir_module>& modules, ir_module& result)
+{
+    PROFILE_SCOPE("link_modules");
+    result = ir_module();
+
+    std::unordered_map<std::string, int32_t> class_ids;
+    std::unordered_map<std::string, function_id> definitions; // by link name
+    std::vector<function_id> inits;
+    bool linked = true;
+
+    for (const ir_module& module : modules)
+    {
+        module_map map;
+
+        for (size_t i = 0; i < module.arrays.size(); ++i)
+            map.arrays.push_back(static_cast<int32_t>(result.arrays.size() + i));
+        for (const ir_array_type& array : module.arrays)
+        {
+            result.arrays.push_back(array);
+            result.arrays.back().element_array = remap(map.arrays, array.element_array);
+        }
+
+        for (size_t i = 0; i < module.globals.size(); ++i)
+        {
+            map.globals.push_back(static_cast<int32_t>(result.globals.size()));
+            result.globals.push_back(module.globals[i]);
+            result.global_arrays.push_back(remap(map.arrays, module.global_arrays[i]));
+        }
+
+        for (const std::string& str : module.strings)
+        {
+            map.strings.push_back(static_cast<int32_t>(result.strings.size()));
+            result.strings.push_back(str);
+        }
+
+        for (const ir_format& format : module.formats)
+        {
+            map.formats.push_back(static_cast<int32_t>(result.formats.size()));
+            result.formats.push_back(format);
+            result.formats.back().text = remap(map.strings, format.text);
+        }
+
+        // the module defining a class comes before every module importing it
+        std::vector<int32_t> defined_classes;
+        for (size_t i = 0; i < module.classes.size(); ++i)
+        {
+            auto it = class_ids.find(module.classes[i].name);
+            if (it != class_ids.end())
+            {
+                map.classes.push_back(it->second);
+                continue;
+            }
+            int32_t id = static_cast<int32_t>(result.classes.size());
+            class_ids.emplace(module.classes[i].name, id);
+            map.classes.push_back(id);
+            defined_classes.push_back(static_cast<int32_t>(i));
+            result.classes.push_back(module.classes[i]);
+        }
+
+        function_id next = static_cast<function_id>(result.functions.size());
+        for (const ir_function& function : module.functions)
+        {
+            if (!function.is_external)
+            {
+                map.functions.push_back(next++);
+                continue;
+            }
+
+            auto it = definitions.find(function.link_name);
+            if (it == definitions.end())
+            {
+                std::cerr << "Unresolved import " << function.link_name << std::endl;
+                linked = false;
+                map.functions.push_back(-1);
+                continue;
+            }
+            map.functions.push_back(it->second);
+        }
+
+        for (int32_t cls : defined_classes)
+        {
+            ir_class& linked_class = result.classes[map.classes[cls]];
+            linked_class.base      = remap(map.classes, linked_class.base);
+            for (int32_t& array : linked_class.field_arrays)
+                array = remap(map.arrays, array);
+            for (function_id& method : linked_class.methods)
+                method = remap(map.functions, method);
+        }
+
+        for (size_t i = 0; i < module.functions.size(); ++i)
+        {
+            const ir_function& function = module.functions[i];
+            if (function.is_external)
+                continue;
+
+            result.functions.push_back(function);
+            ir_function& copy = result.functions.back();
+            copy.owner        = remap(map.classes, copy.owner);
+            copy.overrides    = remap(map.functions, copy.overrides);
+            copy.signature    = -1; // type ids of another type table
+            for (ir_instruction& instr : copy.values)
+                remap_instruction(map, instr);
+
+            if (!function.link_name.empty())
+                definitions.emplace(function.link_name, map.functions[i]);
+            if (static_cast<function_id>(i) == module.init)
+            {
+                copy.name += std::to_string(inits.size());
+                inits.push_back(map.functions[i]);
+            }
+        }
+
+        result.main = remap(map.functions, module.main);
+    }
+
+    // one init calls the inits of all modules, imported modules first
+    ir_function init;
+    init.name      = "$init";
+    block_id entry = init.add_block();
+    for (function_id module_init : inits)
+    {
+        ir_instruction call;
+        call.opcode    = ir_opcode::call;
+        call.immediate = module_init;
+        call.block     = entry;
+        init.blocks[entry].instructions.push_back(init.add_value(std::move(call)));
+    }
+    ir_instruction ret;
+    ret.opcode = ir_opcode::ret;
+    ret.block  = entry;
+    init.blocks[entry].instructions.push_back(init.add_value(std::move(ret)));
+
+    result.init = static_cast<function_id>(result.functions.size());
+    result.functions.push_back(std::move(init));
+
+    return linked;
+}
@@ -0,0 +1,18 @@
+//! \file      linker.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include "ir.hpp"
+
+// Links unoptimized modules into one program, modules come after the modules they import and the program last.
+// External functions are bound to the definition with the same link name, classes with the same name are one class,
+// the first module declaring a class defines it. The inits of all modules run in order before main of the last module.
+// Returns false and reports the unresolved functions if a definition is missing.
+bool link_modules(const std::vector<ir_module>& modules, ir_module& result);
+
+#endif LINKER_HPP
@@ -0,0 +1,151 @@
+//! \file      loop_analysis.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "loop_analysis.hpp"
+#include <algorithm>
+
+loop_analysis::loop_analysis(const ir_function& function, const dominator_tree& dominators)
+    : innermost(function.blocks.size(), -1)
+{
+    // a back edge goes to a block dominating its source
+    for (block_id block : dominators.reverse_postorder())
+    {
+        for (block_id succ : function.successors(block))
+        {
+            if (!dominators.dominates(succ, block))
+                continue;
+
+            auto it = std::find_if(m_loops.begin(), m_loops.end(), [&](const ir_loop& l) { return l.header == succ; });
+            if (it == m_loops.end())
+            {
+                m_loops.emplace_back();
+                m_loops.back().header = succ;
+                it                    = m_loops.end() - 1;
+            }
+            it->latches.push_back(block);
+        }
+    }
+
+    // the body is everything reaching a latch without passing the header
+    for (ir_loop& l : m_loops)
+    {
+        std::vector<bool> member(function.blocks.size(), false);
+        member[l.header]               = true;
+        std::vector<block_id> worklist = l.latches;
+        while (!worklist.empty())
+        {
+            block_id block = worklist.back();
+            worklist.pop_back();
+            if (member[block])
+                continue;
+            member[block] = true;
+            for (block_id pred : function.blocks[block].predecessors)
+            {
+                if (dominators.is_reachable(pred))
+                    worklist.push_back(pred);
+            }
+        }
+
+        for (block_id block = 0; block < static_cast<block_id>(member.size()); ++block)
+        {
+            if (!member[block])
+                continue;
+            l.blocks.push_back(block);
+            for (block_id succ : function.successors(block))
+            {
+                if (!member[succ])
+                {
+                    l.exits.push_back(block);
+                    break;
+                }
+            }
+        }
+
+        std::vector<block_id> outside;
+        for (block_id pred : function.blocks[l.header].predecessors)
+        {
+            if (!member[pred])
+                outside.push_back(pred);
+        }
+        if (outside.size() == 1 && function.successors(outside[0]).size() == 1)
+            l.preheader = outside[0];
+    }
+
+    // nested loops have fewer blocks than the loops around them
+    std::stable_sort(m_loops.begin(), m_loops.end(), [](const ir_loop& a, const ir_loop& b) { return a.blocks.size() < b.blocks.size(); });
+
+    for (int32_t i = 0; i < static_cast<int32_t>(m_loops.size()); ++i)
+    {
+        for (int32_t j = i + 1; j < static_cast<int32_t>(m_loops.size()); ++j)
+        {
+            if (contains(j, m_loops[i].header))
+            {
+                m_loops[i].parent = j;
+                break;
+            }
+        }
+    }
+    for (int32_t i = static_cast<int32_t>(m_loops.size()) - 1; i >= 0; --i)
+    {
+        if (m_loops[i].parent != -1)
+            m_loops[i].depth = m_loops[m_loops[i].parent].depth + 1;
+    }
+
+    for (int32_t i = 0; i < static_cast<int32_t>(m_loops.size()); ++i)
+    {
+        for (block_id block : m_loops[i].blocks)
+        {
+            if (innermost[block] == -1)
+                innermost[block] = i;
+        }
+    }
+}
+
+bool loop_analysis::contains(int32_t loop, block_id block) const
+{
+    const std::vector<block_id>& blocks = m_loops[loop].blocks;
+    return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+std::vector<induction_variable> loop_analysis::induction_variables(const ir_function& function, int32_t loop) const
+{
+    std::vector<induction_variable> result;
+
+    const ir_loop& l       = m_loops[loop];
+    const ir_block& header = function.blocks[l.header];
+    if (l.latches.size() != 1 || header.predecessors.size() != 2)
+        return result;
+
+    size_t latch_index = header.predecessors[0] == l.latches[0] ? 0 : 1;
+    for (value_id value : header.instructions)
+    {
+        const ir_instruction& phi = function.values[value];
+        if (phi.opcode != ir_opcode::phi)
+            break;
+        if (phi.type != ir_type::i32)
+            continue;
+
+        value_id next               = phi.operands[latch_index];
+        const ir_instruction& instr = function.values[next];
+        if ((instr.opcode != ir_opcode::add && instr.opcode != ir_opcode::sub) || instr.operands.size() != 2)
+            continue;
+
+        // phi + c, c + phi or phi - c
+        value_id other = no_value;
+        if (instr.operands[0] == value)
+            other = instr.operands[1];
+        else if (instr.operands[1] == value && instr.opcode == ir_opcode::add)
+            other = instr.operands[0];
+        if (other == no_value || function.values[other].opcode != ir_opcode::constant)
+            continue;
+
+        int32_t step = function.values[other].immediate;
+        if (instr.opcode == ir_opcode::sub)
+            step = static_cast<int32_t>(0u - static_cast<uint32_t>(step));
+        result.push_back(induction_variable{ value, phi.operands[1 - latch_index], next, step });
+    }
+    return result;
+}
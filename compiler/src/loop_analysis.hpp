@@ -0,0 +1,68 @@
+//! \file      loop_analysis.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef LOOP_ANALYSIS_HPP
+#define LOOP_ANALYSIS_HPP
+
+#include "dominator_tree.hpp"
+#include "ir.hpp"
+
+// Natural loop, all back edges to the same header form one loop.
+struct ir_loop
+{
+    block_id header;
+    std::vector<block_id> blocks;  // including the header
+    std::vector<block_id> latches; // sources of the back edges
+    std::vector<block_id> exits;   // blocks inside the loop with a successor outside
+    int32_t parent     = -1;
+    int32_t depth      = 1;
+    block_id preheader = -1; // only predecessor of the header outside the loop, if there is exactly one that jumps only there
+};
+
+// i = phi(init, i + step) in the header of a loop with a single latch
+struct induction_variable
+{
+    value_id phi;
+    value_id init; // value entering the loop
+    value_id next; // value of the next iteration
+    int32_t step;
+};
+
+class loop_analysis
+{
+  public:
+    loop_analysis(const ir_function& function, const dominator_tree& dominators);
+    ~loop_analysis() = default;
+
+    // inner loops come before the loops containing them
+    const std::vector<ir_loop>& loops() const
+    {
+        return m_loops;
+    }
+
+    // innermost loop containing the block, -1 if none
+    int32_t loop_of(block_id block) const
+    {
+        return innermost[block];
+    }
+
+    // number of loops containing the block
+    int32_t depth(block_id block) const
+    {
+        return innermost[block] == -1 ? 0 : m_loops[innermost[block]].depth;
+    }
+
+    bool contains(int32_t loop, block_id block) const;
+
+    // basic induction variables with a constant step
+    std::vector<induction_variable> induction_variables(const ir_function& function, int32_t loop) const;
+
+  private:
+    std::vector<ir_loop> m_loops;
+    std::vector<int32_t> innermost;
+};
+
+#endif LOOP_ANALYSIS_HPP
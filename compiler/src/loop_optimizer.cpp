@@ -0,0 +1,561 @@
+//! \file      loop_optimizer.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "loop_optimizer.hpp"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+
+// larger loops keep their checks instead of being copied
+static const size_t max_versioned_size = 100;
+
+static ir_instruction make_instruction(ir_opcode opcode, ir_type type, std::vector<value_id> operands, int32_t immediate = 0)
+{
+    ir_instruction instr;
+    instr.opcode    = opcode;
+    instr.type      = type;
+    instr.operands  = std::move(operands);
+    instr.immediate = immediate;
+    return instr;
+}
+
+static value_id insert_before_terminator(ir_function& function, block_id block, ir_instruction&& instr)
+{
+    instr.block                         = block;
+    value_id value                      = function.add_value(std::move(instr));
+    std::vector<value_id>& instructions = function.blocks[block].instructions;
+    size_t at                           = function.terminator(block) ? instructions.size() - 1 : instructions.size();
+    instructions.insert(instructions.begin() + at, value);
+    return value;
+}
+
+static value_id insert_phi(ir_function& function, block_id block, ir_type type)
+{
+    ir_instruction instr = make_instruction(ir_opcode::phi, type, {});
+    instr.block          = block;
+    value_id value       = function.add_value(std::move(instr));
+    function.blocks[block].instructions.insert(function.blocks[block].instructions.begin(), value);
+    return value;
+}
+
+static value_id insert_constant(ir_function& function, block_id block, int32_t value)
+{
+    return insert_before_terminator(function, block, make_instruction(ir_opcode::constant, ir_type::i32, {}, value));
+}
+
+static bool constant_value(const ir_function& function, value_id value, int32_t& result)
+{
+    const ir_instruction& instr = function.values[value];
+    if (instr.opcode != ir_opcode::constant || instr.type != ir_type::i32)
+        return false;
+    result = instr.immediate;
+    return true;
+}
+
+static void move_before_terminator(ir_function& function, value_id value, block_id block)
+{
+    std::vector<value_id>& from = function.blocks[function.values[value].block].instructions;
+    from.erase(std::find(from.begin(), from.end(), value));
+
+    std::vector<value_id>& to = function.blocks[block].instructions;
+    to.insert(to.end() - 1, value);
+    function.values[value].block = block;
+}
+
+// the header leaves the loop once phi < bound is false, bound does not change in the loop
+static bool loop_bound(const ir_function& function, const loop_analysis& loops, int32_t loop, value_id phi, value_id& bound)
+{
+    const ir_instruction* term = function.terminator(loops.loops()[loop].header);
+    if (!term || term->opcode != ir_opcode::branch)
+        return false;
+    if (!loops.contains(loop, term->targets[0]) || loops.contains(loop, term->targets[1]))
+        return false;
+
+    const ir_instruction& condition = function.values[term->operands[0]];
+    if (condition.opcode != ir_opcode::lt || condition.operands[0] != phi)
+        return false;
+    if (loops.contains(loop, function.values[condition.operands[1]].block))
+        return false;
+
+    bound = condition.operands[1];
+    return true;
+}
+
+loop_statistics optimize_loops(ir_function& function, const dominator_tree& dominators, const loop_analysis& loops)
+{
+    loop_statistics statistics;
+
+    // inner loops first, code hoisted into an inner preheader can move on to the outer one
+    std::vector<int32_t> checked;
+    for (int32_t loop = 0; loop < static_cast<int32_t>(loops.loops().size()); ++loop)
+    {
+        if (loops.loops()[loop].preheader == -1)
+            continue;
+
+        statistics.hoisted += hoist_invariants(function, dominators, loops, loop);
+        statistics.strength_reduced += reduce_strength(function, loops, loop);
+        if (eliminate_bounds_checks(function, loops, loop, statistics))
+            checked.push_back(loop);
+    }
+
+    // versioned loops are inner loops, copying one does not change the blocks of the others
+    for (int32_t loop : checked)
+        statistics.loops_versioned += version_loop(function, loops, loop) ? 1 : 0;
+    return statistics;
+}
+
+size_t insert_preheaders(ir_function& function, const loop_analysis& loops)
+{
+    size_t inserted = 0;
+    for (const ir_loop& l : loops.loops())
+    {
+        if (l.preheader != -1)
+            continue;
+
+        block_id header = l.header;
+        std::vector<block_id> outside;
+        std::vector<size_t> outside_indices;
+        std::vector<size_t> inside_indices;
+        const std::vector<block_id>& predecessors = function.blocks[header].predecessors;
+        for (size_t i = 0; i < predecessors.size(); ++i)
+        {
+            if (std::binary_search(l.blocks.begin(), l.blocks.end(), predecessors[i]))
+            {
+                inside_indices.push_back(i);
+            }
+            else
+            {
+                outside.push_back(predecessors[i]);
+                outside_indices.push_back(i);
+            }
+        }
+        if (outside.empty())
+            continue;
+
+        block_id preheader = function.add_block();
+
+        // values entering the loop are merged in the preheader
+        for (value_id value : std::vector<value_id>(function.blocks[header].instructions))
+        {
+            if (function.values[value].opcode != ir_opcode::phi)
+                break;
+
+            std::vector<value_id> entering;
+            for (size_t i : outside_indices)
+                entering.push_back(function.values[value].operands[i]);
+
+            value_id merged = entering[0];
+            if (outside.size() > 1)
+            {
+                merged                            = insert_phi(function, preheader, function.values[value].type);
+                function.values[merged].operands = entering;
+            }
+
+            std::vector<value_id> operands = { merged };
+            for (size_t i : inside_indices)
+                operands.push_back(function.values[value].operands[i]);
+            function.values[value].operands = std::move(operands);
+        }
+
+        std::vector<block_id> header_predecessors = { preheader };
+        for (size_t i : inside_indices)
+            header_predecessors.push_back(function.blocks[header].predecessors[i]);
+        function.blocks[header].predecessors    = std::move(header_predecessors);
+        function.blocks[preheader].predecessors = outside;
+
+        for (block_id pred : outside)
+        {
+            ir_instruction& term = function.values[function.blocks[pred].instructions.back()];
+            for (block_id& target : term.targets)
+            {
+                if (target == header)
+                    target = preheader;
+            }
+        }
+
+        ir_instruction jump = make_instruction(ir_opcode::jump, ir_type::unit, {});
+        jump.targets[0]     = header;
+        insert_before_terminator(function, preheader, std::move(jump));
+        ++inserted;
+    }
+    return inserted;
+}
+
+size_t hoist_invariants(ir_function& function, const dominator_tree& dominators, const loop_analysis& loops, int32_t loop)
+{
+    const ir_loop& l = loops.loops()[loop];
+
+    // loads of globals are invariant if nothing in the loop can store to them
+    std::set<int32_t> stored_globals;
+    bool has_calls = false;
+    for (block_id block : l.blocks)
+    {
+        for (value_id value : function.blocks[block].instructions)
+        {
+            const ir_instruction& instr = function.values[value];
+            if (instr.opcode == ir_opcode::store_global)
+                stored_globals.insert(instr.immediate);
+            else if (instr.opcode == ir_opcode::call || instr.opcode == ir_opcode::call_method)
+                has_calls = true;
+        }
+    }
+
+    auto can_hoist = [&](const ir_instruction& instr) {
+        int32_t divisor = 0;
+        switch (instr.opcode)
+        {
+        case ir_opcode::constant:
+        case ir_opcode::copy:
+        case ir_opcode::add:
+        case ir_opcode::sub:
+        case ir_opcode::mul:
+        case ir_opcode::neg:
+        case ir_opcode::eq:
+        case ir_opcode::ne:
+        case ir_opcode::lt:
+        case ir_opcode::gt:
+        case ir_opcode::le:
+        case ir_opcode::ge:
+        case ir_opcode::lnot:
+        case ir_opcode::convert:
+        case ir_opcode::select:
+            return true;
+        case ir_opcode::div:
+        case ir_opcode::mod:
+            // only divisions that can not trap are executed speculatively
+            return instr.type == ir_type::f32 || (constant_value(function, instr.operands[1], divisor) && divisor != 0 && divisor != -1);
+        case ir_opcode::load_global:
+            return !has_calls && !stored_globals.count(instr.immediate);
+        default:
+            return false;
+        }
+    };
+
+    size_t hoisted = 0;
+    bool changed   = true;
+    while (changed)
+    {
+        changed = false;
+        for (block_id block : dominators.reverse_postorder())
+        {
+            if (!loops.contains(loop, block))
+                continue;
+
+            for (value_id value : std::vector<value_id>(function.blocks[block].instructions))
+            {
+                const ir_instruction& instr = function.values[value];
+                if (!can_hoist(instr))
+                    continue;
+
+                bool invariant = std::all_of(instr.operands.begin(), instr.operands.end(), [&](value_id operand) { return !loops.contains(loop, function.values[operand].block); });
+                if (!invariant)
+                    continue;
+
+                move_before_terminator(function, value, l.preheader);
+                ++hoisted;
+                changed = true;
+            }
+        }
+    }
+    return hoisted;
+}
+
+// i % divisor and i / divisor of a counting induction variable
+struct remainder_counter
+{
+    value_id remainder = no_value;
+    value_id wraps     = no_value;
+    value_id quotient  = no_value;
+};
+
+size_t reduce_strength(ir_function& function, const loop_analysis& loops, int32_t loop)
+{
+    const ir_loop& l                     = loops.loops()[loop];
+    std::vector<induction_variable> ivs = loops.induction_variables(function, loop);
+    if (ivs.empty())
+        return 0;
+
+    block_id latch     = l.latches[0];
+    block_id preheader = l.preheader;
+    auto is_invariant  = [&](value_id value) { return !loops.contains(loop, function.values[value].block); };
+
+    // phi operands follow the order of the header predecessors
+    auto make_phi = [&](value_id entering, value_id next) {
+        value_id phi = insert_phi(function, l.header, ir_type::i32);
+        for (block_id pred : function.blocks[l.header].predecessors)
+            function.values[phi].operands.push_back(pred == latch ? next : entering);
+        return phi;
+    };
+
+    size_t reduced = 0;
+    for (const induction_variable& iv : ivs)
+    {
+        value_id bound  = no_value;
+        int32_t init    = 0;
+        bool is_counter = iv.step == 1 && constant_value(function, iv.init, init) && init >= 0 && loop_bound(function, loops, loop, iv.phi, bound);
+        std::map<int32_t, remainder_counter> counters; // by divisor
+
+        for (block_id block : l.blocks)
+        {
+            for (value_id value : std::vector<value_id>(function.blocks[block].instructions))
+            {
+                ir_instruction instr = function.values[value];
+                if (instr.type != ir_type::i32 || instr.operands.size() != 2)
+                    continue;
+
+                value_id replacement = no_value;
+                if (instr.opcode == ir_opcode::mul && (instr.operands[0] == iv.phi || instr.operands[1] == iv.phi))
+                {
+                    // iv * k advances by step * k
+                    value_id factor = instr.operands[0] == iv.phi ? instr.operands[1] : instr.operands[0];
+                    if (factor == iv.phi || !is_invariant(factor))
+                        continue;
+
+                    int32_t constant = 0;
+                    value_id start   = insert_before_terminator(function, preheader, make_instruction(ir_opcode::mul, ir_type::i32, { iv.init, factor }));
+                    value_id step    = no_value;
+                    if (constant_value(function, factor, constant))
+                        step = insert_constant(function, preheader, static_cast<int32_t>(static_cast<uint32_t>(constant) * static_cast<uint32_t>(iv.step)));
+                    else
+                        step = insert_before_terminator(function, preheader, make_instruction(ir_opcode::mul, ir_type::i32, { factor, insert_constant(function, preheader, iv.step) }));
+
+                    value_id phi  = make_phi(start, no_value);
+                    value_id next = insert_before_terminator(function, latch, make_instruction(ir_opcode::add, ir_type::i32, { phi, step }));
+                    std::replace(function.values[phi].operands.begin(), function.values[phi].operands.end(), no_value, next);
+                    replacement = phi;
+                }
+                else if ((instr.opcode == ir_opcode::mod || instr.opcode == ir_opcode::div) && instr.operands[0] == iv.phi && is_counter)
+                {
+                    // the loop bound keeps the counter from overflowing, so it stays non negative
+                    int32_t divisor = 0;
+                    if (!constant_value(function, instr.operands[1], divisor) || divisor <= 1)
+                        continue;
+
+                    // i % c counts up to c and wraps, i / c counts the wraps
+                    remainder_counter& counter = counters[divisor];
+                    if (counter.remainder == no_value)
+                    {
+                        counter.remainder  = make_phi(insert_constant(function, preheader, init % divisor), no_value);
+                        value_id increased = insert_before_terminator(function, latch, make_instruction(ir_opcode::add, ir_type::i32, { counter.remainder, insert_constant(function, latch, 1) }));
+                        counter.wraps      = insert_before_terminator(function, latch, make_instruction(ir_opcode::eq, ir_type::boolean, { increased, insert_constant(function, latch, divisor) }));
+                        value_id next      = insert_before_terminator(function, latch, make_instruction(ir_opcode::select, ir_type::i32, { counter.wraps, insert_constant(function, latch, 0), increased }));
+                        std::replace(function.values[counter.remainder].operands.begin(), function.values[counter.remainder].operands.end(), no_value, next);
+                    }
+                    if (instr.opcode == ir_opcode::div && counter.quotient == no_value)
+                    {
+                        counter.quotient   = make_phi(insert_constant(function, preheader, init / divisor), no_value);
+                        value_id increased = insert_before_terminator(function, latch, make_instruction(ir_opcode::add, ir_type::i32, { counter.quotient, insert_constant(function, latch, 1) }));
+                        value_id next      = insert_before_terminator(function, latch, make_instruction(ir_opcode::select, ir_type::i32, { counter.wraps, increased, counter.quotient }));
+                        std::replace(function.values[counter.quotient].operands.begin(), function.values[counter.quotient].operands.end(), no_value, next);
+                    }
+                    replacement = instr.opcode == ir_opcode::mod ? counter.remainder : counter.quotient;
+                }
+
+                if (replacement == no_value)
+                    continue;
+
+                function.replace_all_uses(value, replacement);
+                function.remove(value);
+                ++reduced;
+            }
+        }
+    }
+    return reduced;
+}
+
+// bounds checks on an induction variable, which is in [init, bound) outside the header
+struct range_checks
+{
+    value_id init;
+    value_id bound;
+    int32_t length; // shortest checked length
+    std::vector<value_id> checks;
+};
+
+static std::vector<range_checks> find_range_checks(const ir_function& function, const loop_analysis& loops, int32_t loop)
+{
+    const ir_loop& l = loops.loops()[loop];
+    std::vector<range_checks> result;
+    for (const induction_variable& iv : loops.induction_variables(function, loop))
+    {
+        range_checks range;
+        if (iv.step <= 0 || !loop_bound(function, loops, loop, iv.phi, range.bound))
+            continue;
+
+        range.init   = iv.init;
+        range.length = std::numeric_limits<int32_t>::max();
+        for (block_id block : l.blocks)
+        {
+            if (block == l.header)
+                continue;
+
+            for (value_id value : function.blocks[block].instructions)
+            {
+                const ir_instruction& check = function.values[value];
+                if (check.opcode != ir_opcode::check_bounds || check.operands[0] != iv.phi)
+                    continue;
+
+                // the next value must not overflow once the induction variable reaches the length
+                if (check.aux <= 0 || static_cast<int64_t>(check.aux) + iv.step > std::numeric_limits<int32_t>::max())
+                    continue;
+                range.length = std::min(range.length, check.aux);
+                range.checks.push_back(value);
+            }
+        }
+        if (!range.checks.empty())
+            result.push_back(std::move(range));
+    }
+    return result;
+}
+
+bool eliminate_bounds_checks(ir_function& function, const loop_analysis& loops, int32_t loop, loop_statistics& statistics)
+{
+    bool remaining = false;
+    for (const range_checks& range : find_range_checks(function, loops, loop))
+    {
+        int32_t init  = 0;
+        int32_t upper = 0;
+        bool proven   = constant_value(function, range.init, init) && init >= 0 && constant_value(function, range.bound, upper);
+        for (value_id check : range.checks)
+        {
+            if (!proven || upper > function.values[check].aux)
+            {
+                remaining = true;
+                continue;
+            }
+            function.remove(check);
+            ++statistics.checks_removed;
+        }
+    }
+    return remaining;
+}
+
+bool version_loop(ir_function& function, const loop_analysis& loops, int32_t loop)
+{
+    const ir_loop& l                 = loops.loops()[loop];
+    std::vector<range_checks> ranges = find_range_checks(function, loops, loop);
+    if (ranges.empty() || function.blocks[l.header].keeps_checks)
+        return false;
+
+    // the copy only needs merges in the exit, so inner loops leaving through the header are versioned
+    bool single_exit = l.exits.size() == 1 && l.exits[0] == l.header;
+    bool inner       = std::none_of(loops.loops().begin(), loops.loops().end(), [&](const ir_loop& other) { return other.parent == loop; });
+    block_id exit    = function.terminator(l.header)->targets[1];
+    size_t size      = 0;
+    for (block_id block : l.blocks)
+        size += function.blocks[block].instructions.size();
+    if (!single_exit || !inner || size > max_versioned_size || function.blocks[exit].predecessors.size() != 1)
+        return false;
+
+    // the copy of the loop runs without the checks
+    block_id first_copy = static_cast<block_id>(function.blocks.size());
+    std::map<block_id, block_id> block_copies;
+    std::map<value_id, value_id> value_copies;
+    for (block_id block : l.blocks)
+        block_copies[block] = function.add_block();
+    for (block_id block : l.blocks)
+    {
+        block_id copy               = block_copies[block];
+        function.blocks[copy].count = function.blocks[block].count;
+        function.blocks[copy].taken = function.blocks[block].taken;
+        for (block_id pred : function.blocks[block].predecessors)
+            function.blocks[copy].predecessors.push_back(block_copies.count(pred) ? block_copies[pred] : pred);
+
+        for (value_id value : function.blocks[block].instructions)
+        {
+            ir_instruction instr = function.values[value];
+            instr.block          = copy;
+            value_copies[value]  = function.add_value(std::move(instr));
+            function.blocks[copy].instructions.push_back(value_copies[value]);
+        }
+    }
+    for (const auto& entry : value_copies)
+    {
+        ir_instruction& instr = function.values[entry.second];
+        for (value_id& operand : instr.operands)
+        {
+            if (value_copies.count(operand))
+                operand = value_copies[operand];
+        }
+        for (block_id& target : instr.targets)
+        {
+            if (block_copies.count(target))
+                target = block_copies[target];
+        }
+    }
+    for (const range_checks& range : ranges)
+    {
+        for (value_id check : range.checks)
+            function.remove(value_copies[check]);
+    }
+
+    // the exit is reached from both loops, values of the loop used after it are merged there
+    block_id header_copy = block_copies[l.header];
+    function.blocks[exit].predecessors.push_back(header_copy);
+    for (value_id value : function.blocks[exit].instructions)
+    {
+        ir_instruction& phi = function.values[value];
+        if (phi.opcode != ir_opcode::phi)
+            break;
+        value_id incoming = phi.operands[0];
+        phi.operands.push_back(value_copies.count(incoming) ? value_copies[incoming] : incoming);
+    }
+
+    std::map<value_id, value_id> merged;
+    for (block_id block = 0; block < first_copy; ++block)
+    {
+        if (loops.contains(loop, block))
+            continue;
+
+        for (value_id value : std::vector<value_id>(function.blocks[block].instructions))
+        {
+            if (block == exit && function.values[value].opcode == ir_opcode::phi)
+                continue;
+
+            std::vector<value_id> operands = function.values[value].operands;
+            for (value_id& operand : operands)
+            {
+                if (!value_copies.count(operand))
+                    continue;
+                if (!merged.count(operand))
+                {
+                    value_id phi                  = insert_phi(function, exit, function.values[operand].type);
+                    function.values[phi].operands = { operand, value_copies[operand] };
+                    merged[operand]               = phi;
+                }
+                operand = merged[operand];
+            }
+            function.values[value].operands = std::move(operands);
+        }
+    }
+
+    // the preheader enters the copy if no check can fail, a loop that is not entered checks nothing
+    block_id preheader = l.preheader;
+    auto boolean       = [&](bool value) { return insert_before_terminator(function, preheader, make_instruction(ir_opcode::constant, ir_type::boolean, {}, value ? 1 : 0)); };
+    value_id in_range  = boolean(true);
+    for (const range_checks& range : ranges)
+    {
+        int32_t init    = 0;
+        value_id enters = insert_before_terminator(function, preheader, make_instruction(ir_opcode::lt, ir_type::boolean, { range.init, range.bound }));
+        value_id fits   = insert_before_terminator(function, preheader, make_instruction(ir_opcode::le, ir_type::boolean, { range.bound, insert_constant(function, preheader, range.length) }));
+        if (!constant_value(function, range.init, init) || init < 0)
+        {
+            value_id positive = insert_before_terminator(function, preheader, make_instruction(ir_opcode::ge, ir_type::boolean, { range.init, insert_constant(function, preheader, 0) }));
+            fits              = insert_before_terminator(function, preheader, make_instruction(ir_opcode::select, ir_type::boolean, { positive, fits, boolean(false) }));
+        }
+        fits     = insert_before_terminator(function, preheader, make_instruction(ir_opcode::select, ir_type::boolean, { enters, fits, boolean(true) }));
+        in_range = insert_before_terminator(function, preheader, make_instruction(ir_opcode::select, ir_type::boolean, { in_range, fits, boolean(false) }));
+    }
+
+    ir_instruction& branch = function.values[function.blocks[preheader].instructions.back()];
+    branch.opcode          = ir_opcode::branch;
+    branch.operands        = { in_range };
+    branch.targets[0]      = header_copy;
+    branch.targets[1]      = l.header;
+    function.blocks[l.header].keeps_checks = true;
+    return true;
+}
@@ -0,0 +1,41 @@
+//! \file      loop_optimizer.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef LOOP_OPTIMIZER_HPP
+#define LOOP_OPTIMIZER_HPP
+
+#include "dominator_tree.hpp"
+#include "ir.hpp"
+#include "loop_analysis.hpp"
+
+struct loop_statistics
+{
+    size_t hoisted          = 0;
+    size_t strength_reduced = 0;
+    size_t checks_removed   = 0;
+    size_t loops_versioned  = 0;
+};
+
+// Works from the inner to the outer loops with a preheader:
+// moves invariant code into the preheader, replaces * / % of induction variables by additions
+// and removes bounds checks on induction variables whose range the loop condition proves.
+// Only versioning loops changes the control flow, the analyses stay valid if no loop was versioned.
+loop_statistics optimize_loops(ir_function& function, const dominator_tree& dominators, const loop_analysis& loops);
+
+// creates a block in front of every loop header that has no single predecessor outside the loop
+size_t insert_preheaders(ir_function& function, const loop_analysis& loops);
+
+size_t hoist_invariants(ir_function& function, const dominator_tree& dominators, const loop_analysis& loops, int32_t loop);
+size_t reduce_strength(ir_function& function, const loop_analysis& loops, int32_t loop);
+
+// removes the checks the loop condition proves, returns true if checks on induction variables remain
+bool eliminate_bounds_checks(ir_function& function, const loop_analysis& loops, int32_t loop, loop_statistics& statistics);
+
+// copies an inner loop without its checks on induction variables, the preheader tests once whether any of them can
+// fail and runs the original loop if one can, so a failing check still traps in its iteration after the earlier ones
+bool version_loop(ir_function& function, const loop_analysis& loops, int32_t loop);
+
+#endif LOOP_OPTIMIZER_HPP
@@ -6,12 +6,26 @@
 
 #include "ast.hpp"
 #include "ast_visitor.hpp"
+#include "class_hierarchy.hpp"
 #include "command_line_parser.hpp"
+#include "dependency_graph.hpp"
+#include "instrumentation.hpp"
+#include "ir_builder.hpp"
+#include "ir_interpreter.hpp"
 #include "lexer.hpp"
+#include "module_loader.hpp"
+#include "name_resolver.hpp"
 #include "parser.hpp"
+#include "pass_manager.hpp"
+#include "profile.hpp"
+#include "type_checker.hpp"
+#include "vectorizer.hpp"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 #ifdef WIN32
 
@@ -38,6 +52,44 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, PSTR, int)
 #endif // WINMAIN
 #endif // WIN32
 
+// optimizes copies of the module with one to max_threads threads and compares the printed ir byte for byte
+static bool check_determinism(const ir_module& built, const std::string& pipeline, pass_options options, size_t max_threads)
+{
+    std::string reference;
+    bool deterministic  = true;
+    options.time_passes = false;
+    for (size_t threads = 1; threads <= max_threads; ++threads)
+    {
+        ir_module module    = built;
+        module.vector_width = native_vector_width();
+        class_hierarchy hierarchy(module);
+        options.threads = threads;
+        pass_manager passes(module, hierarchy, options);
+        if (!passes.add_passes(pipeline))
+            return false;
+        passes.run();
+
+        std::ostringstream code;
+        print_ir(code, module);
+        if (threads == 1)
+        {
+            reference = code.str();
+            continue;
+        }
+
+        std::string compared = code.str();
+        if (compared != reference)
+        {
+            auto difference = std::mismatch(reference.begin(), reference.end(), compared.begin(), compared.end());
+            std::cerr << "Ir with " << threads << " threads differs from the ir with 1 thread at byte " << (difference.first - reference.begin()) << std::endl;
+            deterministic = false;
+        }
+    }
+    if (deterministic)
+        std::cout << "Ir is identical with 1 to " << max_threads << " threads (" << reference.size() << " bytes)" << std::endl;
+    return deterministic;
+}
+
 int main(int argc, char** argv)
 {
     std::cout << "----------------------------" << std::endl;
@@ -58,11 +110,74 @@ int main(int argc, char** argv)
         std::cout << "  -o  \"output file name\"    " << std::endl;
         std::cout << "  -pp (bool) pretty print   " << std::endl;
         std::cout << "  -dot (bool) plot ast  " << std::endl;
+        std::cout << "  -ir (bool) print ir   " << std::endl;
+        std::cout << "  -inline-budget \"instructions\" inlining growth, 0 disables it" << std::endl;
+        std::cout << "  -run (bool) interpret the program" << std::endl;
+        std::cout << "  -c (bool) also compile the input as a module, writes its interface, bytecode and dependencies next to it" << std::endl;
+        std::cout << "     and only lowers the declarations that changed since the last -c" << std::endl;
+        std::cout << "  -deps (bool) write the names every top level declaration uses to dependencies.txt" << std::endl;
+        std::cout << "  -no-vectorize (bool) keep loops scalar" << std::endl;
+        std::cout << "  -O0 -O1 -O2 -O3 optimization level, -O2 by default" << std::endl;
+        std::cout << "  -passes=\"pass,pass,...\" custom pipeline instead of a level" << std::endl;
+        std::cout << "  -time-passes (bool) report wall time, busy time of the threads and ir growth of every pass" << std::endl;
+        std::cout << "  -registers \"count\" machine registers of the register allocator, 16 by default" << std::endl;
+        std::cout << "  -threads \"count\" threads optimizing functions in parallel, one per core by default" << std::endl;
+        std::cout << "  -check-determinism \"count\" compile with 1 to count threads and compare the ir, exits with 1 if it differs" << std::endl;
+        std::cout << "  -profile-generate (bool) count blocks and branches of the run, writes program.profile" << std::endl;
+        std::cout << "  -profile-use \"profile file\" optimize with the counts of an earlier run" << std::endl;
+        std::cout << "  -dump-binary \"output file\" write the dumps of the run as tagged binary records" << std::endl;
+        std::cout << "  -dump-buffer \"bytes\" dump output buffered before it is written, 65536 by default" << std::endl;
+        std::cout << "  -dump-flush-ms \"milliseconds\" longest time a dump stays buffered, 100 by default" << std::endl;
+        std::cout << "  -memory-stats (bool) report the heap and stack memory and the collections of the run" << std::endl;
+        std::cout << "  -nursery \"bytes\" size of the young generation, 262144 by default" << std::endl;
         std::cin.get();
         return 0;
     }
     bool dot_ast = cmd_parser.cmd_option_exists("-dot");
     bool pretty_print = cmd_parser.cmd_option_exists("-pp");
+    bool print_ir_code = cmd_parser.cmd_option_exists("-ir");
+    bool run_program   = cmd_parser.cmd_option_exists("-run");
+    bool write_module  = cmd_parser.cmd_option_exists("-c");
+    bool print_dependencies      = cmd_parser.cmd_option_exists("-deps");
+    bool profile_generate        = cmd_parser.cmd_option_exists("-profile-generate");
+    std::string profile_use_file = cmd_parser.get_cmd_option("-profile-use");
+    std::string dump_binary_file = cmd_parser.get_cmd_option("-dump-binary");
+    bool memory_stats            = cmd_parser.cmd_option_exists("-memory-stats");
+
+    // -O2 unless a level or a pipeline is given
+    int32_t level = 2;
+    for (int32_t l = 0; l <= 3; ++l)
+    {
+        if (cmd_parser.cmd_option_exists("-O" + std::to_string(l)))
+            level = l;
+    }
+    std::string pipeline = pass_manager::pipeline(level);
+    if (cmd_parser.cmd_prefix_exists("-passes="))
+        pipeline = cmd_parser.get_cmd_prefix_value("-passes=");
+
+    pass_options optimization;
+    optimization.vectorize   = !cmd_parser.cmd_option_exists("-no-vectorize");
+    optimization.time_passes = cmd_parser.cmd_option_exists("-time-passes");
+    if (level == 3)
+        optimization.inlining.budget *= 4;
+    if (cmd_parser.cmd_option_exists("-inline-budget"))
+        optimization.inlining.budget = std::stoi(cmd_parser.get_cmd_option("-inline-budget"));
+    if (cmd_parser.cmd_option_exists("-registers"))
+        optimization.registers = std::max(1, std::stoi(cmd_parser.get_cmd_option("-registers")));
+    optimization.threads = std::max(1u, std::thread::hardware_concurrency());
+    if (cmd_parser.cmd_option_exists("-threads"))
+        optimization.threads = static_cast<size_t>(std::max(1, std::stoi(cmd_parser.get_cmd_option("-threads"))));
+
+    output_options output;
+    if (!dump_binary_file.empty())
+        output.mode = dump_mode::binary;
+    if (cmd_parser.cmd_option_exists("-dump-buffer"))
+        output.flush_size = static_cast<size_t>(std::max(0, std::stoi(cmd_parser.get_cmd_option("-dump-buffer"))));
+    if (cmd_parser.cmd_option_exists("-dump-flush-ms"))
+        output.flush_interval = std::max(0, std::stoi(cmd_parser.get_cmd_option("-dump-flush-ms")));
+    size_t nursery_size = runtime::default_nursery_size;
+    if (cmd_parser.cmd_option_exists("-nursery"))
+        nursery_size = static_cast<size_t>(std::max(1024, std::stoi(cmd_parser.get_cmd_option("-nursery"))));
 
     std::string input_file_name  = cmd_parser.get_cmd_option("-i");
     std::string output_file_name = cmd_parser.get_cmd_option("-o");
@@ -83,6 +198,7 @@ int main(int argc, char** argv)
     }
 
     std::cout << "  INPUT: " << input_file_name << "\n  OUTPUT: " << output_file_name << std::endl;
+    PROFILE_BEGIN_SESSION("compile_trace.json");
     std::cout << std::endl;
     std::cout << std::endl;
 
@@ -97,26 +213,160 @@ int main(int argc, char** argv)
     std::cout << std::endl;
     std::cout << std::endl;
 
-    parser token_parser(tokens);
+    // imported modules are next to the input
+    size_t directory_end    = input_file_name.find_last_of("/\\");
+    std::string directory   = directory_end == std::string::npos ? std::string() : input_file_name.substr(0, directory_end);
+    std::string module_name = input_file_name.substr(directory_end == std::string::npos ? 0 : directory_end + 1);
+    module_name             = module_name.substr(0, module_name.find_last_of("."));
+    module_loader modules(directory);
+
+    parser token_parser(tokens, [&modules](const std::string& name, const source_code_position& position, expression_vector& declarations) {
+        return modules.import_module(name, position, declarations);
+    });
 
     unique_ptr<expression> program_node = token_parser.parse();
 
     std::cout << std::endl;
     std::cout << std::endl;
 
+    symbol_table symbols;
+    name_resolver resolver(symbols);
+
+    // a failed import is a parser error, the names it should have declared are reported as unresolved
+    bool valid = resolver.resolve(*program_node) && !token_parser.has_errors();
+
+    type_table types;
+    type_checker checker(symbols, types);
+
+    // types of unresolved names are unknown
+    valid = valid && checker.check(*program_node);
+
+    ir_module module;
+    if (valid)
+    {
+        ir_builder builder(symbols, types);
+        if (write_module)
+            modules.reuse_unchanged(module_name, tokens, *program_node, symbols, types, builder);
+        valid = builder.build(*program_node, module);
+    }
+
+    if (valid && write_module)
+        valid = modules.write_module(module_name, buffer.str(), tokens, *program_node, symbols, types, module);
+    if (valid)
+        valid = modules.link(module);
+
+    // the profile matches the ir as it is built, before any pass changed it
+    std::vector<function_counters> counters;
+    if (valid && profile_generate)
+        counters = instrument_module(module);
+    if (valid && !profile_use_file.empty())
+    {
+        std::ifstream profile_file(profile_use_file);
+        if (!profile_file || !apply_profile(profile_file, module))
+            std::cerr << "Invalid profile " << profile_use_file << ", optimizing without it" << std::endl;
+    }
+
+    if (valid && cmd_parser.cmd_option_exists("-check-determinism"))
+    {
+        size_t max_threads = static_cast<size_t>(std::max(2, std::stoi(cmd_parser.get_cmd_option("-check-determinism"))));
+        if (!check_determinism(module, pipeline, optimization, max_threads))
+        {
+            PROFILE_END_SESSION();
+            return 1;
+        }
+    }
+
+    if (valid)
+    {
+        module.vector_width = native_vector_width();
+
+        class_hierarchy hierarchy(module);
+        pass_manager passes(module, hierarchy, optimization);
+        valid = passes.add_passes(pipeline);
+        if (valid)
+        {
+            passes.run();
+            if (optimization.time_passes)
+                passes.report(std::cout);
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << std::endl;
+
     if (dot_ast)
     {
-        int32_t out = 0;
+        PROFILE_SCOPE("dot_visitor");
         dot_visitor v("graph.dot");
-        v(*program_node, out);
+        v(*program_node, "node_0");
     }
 
     if (pretty_print)
     {
+        PROFILE_SCOPE("pretty_printer");
         pretty_printer v("pretty.ppl");
         v(*program_node, "");
     }
 
+    if (print_dependencies && valid)
+    {
+        PROFILE_SCOPE("dependency_graph");
+        std::ofstream dependencies_file("dependencies.txt");
+        dependency_graph(*program_node, symbols, types).print(dependencies_file, modules.imported_declarations());
+    }
+
+    if (print_ir_code && valid)
+    {
+        PROFILE_SCOPE("print_ir");
+        std::ofstream ir_file("program.ir");
+        print_ir(ir_file, module);
+    }
+
+    if (run_program && valid)
+    {
+        std::ofstream dump_file;
+        if (output.mode == dump_mode::binary)
+            dump_file.open(dump_binary_file, std::ios::binary);
+        runtime rt(module, output.mode == dump_mode::binary ? static_cast<std::ostream&>(dump_file) : std::cout, output, nursery_size);
+        ir_interpreter interpreter(module, rt);
+        rt.enable_counters(counter_count(counters));
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            int32_t result = interpreter.run();
+            rt.flush_output();
+            std::cout << "Exit code: " << result << std::endl;
+        }
+        catch (const runtime_error& err)
+        {
+            std::cerr << "Runtime error: " << err.message << err.position << std::endl;
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Run time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << std::endl;
+
+        if (memory_stats)
+        {
+            auto report = [](const char* name, const memory_statistics& stats) {
+                std::cout << name << ": " << stats.allocations << " allocations, " << stats.allocated_bytes << " bytes allocated, peak " << stats.peak_bytes << " bytes, "
+                          << stats.reserved_bytes << " bytes reserved, " << static_cast<int32_t>(stats.fragmentation() * 100.0 + 0.5) << "% fragmentation" << std::endl;
+            };
+            report("Heap", rt.heap_statistics());
+            report("Stack", rt.stack_statistics());
+
+            const collector_statistics& gc = rt.collection_statistics();
+            std::cout << "Collections: " << gc.minor_collections << " minor, " << gc.major_collections << " major, " << gc.promoted_bytes << " bytes promoted, " << gc.freed_bytes
+                      << " bytes freed, pauses " << gc.total_pause << "us in total, " << gc.longest_pause << "us longest" << std::endl;
+        }
+
+        // a trapped run still has its counts
+        if (profile_generate)
+        {
+            std::ofstream profile_file("program.profile");
+            write_profile(profile_file, counters, rt.counter_values());
+        }
+    }
+
+    PROFILE_END_SESSION();
     std::cout << "Done" << std::endl;
     std::cin.get();
 
@@ -0,0 +1,134 @@
+//! \file      memory_pool.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "memory_pool.hpp"
+#include <algorithm>
+
+// every block is aligned for any runtime value
+static constexpr size_t alignment = 16;
+
+static const size_t chunk_size = 64 * 1024;
+
+static size_t align(size_t size)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+pool_allocator::pool_allocator()
+{
+    // steps of a quarter to a half of the size keep the rounding waste low
+    for (size_t size : { 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 })
+    {
+        size_class cls;
+        cls.size = size;
+        classes.push_back(cls);
+    }
+}
+
+int32_t pool_allocator::class_of(size_t size) const
+{
+    if (size > classes.back().size)
+        return -1;
+    auto it = std::lower_bound(classes.begin(), classes.end(), size, [](const size_class& cls, size_t size) { return cls.size < size; });
+    return static_cast<int32_t>(it - classes.begin());
+}
+
+void* pool_allocator::allocate(size_t size)
+{
+    stats.allocations += 1;
+    stats.allocated_bytes += size;
+    stats.live_bytes += size;
+    stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+
+    int32_t index = class_of(size);
+    if (index == -1)
+    {
+        stats.reserved_bytes += align(size);
+        return ::operator new(align(size));
+    }
+
+    size_class& cls = classes[index];
+    if (cls.free)
+    {
+        free_block* block = cls.free;
+        cls.free          = block->next;
+        return block;
+    }
+
+    if (cls.next == cls.end)
+    {
+        // a chunk holds a whole number of blocks
+        size_t blocks = chunk_size / cls.size;
+        chunks.emplace_back(new char[blocks * cls.size]);
+        cls.next = chunks.back().get();
+        cls.end  = cls.next + blocks * cls.size;
+        stats.reserved_bytes += blocks * cls.size;
+    }
+    void* block = cls.next;
+    cls.next += cls.size;
+    return block;
+}
+
+void pool_allocator::free(void* block, size_t size)
+{
+    stats.live_bytes -= size;
+
+    int32_t index = class_of(size);
+    if (index == -1)
+    {
+        stats.reserved_bytes -= align(size);
+        ::operator delete(block);
+        return;
+    }
+
+    size_class& cls   = classes[index];
+    free_block* freed = static_cast<free_block*>(block);
+    freed->next       = cls.free;
+    cls.free          = freed;
+}
+
+void* region_arena::allocate(size_t size)
+{
+    size = align(size);
+    stats.allocations += 1;
+    stats.allocated_bytes += size;
+
+    if (chunks.empty() || offset + size > chunks[current].size)
+    {
+        // the next chunk is reused when it is large enough, replaced otherwise
+        size_t next = chunks.empty() ? 0 : current + 1;
+        if (next == chunks.size() || chunks[next].size < size)
+        {
+            size_t bytes = std::max(chunk_size, size);
+            if (next < chunks.size())
+                stats.reserved_bytes -= chunks[next].size;
+            else
+                chunks.emplace_back();
+            chunks[next] = { std::unique_ptr<char[]>(new char[bytes]), bytes, 0 };
+            stats.reserved_bytes += bytes;
+        }
+
+        if (next != 0)
+            chunks[current].used = offset;
+        current = next;
+        offset  = 0;
+    }
+
+    void* block = chunks[current].memory.get() + offset;
+    offset += size;
+    stats.live_bytes += size;
+    stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+    return block;
+}
+
+void region_arena::release(mark position)
+{
+    current          = position.chunk;
+    offset           = position.offset;
+    stats.live_bytes = offset;
+    for (size_t i = 0; i < current; ++i)
+        stats.live_bytes += chunks[i].used;
+}
@@ -0,0 +1,119 @@
+//! \file      memory_pool.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef MEMORY_POOL_HPP
+#define MEMORY_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct memory_statistics
+{
+    size_t allocations     = 0; // blocks handed out
+    size_t allocated_bytes = 0; // bytes requested by all allocations
+    size_t live_bytes      = 0; // bytes requested by the blocks in use
+    size_t peak_bytes      = 0; // most live bytes at any time
+    size_t reserved_bytes  = 0; // bytes taken from the system
+
+    // share of the reserved memory that was never requested at once, rounding, free blocks and unused chunk space
+    double fragmentation() const
+    {
+        return reserved_bytes == 0 ? 0.0 : 1.0 - static_cast<double>(peak_bytes) / static_cast<double>(reserved_bytes);
+    }
+};
+
+// Size class allocator for the runtime heap.
+// Blocks up to the largest class are carved from 64 KiB chunks of their class and kept on a free list per class when freed,
+// larger blocks come from operator new. Memory of the chunks is returned when the pool is destroyed.
+class pool_allocator
+{
+  public:
+    pool_allocator();
+    ~pool_allocator() = default;
+
+    pool_allocator(const pool_allocator&)            = delete;
+    pool_allocator& operator=(const pool_allocator&) = delete;
+
+    void* allocate(size_t size);
+
+    // size is the size the block was allocated with
+    void free(void* block, size_t size);
+
+    const memory_statistics& statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    struct size_class
+    {
+        size_t size;
+        free_block* free = nullptr;
+        char* next       = nullptr; // unused part of the newest chunk
+        char* end        = nullptr;
+    };
+
+    // the smallest class that fits, -1 for large blocks
+    int32_t class_of(size_t size) const;
+
+    std::vector<size_class> classes;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    memory_statistics stats;
+};
+
+// Bump allocator for memory that is released all at once, like the objects of a call.
+// release returns everything allocated after a mark, the chunks are kept for the next calls.
+class region_arena
+{
+  public:
+    struct mark
+    {
+        size_t chunk  = 0;
+        size_t offset = 0;
+    };
+
+    region_arena()  = default;
+    ~region_arena() = default;
+
+    region_arena(const region_arena&)            = delete;
+    region_arena& operator=(const region_arena&) = delete;
+
+    void* allocate(size_t size);
+
+    mark position() const
+    {
+        return { current, offset };
+    }
+
+    void release(mark position);
+
+    const memory_statistics& statistics() const
+    {
+        return stats;
+    }
+
+  private:
+    struct chunk
+    {
+        std::unique_ptr<char[]> memory;
+        size_t size;
+        size_t used = 0; // bytes allocated before the next chunk was started
+    };
+
+    std::vector<chunk> chunks;
+    size_t current = 0; // chunk allocated from
+    size_t offset  = 0; // bytes used in the current chunk
+    memory_statistics stats;
+};
+
+#endif MEMORY_POOL_HPP
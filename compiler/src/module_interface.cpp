@@ -0,0 +1,380 @@
+//! \file      module_interface.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "module_interface.hpp"
+#include "binary_stream.hpp"
+
+static const uint32_t interface_version = 2;
+
+enum encoded_type : uint8_t
+{
+    encoded_unit,
+    encoded_i32,
+    encoded_f32,
+    encoded_bool,
+    encoded_str,
+    encoded_user,
+    encoded_array,
+};
+
+enum encoded_declaration : uint8_t
+{
+    encoded_function,
+    encoded_user_type,
+};
+
+static bool is_function_declaration(const expression& decl)
+{
+    return decl.expr_type == expression_type::declaration && decl.expressions.size() > 2;
+}
+
+static void write_type(binary_writer& writer, type_id type, const symbol_table& symbols, const type_table& types)
+{
+    // i32[2][3] is an array of 2 arrays with 3 elements
+    std::vector<int32_t> lengths;
+    while (type >= 0 && types.get(type).kind == type_kind::array)
+    {
+        lengths.push_back(types.get(type).length);
+        type = types.get(type).element;
+    }
+    if (!lengths.empty())
+    {
+        writer.write_u8(encoded_array);
+        writer.write_u32(static_cast<uint32_t>(lengths.size()));
+        for (int32_t length : lengths)
+            writer.write_i32(length);
+    }
+
+    switch (type >= 0 ? types.get(type).kind : type_kind::error)
+    {
+    case type_kind::i32:
+        writer.write_u8(encoded_i32);
+        break;
+    case type_kind::f32:
+        writer.write_u8(encoded_f32);
+        break;
+    case type_kind::boolean:
+        writer.write_u8(encoded_bool);
+        break;
+    case type_kind::str:
+        writer.write_u8(encoded_str);
+        break;
+    case type_kind::user:
+        writer.write_u8(encoded_user);
+        writer.write_string(symbols.name(types.get(type).symbol));
+        break;
+    default:
+        writer.write_u8(encoded_unit);
+        break;
+    }
+}
+
+static void write_signature(binary_writer& writer, const expression& function_decl, const symbol_table& symbols, const type_table& types)
+{
+    const identifier& name = static_cast<const identifier&>(*function_decl.expressions[1]);
+    writer.write_string(name.name);
+
+    std::vector<std::string> parameter_names;
+    const expression* function_tp_name = function_decl.expressions[0].get();
+    const expression* parameters       = function_tp_name ? function_tp_name->expressions[0].get() : nullptr;
+    if (parameters && parameters->expr_type == expression_type::compound)
+    {
+        for (auto& parameter : parameters->expressions)
+        {
+            if (parameter)
+                parameter_names.push_back(static_cast<const identifier&>(*parameter->expressions[1]).name);
+        }
+    }
+
+    const type_info& function_type = types.get(symbols.get(name.symbol).type);
+    writer.write_u32(static_cast<uint32_t>(function_type.parameters.size()));
+    for (size_t i = 0; i < function_type.parameters.size(); ++i)
+    {
+        write_type(writer, function_type.parameters[i], symbols, types);
+        writer.write_string(i < parameter_names.size() ? parameter_names[i] : "$p" + std::to_string(i));
+    }
+    write_type(writer, function_type.result, symbols, types);
+}
+
+void describe_interface(const expression& program, const std::unordered_set<const expression*>& imported, const symbol_table& symbols, const type_table& types,
+                        module_interface& result)
+{
+    binary_writer writer;
+    uint32_t count = 0;
+
+    for (auto& global : program.expressions)
+    {
+        if (!global || imported.count(global.get()))
+            continue;
+
+        if (global->expr_type == expression_type::type_declaration)
+        {
+            symbol_id type_sym = static_cast<const identifier&>(*global->expressions[0]).symbol;
+            if (type_sym == invalid_id)
+                continue;
+
+            std::vector<const expression*> fields;
+            std::vector<const expression*> methods;
+            for (auto& member : global->expressions[2]->expressions)
+            {
+                if (!member || member->expr_type != expression_type::declaration)
+                    continue;
+                if (is_function_declaration(*member))
+                    methods.push_back(member.get());
+                else
+                    fields.push_back(member.get());
+            }
+
+            writer.write_u8(encoded_user_type);
+            writer.write_string(symbols.name(type_sym));
+            symbol_id base_sym = symbols.get(type_sym).base;
+            writer.write_string(base_sym != invalid_id ? symbols.name(base_sym) : std::string());
+
+            writer.write_u32(static_cast<uint32_t>(fields.size()));
+            for (const expression* field : fields)
+            {
+                const identifier& name = static_cast<const identifier&>(*field->expressions[1]);
+                write_type(writer, name.symbol != invalid_id ? symbols.get(name.symbol).type : error_type, symbols, types);
+                writer.write_string(name.name);
+            }
+
+            writer.write_u32(static_cast<uint32_t>(methods.size()));
+            for (const expression* method : methods)
+            {
+                writer.write_u8(static_cast<const identifier&>(*method->expressions[1]).id_type == identifier_type::static_method ? 1 : 0);
+                write_signature(writer, *method, symbols, types);
+            }
+            ++count;
+        }
+        else if (is_function_declaration(*global))
+        {
+            writer.write_u8(encoded_function);
+            write_signature(writer, *global, symbols, types);
+            ++count;
+        }
+    }
+
+    binary_writer declarations;
+    declarations.write_u32(count);
+    declarations.bytes.append(writer.bytes);
+
+    result.declarations = std::move(declarations.bytes);
+    result.hash         = stable_hash(result.declarations);
+}
+
+static void write_hashes(binary_writer& writer, const std::map<std::string, uint64_t>& hashes)
+{
+    writer.write_u32(static_cast<uint32_t>(hashes.size()));
+    for (auto& name_hash : hashes)
+    {
+        writer.write_string(name_hash.first);
+        writer.write_u64(name_hash.second);
+    }
+}
+
+static std::map<std::string, uint64_t> read_hashes(binary_reader& reader)
+{
+    std::map<std::string, uint64_t> hashes;
+    uint32_t count = reader.read_count(12);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string name = reader.read_string();
+        hashes[name]     = reader.read_u64();
+    }
+    return hashes;
+}
+
+void write_interface(std::ostream& out, const module_interface& exported)
+{
+    binary_writer writer;
+    writer.bytes.append("PPLI");
+    writer.write_u32(interface_version);
+    writer.write_u64(exported.source_hash);
+    writer.write_u64(exported.hash);
+    write_hashes(writer, exported.exports);
+    writer.write_u32(static_cast<uint32_t>(exported.imports.size()));
+    for (const interface_import& import : exported.imports)
+    {
+        writer.write_string(import.name);
+        write_hashes(writer, import.uses);
+    }
+    writer.bytes.append(exported.declarations);
+    writer.write_to(out);
+}
+
+bool read_interface(std::istream& in, module_interface& exported)
+{
+    binary_reader reader(in);
+    if (reader.data().compare(0, 4, "PPLI") != 0)
+        return false;
+    reader.read_u32(); // magic
+    if (reader.read_u32() != interface_version)
+        return false;
+
+    exported.source_hash = reader.read_u64();
+    exported.hash        = reader.read_u64();
+    exported.exports     = read_hashes(reader);
+    exported.imports.resize(reader.read_count(8));
+    for (interface_import& import : exported.imports)
+    {
+        import.name = reader.read_string();
+        import.uses = read_hashes(reader);
+    }
+    if (reader.failed())
+        return false;
+
+    exported.declarations = reader.data().substr(reader.position());
+    return stable_hash(exported.declarations) == exported.hash;
+}
+
+static unique_ptr<expression> read_type(binary_reader& reader)
+{
+    source_code_position position{ 0, 0 };
+
+    uint8_t kind = reader.read_u8();
+    if (kind == encoded_array)
+    {
+        std::vector<int32_t> lengths(reader.read_count(4));
+        for (int32_t& length : lengths)
+            length = reader.read_i32();
+
+        unique_ptr<expression> element = read_type(reader);
+        if (lengths.empty() || !element || element->expr_type != expression_type::type_name)
+            return nullptr;
+
+        unique_ptr<expression> atn = std::make_unique<expression>(position, expression_type::array_type_name);
+        atn->expressions.push_back(std::move(element));
+        for (int32_t length : lengths)
+            atn->expressions.push_back(std::make_unique<integer_literal>(position, length));
+        return atn;
+    }
+
+    switch (kind)
+    {
+    case encoded_unit:
+        return std::make_unique<type_name>(position, "()");
+    case encoded_i32:
+        return std::make_unique<type_name>(position, "i32");
+    case encoded_f32:
+        return std::make_unique<type_name>(position, "f32");
+    case encoded_bool:
+        return std::make_unique<type_name>(position, "bool");
+    case encoded_str:
+        return std::make_unique<type_name>(position, "str");
+    case encoded_user:
+        return std::make_unique<type_name>(position, reader.read_string());
+    default:
+        return nullptr;
+    }
+}
+
+static unique_ptr<expression> read_signature(binary_reader& reader, identifier_type id_type)
+{
+    source_code_position position{ 0, 0 };
+    std::string name = reader.read_string();
+
+    unique_ptr<expression> ftn = std::make_unique<expression>(position, expression_type::function_type_name);
+    uint32_t count             = reader.read_count(2);
+    if (count == 0)
+    {
+        ftn->expressions.push_back(std::make_unique<type_name>(position, "()"));
+    }
+    else
+    {
+        unique_ptr<expression> parameters = std::make_unique<expression>(position, expression_type::compound);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            unique_ptr<expression> parameter_type = read_type(reader);
+            if (!parameter_type)
+                return nullptr;
+
+            unique_ptr<expression> parameter = std::make_unique<expression>(position, expression_type::declaration);
+            parameter->expressions.push_back(std::move(parameter_type));
+            parameter->expressions.push_back(std::make_unique<identifier>(position, reader.read_string(), identifier_type::parameter));
+            parameters->expressions.push_back(std::move(parameter));
+        }
+        ftn->expressions.push_back(std::move(parameters));
+    }
+
+    unique_ptr<expression> result_type = read_type(reader);
+    if (!result_type)
+        return nullptr;
+    ftn->expressions.push_back(std::move(result_type));
+
+    // no body, the function is defined by its module
+    unique_ptr<expression> fd = std::make_unique<expression>(position, expression_type::declaration);
+    fd->expressions.push_back(std::move(ftn));
+    fd->expressions.push_back(std::make_unique<identifier>(position, name, id_type));
+    fd->expressions.push_back(nullptr);
+    return fd;
+}
+
+static unique_ptr<expression> read_user_type(binary_reader& reader)
+{
+    source_code_position position{ 0, 0 };
+
+    unique_ptr<expression> td = std::make_unique<expression>(position, expression_type::type_declaration);
+    td->expressions.push_back(std::make_unique<identifier>(position, reader.read_string(), identifier_type::type));
+
+    std::string base = reader.read_string();
+    if (base.empty())
+        td->expressions.push_back(nullptr);
+    else
+        td->expressions.push_back(std::make_unique<identifier>(position, base, identifier_type::type));
+
+    unique_ptr<expression> members = std::make_unique<expression>(position, expression_type::compound);
+    uint32_t fields                = reader.read_count(5);
+    for (uint32_t i = 0; i < fields; ++i)
+    {
+        unique_ptr<expression> field_type = read_type(reader);
+        if (!field_type)
+            return nullptr;
+
+        unique_ptr<expression> field = std::make_unique<expression>(position, expression_type::declaration);
+        field->expressions.push_back(std::move(field_type));
+        field->expressions.push_back(std::make_unique<identifier>(position, reader.read_string(), identifier_type::member));
+        members->expressions.push_back(std::move(field));
+    }
+
+    uint32_t methods = reader.read_count(6);
+    for (uint32_t i = 0; i < methods; ++i)
+    {
+        identifier_type id_type       = reader.read_u8() != 0 ? identifier_type::static_method : identifier_type::method;
+        unique_ptr<expression> method = read_signature(reader, id_type);
+        if (!method)
+            return nullptr;
+        members->expressions.push_back(std::move(method));
+    }
+
+    td->expressions.push_back(std::move(members));
+    return td;
+}
+
+bool declare_interface(const module_interface& exported, expression_vector& declarations)
+{
+    binary_reader reader{ std::string(exported.declarations) };
+
+    uint32_t count = reader.read_count();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        unique_ptr<expression> decl;
+        switch (reader.read_u8())
+        {
+        case encoded_function:
+            decl = read_signature(reader, identifier_type::function);
+            break;
+        case encoded_user_type:
+            decl = read_user_type(reader);
+            break;
+        default:
+            break;
+        }
+        if (!decl || reader.failed())
+            return false;
+        declarations.push_back(std::move(decl));
+    }
+    return !reader.failed();
+}
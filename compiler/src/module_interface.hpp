@@ -0,0 +1,55 @@
+//! \file      module_interface.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef MODULE_INTERFACE_HPP
+#define MODULE_INTERFACE_HPP
+
+#include "ast.hpp"
+#include "symbol_table.hpp"
+#include "type_table.hpp"
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <unordered_set>
+
+struct interface_import
+{
+    std::string name;
+    std::map<std::string, uint64_t> uses; // interface hash of every name the module uses when it was compiled, 0 if not exported
+};
+
+// What importers of a module see: its top level functions and types with their fields and method signatures.
+// Global variables and functions declared in blocks are private to the module.
+//
+//   "PPLI", u32 version, u64 source hash, u64 declarations hash, u32 exports as name and u64 interface hash,
+//   u32 imports as name and u32 used names with their u64 interface hash, u32 declarations:
+//   function: u8 0, the signature
+//   type:     u8 1, name, base name or "", u32 own fields as type and name, u32 methods as u8 static and signature
+//   signature: name, u32 parameters as type and name, result type
+//   type:      u8 kind, the name of user types, u32 lengths and the element type of arrays, outermost length first
+struct module_interface
+{
+    uint64_t source_hash = 0;
+    uint64_t hash        = 0; // of the declarations
+    std::map<std::string, uint64_t> exports; // interface hash of every exported name, see dependency_graph
+    std::vector<interface_import> imports;   // every module the declarations were checked against, imports of imports first
+    std::string declarations;              // encoded as above
+};
+
+// encodes the top level functions and types of the checked program, the imported declarations are skipped
+void describe_interface(const expression& program, const std::unordered_set<const expression*>& imported, const symbol_table& symbols, const type_table& types,
+                        module_interface& result);
+
+void write_interface(std::ostream& out, const module_interface& exported);
+
+// returns false if the file is malformed or of another version
+bool read_interface(std::istream& in, module_interface& exported);
+
+// declarations like the parser builds them, functions without a body and types with method prototypes
+// returns false if the declarations are malformed
+bool declare_interface(const module_interface& exported, expression_vector& declarations);
+
+#endif MODULE_INTERFACE_HPP
@@ -0,0 +1,457 @@
+//! \file      module_loader.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "module_loader.hpp"
+#include "binary_stream.hpp"
+#include "bytecode.hpp"
+#include "dependency_graph.hpp"
+#include "lexer.hpp"
+#include "linker.hpp"
+#include "name_resolver.hpp"
+#include "parser.hpp"
+#include "profile.hpp"
+#include "type_checker.hpp"
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+static const uint32_t dependencies_version = 1;
+
+// what a top level declaration was built from
+struct cached_declaration
+{
+    uint64_t source_hash = 0;
+    int32_t line         = 0;
+    std::map<std::string, uint64_t> uses; // interface hashes of the used names
+};
+
+static bool read_file(const std::string& file_name, std::string& content)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file)
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+static bool is_function_declaration(const expression& decl)
+{
+    return decl.expr_type == expression_type::declaration && decl.expressions.size() > 2;
+}
+
+// name and signature of functions, "type name" of types, empty for global variables
+static std::string declaration_key(const expression& global, const symbol_table& symbols, const type_table& types)
+{
+    if (global.expr_type == expression_type::type_declaration)
+        return "type " + static_cast<const identifier&>(*global.expressions[0]).name;
+    if (!is_function_declaration(global))
+        return std::string();
+
+    symbol_id sym = static_cast<const identifier&>(*global.expressions[1]).symbol;
+    return sym != invalid_id ? symbols.name(sym) + " " + types.to_string(symbols.get(sym).type, symbols) : std::string();
+}
+
+static bool has_local_functions(const expression* expr)
+{
+    if (!expr)
+        return false;
+    if (is_function_declaration(*expr))
+        return true;
+    for (auto& child : expr->expressions)
+    {
+        if (has_local_functions(child.get()))
+            return true;
+    }
+    return false;
+}
+
+// functions declared in blocks have no link name, their ir can not be matched to the previous build
+static bool declares_local_functions(const expression& global)
+{
+    if (global.expr_type != expression_type::type_declaration)
+        return has_local_functions(global.expressions[2].get());
+
+    for (auto& member : global.expressions[2]->expressions)
+    {
+        if (member && is_function_declaration(*member) && has_local_functions(member->expressions[2].get()))
+            return true;
+    }
+    return false;
+}
+
+// hashes the tokens of each declaration up to the next one with their lines relative to its first line, comments and
+// blank lines around it do not change the hash and moving it only moves the lines of its positions
+static std::unordered_map<const expression*, cached_declaration> declaration_sources(const std::vector<token>& tokens, const expression& program,
+                                                                                     const std::unordered_set<const expression*>& imported)
+{
+    std::vector<const expression*> own;
+    std::vector<size_t> first_tokens;
+    size_t next = 0;
+    for (auto& global : program.expressions)
+    {
+        if (!global || imported.count(global.get()))
+            continue;
+
+        const source_code_position& start = global->source_position;
+        while (next < tokens.size() && (tokens[next].position.line != start.line || tokens[next].position.inline_offset != start.inline_offset))
+            ++next;
+        own.push_back(global.get());
+        first_tokens.push_back(next);
+    }
+    first_tokens.push_back(tokens.size());
+
+    std::unordered_map<const expression*, cached_declaration> result;
+    for (size_t i = 0; i < own.size(); ++i)
+    {
+        int32_t line = own[i]->source_position.line;
+        std::string text;
+        for (size_t t = first_tokens[i]; t < first_tokens[i + 1] && t < tokens.size(); ++t)
+        {
+            if (tokens[t].type == token_type::comment || tokens[t].type == token_type::eof)
+                continue;
+            text += std::to_string(tokens[t].position.line - line) + ":" + std::to_string(tokens[t].position.inline_offset) + ":" +
+                    std::to_string(static_cast<int32_t>(tokens[t].type)) + ":" + tokens[t].text + "\n";
+        }
+
+        cached_declaration& entry = result[own[i]];
+        entry.source_hash         = stable_hash(text);
+        entry.line                = line;
+    }
+    return result;
+}
+
+static void write_dependencies(std::ostream& out, uint64_t bytecode_hash, const std::map<std::string, cached_declaration>& cached)
+{
+    binary_writer writer;
+    writer.bytes.append("PPLG");
+    writer.write_u32(dependencies_version);
+    writer.write_u64(bytecode_hash);
+    writer.write_u32(static_cast<uint32_t>(cached.size()));
+    for (auto& key_entry : cached)
+    {
+        writer.write_string(key_entry.first);
+        writer.write_u64(key_entry.second.source_hash);
+        writer.write_i32(key_entry.second.line);
+        writer.write_u32(static_cast<uint32_t>(key_entry.second.uses.size()));
+        for (auto& name_hash : key_entry.second.uses)
+        {
+            writer.write_string(name_hash.first);
+            writer.write_u64(name_hash.second);
+        }
+    }
+    writer.write_to(out);
+}
+
+static bool read_dependencies(std::string&& data, uint64_t& bytecode_hash, std::map<std::string, cached_declaration>& cached)
+{
+    binary_reader reader(std::move(data));
+    if (reader.data().compare(0, 4, "PPLG") != 0)
+        return false;
+    reader.read_u32(); // magic
+    if (reader.read_u32() != dependencies_version)
+        return false;
+
+    bytecode_hash  = reader.read_u64();
+    uint32_t count = reader.read_count(24);
+    for (uint32_t i = 0; i < count && !reader.failed(); ++i)
+    {
+        cached_declaration& entry = cached[reader.read_string()];
+        entry.source_hash         = reader.read_u64();
+        entry.line                = reader.read_i32();
+        uint32_t uses             = reader.read_count(12);
+        for (uint32_t u = 0; u < uses; ++u)
+        {
+            std::string name = reader.read_string();
+            entry.uses[name] = reader.read_u64();
+        }
+    }
+    return !reader.failed();
+}
+
+static bool uses_unchanged(const interface_import& import, const module_interface& dependency)
+{
+    for (auto& name_hash : import.uses)
+    {
+        auto it = dependency.exports.find(name_hash.first);
+        if ((it != dependency.exports.end() ? it->second : 0) != name_hash.second)
+            return false;
+    }
+    return true;
+}
+
+// a new import of an import can declare one of the names
+static bool imports_known(const module_interface& exported, const module_interface& dependency)
+{
+    for (const interface_import& import : dependency.imports)
+    {
+        auto known = [&import](const interface_import& own) { return own.name == import.name; };
+        if (std::none_of(exported.imports.begin(), exported.imports.end(), known))
+            return false;
+    }
+    return true;
+}
+
+module_loader::module_loader(const std::string& directory)
+    : build(std::make_shared<build_state>())
+{
+    build->directory = directory;
+}
+
+module_loader::module_loader(const std::shared_ptr<build_state>& build)
+    : build(build)
+{
+}
+
+bool module_loader::import_module(const std::string& name, const source_code_position& position, expression_vector& declarations)
+{
+    if (std::find(imported.begin(), imported.end(), name) != imported.end())
+        return true;
+
+    const module_interface* exported = load(name, position);
+    if (!exported)
+        return false;
+
+    // the declarations can use the types of the imports of the module
+    for (const interface_import& import : exported->imports)
+    {
+        if (!import_module(import.name, position, declarations))
+            return false;
+    }
+
+    size_t first = declarations.size();
+    if (!declare_interface(*exported, declarations))
+    {
+        std::cerr << "Invalid interface of module " << name << position << std::endl;
+        return false;
+    }
+    for (size_t i = first; i < declarations.size(); ++i)
+        this->declarations.insert(declarations[i].get());
+
+    imported.push_back(name);
+    return true;
+}
+
+const module_interface* module_loader::load(const std::string& name, const source_code_position& position)
+{
+    auto it = build->interfaces.find(name);
+    if (it != build->interfaces.end())
+        return &it->second;
+
+    if (std::find(build->loading.begin(), build->loading.end(), name) != build->loading.end())
+    {
+        std::cerr << "Cyclic import of module " << name << position << std::endl;
+        return nullptr;
+    }
+
+    std::string source;
+    if (!read_file(path(name, ".ppl"), source))
+    {
+        std::cerr << "Unknown module " << name << position << std::endl;
+        return nullptr;
+    }
+
+    build->loading.push_back(name);
+
+    module_interface exported;
+    std::ifstream interface_file(path(name, ".ppli"), std::ios::binary);
+    bool current = interface_file && read_interface(interface_file, exported) && exported.source_hash == stable_hash(source) && std::ifstream(path(name, ".pplb")).good();
+
+    // the module was checked against these interfaces, its code may only change if a name it uses changed
+    bool valid = true;
+    for (size_t i = 0; current && i < exported.imports.size(); ++i)
+    {
+        const module_interface* dependency = load(exported.imports[i].name, position);
+        valid                              = dependency != nullptr;
+        current                            = valid && uses_unchanged(exported.imports[i], *dependency) && imports_known(exported, *dependency);
+    }
+
+    if (valid && current)
+        build->interfaces[name] = std::move(exported);
+    else if (valid)
+        valid = compile(name, source);
+
+    build->loading.pop_back();
+    return valid ? &build->interfaces[name] : nullptr;
+}
+
+bool module_loader::compile(const std::string& name, const std::string& source)
+{
+    PROFILE_SCOPE("module_loader::compile");
+    std::cout << "  MODULE: " << path(name, ".ppl") << std::endl;
+
+    lexer source_lexer;
+    std::vector<token> tokens = source_lexer.parse(source);
+
+    module_loader loader(build);
+    parser token_parser(tokens, [&loader](const std::string& module, const source_code_position& position, expression_vector& declarations) {
+        return loader.import_module(module, position, declarations);
+    });
+    unique_ptr<expression> program = token_parser.parse();
+
+    symbol_table symbols;
+    name_resolver resolver(symbols);
+    bool valid = !token_parser.has_errors() && resolver.resolve(*program);
+
+    type_table types;
+    type_checker checker(symbols, types);
+    valid = valid && checker.check(*program);
+
+    ir_module module;
+    if (valid)
+    {
+        ir_builder builder(symbols, types);
+        loader.reuse_unchanged(name, tokens, *program, symbols, types, builder);
+        valid = builder.build(*program, module);
+    }
+
+    valid = valid && loader.write_module(name, source, tokens, *program, symbols, types, module);
+    if (!valid)
+        std::cerr << "Can not compile module " << name << std::endl;
+    return valid;
+}
+
+void module_loader::reuse_unchanged(const std::string& name, const std::vector<token>& tokens, const expression& program, const symbol_table& symbols,
+                                    const type_table& types, ir_builder& builder)
+{
+    std::string bytecode;
+    std::string dependencies;
+    uint64_t bytecode_hash = 0;
+    std::map<std::string, cached_declaration> cached;
+    if (!read_file(path(name, ".pplb"), bytecode) || !read_file(path(name, ".ppldep"), dependencies) ||
+        !read_dependencies(std::move(dependencies), bytecode_hash, cached) || bytecode_hash != stable_hash(bytecode))
+        return;
+
+    previous = std::make_unique<ir_module>();
+    std::istringstream bytecode_stream(bytecode);
+    if (!read_bytecode(bytecode_stream, *previous))
+    {
+        previous.reset();
+        return;
+    }
+
+    dependency_graph graph(program, symbols, types);
+    std::unordered_map<const expression*, cached_declaration> sources = declaration_sources(tokens, program, declarations);
+    std::unordered_map<const expression*, int32_t> line_deltas;
+    size_t count = 0;
+    for (auto& global : program.expressions)
+    {
+        std::string key = global && !declarations.count(global.get()) ? declaration_key(*global, symbols, types) : std::string();
+        if (key.empty())
+            continue;
+        ++count;
+
+        auto it = cached.find(key);
+        if (it == cached.end() || it->second.source_hash != sources[global.get()].source_hash || declares_local_functions(*global))
+            continue;
+
+        auto changed = [&graph](const std::pair<const std::string, uint64_t>& name_hash) { return graph.interface_hash(name_hash.first) != name_hash.second; };
+        if (std::any_of(it->second.uses.begin(), it->second.uses.end(), changed))
+            continue;
+
+        line_deltas[global.get()] = sources[global.get()].line - it->second.line;
+    }
+
+    std::cout << "  REUSED: " << line_deltas.size() << " of " << count << " declarations of " << path(name, ".ppl") << std::endl;
+    builder.reuse(*previous, std::move(line_deltas));
+}
+
+bool module_loader::write_module(const std::string& name, const std::string& source, const std::vector<token>& tokens, const expression& program,
+                                 const symbol_table& symbols, const type_table& types, const ir_module& module)
+{
+    dependency_graph graph(program, symbols, types);
+    std::unordered_map<const expression*, cached_declaration> sources = declaration_sources(tokens, program, declarations);
+
+    module_interface exported;
+    exported.source_hash = stable_hash(source);
+    std::map<std::string, cached_declaration> cached;
+    std::set<std::string> used;
+    for (auto& global : program.expressions)
+    {
+        if (!global || declarations.count(global.get()))
+            continue;
+
+        const std::vector<std::string>& uses = graph.uses(global.get());
+        used.insert(uses.begin(), uses.end());
+
+        std::string key = declaration_key(*global, symbols, types);
+        if (key.empty())
+            continue;
+
+        const expression& declared_name = *global->expressions[global->expr_type == expression_type::type_declaration ? 0 : 1];
+        std::string exported_name       = static_cast<const identifier&>(declared_name).name;
+        exported.exports[exported_name] = graph.interface_hash(exported_name);
+
+        cached_declaration& entry = cached[key];
+        entry                     = sources[global.get()];
+        for (const std::string& use : uses)
+            entry.uses[use] = graph.interface_hash(use);
+    }
+
+    // importers of a changed module only compile again if a name they use changed, including names it did not declare before
+    for (const std::string& import : imported)
+    {
+        const module_interface& dependency = build->interfaces[import];
+        interface_import entry{ import, {} };
+        for (const std::string& name_used : used)
+        {
+            auto it               = dependency.exports.find(name_used);
+            entry.uses[name_used] = it != dependency.exports.end() ? it->second : 0;
+        }
+        exported.imports.push_back(std::move(entry));
+    }
+    describe_interface(program, declarations, symbols, types, exported);
+
+    std::ostringstream bytecode;
+    write_bytecode(bytecode, module);
+    std::string bytes = bytecode.str();
+
+    // the bytecode is written first, an interface is never newer than its code
+    std::ofstream bytecode_file(path(name, ".pplb"), std::ios::binary);
+    bytecode_file << bytes;
+    bytecode_file.close();
+    std::ofstream dependencies_file(path(name, ".ppldep"), std::ios::binary);
+    write_dependencies(dependencies_file, stable_hash(bytes), cached);
+    dependencies_file.close();
+    std::ofstream interface_file(path(name, ".ppli"), std::ios::binary);
+    write_interface(interface_file, exported);
+    interface_file.close();
+    if (!bytecode_file || !dependencies_file || !interface_file)
+    {
+        std::cerr << "Can not write module " << name << std::endl;
+        return false;
+    }
+
+    build->interfaces[name] = std::move(exported);
+    return true;
+}
+
+bool module_loader::link(ir_module& module)
+{
+    if (imported.empty())
+        return true;
+
+    std::vector<ir_module> modules(imported.size() + 1);
+    for (size_t i = 0; i < imported.size(); ++i)
+    {
+        std::ifstream bytecode_file(path(imported[i], ".pplb"), std::ios::binary);
+        if (!bytecode_file || !read_bytecode(bytecode_file, modules[i]))
+        {
+            std::cerr << "Invalid bytecode of module " << imported[i] << std::endl;
+            return false;
+        }
+    }
+    modules.back() = std::move(module);
+
+    return link_modules(modules, module);
+}
+
+std::string module_loader::path(const std::string& name, const char* extension) const
+{
+    return build->directory.empty() ? name + extension : build->directory + "/" + name + extension;
+}
@@ -0,0 +1,83 @@
+//! \file      module_loader.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef MODULE_LOADER_HPP
+#define MODULE_LOADER_HPP
+
+#include "ast.hpp"
+#include "ir.hpp"
+#include "ir_builder.hpp"
+#include "module_interface.hpp"
+#include "token.hpp"
+#include <map>
+#include <memory>
+#include <unordered_set>
+
+// Finds, compiles and loads the modules a program imports.
+// "import name;" refers to name.ppl in the directory of the program, which compiles to name.ppli, its interface,
+// and name.pplb, its bytecode. Importers only read the interface, the bytecode is linked into the program before it
+// is optimized. Importing a module also imports the modules it imports.
+// A module is compiled again if its source changed or if the interface hash of a name it uses changed in one of its
+// imports, see dependency_graph. name.ppldep records the tokens and the used interface hashes of its top level
+// functions and types, when it is compiled again only the changed ones and the ones using changed names are lowered,
+// the ir of the others is taken from the previous bytecode.
+//
+//   "PPLG", u32 version, u64 hash of the bytecode, u32 declarations as name and signature or "type name",
+//   u64 hash of the tokens, i32 first line, u32 used names with their u64 interface hash
+class module_loader
+{
+  public:
+    explicit module_loader(const std::string& directory);
+    ~module_loader() = default;
+
+    // import handler of the parser
+    bool import_module(const std::string& name, const source_code_position& position, expression_vector& declarations);
+
+    // declarations added to the program by import_module
+    const std::unordered_set<const expression*>& imported_declarations() const
+    {
+        return declarations;
+    }
+
+    // modules the program imports, imports of imports first
+    const std::vector<std::string>& imported_modules() const
+    {
+        return imported;
+    }
+
+    // lets the builder take the ir of the declarations that did not change since module name was written
+    void reuse_unchanged(const std::string& name, const std::vector<token>& tokens, const expression& program, const symbol_table& symbols, const type_table& types,
+                         ir_builder& builder);
+
+    // writes interface, bytecode and dependencies of the checked and built program as module name
+    bool write_module(const std::string& name, const std::string& source, const std::vector<token>& tokens, const expression& program, const symbol_table& symbols,
+                      const type_table& types, const ir_module& module);
+
+    // links the bytecode of the imported modules and the program into module
+    bool link(ir_module& module);
+
+  private:
+    // shared by the loaders of all modules compiled for one program
+    struct build_state
+    {
+        std::string directory;
+        std::map<std::string, module_interface> interfaces; // up to date interfaces of loaded modules
+        std::vector<std::string> loading;                   // an import of one of them is a cycle
+    };
+
+    explicit module_loader(const std::shared_ptr<build_state>& build);
+
+    const module_interface* load(const std::string& name, const source_code_position& position);
+    bool compile(const std::string& name, const std::string& source);
+    std::string path(const std::string& name, const char* extension) const;
+
+    std::shared_ptr<build_state> build;
+    std::vector<std::string> imported;
+    std::unordered_set<const expression*> declarations;
+    std::unique_ptr<ir_module> previous; // bytecode reused by the builder
+};
+
+#endif MODULE_LOADER_HPP
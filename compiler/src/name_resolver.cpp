@@ -0,0 +1,407 @@
+//! \file      name_resolver.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "name_resolver.hpp"
+#include "profile.hpp"
+
+static identifier_type to_identifier_type(symbol_kind kind)
+{
+    switch (kind)
+    {
+    case symbol_kind::global_variable:
+    case symbol_kind::local_variable:
+        return identifier_type::variable;
+    case symbol_kind::parameter:
+        return identifier_type::parameter;
+    case symbol_kind::builtin:
+    case symbol_kind::function:
+        return identifier_type::function;
+    case symbol_kind::user_type:
+        return identifier_type::type;
+    case symbol_kind::member:
+        return identifier_type::member;
+    case symbol_kind::method:
+        return identifier_type::method;
+    case symbol_kind::static_method:
+        return identifier_type::static_method;
+    default:
+        return identifier_type::undefined;
+    }
+}
+
+static bool is_primitive_type_name(const std::string& name)
+{
+    return name == "i32" || name == "f32" || name == "bool" || name == "str" || name == "()";
+}
+
+static bool is_function_declaration(const expression& decl)
+{
+    return decl.expr_type == expression_type::declaration && decl.expressions.size() > 2;
+}
+
+name_resolver::name_resolver(symbol_table& symbols)
+    : symbols(symbols)
+{
+    DEFINE_VISITOR_AND_VISITABLES(name_resolver, ast_node, expression, identifier, type_name);
+
+    symbols.declare(symbols.global, "dump", symbol_kind::builtin, nullptr, source_code_position{ 0, 0 });
+}
+
+bool name_resolver::resolve(expression& program)
+{
+    PROFILE_SCOPE("name_resolver::resolve");
+    declare_globals(program);
+
+    for (auto& global : program.expressions)
+    {
+        if (global)
+            (*this)(*global, symbols.global);
+    }
+
+    for (const semantic_error& err : m_errors)
+    {
+        std::cerr << err.message << err.position << std::endl;
+    }
+
+    return m_errors.empty();
+}
+
+void name_resolver::declare_globals(expression& program)
+{
+    // types first, signatures and members can reference any of them
+    for (auto& global : program.expressions)
+    {
+        if (!global || global->expr_type != expression_type::type_declaration)
+            continue;
+
+        identifier& name   = static_cast<identifier&>(*global->expressions[0]);
+        symbol_id type_sym = declare(symbols.global, name, symbol_kind::user_type, global.get());
+        if (type_sym != invalid_id)
+            symbols.get(type_sym).member_scope = symbols.create_scope(scope_kind::type, symbols.global, type_sym);
+    }
+
+    for (auto& global : program.expressions)
+    {
+        if (!global)
+            continue;
+
+        switch (global->expr_type)
+        {
+        case expression_type::type_declaration:
+        {
+            symbol_id type_sym = static_cast<identifier&>(*global->expressions[0]).symbol;
+            if (type_sym == invalid_id)
+                break;
+
+            if (global->expressions[1])
+            {
+                (*this)(*global->expressions[1], symbols.global);
+                symbol_id base_sym = type_of_identifier(global->expressions[1].get());
+
+                // base types are declared before, so only a type extending itself can form a cycle
+                if (base_sym == invalid_id || base_sym == type_sym)
+                {
+                    create_error(global->expressions[1]->source_position, "Invalid base type " + global->expressions[1]->to_string());
+                }
+                else
+                {
+                    // members of the base are visible through the scope chain
+                    symbols.get(type_sym).base                                   = base_sym;
+                    symbols.get_scope(symbols.get(type_sym).member_scope).parent = symbols.get(base_sym).member_scope;
+                }
+            }
+
+            declare_members(*global, type_sym);
+            break;
+        }
+        case expression_type::declaration:
+        {
+            identifier& name = static_cast<identifier&>(*global->expressions[1]);
+            declare(symbols.global, name, is_function_declaration(*global) ? symbol_kind::function : symbol_kind::global_variable, global.get());
+            break;
+        }
+        case expression_type::assign:
+        {
+            expression* decl = global->expressions[0].get();
+            if (decl && decl->expr_type == expression_type::declaration)
+                declare(symbols.global, static_cast<identifier&>(*decl->expressions[1]), symbol_kind::global_variable, decl);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void name_resolver::declare_members(expression& type_decl, symbol_id type_symbol)
+{
+    scope_id member_scope = symbols.get(type_symbol).member_scope;
+
+    for (auto& member : type_decl.expressions[2]->expressions)
+    {
+        if (!member || member->expr_type != expression_type::declaration)
+            continue;
+
+        identifier& name = static_cast<identifier&>(*member->expressions[1]);
+
+        symbol_kind kind = symbol_kind::member;
+        if (is_function_declaration(*member))
+            kind = name.id_type == identifier_type::static_method ? symbol_kind::static_method : symbol_kind::method;
+
+        symbol_id member_sym = declare(member_scope, name, kind, member.get());
+        if (member_sym != invalid_id)
+            symbols.get(member_sym).owner = type_symbol;
+    }
+}
+
+void name_resolver::visit(ast_node&, scope_id)
+{
+}
+
+void name_resolver::visit(expression& expr, scope_id current)
+{
+    switch (expr.expr_type)
+    {
+    case expression_type::declaration:
+        if (is_function_declaration(expr))
+            resolve_function(expr, static_cast<identifier&>(*expr.expressions[1]).symbol, current);
+        else
+            resolve_variable(expr, current);
+        return;
+    case expression_type::assign:
+        // the initializer can not see the declared variable
+        if (expr.expressions[1])
+            (*this)(*expr.expressions[1], current);
+        if (expr.expressions[0])
+            (*this)(*expr.expressions[0], current);
+        return;
+    case expression_type::type_declaration:
+    {
+        symbol_id type_sym = static_cast<identifier&>(*expr.expressions[0]).symbol;
+        if (type_sym == invalid_id)
+            return;
+
+        scope_id member_scope = symbols.get(type_sym).member_scope;
+        for (auto& member : expr.expressions[2]->expressions)
+        {
+            if (member)
+                (*this)(*member, member_scope);
+        }
+        return;
+    }
+    case expression_type::branch:
+        (*this)(*expr.expressions[0], current);
+        for (size_t i = 1; i < expr.expressions.size(); ++i)
+        {
+            if (!expr.expressions[i])
+                continue;
+            if (expr.expressions[i]->expr_type == expression_type::compound)
+                resolve_block(*expr.expressions[i], current);
+            else
+                (*this)(*expr.expressions[i], current); // else if
+        }
+        return;
+    case expression_type::loop:
+        (*this)(*expr.expressions[0], current);
+        if (expr.expressions.size() > 1 && expr.expressions[1])
+            resolve_block(*expr.expressions[1], current);
+        return;
+    case expression_type::member_access:
+        // the member depends on the type of the object, bound by the type_checker
+        if (expr.expressions[0])
+            (*this)(*expr.expressions[0], current);
+        return;
+    case expression_type::scope_access:
+    {
+        (*this)(*expr.expressions[0], current);
+        symbol_id type_sym = type_of_identifier(expr.expressions[0].get());
+        if (type_sym == invalid_id)
+        {
+            create_error(expr.source_position, expr.expressions[0]->to_string() + " is not a type");
+            return;
+        }
+        if (expr.expressions[1] && expr.expressions[1]->expr_type == expression_type::identifier)
+            resolve_member_of(static_cast<identifier&>(*expr.expressions[1]), type_sym);
+        return;
+    }
+    case expression_type::instantiation:
+    {
+        (*this)(*expr.expressions[0], current);
+        symbol_id type_sym = type_of_identifier(expr.expressions[0].get());
+        if (type_sym == invalid_id)
+            create_error(expr.source_position, expr.expressions[0]->to_string() + " is not a type");
+
+        for (size_t i = 1; i < expr.expressions.size(); ++i)
+        {
+            expression& argument = *expr.expressions[i];
+            if (argument.expr_type == expression_type::field_init)
+            {
+                if (type_sym != invalid_id)
+                    resolve_member_of(static_cast<identifier&>(*argument.expressions[0]), type_sym);
+                if (argument.expressions[1])
+                    (*this)(*argument.expressions[1], current);
+            }
+            else
+                (*this)(argument, current);
+        }
+        return;
+    }
+    default:
+        for (auto& child : expr.expressions)
+        {
+            if (child)
+                (*this)(*child, current);
+        }
+        return;
+    }
+}
+
+void name_resolver::visit(identifier& ident, scope_id current)
+{
+    // declared identifiers are bound on declaration
+    if (ident.symbol != invalid_id)
+        return;
+
+    symbol_id id = symbols.lookup(current, ident.name);
+    if (id == invalid_id)
+    {
+        create_error(ident.source_position, "Unresolved identifier " + ident.name);
+        return;
+    }
+
+    ident.symbol = id;
+    if (ident.id_type == identifier_type::undefined)
+        ident.id_type = to_identifier_type(symbols.get(id).kind);
+}
+
+void name_resolver::visit(type_name& tp_name, scope_id current)
+{
+    if (is_primitive_type_name(tp_name.string_representation))
+        return;
+
+    symbol_id id = symbols.lookup(current, tp_name.string_representation);
+    if (id == invalid_id || symbols.get(id).kind != symbol_kind::user_type)
+    {
+        create_error(tp_name.source_position, "Unknown type " + tp_name.string_representation);
+        return;
+    }
+
+    tp_name.symbol = id;
+}
+
+void name_resolver::resolve_block(expression& block, scope_id parent)
+{
+    scope_id block_scope = symbols.create_scope(scope_kind::block, parent, symbols.get_scope(parent).owner);
+
+    for (auto& statement : block.expressions)
+    {
+        if (!statement)
+            continue;
+        if (statement->expr_type == expression_type::compound)
+            resolve_block(*statement, block_scope);
+        else
+            (*this)(*statement, block_scope);
+    }
+}
+
+void name_resolver::resolve_function(expression& function_decl, symbol_id function_symbol, scope_id parent)
+{
+    identifier& name = static_cast<identifier&>(*function_decl.expressions[1]);
+
+    // functions declared inside blocks are not known before
+    scope_kind kind = symbols.get_scope(parent).kind;
+    if (kind == scope_kind::block || kind == scope_kind::function)
+        function_symbol = declare(parent, name, symbol_kind::function, &function_decl);
+
+    scope_id function_scope = symbols.create_scope(scope_kind::function, parent, function_symbol);
+
+    expression* function_tp_name = function_decl.expressions[0].get();
+    if (function_tp_name)
+    {
+        expression* parameters = function_tp_name->expressions[0].get();
+        if (parameters && parameters->expr_type == expression_type::compound)
+        {
+            for (auto& parameter : parameters->expressions)
+            {
+                if (!parameter)
+                    continue;
+                (*this)(*parameter->expressions[0], parent);
+                declare(function_scope, static_cast<identifier&>(*parameter->expressions[1]), symbol_kind::parameter, parameter.get());
+            }
+        }
+
+        if (function_tp_name->expressions.size() > 1 && function_tp_name->expressions[1])
+            (*this)(*function_tp_name->expressions[1], parent);
+    }
+
+    if (function_decl.expressions[2])
+        resolve_block(*function_decl.expressions[2], function_scope);
+}
+
+void name_resolver::resolve_variable(expression& variable_decl, scope_id current)
+{
+    if (variable_decl.expressions[0])
+        (*this)(*variable_decl.expressions[0], current);
+
+    identifier& name = static_cast<identifier&>(*variable_decl.expressions[1]);
+
+    // globals and members are declared before
+    scope_kind kind = symbols.get_scope(current).kind;
+    if (kind == scope_kind::block || kind == scope_kind::function)
+        declare(current, name, symbol_kind::local_variable, &variable_decl);
+}
+
+void name_resolver::resolve_member_of(identifier& member, symbol_id type_symbol)
+{
+    name_id name = symbols.names.find(member.name);
+
+    // only walk the type and its bases, not the enclosing global scope
+    scope_id current = symbols.get(type_symbol).member_scope;
+    while (name != invalid_id && current != invalid_id && symbols.get_scope(current).kind == scope_kind::type)
+    {
+        symbol_id id = symbols.lookup_local(current, name);
+        if (id != invalid_id)
+        {
+            member.symbol = id;
+            if (member.id_type == identifier_type::undefined)
+                member.id_type = to_identifier_type(symbols.get(id).kind);
+            return;
+        }
+        current = symbols.get_scope(current).parent;
+    }
+
+    create_error(member.source_position, member.name + " is not a member of " + symbols.name(type_symbol));
+}
+
+symbol_id name_resolver::declare(scope_id current, identifier& ident, symbol_kind kind, expression* declaration)
+{
+    symbol_id id = symbols.declare(current, ident.name, kind, declaration, ident.source_position);
+    if (id == invalid_id)
+    {
+        create_error(ident.source_position, "Redeclaration of " + ident.name);
+        return invalid_id;
+    }
+
+    ident.symbol = id;
+    return id;
+}
+
+symbol_id name_resolver::type_of_identifier(expression* expr)
+{
+    if (!expr || expr->expr_type != expression_type::identifier)
+        return invalid_id;
+
+    symbol_id id = static_cast<identifier*>(expr)->symbol;
+    if (id == invalid_id || symbols.get(id).kind != symbol_kind::user_type)
+        return invalid_id;
+
+    return id;
+}
+
+void name_resolver::create_error(const source_code_position& position, const std::string& msg)
+{
+    m_errors.push_back(semantic_error{ position, msg });
+}
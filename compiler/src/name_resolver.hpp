@@ -0,0 +1,52 @@
+//! \file      name_resolver.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef NAME_RESOLVER_HPP
+#define NAME_RESOLVER_HPP
+
+#include "ast.hpp"
+#include "symbol_table.hpp"
+
+// Builds the scopes of a program and binds every identifier to its symbol.
+// Members accessed with '.' depend on the type of the object and are bound by the type_checker.
+class name_resolver : public base_visitor<ast_node, void, scope_id>
+{
+  public:
+    name_resolver(symbol_table& symbols);
+    ~name_resolver() = default;
+
+    // returns false if there were unresolved or redeclared names
+    bool resolve(expression& program);
+
+    void visit(ast_node& node, scope_id current);
+    void visit(expression& expr, scope_id current);
+    void visit(identifier& ident, scope_id current);
+    void visit(type_name& tp_name, scope_id current);
+
+    const semantic_error_list& errors() const
+    {
+        return m_errors;
+    }
+
+  private:
+    void declare_globals(expression& program);
+    void declare_members(expression& type_decl, symbol_id type_symbol);
+
+    void resolve_block(expression& block, scope_id parent);
+    void resolve_function(expression& function_decl, symbol_id function_symbol, scope_id parent);
+    void resolve_variable(expression& variable_decl, scope_id current);
+    void resolve_member_of(identifier& member, symbol_id type_symbol);
+
+    symbol_id declare(scope_id current, identifier& ident, symbol_kind kind, expression* declaration);
+    symbol_id type_of_identifier(expression* expr);
+
+    void create_error(const source_code_position& position, const std::string& msg);
+
+    symbol_table& symbols;
+    semantic_error_list m_errors;
+};
+
+#endif NAME_RESOLVER_HPP
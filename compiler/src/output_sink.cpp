@@ -0,0 +1,80 @@
+//! \file      output_sink.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "output_sink.hpp"
+#include <cstdio>
+
+output_sink::output_sink(std::ostream& out, const output_options& options)
+    : out(out)
+    , options(options)
+    , last_write(std::chrono::steady_clock::now())
+{
+    buffer.reserve(options.flush_size + 256);
+}
+
+output_sink::~output_sink()
+{
+    flush();
+}
+
+void output_sink::write_i32(int32_t value)
+{
+    // written backwards from the end
+    char digits[16];
+    char* first        = digits + sizeof(digits);
+    uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+    do
+    {
+        *--first = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+        *--first = '-';
+    buffer.append(first, digits + sizeof(digits));
+}
+
+void output_sink::write_f32(float value)
+{
+    // the default format of streams
+    char digits[32];
+    int32_t length = std::snprintf(digits, sizeof(digits), "%g", static_cast<double>(value));
+    buffer.append(digits, static_cast<size_t>(length));
+}
+
+void output_sink::write_u32(uint32_t value)
+{
+    for (int32_t shift = 0; shift < 32; shift += 8)
+        buffer.push_back(static_cast<char>((value >> shift) & 0xff));
+}
+
+void output_sink::write_bytes(const char* data, size_t size)
+{
+    write_u32(static_cast<uint32_t>(size));
+    buffer.append(data, size);
+}
+
+void output_sink::end_record()
+{
+    if (buffer.size() >= options.flush_size)
+    {
+        flush();
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_write).count() >= options.flush_interval)
+        flush();
+}
+
+void output_sink::flush()
+{
+    last_write = std::chrono::steady_clock::now();
+    if (buffer.empty())
+        return;
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
+    buffer.clear();
+}
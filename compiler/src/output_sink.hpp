@@ -0,0 +1,111 @@
+//! \file      output_sink.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum class dump_mode
+{
+    text,   // the formatted lines
+    binary, // tagged values, see output_sink
+};
+
+struct output_options
+{
+    dump_mode mode         = dump_mode::text;
+    size_t flush_size      = 64 * 1024; // bytes buffered before they are written
+    int64_t flush_interval = 100;       // milliseconds a finished dump may wait in the buffer, 0 writes every dump
+};
+
+// Buffers the output of dump and writes it in large blocks.
+// The buffer is written when it holds flush_size bytes, when a dump finishes flush_interval after the last write,
+// on flush and when the sink is destroyed. Every runtime has its own sink, so a thread never shares its buffer.
+//
+// The binary mode writes a header and one record per dump, all integers are little endian:
+//   header:   "PPLD", u32 version, u32 formats, every format as u32 segments and u32 length + bytes per segment,
+//             u32 classes, every class as its name and u32 fields with their names, names are u32 length + bytes
+//   record:   i32 format or -1, u32 arguments, the tagged arguments
+//   value:    u8 tag, i32 | f32 | u8 boolean | nothing for unit and null | u32 length + bytes of a string |
+//             u32 length and values of an array | i32 class and the values of its fields
+class output_sink
+{
+  public:
+    enum value_tag : uint8_t
+    {
+        tag_i32,
+        tag_f32,
+        tag_boolean,
+        tag_unit,
+        tag_null,
+        tag_string,
+        tag_array,
+        tag_instance,
+    };
+
+    output_sink(std::ostream& out, const output_options& options);
+    ~output_sink();
+
+    output_sink(const output_sink&)            = delete;
+    output_sink& operator=(const output_sink&) = delete;
+
+    dump_mode mode() const
+    {
+        return options.mode;
+    }
+
+    void write(const char* data, size_t size)
+    {
+        buffer.append(data, size);
+    }
+
+    void write(const std::string& text)
+    {
+        buffer.append(text);
+    }
+
+    void write(const char* text)
+    {
+        buffer.append(text);
+    }
+
+    void put(char c)
+    {
+        buffer.push_back(c);
+    }
+
+    // text
+    void write_i32(int32_t value);
+    void write_f32(float value);
+
+    // binary
+    void write_u8(uint8_t value)
+    {
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    void write_u32(uint32_t value);
+
+    // length and bytes
+    void write_bytes(const char* data, size_t size);
+
+    // ends a dump, writes the buffer once a threshold is reached
+    void end_record();
+
+    void flush();
+
+  private:
+    std::ostream& out;
+    output_options options;
+    std::string buffer;
+    std::chrono::steady_clock::time_point last_write;
+};
+
+#endif OUTPUT_SINK_HPP
@@ -5,6 +5,7 @@
 //! \copyright Apache License 2.0
 
 #include "parser.hpp"
+#include "profile.hpp"
 #include <iostream>
 
 expected_result parser::expect_token(token_type expected)
@@ -22,6 +23,7 @@ expected_result parser::expect_token(token_type expected)
 
 unique_ptr<expression> parser::parse()
 {
+    PROFILE_SCOPE("parser::parse");
     unique_ptr<expression> program = std::make_unique<expression>(source_code_position{ 0, 0 }, expression_type::compound);
 
     bool end = false;
@@ -50,6 +52,30 @@ unique_ptr<expression> parser::parse()
                 program->expressions.push_back(std::move(decl));
             break;
         }
+        case token_type::token_identifier:
+        {
+            if (!is_type_name_token(t))
+            {
+                pop_token();
+                create_error(t.position, "Unknown type " + t.text);
+                break;
+            }
+            // variable declaration with user type
+            unique_ptr<expression> decl = parse_variable_definition(identifier_type::variable);
+            if (decl)
+                program->expressions.push_back(std::move(decl));
+            break;
+        }
+        case token_type::keyword_type:
+        {
+            unique_ptr<expression> decl = parse_type_declaration();
+            if (decl)
+                program->expressions.push_back(std::move(decl));
+            break;
+        }
+        case token_type::keyword_import:
+            parse_import(*program);
+            break;
         case token_type::comment:
         case token_type::eof:
             pop_token();
@@ -141,7 +167,13 @@ unique_ptr<expression> parser::parse_parameter_declaration()
         case token_type::type_f32:
         case token_type::type_bool:
         case token_type::type_str:
+        case token_type::token_identifier:
         {
+            if (!is_type_name_token(t) && t.type == token_type::token_identifier)
+            {
+                create_error(t.position, "Unknown type " + t.text);
+                return std::move(pd);
+            }
             // possible variable declaration
             unique_ptr<expression> decl = parse_variable_declaration(identifier_type::parameter);
             if (decl)
@@ -175,7 +207,7 @@ unique_ptr<expression> parser::parse_parameter_declaration()
     return std::move(pd);
 }
 
-unique_ptr<expression> parser::parse_function_declaration()
+unique_ptr<expression> parser::parse_function_declaration(identifier_type id_type)
 {
     unique_ptr<expression> function_tp_name = parse_function_type_name();
 
@@ -191,7 +223,7 @@ unique_ptr<expression> parser::parse_function_declaration()
     else
         return nullptr;
 
-    unique_ptr<expression> ident = parse_identifier(identifier_type::function);
+    unique_ptr<expression> ident = parse_identifier(id_type);
 
     if (!ident)
         return nullptr;
@@ -212,6 +244,186 @@ unique_ptr<expression> parser::parse_function_declaration()
     return std::move(fd);
 }
 
+unique_ptr<expression> parser::parse_type_declaration()
+{
+    token type_token = next_token(); // type
+
+    auto expectation = expect_token(token_type::token_identifier);
+
+    if (!IS_EXPECTED(expectation))
+        return nullptr;
+
+    token name_token = EXPECTED_TOKEN(expectation);
+
+    // known from here on, members and methods can use the type
+    ctx.declare_type_name(name_token.text);
+
+    unique_ptr<expression> td = std::make_unique<expression>(type_token.position, expression_type::type_declaration);
+    td->expressions.push_back(std::make_unique<identifier>(name_token.position, name_token.text, identifier_type::type));
+
+    unique_ptr<expression> base;
+    if (peek_token().type == token_type::keyword_extends)
+    {
+        pop_token();
+        token base_token = peek_token();
+        if (!is_type_name_token(base_token))
+        {
+            create_error(base_token.position, "Unknown type " + base_token.text);
+            return nullptr;
+        }
+        base = parse_identifier(identifier_type::type);
+    }
+    td->expressions.push_back(std::move(base));
+
+    expect_token(token_type::assign);
+
+    expectation = expect_token(token_type::l_brace);
+
+    if (!IS_EXPECTED(expectation))
+        return nullptr;
+
+    unique_ptr<expression> members = std::make_unique<expression>(EXPECTED_TOKEN(expectation).position, expression_type::compound);
+    bool is_public                 = false;
+    auto add_member                = [&members, &is_public](unique_ptr<expression> decl) {
+        if (!decl)
+            return;
+        static_cast<identifier&>(*decl->expressions[1]).is_public = is_public;
+        members->expressions.push_back(std::move(decl));
+    };
+
+    do
+    {
+        token t = peek_token();
+        switch (t.type)
+        {
+        case token_type::keyword_pub:
+            // visibility is recorded, but not enforced yet
+            pop_token();
+            expect_token(token_type::colon);
+            is_public = true;
+            break;
+        case token_type::keyword_static:
+            pop_token();
+            add_member(parse_function_declaration(identifier_type::static_method));
+            break;
+        case token_type::unit:
+        case token_type::l_parentheses:
+            add_member(parse_function_declaration(identifier_type::method));
+            break;
+        case token_type::type_i32:
+        case token_type::type_f32:
+        case token_type::type_bool:
+        case token_type::type_str:
+        case token_type::token_identifier:
+        {
+            if (!is_type_name_token(t) && t.type == token_type::token_identifier)
+            {
+                pop_token();
+                create_error(t.position, "Unknown type " + t.text);
+                break;
+            }
+            add_member(parse_variable_declaration(identifier_type::member));
+            expect_token(token_type::semicolon);
+            break;
+        }
+        case token_type::r_brace:
+            pop_token();
+            expect_token(token_type::semicolon);
+            td->expressions.push_back(std::move(members));
+            return std::move(td);
+        case token_type::eof:
+            create_error(t.position, "Unexpected token " + to_string(t.type));
+            return nullptr;
+        default:
+            pop_token();
+            create_error(t.position, "Unexpected token " + to_string(t.type));
+            break;
+        }
+    } while (true);
+
+    return nullptr;
+}
+
+void parser::parse_import(expression& program)
+{
+    token import_token = next_token(); // import
+
+    auto expectation = expect_token(token_type::token_identifier);
+    if (!IS_EXPECTED(expectation))
+        return;
+    token name_token = EXPECTED_TOKEN(expectation);
+    expect_token(token_type::semicolon);
+
+    expression_vector declarations;
+    if (!on_import || !on_import(name_token.text, name_token.position, declarations))
+    {
+        create_error(import_token.position, "Can not import " + name_token.text);
+        return;
+    }
+
+    // imported types start declarations like the ones of this file
+    for (auto& decl : declarations)
+    {
+        if (decl->expr_type == expression_type::type_declaration)
+            ctx.declare_type_name(decl->expressions[0]->to_string());
+        program.expressions.push_back(std::move(decl));
+    }
+}
+
+unique_ptr<expression> parser::parse_instantiation()
+{
+    unique_ptr<expression> type_ident = parse_identifier(identifier_type::type);
+
+    unique_ptr<expression> inst = std::make_unique<expression>(type_ident->source_position, expression_type::instantiation);
+    inst->expressions.push_back(std::move(type_ident));
+
+    expect_token(token_type::l_brace);
+
+    if (peek_token().type == token_type::r_brace)
+    {
+        pop_token();
+        return std::move(inst);
+    }
+
+    do
+    {
+        token t = peek_token();
+        unique_ptr<expression> argument;
+        if (t.type == token_type::token_identifier && peek_second_token().type == token_type::colon)
+        {
+            // named member initialization
+            unique_ptr<expression> member = parse_identifier(identifier_type::member);
+            pop_token(); // :
+            argument = std::make_unique<expression>(t.position, expression_type::field_init);
+            argument->expressions.push_back(std::move(member));
+            argument->expressions.push_back(parse_expression_pratt(infix_operator_precedence(token_type::comma) + 1));
+        }
+        else
+        {
+            argument = parse_expression_pratt(infix_operator_precedence(token_type::comma) + 1);
+        }
+
+        if (!argument)
+            return nullptr;
+
+        inst->expressions.push_back(std::move(argument));
+
+        token limiter = next_token();
+        switch (limiter.type)
+        {
+        case token_type::comma:
+            break;
+        case token_type::r_brace:
+            return std::move(inst);
+        default:
+            create_error(limiter.position, "Unexpected token " + to_string(limiter.type));
+            return std::move(inst);
+        }
+    } while (true);
+
+    return std::move(inst);
+}
+
 unique_ptr<expression> parser::parse_type_name()
 {
     token type_name_token = next_token();
@@ -281,6 +493,16 @@ unique_ptr<expression> parser::parse_function_type_name()
         if (!return_type_name)
             return nullptr;
         break;
+    case token_type::token_identifier:
+        if (!is_type_name_token(return_type_token))
+        {
+            create_error(return_type_token.position, "Unknown type " + return_type_token.text);
+            return nullptr;
+        }
+        return_type_name = parse_type_name();
+        if (!return_type_name)
+            return nullptr;
+        break;
     default:
         create_error(t.position, "Unexpected token " + to_string(t.type));
         break;
@@ -355,11 +577,19 @@ unique_ptr<expression> parser::parse_block()
                 block->expressions.push_back(std::move(decl));
             break;
         }
+        case token_type::token_identifier:
+        {
+            // variable declaration with user type, otherwise statement
+            bool declaration            = is_type_name_token(t) && peek_second_token().type == token_type::token_identifier;
+            unique_ptr<expression> expr = declaration ? parse_variable_definition(identifier_type::variable) : parse_statement();
+            if (expr)
+                block->expressions.push_back(std::move(expr));
+            break;
+        }
         case token_type::keyword_while:
         case token_type::keyword_if:
         case token_type::keyword_return:
         case token_type::function_dump:
-        case token_type::token_identifier:
         {
             // possible expression
             unique_ptr<expression> expr = parse_statement();
@@ -521,11 +751,18 @@ unique_ptr<expression> parser::parse_expression_pratt(int32_t min_precedence)
             unique_ptr<expression> operation = std::make_unique<expression>(t.position, operator_token_type_to_expression_type(t.type));
             if (t.type == token_type::l_parentheses)
             {
-                // function call
-                unique_ptr<expression> rhs = parse_expression_pratt(0);
-                expect_token(token_type::r_parentheses);
+                // function call, one child per argument
                 operation->expressions.push_back(std::move(lhs));
-                operation->expressions.push_back(std::move(rhs));
+                do
+                {
+                    unique_ptr<expression> argument = parse_expression_pratt(infix_operator_precedence(token_type::comma) + 1);
+                    if (argument)
+                        operation->expressions.push_back(std::move(argument));
+                    if (peek_token().type != token_type::comma)
+                        break;
+                    pop_token();
+                } while (true);
+                expect_token(token_type::r_parentheses);
             }
             else if (t.type == token_type::l_bracket)
             {
@@ -582,8 +819,11 @@ unique_ptr<expression> parser::parse_atom()
         expect_token(token_type::r_parentheses);
         return expr;
     }
-    case token_type::function_dump:
     case token_type::token_identifier:
+        if (is_type_name_token(atom_token) && peek_second_token().type == token_type::l_brace)
+            return parse_instantiation();
+        return parse_identifier();
+    case token_type::function_dump:
         return parse_identifier();
     case token_type::integer_literal:
         pop_token();
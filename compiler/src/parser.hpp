@@ -9,8 +9,10 @@
 
 #include "ast.hpp"
 #include "token.hpp"
+#include <functional>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 struct parser_error
@@ -27,32 +29,56 @@ using expected_result   = std::tuple<bool, token>;
 class parser_context
 {
   public:
-    parser_context()
-        : temp_counter(0){};
+    parser_context() = default;
 
+    // temps are named after their position, so a name does not depend on the order the parser declares them in
     inline std::unique_ptr<identifier> declare_temp(source_code_position& position)
     {
-        std::string name = "$I" + std::to_string(temp_counter++);
+        std::string name = "$I" + std::to_string(position.line) + "_" + std::to_string(position.inline_offset);
+        int32_t& count   = temps_at[name];
+        if (count++ > 0)
+            name += "_" + std::to_string(count - 1);
 
         unique_ptr<identifier> ident = std::make_unique<identifier>(position, name, identifier_type::undefined);
 
-        return std::move(ident);
+        return ident;
+    }
+
+    // user type names have to be known to tell declarations and instantiations from expressions
+    inline void declare_type_name(const std::string& name)
+    {
+        type_names.insert(name);
+    }
+
+    inline bool is_type_name(const std::string& name) const
+    {
+        return type_names.find(name) != type_names.end();
     }
 
   private:
-    int32_t temp_counter;
+    std::unordered_map<std::string, int32_t> temps_at; // temps declared at a position
+    std::unordered_set<std::string> type_names;
 };
 
+// called for "import name;", appends the declarations of the module and returns false if it can not be imported
+using import_handler = std::function<bool(const std::string& module, const source_code_position& position, expression_vector& declarations)>;
+
 class parser
 {
   public:
-    parser(const std::vector<token>& tokens)
-        : m_tokens(tokens.rbegin(), tokens.rend()){};
+    parser(const std::vector<token>& tokens, const import_handler& on_import = nullptr)
+        : m_tokens(tokens.rbegin(), tokens.rend())
+        , on_import(on_import){};
 
     ~parser() = default;
 
     unique_ptr<expression> parse();
 
+    bool has_errors() const
+    {
+        return !m_errors.empty();
+    }
+
   private:
     // do not call after eof token was popped
     void pop_token()
@@ -87,6 +113,25 @@ class parser
         pop_token();
         return t;
     };
+    // peeks the token after the next one
+    // only call until eof token occurs
+    token peek_second_token()
+    {
+        token t = next_token();
+        if (t.type == token_type::eof)
+        {
+            push_token(t);
+            return t;
+        }
+        token second = peek_token();
+        push_token(t);
+        return second;
+    };
+    // user type names start declarations like primitive type names
+    bool is_type_name_token(const token& t) const
+    {
+        return t.type == token_type::token_identifier && ctx.is_type_name(t.text);
+    }
 
     void create_error(source_code_position& position, const std::string& msg);
 
@@ -98,7 +143,10 @@ class parser
     unique_ptr<expression> parse_variable_definition(identifier_type id_type = identifier_type::undefined);
     unique_ptr<expression> parse_variable_declaration(identifier_type id_type = identifier_type::undefined);
     unique_ptr<expression> parse_parameter_declaration();
-    unique_ptr<expression> parse_function_declaration();
+    unique_ptr<expression> parse_function_declaration(identifier_type id_type = identifier_type::function);
+    unique_ptr<expression> parse_type_declaration();
+    void parse_import(expression& program);
+    unique_ptr<expression> parse_instantiation();
     unique_ptr<expression> parse_type_name();
     unique_ptr<expression> parse_primitive_type_name();
     unique_ptr<expression> parse_function_type_name();
@@ -115,6 +163,7 @@ class parser
 
     std::vector<token> m_tokens;
     parser_error_list m_errors;
+    import_handler on_import;
 };
 
 #endif PARSER_HPP
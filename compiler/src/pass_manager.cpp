@@ -0,0 +1,431 @@
+//! \file      pass_manager.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "pass_manager.hpp"
+#include "block_layout.hpp"
+#include "dead_code.hpp"
+#include "escape_analysis.hpp"
+#include "instruction_selection.hpp"
+#include "ir_cleanup.hpp"
+#include "loop_optimizer.hpp"
+#include "profile.hpp"
+#include "tail_calls.hpp"
+#include "value_numbering.hpp"
+#include "vectorizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+const dominator_tree& function_analyses::dominators(const ir_function& function)
+{
+    if (!m_dominators)
+    {
+        m_dominators = std::make_unique<dominator_tree>(function);
+        ++computed;
+    }
+    return *m_dominators;
+}
+
+const loop_analysis& function_analyses::loops(const ir_function& function)
+{
+    if (!m_loops)
+    {
+        m_loops = std::make_unique<loop_analysis>(function, dominators(function));
+        ++computed;
+    }
+    return *m_loops;
+}
+
+effect_analysis& function_analyses::effects(const ir_function& function, const function_effects& callees)
+{
+    if (!m_effects)
+    {
+        m_effects = std::make_unique<effect_analysis>(function, callees);
+        ++computed;
+    }
+    return *m_effects;
+}
+
+void function_analyses::invalidate(analysis_set preserved)
+{
+    if ((preserved & analysis_dominators) == 0)
+        preserved &= ~analysis_loops;
+
+    if ((preserved & analysis_dominators) == 0)
+        m_dominators.reset();
+    if ((preserved & analysis_loops) == 0)
+        m_loops.reset();
+    if ((preserved & analysis_effects) == 0)
+        m_effects.reset();
+}
+
+size_t ir_size_in_bytes(const ir_function& function)
+{
+    // sizes, not capacities, so the growth of a pass does not depend on when a vector reallocated
+    size_t bytes = function.blocks.size() * sizeof(ir_block);
+    for (const ir_block& block : function.blocks)
+    {
+        bytes += (block.instructions.size() + block.predecessors.size()) * sizeof(value_id);
+        for (value_id value : block.instructions)
+            bytes += sizeof(ir_instruction) + function.values[value].operands.size() * sizeof(value_id);
+    }
+    return bytes;
+}
+
+size_t ir_size_in_bytes(const ir_module& module)
+{
+    size_t bytes = 0;
+    for (const ir_function& function : module.functions)
+        bytes += ir_size_in_bytes(function);
+    return bytes;
+}
+
+pass_manager::pass_manager(ir_module& module, const class_hierarchy& hierarchy, const pass_options& options)
+    : module(module)
+    , hierarchy(hierarchy)
+    , options(options)
+{
+}
+
+std::string pass_manager::pipeline(int32_t level)
+{
+    switch (level)
+    {
+    case 0:
+        return "";
+    case 1:
+        return "devirtualize,tail-recursion,cleanup,gvn,cleanup,dce,cleanup,layout-blocks,strip";
+    case 2:
+        // folded conditions leave branches the cleanup removes, which merges blocks for the loop optimizer
+        return "devirtualize,tail-recursion,inline,cleanup,gvn,sroa,cleanup,loops,vectorize,gvn,dce,cleanup,stack-alloc,layout-blocks,strip";
+    default:
+        // a second round finds the invariants and redundancies the first one uncovered
+        return "devirtualize,tail-recursion,inline,cleanup,gvn,sroa,cleanup,loops,vectorize,gvn,dce,cleanup,gvn,sroa,cleanup,loops,gvn,dce,cleanup,stack-alloc,layout-blocks,strip";
+    }
+}
+
+bool pass_manager::find_pass(const std::string& name, pass& result)
+{
+    result      = pass();
+    result.name = name;
+
+    if (name == "devirtualize")
+    {
+        result.run_module = [this]() { return devirtualize(module, hierarchy) > 0; };
+    }
+    else if (name == "tail-recursion")
+    {
+        // recursive functions turned into loops can be inlined
+        result.run_module = [this]() {
+            size_t eliminated = 0;
+            for (function_id id = 0; id < static_cast<function_id>(module.functions.size()); ++id)
+                eliminated += eliminate_tail_recursion(module.functions[id], id);
+            return eliminated > 0;
+        };
+    }
+    else if (name == "inline")
+    {
+        // inlined bodies can reveal the classes of more receivers, which can be inlined in the next round
+        result.run_module = [this]() {
+            size_t total = 0;
+            for (size_t round = 0; round < 2; ++round)
+            {
+                inliner inline_pass(module, options.inlining);
+                size_t inlined          = inline_pass.run();
+                options.inlining.budget = inline_pass.remaining_budget();
+                total += inlined;
+                if (inlined == 0 || devirtualize(module, hierarchy) == 0)
+                    break;
+            }
+            return total > 0;
+        };
+    }
+    else if (name == "strip")
+    {
+        result.run_module = [this]() { return strip_dead_functions(module) > 0; };
+    }
+    else if (name == "cleanup")
+    {
+        result.run_function = [this](ir_function& function, function_analyses& analyses) { return cleanup_function(function, analyses.effects(function, *callees)); };
+    }
+    else if (name == "gvn")
+    {
+        result.run_function = [this](ir_function& function, function_analyses& analyses) {
+            return number_values(function, analyses.dominators(function), analyses.effects(function, *callees)) > 0;
+        };
+        result.preserved = analysis_all;
+    }
+    else if (name == "sroa")
+    {
+        result.run_function = [this](ir_function& function, function_analyses& analyses) { return replace_aggregates(function, module, analyses.dominators(function)) > 0; };
+        result.preserved    = analysis_dominators | analysis_loops;
+    }
+    else if (name == "loops")
+    {
+        result.run_function = [](ir_function& function, function_analyses& analyses) {
+            size_t preheaders = insert_preheaders(function, analyses.loops(function));
+            if (preheaders > 0)
+                analyses.invalidate(analysis_none);
+
+            loop_statistics statistics = optimize_loops(function, analyses.dominators(function), analyses.loops(function));
+            if (statistics.loops_versioned > 0)
+                analyses.invalidate(analysis_none);
+            return preheaders + statistics.hoisted + statistics.strength_reduced + statistics.checks_removed + statistics.loops_versioned > 0;
+        };
+        result.preserved = analysis_dominators | analysis_loops;
+    }
+    else if (name == "vectorize")
+    {
+        result.run_function = [this](ir_function& function, function_analyses& analyses) {
+            return options.vectorize && vectorize_loops(function, analyses.loops(function), module.vector_width) > 0;
+        };
+    }
+    else if (name == "dce")
+    {
+        result.run_function = [this](ir_function& function, function_analyses& analyses) { return remove_dead_values(function, analyses.effects(function, *callees)); };
+        result.preserved    = analysis_all;
+    }
+    else if (name == "stack-alloc")
+    {
+        result.run_function = [](ir_function& function, function_analyses& analyses) { return allocate_on_stack(function, analyses.loops(function)) > 0; };
+        result.preserved    = analysis_dominators | analysis_loops;
+    }
+    else if (name == "layout-blocks")
+    {
+        result.run_function = [](ir_function& function, function_analyses& analyses) { return layout_blocks(function, analyses.dominators(function), analyses.loops(function)) > 0; };
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool pass_manager::add_passes(const std::string& list)
+{
+    bool valid = true;
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ','))
+    {
+        if (name.empty())
+            continue;
+
+        pass p;
+        if (!find_pass(name, p))
+        {
+            std::cerr << "Unknown pass " << name << std::endl;
+            valid = false;
+            continue;
+        }
+        passes.push_back(std::move(p));
+    }
+    return valid;
+}
+
+void pass_manager::run_pass(const pass& p, pass_timing& timing)
+{
+    PROFILE_SCOPE(p.name);
+    int64_t bytes = options.time_passes ? static_cast<int64_t>(ir_size_in_bytes(module)) : 0;
+    auto start    = std::chrono::steady_clock::now();
+
+    // module passes change or renumber any function
+    if (p.run_module())
+    {
+        ++timing.changed;
+        for (const function_analyses& function : analyses)
+            analyses_computed += function.computed;
+        analyses.clear();
+        callees.reset();
+    }
+    analyses.resize(module.functions.size());
+
+    auto end             = std::chrono::steady_clock::now();
+    int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    timing.microseconds += microseconds;
+    timing.busy_microseconds += microseconds;
+    if (options.time_passes)
+        timing.ir_bytes += static_cast<int64_t>(ir_size_in_bytes(module)) - bytes;
+}
+
+void pass_manager::run_function_passes(const std::vector<const pass*>& group, const std::vector<pass_timing*>& group_timings)
+{
+    // the workers only read the summaries of the callees
+    if (!callees)
+        callees = std::make_unique<function_effects>(module);
+
+    // every worker sums its own timings, they are added up in a fixed order afterwards
+    std::vector<std::vector<pass_timing>> worker_timings(pool->workers(), std::vector<pass_timing>(group.size()));
+    auto stretch_start = std::chrono::steady_clock::now();
+    pool->run(module.functions.size(), [&](size_t i, size_t worker) {
+        ir_function& function = module.functions[i];
+        PROFILE_SCOPE(function.name);
+        for (size_t k = 0; k < group.size(); ++k)
+        {
+            PROFILE_SCOPE(group[k]->name);
+            pass_timing& timing = worker_timings[worker][k];
+            int64_t bytes       = options.time_passes ? static_cast<int64_t>(ir_size_in_bytes(function)) : 0;
+            auto start          = std::chrono::steady_clock::now();
+
+            if (group[k]->run_function(function, analyses[i]))
+            {
+                analyses[i].invalidate(group[k]->preserved);
+                ++timing.changed;
+            }
+
+            auto end = std::chrono::steady_clock::now();
+            timing.busy_microseconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            if (options.time_passes)
+                timing.ir_bytes += static_cast<int64_t>(ir_size_in_bytes(function)) - bytes;
+        }
+    });
+    auto stretch_end = std::chrono::steady_clock::now();
+
+    std::vector<pass_timing> summed(group.size());
+    int64_t busy = 0;
+    for (const std::vector<pass_timing>& timings_of_worker : worker_timings)
+    {
+        for (size_t k = 0; k < group.size(); ++k)
+        {
+            summed[k].busy_microseconds += timings_of_worker[k].busy_microseconds;
+            summed[k].ir_bytes += timings_of_worker[k].ir_bytes;
+            summed[k].changed += timings_of_worker[k].changed;
+            busy += timings_of_worker[k].busy_microseconds;
+        }
+    }
+
+    // the passes of a stretch run interleaved on every function, the wall time of the stretch is split by their busy time
+    int64_t wall     = std::chrono::duration_cast<std::chrono::microseconds>(stretch_end - stretch_start).count();
+    int64_t assigned = 0;
+    for (size_t k = 0; k < group.size(); ++k)
+    {
+        int64_t microseconds = k + 1 == group.size() ? wall - assigned : busy > 0 ? wall * summed[k].busy_microseconds / busy : wall / static_cast<int64_t>(group.size());
+        assigned += microseconds;
+        group_timings[k]->microseconds += microseconds;
+        group_timings[k]->busy_microseconds += summed[k].busy_microseconds;
+        group_timings[k]->ir_bytes += summed[k].ir_bytes;
+        group_timings[k]->changed += summed[k].changed;
+    }
+}
+
+pass_manager::pass_timing& pass_manager::timing_of(const std::string& name)
+{
+    auto it = std::find_if(timings.begin(), timings.end(), [&](const pass_timing& timing) { return timing.name == name; });
+    if (it != timings.end())
+        return *it;
+    timings.emplace_back();
+    timings.back().name = name;
+    return timings.back();
+}
+
+void pass_manager::run()
+{
+    analyses.clear();
+    analyses.resize(module.functions.size());
+    callees.reset();
+    pool = std::make_unique<thread_pool>(options.threads);
+
+    // only methods still called virtually get vtable slots
+    pass layout;
+    layout.name       = "layout-vtables";
+    layout.run_module = [this]() {
+        layout_vtables(module, hierarchy);
+        return true;
+    };
+
+    // instruction selection and register allocation turn the ir into code, no pass may change it afterwards
+    pass selection;
+    selection.name         = "select-instructions";
+    selection.run_function = [](ir_function& function, function_analyses&) { return select_instructions(function) > 0; };
+    selection.preserved    = analysis_dominators | analysis_loops;
+
+    pass cleanup;
+    cleanup.name         = "peephole";
+    cleanup.run_function = [this](ir_function& function, function_analyses& analyses) { return peephole(function, analyses.effects(function, *callees)) > 0; };
+    cleanup.preserved    = analysis_dominators | analysis_loops;
+
+    pass allocation;
+    allocation.name         = "allocate-registers";
+    allocation.run_function = [this](ir_function& function, function_analyses& analyses) {
+        register_statistics statistics = allocate_registers(function, analyses.loops(function), options.registers);
+        std::lock_guard<std::mutex> lock(statistics_mutex);
+        registers.registers = std::max(registers.registers, statistics.registers);
+        registers.spilled += statistics.spilled;
+        registers.coalesced += statistics.coalesced;
+        return true;
+    };
+    allocation.preserved = analysis_dominators | analysis_loops;
+
+    std::vector<const pass*> pipeline;
+    for (const pass& p : passes)
+        pipeline.push_back(&p);
+    for (const pass* p : { &layout, &selection, &cleanup, &allocation })
+        pipeline.push_back(p);
+    size_t user_passes = passes.size();
+
+    // at most one timing per pass is added, the timings of a group keep their addresses
+    timings.reserve(timings.size() + pipeline.size());
+
+    for (size_t first = 0; first < pipeline.size();)
+    {
+        // the code generating passes are timed apart from passes of the same name in the pipeline
+        auto timing = [&](size_t index) -> pass_timing& {
+            if (index < user_passes)
+                return timing_of(pipeline[index]->name);
+            timings.emplace_back();
+            timings.back().name = pipeline[index]->name;
+            return timings.back();
+        };
+
+        if (pipeline[first]->run_module)
+        {
+            run_pass(*pipeline[first], timing(first));
+            ++first;
+            continue;
+        }
+
+        size_t last = first;
+        while (last < pipeline.size() && !pipeline[last]->run_module)
+            ++last;
+
+        std::vector<const pass*> group(pipeline.begin() + first, pipeline.begin() + last);
+        std::vector<pass_timing*> group_timings;
+        for (size_t index = first; index < last; ++index)
+            group_timings.push_back(&timing(index));
+        run_function_passes(group, group_timings);
+        first = last;
+    }
+
+    for (const function_analyses& function : analyses)
+        analyses_computed += function.computed;
+}
+
+void pass_manager::report(std::ostream& out) const
+{
+    int64_t total = 0;
+    int64_t busy  = 0;
+    for (const pass_timing& timing : timings)
+    {
+        total += timing.microseconds;
+        busy += timing.busy_microseconds;
+    }
+
+    out << "  Pass                Wall (us)   Share  Busy (us)   ir bytes    Changed" << std::endl;
+    for (const pass_timing& timing : timings)
+    {
+        double share = total > 0 ? 100.0 * static_cast<double>(timing.microseconds) / static_cast<double>(total) : 0.0;
+        out << "  " << std::left << std::setw(18) << timing.name << std::right;
+        out << std::setw(11) << timing.microseconds;
+        out << std::setw(7) << std::fixed << std::setprecision(1) << share << "%";
+        out << std::setw(11) << timing.busy_microseconds;
+        out << std::setw(11) << std::showpos << timing.ir_bytes << std::noshowpos;
+        out << std::setw(11) << timing.changed << std::endl;
+    }
+    out << "  " << std::left << std::setw(18) << "Total" << std::right << std::setw(11) << total << std::setw(19) << busy << std::endl;
+    out << "  Analyses computed: " << analyses_computed << std::endl;
+    out << "  Registers: " << registers.registers << ", spilled values: " << registers.spilled << ", coalesced moves: " << registers.coalesced << std::endl;
+}
@@ -0,0 +1,132 @@
+//! \file      pass_manager.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef PASS_MANAGER_HPP
+#define PASS_MANAGER_HPP
+
+#include "class_hierarchy.hpp"
+#include "dominator_tree.hpp"
+#include "effect_analysis.hpp"
+#include "inliner.hpp"
+#include "ir.hpp"
+#include "loop_analysis.hpp"
+#include "register_allocator.hpp"
+#include "thread_pool.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// analyses a pass keeps valid when it changes a function
+using analysis_set = uint32_t;
+
+static constexpr analysis_set analysis_none       = 0;
+static constexpr analysis_set analysis_dominators = 1 << 0;
+static constexpr analysis_set analysis_loops      = 1 << 1; // depends on the dominators
+static constexpr analysis_set analysis_effects    = 1 << 2; // kept by passes that invalidate the values they change in place
+static constexpr analysis_set analysis_all        = analysis_dominators | analysis_loops | analysis_effects;
+
+// Analyses of one function, computed on first use and kept until a pass invalidates them.
+class function_analyses
+{
+  public:
+    function_analyses()  = default;
+    ~function_analyses() = default;
+
+    function_analyses(function_analyses&&) = default;
+    function_analyses& operator=(function_analyses&&) = default;
+
+    const dominator_tree& dominators(const ir_function& function);
+    const loop_analysis& loops(const ir_function& function);
+    effect_analysis& effects(const ir_function& function, const function_effects& callees);
+
+    // drops every analysis not in preserved and the ones depending on dropped analyses
+    void invalidate(analysis_set preserved);
+
+    size_t computed = 0; // analyses computed, not taken from the cache
+
+  private:
+    std::unique_ptr<dominator_tree> m_dominators;
+    std::unique_ptr<loop_analysis> m_loops;
+    std::unique_ptr<effect_analysis> m_effects;
+};
+
+struct pass_options
+{
+    inline_options inlining;
+    bool vectorize    = true;
+    bool time_passes  = false;
+    int32_t registers = 16; // machine registers per class of the register allocator
+    size_t threads    = 1;  // workers optimizing functions in parallel
+};
+
+// Runs a pipeline of module and function passes in order, function passes run on every function.
+// A function pass returns true if it changed the function, the analyses it does not preserve are computed again when used.
+// Function passes only change their function, so consecutive function passes run one function after the other,
+// on a pool of threads. Every function sees the same passes in the same order, the result does not depend on the threads.
+class pass_manager
+{
+  public:
+    pass_manager(ir_module& module, const class_hierarchy& hierarchy, const pass_options& options);
+    ~pass_manager() = default;
+
+    // passes of the optimization levels 0 to 3, comma separated
+    static std::string pipeline(int32_t level);
+
+    // appends a comma separated list of passes, returns false and reports unknown passes
+    bool add_passes(const std::string& list);
+
+    // runs the pipeline, then the vtable layout, instruction selection and register allocation every program needs
+    void run();
+
+    // wall time, busy time of the threads and change of the ir size of every pass, summed over all functions
+    void report(std::ostream& out) const;
+
+  private:
+    struct pass
+    {
+        std::string name;
+        std::function<bool(ir_function&, function_analyses&)> run_function; // empty for module passes
+        std::function<bool()> run_module;
+        analysis_set preserved = analysis_none;
+    };
+
+    struct pass_timing
+    {
+        std::string name;
+        int64_t microseconds      = 0; // wall time, a stretch of function passes is split by the busy time of its passes
+        int64_t busy_microseconds = 0; // time the threads spent in the pass, summed over the threads
+        int64_t ir_bytes          = 0; // growth of the ir in blocks, not of the memory allocated
+        size_t changed            = 0; // runs that changed something
+    };
+
+    bool find_pass(const std::string& name, pass& result);
+    void run_pass(const pass& p, pass_timing& timing);
+
+    // runs the function passes on every function, one function per task
+    void run_function_passes(const std::vector<const pass*>& group, const std::vector<pass_timing*>& group_timings);
+
+    pass_timing& timing_of(const std::string& name);
+
+    ir_module& module;
+    const class_hierarchy& hierarchy;
+    pass_options options;
+    std::vector<pass> passes;
+    std::vector<pass_timing> timings;
+    std::vector<function_analyses> analyses; // one per function
+    std::unique_ptr<function_effects> callees; // summaries of all functions, computed again after a module pass changed one
+    size_t analyses_computed = 0;
+    register_statistics registers;
+    std::mutex statistics_mutex; // of the registers, functions are allocated in parallel
+    std::unique_ptr<thread_pool> pool;
+};
+
+// bytes the blocks and the instructions in them take, removed instructions and unused capacity are not counted
+size_t ir_size_in_bytes(const ir_function& function);
+
+// bytes the blocks and instructions of all functions take
+size_t ir_size_in_bytes(const ir_module& module);
+
+#endif PASS_MANAGER_HPP
@@ -0,0 +1,110 @@
+//! \file      profile.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "profile.hpp"
+
+#ifdef PROFILE
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+// every thread counts its own allocations, so a scope does not count the ones of the other workers
+static thread_local size_t allocation_count = 0;
+static std::atomic<size_t> thread_count(0);
+
+// counts every allocation of the compiler, the trace shows the difference per scope
+void* operator new(size_t size)
+{
+    ++allocation_count;
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+static std::string escape_json(const std::string& text)
+{
+    std::string result;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            result.append(1, '\\');
+        result.append(1, c);
+    }
+    return result;
+}
+
+profiler& profiler::get()
+{
+    static profiler instance;
+    return instance;
+}
+
+size_t profiler::allocations()
+{
+    return allocation_count;
+}
+
+void profiler::begin_session(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    file_name     = name;
+    session_start = std::chrono::steady_clock::now();
+    events.clear();
+}
+
+void profiler::record(trace_event&& event)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(std::move(event));
+}
+
+void profiler::end_session()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream file(file_name);
+    file << "{\"otherData\": {},\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        const trace_event& event = events[i];
+        file << (i > 0 ? "," : "") << "\n{";
+        file << "\"name\":\"" << escape_json(event.name) << "\",";
+        file << "\"cat\":\"compile\",\"ph\":\"X\",\"pid\":0,";
+        file << "\"tid\":" << event.thread << ",";
+        file << "\"ts\":" << event.start << ",";
+        file << "\"dur\":" << event.duration << ",";
+        file << "\"args\":{\"allocations\":" << event.allocations << "}}";
+    }
+    file << "\n]}" << std::endl;
+    events.clear();
+}
+
+profile_scope::~profile_scope()
+{
+    // threads are numbered in the order they first record an event
+    static thread_local size_t thread = thread_count++;
+
+    trace_event event;
+    event.name        = std::move(name);
+    event.start       = start;
+    event.duration    = profiler::get().now() - start;
+    event.allocations = profiler::allocations() - allocations;
+    event.thread      = thread;
+    profiler::get().record(std::move(event));
+}
+
+#endif PROFILE
@@ -0,0 +1,93 @@
+//! \file      profile.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+// Scoped timers writing a chrome trace, open the file in chrome://tracing or ui.perfetto.dev.
+// Everything is compiled out unless PROFILE is defined, the cmake option PROFILE defines it.
+
+#ifdef PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct trace_event
+{
+    std::string name;
+    int64_t start;       // microseconds since the session began
+    int64_t duration;    // microseconds
+    size_t allocations;  // operator new calls while the scope was open
+    size_t thread;
+};
+
+class profiler
+{
+  public:
+    static profiler& get();
+
+    void begin_session(const std::string& file_name);
+
+    // writes the collected events
+    void end_session();
+
+    void record(trace_event&& event);
+
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - session_start).count();
+    }
+
+    // operator new calls of the calling thread since it started
+    static size_t allocations();
+
+  private:
+    profiler()  = default;
+    ~profiler() = default;
+
+    std::string file_name;
+    std::chrono::steady_clock::time_point session_start = std::chrono::steady_clock::now();
+    std::vector<trace_event> events;
+    std::mutex mutex;
+};
+
+class profile_scope
+{
+  public:
+    profile_scope(const std::string& name)
+        : name(name)
+        , start(profiler::get().now())
+        , allocations(profiler::allocations())
+    {
+    }
+
+    ~profile_scope();
+
+  private:
+    std::string name;
+    int64_t start;
+    size_t allocations;
+};
+
+#define PROFILE_CONCATENATE_IMPL(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_IMPL(a, b)
+
+#define PROFILE_BEGIN_SESSION(file_name) profiler::get().begin_session(file_name)
+#define PROFILE_END_SESSION() profiler::get().end_session()
+#define PROFILE_SCOPE(name) profile_scope PROFILE_CONCATENATE(profile_scope_, __LINE__)(name)
+
+#else
+
+#define PROFILE_BEGIN_SESSION(file_name)
+#define PROFILE_END_SESSION()
+#define PROFILE_SCOPE(name)
+
+#endif PROFILE
+
+#endif PROFILE_HPP
@@ -0,0 +1,471 @@
+//! \file      register_allocator.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "register_allocator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+// deeper loops do not raise the spill cost any further
+static const int32_t max_weighted_depth = 6;
+
+static bool is_vector(ir_type type)
+{
+    return type == ir_type::vi32 || type == ir_type::vf32;
+}
+
+// true if the instruction writes a register, calls of unit functions write their result as well
+static bool defines_value(const ir_instruction& instr)
+{
+    if (instr.block == -1 || instr.opcode == ir_opcode::nop)
+        return false;
+    return instr.type != ir_type::unit || instr.opcode == ir_opcode::call || instr.opcode == ir_opcode::call_method;
+}
+
+// set of values, one bit each
+class value_set
+{
+  public:
+    explicit value_set(size_t size)
+        : words((size + 63) / 64, 0)
+    {
+    }
+
+    bool contains(value_id value) const
+    {
+        return (words[value / 64] >> (value % 64)) & 1;
+    }
+
+    void insert(value_id value)
+    {
+        words[value / 64] |= uint64_t(1) << (value % 64);
+    }
+
+    void erase(value_id value)
+    {
+        words[value / 64] &= ~(uint64_t(1) << (value % 64));
+    }
+
+    // this = uses | (out & ~defs), returns true if the set changed
+    bool assign_live_in(const value_set& uses, const value_set& out, const value_set& defs)
+    {
+        bool changed = false;
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            uint64_t word = uses.words[i] | (out.words[i] & ~defs.words[i]);
+            changed       = changed || word != words[i];
+            words[i]      = word;
+        }
+        return changed;
+    }
+
+    void unite(const value_set& other)
+    {
+        for (size_t i = 0; i < words.size(); ++i)
+            words[i] |= other.words[i];
+    }
+
+    template <typename Function>
+    void for_each(Function f) const
+    {
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            for (uint64_t word = words[i]; word != 0; word &= word - 1)
+            {
+                int32_t bit = 0;
+                while (((word >> bit) & 1) == 0)
+                    ++bit;
+                f(static_cast<value_id>(i * 64 + bit));
+            }
+        }
+    }
+
+  private:
+    std::vector<uint64_t> words;
+};
+
+static size_t phi_count(const ir_function& function, block_id block)
+{
+    const std::vector<value_id>& instructions = function.blocks[block].instructions;
+    size_t count                              = 0;
+    while (count < instructions.size() && function.values[instructions[count]].opcode == ir_opcode::phi)
+        ++count;
+    return count;
+}
+
+// values live at the end of every block, phi operands are live at the end of their predecessor
+static std::vector<value_set> live_out_sets(const ir_function& function)
+{
+    size_t size = function.values.size();
+    std::vector<value_set> uses(function.blocks.size(), value_set(size));
+    std::vector<value_set> defs(function.blocks.size(), value_set(size));
+    std::vector<value_set> phi_uses(function.blocks.size(), value_set(size));
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const ir_block& b = function.blocks[block];
+        for (value_id value : b.instructions)
+        {
+            const ir_instruction& instr = function.values[value];
+            if (instr.opcode == ir_opcode::phi)
+            {
+                for (size_t i = 0; i < instr.operands.size() && i < b.predecessors.size(); ++i)
+                    phi_uses[b.predecessors[i]].insert(instr.operands[i]);
+            }
+            else
+            {
+                for (value_id operand : instr.operands)
+                {
+                    if (!defs[block].contains(operand))
+                        uses[block].insert(operand);
+                }
+            }
+            defs[block].insert(value);
+        }
+    }
+
+    std::vector<value_set> live_in(function.blocks.size(), value_set(size));
+    std::vector<value_set> live_out(function.blocks.size(), value_set(size));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (block_id block = static_cast<block_id>(function.blocks.size()) - 1; block >= 0; --block)
+        {
+            live_out[block] = phi_uses[block];
+            for (block_id succ : function.successors(block))
+                live_out[block].unite(live_in[succ]);
+            if (live_in[block].assign_live_in(uses[block], live_out[block], defs[block]))
+                changed = true;
+        }
+    }
+    return live_out;
+}
+
+// interference graph over the representatives of coalesced values
+class interference_graph
+{
+  public:
+    interference_graph(const ir_function& function)
+        : function(function)
+        , edges(function.values.size())
+        , parent(function.values.size())
+    {
+        for (value_id value = 0; value < static_cast<value_id>(parent.size()); ++value)
+            parent[value] = value;
+    }
+
+    void add_edge(value_id a, value_id b)
+    {
+        if (a == b || is_vector(function.values[a].type) != is_vector(function.values[b].type))
+            return;
+        edges[a].insert(b);
+        edges[b].insert(a);
+    }
+
+    value_id find(value_id value)
+    {
+        while (parent[value] != value)
+        {
+            parent[value] = parent[parent[value]];
+            value         = parent[value];
+        }
+        return value;
+    }
+
+    // merges the nodes of a and b unless they interfere
+    bool coalesce(value_id a, value_id b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a == b || is_vector(function.values[a].type) != is_vector(function.values[b].type) || edges[a].count(b) > 0)
+            return false;
+
+        for (value_id neighbour : edges[b])
+        {
+            edges[neighbour].erase(b);
+            edges[neighbour].insert(a);
+            edges[a].insert(neighbour);
+        }
+        edges[b].clear();
+        parent[b] = a;
+        return true;
+    }
+
+    const std::set<value_id>& neighbours(value_id node) const
+    {
+        return edges[node];
+    }
+
+  private:
+    const ir_function& function;
+    std::vector<std::set<value_id>> edges;
+    std::vector<value_id> parent;
+};
+
+static void build_interference(const ir_function& function, const std::vector<value_set>& live_out, interference_graph& graph)
+{
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const std::vector<value_id>& instructions = function.blocks[block].instructions;
+        size_t phis                               = phi_count(function, block);
+        value_set live                            = live_out[block];
+
+        // dead definitions still write their register, so they interfere as well
+        for (size_t i = instructions.size(); i-- > phis;)
+        {
+            value_id value              = instructions[i];
+            const ir_instruction& instr = function.values[value];
+            if (defines_value(instr))
+            {
+                live.erase(value);
+                // a copy and its source hold the same value
+                live.for_each([&](value_id other) {
+                    if (instr.opcode != ir_opcode::copy || instr.operands[0] != other)
+                        graph.add_edge(value, other);
+                });
+            }
+            for (value_id operand : instr.operands)
+                live.insert(operand);
+        }
+
+        // the phis of a block are written together when it is entered
+        for (size_t i = 0; i < phis; ++i)
+            live.erase(instructions[i]);
+        for (size_t i = 0; i < phis; ++i)
+        {
+            live.for_each([&](value_id other) { graph.add_edge(instructions[i], other); });
+            for (size_t j = i + 1; j < phis; ++j)
+                graph.add_edge(instructions[i], instructions[j]);
+        }
+    }
+}
+
+// colors the nodes of one register class, spilled nodes get colors from machine_registers on
+static void color_nodes(interference_graph& graph, const std::vector<value_id>& nodes, const std::vector<double>& costs, int32_t machine_registers, std::vector<int32_t>& colors)
+{
+    size_t registers = static_cast<size_t>(machine_registers);
+    std::vector<size_t> degree(colors.size(), 0);
+    std::vector<bool> removed(colors.size(), false);
+    std::vector<value_id> low;
+    for (value_id node : nodes)
+    {
+        degree[node] = graph.neighbours(node).size();
+        if (degree[node] < registers)
+            low.push_back(node);
+    }
+
+    // simplify, nodes with fewer neighbours than registers always find a color
+    std::vector<value_id> order;
+    while (order.size() < nodes.size())
+    {
+        value_id next = no_value;
+        while (!low.empty() && next == no_value)
+        {
+            if (!removed[low.back()])
+                next = low.back();
+            low.pop_back();
+        }
+
+        // the cheapest node to spill is pushed as well, it may still find a color when its neighbours share colors
+        if (next == no_value)
+        {
+            double best = 0.0;
+            for (value_id node : nodes)
+            {
+                double cost = costs[node] / static_cast<double>(std::max<size_t>(degree[node], 1));
+                if (!removed[node] && (next == no_value || cost < best))
+                {
+                    next = node;
+                    best = cost;
+                }
+            }
+        }
+
+        removed[next] = true;
+        order.push_back(next);
+        for (value_id neighbour : graph.neighbours(next))
+        {
+            if (!removed[neighbour] && degree[neighbour]-- == registers)
+                low.push_back(neighbour);
+        }
+    }
+
+    // select in reverse order
+    std::vector<value_id> spilled;
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        std::vector<bool> used(registers, false);
+        for (value_id neighbour : graph.neighbours(*it))
+        {
+            if (colors[neighbour] >= 0 && colors[neighbour] < machine_registers)
+                used[colors[neighbour]] = true;
+        }
+        auto free = std::find(used.begin(), used.end(), false);
+        if (free == used.end())
+            spilled.push_back(*it);
+        else
+            colors[*it] = static_cast<int32_t>(free - used.begin());
+    }
+
+    // spill slots are shared by spilled values that do not interfere
+    for (value_id node : spilled)
+    {
+        std::vector<bool> used;
+        for (value_id neighbour : graph.neighbours(node))
+        {
+            int32_t slot = colors[neighbour] - machine_registers;
+            if (slot < 0)
+                continue;
+            if (used.size() <= static_cast<size_t>(slot))
+                used.resize(slot + 1, false);
+            used[slot] = true;
+        }
+        colors[node] = machine_registers + static_cast<int32_t>(std::find(used.begin(), used.end(), false) - used.begin());
+    }
+}
+
+// the collector may run at allocations and calls, it finds the references of a frame in the registers of the live values
+static bool is_safepoint(const ir_instruction& instr)
+{
+    return instr.opcode == ir_opcode::new_array || instr.opcode == ir_opcode::new_object || instr.opcode == ir_opcode::call || instr.opcode == ir_opcode::call_method;
+}
+
+// operands count as live, the collector runs before the instruction reads them or writes its result
+static void build_stack_maps(ir_function& function, const std::vector<value_set>& live_out)
+{
+    function.stack_maps.assign(function.values.size(), {});
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const std::vector<value_id>& instructions = function.blocks[block].instructions;
+        size_t phis                               = phi_count(function, block);
+        value_set live                            = live_out[block];
+        for (size_t i = instructions.size(); i-- > phis;)
+        {
+            value_id value              = instructions[i];
+            const ir_instruction& instr = function.values[value];
+            live.erase(value);
+            for (value_id operand : instr.operands)
+                live.insert(operand);
+            if (!is_safepoint(instr))
+                continue;
+
+            std::vector<int32_t>& map = function.stack_maps[value];
+            live.for_each([&](value_id other) {
+                if (function.values[other].type == ir_type::ref)
+                    map.push_back(function.registers[other]);
+            });
+            std::sort(map.begin(), map.end());
+            map.erase(std::unique(map.begin(), map.end()), map.end());
+        }
+    }
+}
+
+register_statistics allocate_registers(ir_function& function, const loop_analysis& loops, int32_t machine_registers)
+{
+    register_statistics statistics;
+    interference_graph graph(function);
+    std::vector<value_set> live_out = live_out_sets(function);
+    build_interference(function, live_out, graph);
+
+    auto weight = [&](block_id block) { return std::pow(10.0, std::min(loops.depth(block), max_weighted_depth)); };
+
+    // the hottest moves are coalesced first
+    struct move
+    {
+        value_id result;
+        value_id source;
+        double weight;
+    };
+    std::vector<move> moves;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const ir_block& b = function.blocks[block];
+        for (value_id value : b.instructions)
+        {
+            const ir_instruction& instr = function.values[value];
+            if (instr.opcode == ir_opcode::phi)
+            {
+                for (size_t i = 0; i < instr.operands.size() && i < b.predecessors.size(); ++i)
+                    moves.push_back({ value, instr.operands[i], weight(b.predecessors[i]) });
+            }
+            else if (instr.opcode == ir_opcode::copy)
+            {
+                moves.push_back({ value, instr.operands[0], weight(block) });
+            }
+        }
+    }
+    std::stable_sort(moves.begin(), moves.end(), [](const move& a, const move& b) { return a.weight > b.weight; });
+    for (const move& m : moves)
+    {
+        if (graph.coalesce(m.result, m.source))
+            ++statistics.coalesced;
+    }
+
+    // spill costs of the coalesced nodes, spilled constants are loaded again instead of stored
+    std::vector<double> costs(function.values.size(), 0.0);
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        double w = weight(block);
+        for (value_id value : function.blocks[block].instructions)
+        {
+            const ir_instruction& instr = function.values[value];
+            costs[graph.find(value)] += instr.opcode == ir_opcode::constant ? w / 2.0 : w;
+            for (value_id operand : instr.operands)
+                costs[graph.find(operand)] += w;
+        }
+    }
+
+    std::vector<value_id> scalars;
+    std::vector<value_id> vectors;
+    for (value_id value = 0; value < static_cast<value_id>(function.values.size()); ++value)
+    {
+        if (!defines_value(function.values[value]) || graph.find(value) != value)
+            continue;
+        if (is_vector(function.values[value].type))
+            vectors.push_back(value);
+        else
+            scalars.push_back(value);
+    }
+
+    std::vector<int32_t> colors(function.values.size(), -1);
+    color_nodes(graph, scalars, costs, machine_registers, colors);
+    color_nodes(graph, vectors, costs, machine_registers, colors);
+
+    // every instruction gets a register, the ones that write none get the first one
+    function.registers.assign(function.values.size(), 0);
+    function.frame_size       = 1;
+    function.vector_registers = 0;
+    std::set<int32_t> used_scalars;
+    std::set<int32_t> used_vectors;
+    for (value_id value = 0; value < static_cast<value_id>(function.values.size()); ++value)
+    {
+        ir_instruction& instr = function.values[value];
+        if (!defines_value(instr))
+            continue;
+
+        int32_t color = colors[graph.find(value)];
+        if (is_vector(instr.type))
+        {
+            instr.aux                 = color;
+            function.vector_registers = std::max(function.vector_registers, color + 1);
+            used_vectors.insert(color);
+        }
+        else
+        {
+            function.registers[value] = color;
+            function.frame_size       = std::max(function.frame_size, color + 1);
+            used_scalars.insert(color);
+        }
+        if (color >= machine_registers)
+            ++statistics.spilled;
+    }
+
+    auto in_registers = [&](const std::set<int32_t>& used) { return std::count_if(used.begin(), used.end(), [&](int32_t color) { return color < machine_registers; }); };
+    statistics.registers = in_registers(used_scalars) + in_registers(used_vectors);
+
+    build_stack_maps(function, live_out);
+    return statistics;
+}
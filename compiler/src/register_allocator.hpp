@@ -0,0 +1,27 @@
+//! \file      register_allocator.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef REGISTER_ALLOCATOR_HPP
+#define REGISTER_ALLOCATOR_HPP
+
+#include "ir.hpp"
+#include "loop_analysis.hpp"
+
+struct register_statistics
+{
+    size_t registers = 0; // machine registers in use, scalar and vector
+    size_t spilled   = 0; // values living in spill slots
+    size_t coalesced = 0; // phi operands and copies sharing the register of their result
+};
+
+// Graph coloring register allocation in the style of Chaitin and Briggs, scalars and vectors are separate classes.
+// Phi operands and copies that do not interfere with their result are coalesced first, the hottest moves first.
+// Values that find no color get a spill slot after the registers, the ones with the lowest spill cost are chosen:
+// uses and definitions weighted by 10 to the loop depth, over the number of interferences, constants count half.
+// Fills the registers, frame size and stack maps of the function and renumbers the vector registers.
+register_statistics allocate_registers(ir_function& function, const loop_analysis& loops, int32_t machine_registers);
+
+#endif REGISTER_ALLOCATOR_HPP
@@ -0,0 +1,385 @@
+//! \file      runtime.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "runtime.hpp"
+#include <algorithm>
+#include <new>
+
+runtime_string::runtime_string(const std::string& text)
+    : length(text.size())
+    , hash(std::hash<std::string>()(text))
+{
+    if (length <= inline_capacity)
+    {
+        std::memcpy(small, text.data(), length);
+        return;
+    }
+    char* buffer = new char[length];
+    std::memcpy(buffer, text.data(), length);
+    shared = std::shared_ptr<const char>(buffer, std::default_delete<const char[]>());
+}
+
+runtime::runtime(const ir_module& module, std::ostream& out, const output_options& options, size_t nursery_size)
+    : module(module)
+    , out(out, options)
+    , collector(module, pool, nursery_size)
+{
+    if (options.mode == dump_mode::binary)
+        write_header();
+
+    // zeroed, arrays are allocated by the init function
+    runtime_value zero;
+    zero.ref = nullptr;
+    globals.resize(module.globals.size(), zero);
+
+    for (const std::string& text : module.strings)
+    {
+        runtime_object* str = allocate(runtime_object_kind::string, -1, 0, false, placement::old);
+        str->text           = runtime_string(text);
+        strings.push_back(str);
+    }
+}
+
+runtime::~runtime()
+{
+    release_stack(0);
+}
+
+runtime_object* runtime::allocate(runtime_object_kind kind, int32_t type, int32_t length, bool references, placement where)
+{
+    size_t size = sizeof(runtime_object) + static_cast<size_t>(length) * (references ? sizeof(runtime_value) : sizeof(int32_t));
+
+    runtime_object* object;
+    if (where == placement::stack)
+    {
+        region_arena::mark position = arena.position();
+        object                      = new (arena.allocate(size)) runtime_object();
+        object->flags               = object_on_stack;
+        stack.push_back({ object, position });
+    }
+    else
+        object = new (where == placement::old ? collector.allocate_old(size) : collector.allocate(size)) runtime_object();
+
+    object->kind   = kind;
+    object->type   = type;
+    object->length = length;
+    if (references)
+        object->elements = reinterpret_cast<runtime_value*>(object + 1);
+    else if (length > 0)
+        object->words = reinterpret_cast<int32_t*>(object + 1);
+    return object;
+}
+
+void runtime::collect_before(size_t size)
+{
+    if (!roots || !collector.needs_collection(size))
+        return;
+
+    collector.collect([&]() {
+        roots->visit_roots(collector);
+        for (size_t i = 0; i < globals.size(); ++i)
+        {
+            if (module.globals[i].type == ir_type::ref)
+                collector.visit(globals[i]);
+        }
+        for (runtime_object* str : strings)
+        {
+            runtime_value value;
+            value.ref = str;
+            collector.visit(value);
+        }
+        for (const stack_object& entry : stack)
+            collector.visit_fields(entry.object);
+    });
+}
+
+void runtime::release_stack(size_t mark)
+{
+    if (mark == stack.size())
+        return;
+
+    region_arena::mark position = stack[mark].position;
+    for (size_t i = mark; i < stack.size(); ++i)
+        stack[i].object->~runtime_object();
+    stack.resize(mark);
+    arena.release(position);
+}
+
+runtime_object* runtime::new_array(int32_t array_type, const runtime_value* fill, bool on_stack)
+{
+    // the collector runs before anything is allocated, objects under construction are never roots
+    const ir_array_type& type = module.arrays[array_type];
+    collect_before(sizeof(runtime_object) + static_cast<size_t>(type.length) * sizeof(runtime_value));
+    return build_array(array_type, fill, on_stack ? placement::stack : placement::young);
+}
+
+runtime_object* runtime::new_instance(int32_t class_id, bool on_stack)
+{
+    collect_before(sizeof(runtime_object) + module.classes[class_id].field_types.size() * sizeof(runtime_value));
+    return build_instance(class_id, on_stack ? placement::stack : placement::young);
+}
+
+runtime_object* runtime::build_array(int32_t array_type, const runtime_value* fill, placement where)
+{
+    const ir_array_type& type = module.arrays[array_type];
+    bool references           = type.element == ir_type::ref;
+    runtime_object* array     = allocate(runtime_object_kind::array, array_type, type.length, references, where);
+
+    if (!references)
+    {
+        std::fill_n(array->words, type.length, fill ? fill->i : 0);
+        return array;
+    }
+
+    runtime_value element;
+    element.ref = nullptr;
+    if (fill && type.element_array == -1)
+        element = *fill;
+    std::fill_n(array->elements, type.length, element);
+
+    if (type.element_array != -1)
+    {
+        for (int32_t i = 0; i < type.length; ++i)
+        {
+            array->elements[i].ref = build_array(type.element_array, fill, placement::young);
+            write_barrier(array, array->elements[i]);
+        }
+    }
+    else if (fill)
+        write_barrier(array, element);
+    return array;
+}
+
+runtime_object* runtime::build_instance(int32_t class_id, placement where)
+{
+    const ir_class& cls      = module.classes[class_id];
+    int32_t fields           = static_cast<int32_t>(cls.field_types.size());
+    runtime_object* instance = allocate(runtime_object_kind::instance, class_id, fields, true, where);
+
+    runtime_value zero;
+    zero.ref = nullptr;
+    std::fill_n(instance->elements, fields, zero);
+    for (size_t i = 0; i < cls.field_arrays.size(); ++i)
+    {
+        if (cls.field_arrays[i] != -1)
+        {
+            instance->elements[i].ref = build_array(cls.field_arrays[i], nullptr, placement::young);
+            write_barrier(instance, instance->elements[i]);
+        }
+    }
+    return instance;
+}
+
+void runtime::dump(int32_t format, const std::vector<ir_type>& types, const runtime_value* arguments)
+{
+    if (out.mode() == dump_mode::binary)
+    {
+        out.write_u32(static_cast<uint32_t>(format));
+        out.write_u32(static_cast<uint32_t>(types.size()));
+        for (size_t i = 0; i < types.size(); ++i)
+            encode(types[i], arguments[i]);
+        out.end_record();
+        return;
+    }
+
+    size_t next = 0;
+    if (format != -1)
+    {
+        // the type checker matches the placeholders with the arguments
+        const std::vector<std::string>& segments = module.formats[format].segments;
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            if (i > 0)
+            {
+                if (next < types.size())
+                {
+                    print(types[next], arguments[next]);
+                    ++next;
+                }
+                else
+                    out.write("{}", 2);
+            }
+            out.write(segments[i]);
+        }
+    }
+
+    // arguments without a placeholder are appended
+    for (; next < types.size(); ++next)
+    {
+        if (next > 0 || format != -1)
+            out.put(' ');
+        print(types[next], arguments[next]);
+    }
+    out.put('\n');
+    out.end_record();
+}
+
+void runtime::print(ir_type type, runtime_value value)
+{
+    switch (type)
+    {
+    case ir_type::i32:
+        out.write_i32(value.i);
+        return;
+    case ir_type::f32:
+        out.write_f32(value.f);
+        return;
+    case ir_type::boolean:
+        out.write(value.i ? "true" : "false");
+        return;
+    case ir_type::unit:
+        out.write("()");
+        return;
+    default:
+        break;
+    }
+
+    const runtime_object* object = value.ref;
+    if (!object)
+    {
+        out.write("null");
+        return;
+    }
+
+    switch (object->kind)
+    {
+    case runtime_object_kind::string:
+        out.write(object->text.data(), object->text.size());
+        break;
+    case runtime_object_kind::array:
+    {
+        const ir_array_type& array = module.arrays[object->type];
+        out.put('[');
+        for (int32_t i = 0; i < array.length; ++i)
+        {
+            runtime_value element;
+            if (array.element == ir_type::ref)
+                element = object->elements[i];
+            else
+                element.i = object->words[i];
+
+            if (i > 0)
+                out.write(", ");
+            print(array.element, element);
+        }
+        out.put(']');
+        break;
+    }
+    case runtime_object_kind::instance:
+    {
+        const ir_class& cls = module.classes[object->type];
+        out.write(cls.name);
+        out.put('{');
+        for (int32_t i = 0; i < object->length; ++i)
+        {
+            if (i > 0)
+                out.write(", ");
+            out.write(cls.field_names[i]);
+            out.write(": ");
+            print(cls.field_types[i], object->elements[i]);
+        }
+        out.put('}');
+        break;
+    }
+    }
+}
+
+void runtime::encode(ir_type type, runtime_value value)
+{
+    switch (type)
+    {
+    case ir_type::i32:
+        out.write_u8(output_sink::tag_i32);
+        out.write_u32(static_cast<uint32_t>(value.i));
+        return;
+    case ir_type::f32:
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value.f, sizeof(bits));
+        out.write_u8(output_sink::tag_f32);
+        out.write_u32(bits);
+        return;
+    }
+    case ir_type::boolean:
+        out.write_u8(output_sink::tag_boolean);
+        out.write_u8(value.i ? 1 : 0);
+        return;
+    case ir_type::unit:
+        out.write_u8(output_sink::tag_unit);
+        return;
+    default:
+        break;
+    }
+
+    const runtime_object* object = value.ref;
+    if (!object)
+    {
+        out.write_u8(output_sink::tag_null);
+        return;
+    }
+
+    switch (object->kind)
+    {
+    case runtime_object_kind::string:
+        out.write_u8(output_sink::tag_string);
+        out.write_bytes(object->text.data(), object->text.size());
+        break;
+    case runtime_object_kind::array:
+    {
+        const ir_array_type& array = module.arrays[object->type];
+        out.write_u8(output_sink::tag_array);
+        out.write_u32(static_cast<uint32_t>(array.length));
+        for (int32_t i = 0; i < array.length; ++i)
+        {
+            runtime_value element;
+            if (array.element == ir_type::ref)
+                element = object->elements[i];
+            else
+                element.i = object->words[i];
+            encode(array.element, element);
+        }
+        break;
+    }
+    case runtime_object_kind::instance:
+    {
+        const ir_class& cls = module.classes[object->type];
+        out.write_u8(output_sink::tag_instance);
+        out.write_u32(static_cast<uint32_t>(object->type));
+        for (int32_t i = 0; i < object->length; ++i)
+            encode(cls.field_types[i], object->elements[i]);
+        break;
+    }
+    }
+}
+
+void runtime::write_header()
+{
+    out.write("PPLD", 4);
+    out.write_u32(1);
+
+    out.write_u32(static_cast<uint32_t>(module.formats.size()));
+    for (const ir_format& format : module.formats)
+    {
+        out.write_u32(static_cast<uint32_t>(format.segments.size()));
+        for (const std::string& segment : format.segments)
+            out.write_bytes(segment.data(), segment.size());
+    }
+
+    out.write_u32(static_cast<uint32_t>(module.classes.size()));
+    for (const ir_class& cls : module.classes)
+    {
+        out.write_bytes(cls.name.data(), cls.name.size());
+        out.write_u32(static_cast<uint32_t>(cls.field_names.size()));
+        for (const std::string& field : cls.field_names)
+            out.write_bytes(field.data(), field.size());
+    }
+}
+
+void runtime::trap(const std::string& message, source_code_position position)
+{
+    out.flush();
+    throw runtime_error{ position, message };
+}
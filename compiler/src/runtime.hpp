@@ -0,0 +1,227 @@
+//! \file      runtime.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef RUNTIME_HPP
+#define RUNTIME_HPP
+
+#include "garbage_collector.hpp"
+#include "ir.hpp"
+#include "memory_pool.hpp"
+#include "output_sink.hpp"
+#include <cstring>
+#include <memory>
+
+struct runtime_object;
+
+// booleans are stored as 0 and 1 in i
+union runtime_value
+{
+    int32_t i;
+    float f;
+    runtime_object* ref;
+};
+
+// Immutable text of str values. Short strings are stored inline, longer ones share one buffer between copies,
+// so copying never allocates. The hash makes most unequal strings compare in constant time.
+class runtime_string
+{
+  public:
+    runtime_string() = default;
+    explicit runtime_string(const std::string& text);
+    ~runtime_string() = default;
+
+    const char* data() const
+    {
+        return length <= inline_capacity ? small : shared.get();
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    bool operator==(const runtime_string& other) const
+    {
+        return length == other.length && hash == other.hash && std::memcmp(data(), other.data(), length) == 0;
+    }
+
+  private:
+    static constexpr size_t inline_capacity = 22;
+
+    size_t length = 0;
+    size_t hash   = 0;
+    char small[inline_capacity + 1] = {};
+    std::shared_ptr<const char> shared; // longer strings
+};
+
+#define RUNTIME_OBJECT_KIND_ENUMERATION(op) op(string) op(array) op(instance)
+
+#define op(x) x,
+enum class runtime_object_kind
+{
+    RUNTIME_OBJECT_KIND_ENUMERATION(op)
+};
+#undef op
+
+// the fields or elements are stored right after the object, in the same block
+struct runtime_object
+{
+    runtime_object_kind kind;
+    int32_t type   = -1;               // array type or class
+    int32_t length = 0;                // fields or elements
+    uint32_t flags = 0;                // of the collector
+    runtime_string text;               // strings
+    runtime_value* elements = nullptr; // fields or elements of arrays of references
+    int32_t* words          = nullptr; // elements of i32, f32 and boolean arrays, packed for vector loads
+    runtime_object* forward = nullptr; // copy in the old generation of a promoted nursery object
+};
+
+// the references of a running program outside the heap, in its frames
+class root_set
+{
+  public:
+    virtual ~root_set() = default;
+
+    // calls visit of the collector for every frame slot that holds a reference
+    virtual void visit_roots(garbage_collector& collector) = 0;
+};
+
+struct runtime_error
+{
+    source_code_position position;
+    std::string message;
+};
+
+// Heap, globals and builtins of a running program.
+class runtime
+{
+  public:
+    static constexpr size_t default_nursery_size = 256 * 1024;
+
+    runtime(const ir_module& module, std::ostream& out, const output_options& options = {}, size_t nursery_size = default_nursery_size);
+    ~runtime();
+
+    runtime(const runtime&)            = delete;
+    runtime& operator=(const runtime&) = delete;
+
+    runtime_value& global(int32_t global)
+    {
+        return globals[global];
+    }
+
+    // the frames the collector finds the references of the program in, there is no collection without them
+    void set_roots(root_set* frames)
+    {
+        roots = frames;
+    }
+
+    // string constants are allocated once
+    runtime_object* string(int32_t id)
+    {
+        return strings[id];
+    }
+
+    // nested arrays are allocated with the outer one, fill initializes the innermost elements
+    // only the outer array of a stack allocation is on the stack
+    // the collector may run before the allocation, the roots must hold every live reference
+    runtime_object* new_array(int32_t array_type, const runtime_value* fill, bool on_stack = false);
+
+    // fields are zeroed, array fields allocated
+    runtime_object* new_instance(int32_t class_id, bool on_stack = false);
+
+    // every store of a reference into an object goes through the barrier
+    void write_barrier(runtime_object* object, runtime_value value)
+    {
+        if (value.ref && collector.in_nursery(value.ref) && !collector.in_nursery(object) && (object->flags & (object_on_stack | object_remembered)) == 0)
+            collector.remember(object);
+    }
+
+    // stack allocations are freed together when the frame that made them returns
+    size_t stack_mark() const
+    {
+        return stack.size();
+    }
+
+    void release_stack(size_t mark);
+
+    // prints the arguments into the placeholders of the format, or one after another without a format
+    void dump(int32_t format, const std::vector<ir_type>& types, const runtime_value* arguments);
+
+    // writes the buffered dumps
+    void flush_output()
+    {
+        out.flush();
+    }
+
+    // stops the program
+    [[noreturn]] void trap(const std::string& message, source_code_position position);
+
+    // profile counters of instrumented programs, zeroed
+    void enable_counters(size_t count)
+    {
+        counters.assign(count, 0);
+    }
+
+    void count(int32_t counter)
+    {
+        ++counters[counter];
+    }
+
+    const std::vector<int64_t>& counter_values() const
+    {
+        return counters;
+    }
+
+    const memory_statistics& heap_statistics() const
+    {
+        return pool.statistics();
+    }
+
+    const memory_statistics& stack_statistics() const
+    {
+        return arena.statistics();
+    }
+
+    const collector_statistics& collection_statistics() const
+    {
+        return collector.statistics();
+    }
+
+  private:
+    struct stack_object
+    {
+        runtime_object* object;
+        region_arena::mark position; // of the arena before the object
+    };
+
+    enum class placement
+    {
+        young, // nursery, or old when it is full
+        old,
+        stack,
+    };
+
+    runtime_object* allocate(runtime_object_kind kind, int32_t type, int32_t length, bool references, placement where);
+    runtime_object* build_array(int32_t array_type, const runtime_value* fill, placement where);
+    runtime_object* build_instance(int32_t class_id, placement where);
+    void collect_before(size_t size);
+    void print(ir_type type, runtime_value value);
+    void encode(ir_type type, runtime_value value);
+    void write_header();
+
+    const ir_module& module;
+    output_sink out;
+    pool_allocator pool;
+    region_arena arena;              // objects of the calls, released when a call returns
+    garbage_collector collector;     // owns the heap objects
+    root_set* roots = nullptr;
+    std::vector<stack_object> stack; // objects that do not escape their frame
+    std::vector<runtime_value> globals;
+    std::vector<runtime_object*> strings;
+    std::vector<int64_t> counters;
+};
+
+#endif RUNTIME_HPP
@@ -0,0 +1,172 @@
+//! \file      simd.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "simd.hpp"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PPL_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PPL_SSE2
+#endif
+
+static float to_float(int32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int32_t to_bits(float value)
+{
+    int32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static int32_t scalar_binary(ir_opcode opcode, ir_type type, int32_t a, int32_t b)
+{
+    if (type == ir_type::vf32)
+    {
+        switch (opcode)
+        {
+        case ir_opcode::add:
+            return to_bits(to_float(a) + to_float(b));
+        case ir_opcode::sub:
+            return to_bits(to_float(a) - to_float(b));
+        case ir_opcode::mul:
+            return to_bits(to_float(a) * to_float(b));
+        default:
+            return to_bits(to_float(a) / to_float(b));
+        }
+    }
+
+    // i32 arithmetic wraps around
+    uint32_t x = static_cast<uint32_t>(a);
+    uint32_t y = static_cast<uint32_t>(b);
+    switch (opcode)
+    {
+    case ir_opcode::add:
+        return static_cast<int32_t>(x + y);
+    case ir_opcode::sub:
+        return static_cast<int32_t>(x - y);
+    default:
+        return static_cast<int32_t>(x * y);
+    }
+}
+
+#if defined(PPL_SSE2)
+static __m128i multiply_i32(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+    return _mm_mullo_epi32(a, b);
+#else
+    // sse2 only multiplies the even lanes into 64 bits
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+#endif
+
+void simd_binary(ir_opcode opcode, ir_type type, int32_t width, const int32_t* a, const int32_t* b, int32_t* result)
+{
+    bool is_float = type == ir_type::vf32;
+    int32_t lane  = 0;
+
+#if defined(PPL_AVX2)
+    for (; lane + 8 <= width; lane += 8)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lane));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + lane));
+        __m256 fx = _mm256_castsi256_ps(x);
+        __m256 fy = _mm256_castsi256_ps(y);
+        __m256i r;
+        switch (opcode)
+        {
+        case ir_opcode::add:
+            r = is_float ? _mm256_castps_si256(_mm256_add_ps(fx, fy)) : _mm256_add_epi32(x, y);
+            break;
+        case ir_opcode::sub:
+            r = is_float ? _mm256_castps_si256(_mm256_sub_ps(fx, fy)) : _mm256_sub_epi32(x, y);
+            break;
+        case ir_opcode::mul:
+            r = is_float ? _mm256_castps_si256(_mm256_mul_ps(fx, fy)) : _mm256_mullo_epi32(x, y);
+            break;
+        default:
+            r = _mm256_castps_si256(_mm256_div_ps(fx, fy));
+            break;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + lane), r);
+    }
+#endif
+
+#if defined(PPL_SSE2)
+    for (; lane + 4 <= width; lane += 4)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lane));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + lane));
+        __m128 fx = _mm_castsi128_ps(x);
+        __m128 fy = _mm_castsi128_ps(y);
+        __m128i r;
+        switch (opcode)
+        {
+        case ir_opcode::add:
+            r = is_float ? _mm_castps_si128(_mm_add_ps(fx, fy)) : _mm_add_epi32(x, y);
+            break;
+        case ir_opcode::sub:
+            r = is_float ? _mm_castps_si128(_mm_sub_ps(fx, fy)) : _mm_sub_epi32(x, y);
+            break;
+        case ir_opcode::mul:
+            r = is_float ? _mm_castps_si128(_mm_mul_ps(fx, fy)) : multiply_i32(x, y);
+            break;
+        default:
+            r = _mm_castps_si128(_mm_div_ps(fx, fy));
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + lane), r);
+    }
+#endif
+
+    for (; lane < width; ++lane)
+        result[lane] = scalar_binary(opcode, type, a[lane], b[lane]);
+}
+
+void simd_unary(ir_opcode opcode, ir_type type, int32_t width, const int32_t* a, int32_t* result)
+{
+    int32_t lane = 0;
+
+#if defined(PPL_SSE2)
+    // -x flips the sign bit of floats, -0.0 stays distinct from 0.0
+    __m128i sign = type == ir_type::vf32 ? _mm_set1_epi32(static_cast<int32_t>(0x80000000u)) : _mm_setzero_si128();
+    for (; lane + 4 <= width; lane += 4)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lane));
+        __m128i r;
+        if (opcode == ir_opcode::convert)
+            r = _mm_castps_si128(_mm_cvtepi32_ps(x));
+        else if (type == ir_type::vf32)
+            r = _mm_xor_si128(x, sign);
+        else
+            r = _mm_sub_epi32(_mm_setzero_si128(), x);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + lane), r);
+    }
+#endif
+
+    for (; lane < width; ++lane)
+    {
+        if (opcode == ir_opcode::convert)
+            result[lane] = to_bits(static_cast<float>(a[lane]));
+        else if (type == ir_type::vf32)
+            result[lane] = to_bits(-to_float(a[lane]));
+        else
+            result[lane] = static_cast<int32_t>(0u - static_cast<uint32_t>(a[lane]));
+    }
+}
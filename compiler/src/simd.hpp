@@ -0,0 +1,21 @@
+//! \file      simd.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include "ir.hpp"
+
+// Lane wise operations on vectors of width i32 or f32 lanes, f32 lanes are stored as their bits.
+// Uses avx2 or sse2 when the compiler targets them and scalar code for the lanes left over.
+
+// add, sub, mul and div (only f32)
+void simd_binary(ir_opcode opcode, ir_type type, int32_t width, const int32_t* a, const int32_t* b, int32_t* result);
+
+// neg and convert from i32 to f32
+void simd_unary(ir_opcode opcode, ir_type type, int32_t width, const int32_t* a, int32_t* result);
+
+#endif SIMD_HPP
@@ -0,0 +1,225 @@
+//! \file      symbol_table.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include "ast.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using name_id   = int32_t;
+using symbol_id = int32_t;
+using scope_id  = int32_t;
+
+static constexpr int32_t invalid_id = -1;
+
+struct semantic_error
+{
+    source_code_position position;
+    std::string message;
+};
+using semantic_error_list = std::vector<semantic_error>;
+
+#define SYMBOL_KIND_ENUMERATION(op)                                                         \
+    op(builtin) op(global_variable) op(function) op(parameter) op(local_variable) /* code */ \
+        op(user_type) op(member) op(method) op(static_method)                     /* types */
+
+#define op(x) x,
+enum class symbol_kind
+{
+    SYMBOL_KIND_ENUMERATION(op)
+};
+#undef op
+
+#define op(x)            \
+    case symbol_kind::x: \
+        return #x;
+static std::string to_string(symbol_kind kind)
+{
+    switch (kind)
+    {
+        SYMBOL_KIND_ENUMERATION(op)
+    default:
+        return "unknown";
+    }
+};
+#undef op
+
+#define SCOPE_KIND_ENUMERATION(op) op(global) op(type) op(function) op(block)
+
+#define op(x) x,
+enum class scope_kind
+{
+    SCOPE_KIND_ENUMERATION(op)
+};
+#undef op
+
+// Interns strings, equal names share one id, so names can be compared as integers.
+class string_interner
+{
+  public:
+    name_id intern(const std::string& str)
+    {
+        auto it = ids.find(str);
+        if (it != ids.end())
+            return it->second;
+
+        name_id id = static_cast<name_id>(names.size());
+        names.push_back(str);
+        ids.emplace(str, id);
+        return id;
+    }
+
+    // returns invalid_id if the string was never interned
+    name_id find(const std::string& str) const
+    {
+        auto it = ids.find(str);
+        return it != ids.end() ? it->second : invalid_id;
+    }
+
+    const std::string& name(name_id id) const
+    {
+        return names[id];
+    }
+
+  private:
+    std::unordered_map<std::string, name_id> ids;
+    std::vector<std::string> names;
+};
+
+struct symbol
+{
+    name_id name;
+    symbol_kind kind;
+    scope_id scope;          // scope the symbol is declared in
+    expression* declaration; // declaring ast node, nullptr for builtins
+    source_code_position position;
+    symbol_id next_overload = invalid_id; // functions and methods with the same name in the same scope
+    symbol_id owner         = invalid_id; // user type for members and methods
+    scope_id member_scope   = invalid_id; // scope with the members for user types
+    symbol_id base          = invalid_id; // base type for user types
+    int32_t type            = invalid_id; // set by the type_checker
+};
+
+struct scope
+{
+    scope_kind kind;
+    scope_id parent;
+    symbol_id owner; // function or user type owning the scope
+    std::unordered_map<name_id, symbol_id> symbols;
+};
+
+class symbol_table
+{
+  public:
+    symbol_table()
+    {
+        global = create_scope(scope_kind::global, invalid_id, invalid_id);
+    }
+    ~symbol_table() = default;
+
+    scope_id create_scope(scope_kind kind, scope_id parent, symbol_id owner)
+    {
+        scope_id id = static_cast<scope_id>(scopes.size());
+        scopes.push_back(scope{ kind, parent, owner, {} });
+        return id;
+    }
+
+    // declares a new symbol in the given scope
+    // functions and methods are chained as overloads, returns invalid_id on any other redeclaration
+    symbol_id declare(scope_id in_scope, const std::string& name, symbol_kind kind, expression* declaration, const source_code_position& position)
+    {
+        name_id nid  = names.intern(name);
+        symbol_id id = static_cast<symbol_id>(symbols.size());
+
+        auto& table = scopes[in_scope].symbols;
+        auto it     = table.find(nid);
+        if (it != table.end())
+        {
+            if (!is_overloadable(kind) || !is_overloadable(symbols[it->second].kind))
+                return invalid_id;
+
+            symbol_id last = it->second;
+            while (symbols[last].next_overload != invalid_id)
+                last = symbols[last].next_overload;
+            symbols[last].next_overload = id;
+        }
+        else
+        {
+            table.emplace(nid, id);
+        }
+
+        symbols.push_back(symbol{ nid, kind, in_scope, declaration, position });
+        return id;
+    }
+
+    // searches the scope and its parents, returns the first overload for functions
+    symbol_id lookup(scope_id in_scope, name_id name) const
+    {
+        while (in_scope != invalid_id)
+        {
+            symbol_id id = lookup_local(in_scope, name);
+            if (id != invalid_id)
+                return id;
+            in_scope = scopes[in_scope].parent;
+        }
+        return invalid_id;
+    }
+
+    symbol_id lookup_local(scope_id in_scope, name_id name) const
+    {
+        const auto& table = scopes[in_scope].symbols;
+        auto it           = table.find(name);
+        return it != table.end() ? it->second : invalid_id;
+    }
+
+    symbol_id lookup(scope_id in_scope, const std::string& name) const
+    {
+        name_id nid = names.find(name);
+        return nid == invalid_id ? invalid_id : lookup(in_scope, nid);
+    }
+
+    symbol& get(symbol_id id)
+    {
+        return symbols[id];
+    }
+
+    const symbol& get(symbol_id id) const
+    {
+        return symbols[id];
+    }
+
+    scope& get_scope(scope_id id)
+    {
+        return scopes[id];
+    }
+
+    const std::string& name(symbol_id id) const
+    {
+        return names.name(symbols[id].name);
+    }
+
+    size_t symbol_count() const
+    {
+        return symbols.size();
+    }
+
+    static bool is_overloadable(symbol_kind kind)
+    {
+        return kind == symbol_kind::function || kind == symbol_kind::method || kind == symbol_kind::static_method;
+    }
+
+    scope_id global;
+    string_interner names;
+
+  private:
+    std::vector<symbol> symbols;
+    std::vector<scope> scopes;
+};
+
+#endif SYMBOL_TABLE_HPP
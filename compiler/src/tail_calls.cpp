@@ -0,0 +1,249 @@
+//! \file      tail_calls.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "tail_calls.hpp"
+#include <algorithm>
+
+// a recursive call at the end of block, returned directly or combined with another value first
+struct tail_site
+{
+    block_id block;
+    value_id call;
+    value_id combine = no_value;
+};
+
+static bool is_self_call(const ir_instruction& instr, function_id self)
+{
+    return instr.opcode == ir_opcode::call && instr.immediate == self;
+}
+
+// value is the result of function if ret returns it
+static bool returns(const ir_function& function, const ir_instruction& ret, value_id value)
+{
+    if (ret.opcode != ir_opcode::ret)
+        return false;
+    return ret.operands.empty() ? function.result == ir_type::unit : ret.operands[0] == value;
+}
+
+bool is_tail_call(const ir_function& function, value_id call)
+{
+    block_id block                            = function.values[call].block;
+    const std::vector<value_id>& instructions = function.blocks[block].instructions;
+    if (instructions.size() < 2 || instructions[instructions.size() - 2] != call)
+        return false;
+
+    const ir_instruction& terminator = function.values[instructions.back()];
+    if (terminator.opcode != ir_opcode::jump)
+        return returns(function, terminator, call);
+
+    // the return of an if statement is in the block after it, profile counters there are skipped by the tail call
+    const ir_block& target = function.blocks[terminator.targets[0]];
+    value_id rest[2]       = { no_value, no_value };
+    size_t count           = 0;
+    for (value_id value : target.instructions)
+    {
+        if (function.values[value].opcode == ir_opcode::count)
+            continue;
+        if (count == 2)
+            return false;
+        rest[count++] = value;
+    }
+    if (count == 1)
+        return returns(function, function.values[rest[0]], call);
+    if (count != 2)
+        return false;
+
+    const ir_instruction& phi = function.values[rest[0]];
+    size_t predecessor        = std::find(target.predecessors.begin(), target.predecessors.end(), block) - target.predecessors.begin();
+    return phi.opcode == ir_opcode::phi && phi.operands[predecessor] == call && returns(function, function.values[rest[1]], rest[0]);
+}
+
+static value_id add_instruction(ir_function& function, ir_opcode opcode, ir_type type, std::vector<value_id> operands, block_id block, source_code_position position)
+{
+    ir_instruction instr;
+    instr.opcode   = opcode;
+    instr.type     = type;
+    instr.operands = std::move(operands);
+    instr.block    = block;
+    instr.position = position;
+    return function.add_value(std::move(instr));
+}
+
+size_t eliminate_tail_recursion(ir_function& function, function_id self)
+{
+    // the entry has to stay free of predecessors to keep the parameters out of the loop
+    if (!function.blocks[0].predecessors.empty())
+        return 0;
+
+    std::vector<tail_site> sites;
+    ir_opcode accumulate = ir_opcode::nop;
+    for (block_id block = 0; block < static_cast<block_id>(function.blocks.size()); ++block)
+    {
+        const std::vector<value_id>& instructions = function.blocks[block].instructions;
+        size_t count                              = instructions.size();
+        if (count < 2)
+            continue;
+
+        value_id last = instructions[count - 2];
+        if (is_self_call(function.values[last], self) && is_tail_call(function, last))
+        {
+            tail_site site;
+            site.block = block;
+            site.call  = last;
+            sites.push_back(site);
+            continue;
+        }
+
+        // the wrapping i32 add and mul can be reassociated, f32 ones can not
+        const ir_instruction& ret     = function.values[instructions[count - 1]];
+        const ir_instruction& combine = function.values[last];
+        if (count < 3 || ret.opcode != ir_opcode::ret || ret.operands != std::vector<value_id>{ last } || combine.type != ir_type::i32 || (combine.opcode != ir_opcode::add && combine.opcode != ir_opcode::mul))
+            continue;
+        if (accumulate != ir_opcode::nop && accumulate != combine.opcode)
+            continue;
+
+        // the call is an operand of the combine, constants and other pure values may be computed between them
+        value_id call = no_value;
+        for (value_id operand : combine.operands)
+        {
+            if (is_self_call(function.values[operand], self) && function.values[operand].block == block)
+                call = operand;
+        }
+        if (call == no_value || combine.operands[0] == combine.operands[1])
+            continue;
+
+        size_t at    = std::find(instructions.begin(), instructions.end(), call) - instructions.begin();
+        bool between = std::all_of(instructions.begin() + at + 1, instructions.end() - 2, [&](value_id value) {
+            const ir_instruction& instr = function.values[value];
+            return instruction_effects(instr) == effect_none && std::find(instr.operands.begin(), instr.operands.end(), call) == instr.operands.end();
+        });
+        if (!between)
+            continue;
+
+        tail_site site;
+        site.block   = block;
+        site.call    = call;
+        site.combine = last;
+        sites.push_back(site);
+        accumulate = combine.opcode;
+    }
+
+    if (sites.empty())
+        return 0;
+
+    // the entry keeps parameters and constants, everything else moves to the new loop header
+    block_id header = function.add_block();
+    std::vector<value_id> entry;
+    for (value_id value : function.blocks[0].instructions)
+    {
+        ir_instruction& instr = function.values[value];
+        if (instr.opcode == ir_opcode::param || instr.opcode == ir_opcode::constant)
+        {
+            entry.push_back(value);
+            continue;
+        }
+        instr.block = header;
+        function.blocks[header].instructions.push_back(value);
+    }
+    for (block_id successor : function.successors(header))
+        std::replace(function.blocks[successor].predecessors.begin(), function.blocks[successor].predecessors.end(), 0, header);
+
+    source_code_position position = function.values[function.blocks[header].instructions.back()].position;
+
+    // every parameter becomes a phi of the argument it got from the entry or the recursive calls
+    std::vector<value_id> phis;
+    std::vector<value_id> parameter_phis(function.parameters.size(), no_value);
+    for (value_id value : entry)
+    {
+        if (function.values[value].opcode != ir_opcode::param)
+            continue;
+        value_id phi = add_instruction(function, ir_opcode::phi, function.values[value].type, {}, header, position);
+        function.replace_all_uses(value, phi);
+        function.values[phi].operands.push_back(value);
+        parameter_phis[function.values[value].immediate] = phi;
+        phis.push_back(phi);
+    }
+
+    value_id accumulator = no_value;
+    if (accumulate != ir_opcode::nop)
+    {
+        value_id identity                   = add_instruction(function, ir_opcode::constant, ir_type::i32, {}, 0, position);
+        function.values[identity].immediate = accumulate == ir_opcode::add ? 0 : 1;
+        entry.push_back(identity);
+        accumulator = add_instruction(function, ir_opcode::phi, ir_type::i32, { identity }, header, position);
+        phis.push_back(accumulator);
+    }
+
+    function.blocks[header].instructions.insert(function.blocks[header].instructions.begin(), phis.begin(), phis.end());
+    function.blocks[header].predecessors = { 0 };
+
+    ir_instruction jump;
+    jump.opcode     = ir_opcode::jump;
+    jump.block      = 0;
+    jump.targets[0] = header;
+    jump.position   = position;
+    entry.push_back(function.add_value(std::move(jump)));
+    function.blocks[0].instructions = std::move(entry);
+
+    // the recursive calls pass their arguments to the phis instead
+    for (const tail_site& site : sites)
+    {
+        block_id block                     = site.block == 0 ? header : site.block;
+        std::vector<value_id> arguments    = function.values[site.call].operands;
+        source_code_position call_position = function.values[site.call].position;
+        value_id other                     = no_value;
+        if (site.combine != no_value)
+        {
+            const std::vector<value_id>& operands = function.values[site.combine].operands;
+            other                                 = operands[0] == site.call ? operands[1] : operands[0];
+        }
+        value_id terminator = function.blocks[block].instructions.back();
+        if (function.values[terminator].opcode == ir_opcode::jump)
+            function.remove_edge(block, function.values[terminator].targets[0]);
+        function.remove(terminator);
+        if (site.combine != no_value)
+            function.remove(site.combine);
+        function.remove(site.call);
+
+        value_id collected = accumulator;
+        if (site.combine != no_value)
+        {
+            collected = add_instruction(function, accumulate, ir_type::i32, { accumulator, other }, block, call_position);
+            function.blocks[block].instructions.push_back(collected);
+        }
+
+        value_id back = add_instruction(function, ir_opcode::jump, ir_type::unit, {}, block, call_position);
+        function.values[back].targets[0] = header;
+        function.blocks[block].instructions.push_back(back);
+        function.blocks[header].predecessors.push_back(block);
+
+        for (size_t i = 0; i < parameter_phis.size(); ++i)
+        {
+            if (parameter_phis[i] != no_value)
+                function.values[parameter_phis[i]].operands.push_back(arguments[i]);
+        }
+        if (accumulator != no_value)
+            function.values[accumulator].operands.push_back(collected);
+    }
+
+    // the remaining returns apply what the skipped calls would have applied on their way back
+    if (accumulator != no_value)
+    {
+        for (ir_block& block : function.blocks)
+        {
+            if (block.instructions.empty())
+                continue;
+            ir_instruction& ret = function.values[block.instructions.back()];
+            if (ret.opcode != ir_opcode::ret || ret.operands.empty())
+                continue;
+
+            value_id result = add_instruction(function, accumulate, ir_type::i32, { accumulator, ret.operands[0] }, ret.block, ret.position);
+            function.values[block.instructions.back()].operands[0] = result;
+            block.instructions.insert(block.instructions.end() - 1, result);
+        }
+    }
+    return sites.size();
+}
@@ -0,0 +1,21 @@
+//! \file      tail_calls.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef TAIL_CALLS_HPP
+#define TAIL_CALLS_HPP
+
+#include "ir.hpp"
+
+// Turns calls of the function itself whose result is returned directly into jumps back to its start.
+// A result only added to or multiplied with another i32 before it is returned is collected in an accumulator,
+// so return n * fact(n - 1) becomes a loop too.
+// Returns the number of removed calls.
+size_t eliminate_tail_recursion(ir_function& function, function_id self);
+
+// true if the result of call is returned right after it, either in its block or in the one it jumps to
+bool is_tail_call(const ir_function& function, value_id call);
+
+#endif TAIL_CALLS_HPP
@@ -0,0 +1,120 @@
+//! \file      thread_pool.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "thread_pool.hpp"
+#include <algorithm>
+
+thread_pool::thread_pool(size_t workers)
+{
+    workers = std::max<size_t>(workers, 1);
+    for (size_t worker = 0; worker < workers; ++worker)
+        queues.emplace_back(new task_queue());
+    for (size_t worker = 1; worker < workers; ++worker)
+        threads.emplace_back([this, worker]() { worker_loop(worker); });
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void thread_pool::run(size_t count, const task_function& task)
+{
+    if (threads.empty() || count < 2)
+    {
+        for (size_t index = 0; index < count; ++index)
+            task(index, 0);
+        return;
+    }
+
+    {
+        // neighbouring indices go to the same worker
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t worker = 0; worker < queues.size(); ++worker)
+        {
+            std::lock_guard<std::mutex> queue_lock(queues[worker]->mutex);
+            for (size_t index = worker * count / queues.size(); index < (worker + 1) * count / queues.size(); ++index)
+                queues[worker]->indices.push_back(index);
+        }
+        current  = &task;
+        finished = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    work(0, task);
+
+    // every worker leaves the run before the task goes out of scope
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return finished == threads.size(); });
+    current = nullptr;
+}
+
+bool thread_pool::take(size_t worker, size_t& index)
+{
+    {
+        task_queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.indices.empty())
+        {
+            index = own.indices.back();
+            own.indices.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        task_queue& victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.indices.empty())
+        {
+            index = victim.indices.front();
+            victim.indices.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void thread_pool::work(size_t worker, const task_function& task)
+{
+    // no task adds tasks, so empty queues stay empty until the next run
+    size_t index;
+    while (take(worker, index))
+        task(index, worker);
+}
+
+void thread_pool::worker_loop(size_t worker)
+{
+    size_t seen = 0;
+    for (;;)
+    {
+        const task_function* task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            task = current;
+        }
+
+        work(worker, *task);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++finished;
+        }
+        done.notify_all();
+    }
+}
@@ -0,0 +1,63 @@
+//! \file      thread_pool.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing pool for independent tasks, like the optimization of the functions of a module.
+// Every worker owns a queue of task indices, it takes them from the back and steals from the front of the other queues
+// once its own is empty. The thread calling run is the first worker.
+class thread_pool
+{
+  public:
+    using task_function = std::function<void(size_t index, size_t worker)>;
+
+    // workers including the calling thread, at least one
+    explicit thread_pool(size_t workers);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&)            = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t workers() const
+    {
+        return queues.size();
+    }
+
+    // calls task for every index below count and returns when all calls returned
+    void run(size_t count, const task_function& task);
+
+  private:
+    struct task_queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> indices;
+    };
+
+    bool take(size_t worker, size_t& index);
+    void work(size_t worker, const task_function& task);
+    void worker_loop(size_t worker);
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const task_function* current = nullptr;
+    size_t generation            = 0; // runs started, workers wait for the next one
+    size_t finished              = 0; // workers done with the current run
+    bool stopping                = false;
+};
+
+#endif THREAD_POOL_HPP
@@ -19,7 +19,7 @@
         op(less_then) op(greather_then) op(exclamation_mark) op(logical_and) op(logical_or) op(equal) op(less_then_or_equal) op(greather_then_or_equal) op(not_equal) op(transmutation_arrow)      \
             op(l_parentheses) op(r_parentheses) op(l_brace) op(r_brace) op(l_bracket) op(r_bracket) op(comma) op(semicolon) op(colon) op(double_colon) op(point) op(comment) op(eof) op(type_i32)  \
                 op(type_f32) op(type_bool) op(type_str) op(keyword_as) op(keyword_if) op(keyword_else) op(keyword_while) op(keyword_return) op(keyword_pub) op(keyword_static) op(keyword_type)    \
-                    op(keyword_extends) op(function_dump)
+                    op(keyword_extends) op(keyword_import) op(function_dump)
 
 #define op(x) x,
 enum class token_type
@@ -268,6 +268,8 @@ static int32_t operator_precedence(token_type op)
         return 0;
     case token_type::keyword_extends:
         return 0;
+    case token_type::keyword_import:
+        return 0;
     case token_type::function_dump:
         return 0;
 
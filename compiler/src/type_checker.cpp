@@ -0,0 +1,905 @@
+//! \file      type_checker.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "type_checker.hpp"
+#include "profile.hpp"
+#include <algorithm>
+#include <limits>
+
+static bool is_function_declaration(const expression& decl)
+{
+    return decl.expr_type == expression_type::declaration && decl.expressions.size() > 2;
+}
+
+type_checker::type_checker(symbol_table& symbols, type_table& types)
+    : symbols(symbols)
+    , types(types)
+{
+    DEFINE_VISITOR_AND_VISITABLES(type_checker, ast_node, expression, identifier, type_name, integer_literal, floating_point_literal, string_literal, boolean_literal);
+}
+
+bool type_checker::check(expression& program)
+{
+    PROFILE_SCOPE("type_checker::check");
+    declare_types(program);
+
+    for (auto& global : program.expressions)
+    {
+        if (global)
+            (*this)(*global, invalid_id);
+    }
+
+    for (const semantic_error& err : m_errors)
+    {
+        std::cerr << err.message << err.position << std::endl;
+    }
+
+    return m_errors.empty();
+}
+
+void type_checker::declare_types(expression& program)
+{
+    // bases are declared before derived types, so their fields are known
+    for (auto& global : program.expressions)
+    {
+        if (global && global->expr_type == expression_type::type_declaration)
+            declare_user_type(*global);
+    }
+
+    for (auto& global : program.expressions)
+    {
+        if (!global)
+            continue;
+
+        expression* decl = global.get();
+        if (decl->expr_type == expression_type::assign)
+            decl = decl->expressions[0].get();
+        if (!decl || decl->expr_type != expression_type::declaration)
+            continue;
+
+        symbol_id sym = static_cast<identifier&>(*decl->expressions[1]).symbol;
+        if (sym == invalid_id)
+            continue;
+
+        symbols.get(sym).type = is_function_declaration(*decl) ? type_of_function(*decl) : type_of_type_name(decl->expressions[0].get());
+    }
+}
+
+void type_checker::declare_user_type(expression& type_decl)
+{
+    symbol_id type_sym = static_cast<identifier&>(*type_decl.expressions[0]).symbol;
+    if (type_sym == invalid_id)
+        return;
+
+    type_id user_type          = types.user(type_sym);
+    symbols.get(type_sym).type = user_type;
+    type_decl.type             = user_type;
+
+    std::vector<symbol_id> fields;
+    type_id base_type = invalid_id;
+    if (symbols.get(type_sym).base != invalid_id)
+    {
+        base_type = symbols.get(symbols.get(type_sym).base).type;
+        fields    = types.get(base_type).fields;
+    }
+
+    for (auto& member : type_decl.expressions[2]->expressions)
+    {
+        if (!member || member->expr_type != expression_type::declaration)
+            continue;
+
+        symbol_id member_sym = static_cast<identifier&>(*member->expressions[1]).symbol;
+        if (member_sym == invalid_id)
+            continue;
+
+        if (is_function_declaration(*member))
+        {
+            symbols.get(member_sym).type = type_of_function(*member);
+        }
+        else
+        {
+            symbols.get(member_sym).type = type_of_type_name(member->expressions[0].get());
+            fields.push_back(member_sym);
+        }
+    }
+
+    // interning above can move the type infos
+    types.get(user_type).base   = base_type;
+    types.get(user_type).fields = std::move(fields);
+}
+
+type_id type_checker::type_of_type_name(expression* tp_name)
+{
+    if (!tp_name)
+        return error_type;
+
+    type_id result = error_type;
+    switch (tp_name->expr_type)
+    {
+    case expression_type::type_name:
+    {
+        type_name& name = static_cast<type_name&>(*tp_name);
+        if (name.string_representation == "i32")
+            result = i32_type;
+        else if (name.string_representation == "f32")
+            result = f32_type;
+        else if (name.string_representation == "bool")
+            result = bool_type;
+        else if (name.string_representation == "str")
+            result = str_type;
+        else if (name.string_representation == "()")
+            result = unit_type;
+        else if (name.symbol != invalid_id)
+            result = types.user(name.symbol);
+        break;
+    }
+    case expression_type::array_type_name:
+    {
+        // i32[2][3] is an array of 2 arrays with 3 elements
+        result = type_of_type_name(tp_name->expressions[0].get());
+        for (size_t i = tp_name->expressions.size() - 1; i > 0; --i)
+        {
+            int32_t length = 0;
+            if (!constant_integer(tp_name->expressions[i].get(), length) || length <= 0)
+            {
+                create_error(tp_name->source_position, "Array size has to be a positive constant");
+                return error_type;
+            }
+            result = types.array_of(result, length);
+        }
+        break;
+    }
+    case expression_type::function_type_name:
+    {
+        std::vector<type_id> parameters;
+        expression* parameter_list = tp_name->expressions[0].get();
+        if (parameter_list && parameter_list->expr_type == expression_type::compound)
+        {
+            for (auto& parameter : parameter_list->expressions)
+            {
+                if (!parameter)
+                    continue;
+                type_id parameter_type = type_of_type_name(parameter->expressions[0].get());
+                parameters.push_back(parameter_type);
+
+                identifier& name = static_cast<identifier&>(*parameter->expressions[1]);
+                name.type        = parameter_type;
+                parameter->type  = parameter_type;
+                if (name.symbol != invalid_id)
+                    symbols.get(name.symbol).type = parameter_type;
+            }
+        }
+        type_id result_type = tp_name->expressions.size() > 1 ? type_of_type_name(tp_name->expressions[1].get()) : error_type;
+        result              = types.function_of(parameters, result_type);
+        break;
+    }
+    default:
+        break;
+    }
+
+    tp_name->type = result;
+    return result;
+}
+
+type_id type_checker::type_of_function(expression& function_decl)
+{
+    type_id result = type_of_type_name(function_decl.expressions[0].get());
+
+    function_decl.expressions[1]->type = result;
+    function_decl.type                 = result;
+    return result;
+}
+
+bool type_checker::constant_integer(expression* expr, int32_t& value)
+{
+    if (!expr)
+        return false;
+
+    switch (expr->expr_type)
+    {
+    case expression_type::i32_lit:
+        value = static_cast<integer_literal*>(expr)->value;
+        return true;
+    case expression_type::add:
+    case expression_type::sub:
+    case expression_type::mult:
+    {
+        int32_t lhs = 0;
+        int32_t rhs = 0;
+        if (!constant_integer(expr->expressions[1].get(), rhs))
+            return false;
+        if (!expr->expressions[0])
+        {
+            value = expr->expr_type == expression_type::sub ? -rhs : rhs;
+            return true;
+        }
+        if (!constant_integer(expr->expressions[0].get(), lhs))
+            return false;
+        value = expr->expr_type == expression_type::add ? lhs + rhs : (expr->expr_type == expression_type::sub ? lhs - rhs : lhs * rhs);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+type_id type_checker::visit(ast_node&, symbol_id)
+{
+    return unit_type;
+}
+
+type_id type_checker::visit(expression& expr, symbol_id function)
+{
+    type_id result = unit_type;
+
+    switch (expr.expr_type)
+    {
+    case expression_type::declaration:
+    {
+        if (is_function_declaration(expr))
+            return check_function(expr);
+
+        result           = type_of_type_name(expr.expressions[0].get());
+        identifier& name = static_cast<identifier&>(*expr.expressions[1]);
+        name.type        = result;
+        if (name.symbol != invalid_id)
+            symbols.get(name.symbol).type = result;
+        break;
+    }
+    case expression_type::type_declaration:
+        for (auto& member : expr.expressions[2]->expressions)
+        {
+            if (member && is_function_declaration(*member))
+                check_function(*member);
+        }
+        return expr.type;
+    case expression_type::assign:
+        result = check_assign(expr, function);
+        break;
+    case expression_type::ret:
+    {
+        type_id function_type = function != invalid_id ? symbols.get(function).type : invalid_id;
+        type_id result_type   = (function_type != invalid_id && types.get(function_type).kind == type_kind::function) ? types.get(function_type).result : error_type;
+        if (function == invalid_id)
+            create_error(expr.source_position, "Return outside of a function");
+
+        if (!expr.expressions.empty() && expr.expressions[0])
+        {
+            check_child(expr.expressions[0], function);
+            if (result_type == unit_type)
+                create_error(expr.source_position, "Function without result returns a value");
+            else
+                convert(expr.expressions[0], result_type);
+        }
+        else if (result_type != unit_type && result_type != error_type)
+        {
+            create_error(expr.source_position, "Missing return value");
+        }
+        break;
+    }
+    case expression_type::branch:
+    case expression_type::loop:
+    {
+        type_id condition = check_child(expr.expressions[0], function);
+        if (condition != bool_type && condition != error_type)
+            create_error(expr.source_position, "Condition has to be bool, got " + types.to_string(condition, symbols));
+        for (size_t i = 1; i < expr.expressions.size(); ++i)
+            check_child(expr.expressions[i], function);
+        break;
+    }
+    case expression_type::cast:
+    {
+        type_id from = check_child(expr.expressions[0], function);
+        result       = type_of_type_name(expr.expressions[1].get());
+
+        bool valid = from == result || from == error_type || result == error_type;
+        valid      = valid || (types.is_numeric(from) && types.is_numeric(result));
+        valid      = valid || (from == bool_type && result == i32_type) || (from == i32_type && result == bool_type);
+        valid      = valid || (types.is_user(from) && types.inheritance_distance(from, result) >= 0);
+        if (!valid)
+        {
+            create_error(expr.source_position, "Can not cast " + types.to_string(from, symbols) + " to " + types.to_string(result, symbols));
+            result = error_type;
+        }
+        break;
+    }
+    case expression_type::function_call:
+        result = check_call(expr, function);
+        break;
+    case expression_type::array_access:
+    {
+        type_id base  = check_child(expr.expressions[0], function);
+        type_id index = check_child(expr.expressions[1], function);
+        if (index != i32_type && index != error_type)
+            create_error(expr.source_position, "Array index has to be i32, got " + types.to_string(index, symbols));
+
+        if (base == error_type)
+            result = error_type;
+        else if (types.get(base).kind != type_kind::array)
+        {
+            create_error(expr.source_position, types.to_string(base, symbols) + " is not an array");
+            result = error_type;
+        }
+        else
+            result = types.get(base).element;
+        break;
+    }
+    case expression_type::member_access:
+        result = check_member_access(expr, function);
+        break;
+    case expression_type::scope_access:
+        create_error(expr.source_position, "Static methods have to be called");
+        result = error_type;
+        break;
+    case expression_type::instantiation:
+        result = check_instantiation(expr, function);
+        break;
+    case expression_type::compound:
+        for (auto& child : expr.expressions)
+            check_child(child, function);
+        break;
+    case expression_type::type_name:
+    case expression_type::array_type_name:
+    case expression_type::function_type_name:
+        return type_of_type_name(&expr);
+    case expression_type::nop:
+        break;
+    default:
+        result = check_operator(expr, function);
+        break;
+    }
+
+    expr.type = result;
+    return result;
+}
+
+type_id type_checker::visit(identifier& ident, symbol_id function)
+{
+    if (ident.symbol == invalid_id)
+        return ident.type = error_type; // reported by the name_resolver
+
+    const symbol& sym = symbols.get(ident.symbol);
+    type_id result    = sym.type != invalid_id ? sym.type : error_type;
+
+    switch (sym.kind)
+    {
+    case symbol_kind::global_variable:
+    case symbol_kind::local_variable:
+    case symbol_kind::parameter:
+        break;
+    case symbol_kind::member:
+        if (is_static_context(function))
+        {
+            create_error(ident.source_position, "Member " + ident.name + " used in static method");
+            result = error_type;
+        }
+        break;
+    case symbol_kind::function:
+    case symbol_kind::method:
+    case symbol_kind::static_method:
+    case symbol_kind::builtin:
+        create_error(ident.source_position, "Function " + ident.name + " has to be called");
+        result = error_type;
+        break;
+    case symbol_kind::user_type:
+        create_error(ident.source_position, "Type " + ident.name + " used as value");
+        result = error_type;
+        break;
+    }
+
+    ident.type = result;
+    return result;
+}
+
+type_id type_checker::visit(type_name& tp_name, symbol_id)
+{
+    return type_of_type_name(&tp_name);
+}
+
+type_id type_checker::visit(integer_literal& literal, symbol_id)
+{
+    return literal.type = i32_type;
+}
+
+type_id type_checker::visit(floating_point_literal& literal, symbol_id)
+{
+    return literal.type = f32_type;
+}
+
+type_id type_checker::visit(string_literal& literal, symbol_id)
+{
+    return literal.type = str_type;
+}
+
+type_id type_checker::visit(boolean_literal& literal, symbol_id)
+{
+    return literal.type = bool_type;
+}
+
+type_id type_checker::check_child(unique_ptr<expression>& child, symbol_id function)
+{
+    if (!child)
+        return unit_type;
+
+    return (*this)(*child, function);
+}
+
+type_id type_checker::check_function(expression& function_decl)
+{
+    identifier& name = static_cast<identifier&>(*function_decl.expressions[1]);
+
+    // also assigns the parameter types for functions declared in blocks
+    type_id result = type_of_function(function_decl);
+    if (name.symbol != invalid_id)
+        symbols.get(name.symbol).type = result;
+
+    check_child(function_decl.expressions[2], name.symbol);
+
+    function_decl.type = result;
+    return result;
+}
+
+type_id type_checker::check_assign(expression& assign, symbol_id function)
+{
+    expression* lhs = assign.expressions[0].get();
+    if (!lhs)
+        return error_type;
+
+    bool is_declaration = lhs->expr_type == expression_type::declaration;
+    type_id target      = check_child(assign.expressions[0], function);
+    if (!is_declaration && !is_assignable(*lhs))
+        create_error(assign.source_position, "Expression is not assignable");
+
+    type_id value = check_child(assign.expressions[1], function);
+
+    // arrays can be initialized with a single value for all elements
+    type_id element = target;
+    while (element >= 0 && types.get(element).kind == type_kind::array)
+        element = types.get(element).element;
+
+    if (is_declaration && element != target && (value == error_type || types.get(value).kind != type_kind::array))
+        convert(assign.expressions[1], element);
+    else
+        convert(assign.expressions[1], target);
+
+    return target;
+}
+
+type_id type_checker::check_operator(expression& expr, symbol_id function)
+{
+    std::string op = expr.to_string();
+
+    // prefix operators only have a right operand
+    if (!expr.expressions[0])
+    {
+        type_id operand = check_child(expr.expressions[1], function);
+        if (operand == error_type)
+            return error_type;
+
+        if (expr.expr_type == expression_type::lnot)
+        {
+            if (operand != bool_type)
+                create_error(expr.source_position, "Operator ! needs a bool operand, got " + types.to_string(operand, symbols));
+            return bool_type;
+        }
+        if (!types.is_numeric(operand))
+        {
+            create_error(expr.source_position, "Operator " + op + " needs a numeric operand, got " + types.to_string(operand, symbols));
+            return error_type;
+        }
+        return operand;
+    }
+
+    type_id lhs = check_child(expr.expressions[0], function);
+    type_id rhs = check_child(expr.expressions[1], function);
+    if (lhs == error_type || rhs == error_type)
+        return error_type;
+
+    switch (expr.expr_type)
+    {
+    case expression_type::land:
+    case expression_type::lor:
+        if (lhs != bool_type || rhs != bool_type)
+            create_error(expr.source_position, "Operator " + op + " needs bool operands, got " + types.to_string(lhs, symbols) + " and " + types.to_string(rhs, symbols));
+        return bool_type;
+    case expression_type::eq:
+    case expression_type::neq:
+        if (!(types.is_numeric(lhs) && types.is_numeric(rhs)))
+        {
+            if (lhs != rhs && conversion_cost(lhs, rhs) < 0 && conversion_cost(rhs, lhs) < 0)
+                create_error(expr.source_position, "Can not compare " + types.to_string(lhs, symbols) + " and " + types.to_string(rhs, symbols));
+            return bool_type;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (!types.is_numeric(lhs) || !types.is_numeric(rhs))
+    {
+        create_error(expr.source_position, "Operator " + op + " needs numeric operands, got " + types.to_string(lhs, symbols) + " and " + types.to_string(rhs, symbols));
+        return error_type;
+    }
+
+    // mixed arithmetic is done in f32
+    type_id common = (lhs == f32_type || rhs == f32_type) ? f32_type : i32_type;
+    if (expr.expr_type == expression_type::mod && common != i32_type)
+    {
+        create_error(expr.source_position, "Operator % needs i32 operands");
+        return error_type;
+    }
+
+    convert(expr.expressions[0], common);
+    convert(expr.expressions[1], common);
+
+    switch (expr.expr_type)
+    {
+    case expression_type::eq:
+    case expression_type::neq:
+    case expression_type::lt:
+    case expression_type::gt:
+    case expression_type::lte:
+    case expression_type::gte:
+        return bool_type;
+    default:
+        return common;
+    }
+}
+
+type_id type_checker::check_call(expression& call, symbol_id function)
+{
+    expression* callee = call.expressions[0].get();
+    if (!callee)
+        return error_type;
+
+    std::vector<type_id> argument_types;
+    for (size_t i = 1; i < call.expressions.size(); ++i)
+        argument_types.push_back(check_child(call.expressions[i], function));
+
+    identifier* name = nullptr;
+    switch (callee->expr_type)
+    {
+    case expression_type::identifier:
+    {
+        name = static_cast<identifier*>(callee);
+        if (name->symbol == invalid_id)
+            return error_type;
+
+        symbol_kind kind = symbols.get(name->symbol).kind;
+        if (kind == symbol_kind::builtin)
+            return check_dump(call);
+        if (kind == symbol_kind::method && is_static_context(function))
+        {
+            create_error(call.source_position, "Method " + name->name + " called without object in static method");
+            return error_type;
+        }
+        if (!symbol_table::is_overloadable(kind))
+        {
+            create_error(call.source_position, name->name + " is not a function");
+            return error_type;
+        }
+        break;
+    }
+    case expression_type::member_access:
+    {
+        type_id object = check_child(callee->expressions[0], function);
+        if (object == error_type)
+            return error_type;
+        name = static_cast<identifier*>(callee->expressions[1].get());
+        if (!types.is_user(object))
+        {
+            create_error(call.source_position, types.to_string(object, symbols) + " has no methods");
+            return error_type;
+        }
+        name->symbol = find_member(object, name->name);
+        if (name->symbol == invalid_id || symbols.get(name->symbol).kind != symbol_kind::method)
+        {
+            create_error(call.source_position, name->name + " is not a method of " + types.to_string(object, symbols));
+            name->symbol = invalid_id;
+            return error_type;
+        }
+        name->id_type = identifier_type::method;
+        break;
+    }
+    case expression_type::scope_access:
+    {
+        name = static_cast<identifier*>(callee->expressions[1].get());
+        if (name->symbol == invalid_id)
+            return error_type;
+        if (symbols.get(name->symbol).kind != symbol_kind::static_method)
+        {
+            create_error(call.source_position, name->name + " is not a static method");
+            return error_type;
+        }
+        break;
+    }
+    default:
+        create_error(call.source_position, "Expression is not callable");
+        return error_type;
+    }
+
+    symbol_id chosen = resolve_overload(name->symbol, argument_types, call.source_position);
+    if (chosen == invalid_id)
+        return error_type;
+
+    type_id function_type = symbols.get(chosen).type;
+    name->symbol          = chosen;
+    name->type            = function_type;
+    callee->type          = function_type;
+
+    std::vector<type_id> parameters = types.get(function_type).parameters;
+    for (size_t i = 0; i < parameters.size(); ++i)
+        convert(call.expressions[i + 1], parameters[i]);
+
+    return types.get(function_type).result;
+}
+
+type_id type_checker::check_dump(expression& call)
+{
+    for (size_t i = 1; i < call.expressions.size(); ++i)
+    {
+        type_id argument = call.expressions[i]->type;
+        if (argument != error_type && (argument == unit_type || types.get(argument).kind == type_kind::function))
+            create_error(call.expressions[i]->source_position, "Can not dump " + types.to_string(argument, symbols));
+    }
+
+    // literal format strings have one {} per following argument
+    if (call.expressions.size() > 1 && call.expressions[1]->expr_type == expression_type::str_lit)
+    {
+        const std::string& format = static_cast<string_literal&>(*call.expressions[1]).value;
+
+        size_t placeholders = 0;
+        for (size_t pos = format.find("{}"); pos != std::string::npos; pos = format.find("{}", pos + 2))
+            ++placeholders;
+
+        size_t arguments = call.expressions.size() - 2;
+        if (placeholders != arguments && (placeholders > 0 || arguments > 0))
+            create_error(call.source_position, "dump format expects " + std::to_string(placeholders) + " arguments, got " + std::to_string(arguments));
+    }
+
+    call.expressions[0]->type = unit_type;
+    return unit_type;
+}
+
+type_id type_checker::check_instantiation(expression& inst, symbol_id function)
+{
+    symbol_id type_sym = static_cast<identifier&>(*inst.expressions[0]).symbol;
+    if (type_sym == invalid_id || symbols.get(type_sym).kind != symbol_kind::user_type)
+        return error_type;
+
+    type_id result                = symbols.get(type_sym).type;
+    inst.expressions[0]->type     = result;
+    std::vector<symbol_id> fields = types.get(result).fields;
+    std::vector<bool> initialized(fields.size(), false);
+
+    size_t positional = 0;
+    for (size_t i = 1; i < inst.expressions.size(); ++i)
+    {
+        unique_ptr<expression>& argument = inst.expressions[i];
+        symbol_id field                  = invalid_id;
+
+        if (argument->expr_type == expression_type::field_init)
+        {
+            field = static_cast<identifier&>(*argument->expressions[0]).symbol;
+            if (field == invalid_id)
+                continue; // reported by the name_resolver
+            if (symbols.get(field).kind != symbol_kind::member)
+            {
+                create_error(argument->source_position, symbols.name(field) + " is not a field");
+                continue;
+            }
+        }
+        else
+        {
+            if (positional >= fields.size())
+            {
+                create_error(argument->source_position, "Too many arguments for " + symbols.name(type_sym));
+                continue;
+            }
+            field = fields[positional++];
+
+            // positional arguments are made explicit
+            source_code_position position = argument->source_position;
+            unique_ptr<identifier> member = std::make_unique<identifier>(position, symbols.name(field), identifier_type::member);
+            member->symbol                = field;
+            unique_ptr<expression> init   = std::make_unique<expression>(position, expression_type::field_init);
+            init->expressions.push_back(std::move(member));
+            init->expressions.push_back(std::move(argument));
+            argument = std::move(init);
+        }
+
+        size_t index = std::find(fields.begin(), fields.end(), field) - fields.begin();
+        if (index < initialized.size())
+        {
+            if (initialized[index])
+                create_error(argument->source_position, "Field " + symbols.name(field) + " is initialized twice");
+            initialized[index] = true;
+        }
+
+        type_id field_type             = symbols.get(field).type;
+        argument->expressions[0]->type = field_type;
+        check_child(argument->expressions[1], function);
+        convert(argument->expressions[1], field_type);
+        argument->type = field_type;
+    }
+
+    return result;
+}
+
+type_id type_checker::check_member_access(expression& access, symbol_id function)
+{
+    type_id object = check_child(access.expressions[0], function);
+    if (object == error_type)
+        return error_type;
+
+    identifier& name = static_cast<identifier&>(*access.expressions[1]);
+    if (!types.is_user(object))
+    {
+        create_error(access.source_position, types.to_string(object, symbols) + " has no members");
+        return error_type;
+    }
+
+    symbol_id member = find_member(object, name.name);
+    if (member == invalid_id)
+    {
+        create_error(access.source_position, name.name + " is not a member of " + types.to_string(object, symbols));
+        return error_type;
+    }
+    if (symbols.get(member).kind != symbol_kind::member)
+    {
+        create_error(access.source_position, "Method " + name.name + " has to be called");
+        return error_type;
+    }
+
+    name.symbol  = member;
+    name.id_type = identifier_type::member;
+    name.type    = symbols.get(member).type;
+    return name.type;
+}
+
+symbol_id type_checker::resolve_overload(symbol_id first, const std::vector<type_id>& argument_types, const source_code_position& position)
+{
+    symbol_id best    = invalid_id;
+    int32_t best_cost = std::numeric_limits<int32_t>::max();
+    bool ambiguous    = false;
+
+    for (symbol_id candidate = first; candidate != invalid_id; candidate = symbols.get(candidate).next_overload)
+    {
+        type_id function_type = symbols.get(candidate).type;
+        if (function_type < 0 || types.get(function_type).kind != type_kind::function)
+            continue;
+
+        const std::vector<type_id>& parameters = types.get(function_type).parameters;
+        if (parameters.size() != argument_types.size())
+            continue;
+
+        int32_t cost = 0;
+        for (size_t i = 0; i < parameters.size() && cost >= 0; ++i)
+        {
+            int32_t argument_cost = conversion_cost(argument_types[i], parameters[i]);
+            cost                  = argument_cost < 0 ? -1 : cost + argument_cost;
+        }
+        if (cost < 0)
+            continue;
+
+        if (cost < best_cost)
+        {
+            best      = candidate;
+            best_cost = cost;
+            ambiguous = false;
+        }
+        else if (cost == best_cost)
+        {
+            ambiguous = true;
+        }
+    }
+
+    if (best != invalid_id && !ambiguous)
+        return best;
+
+    std::string signature = symbols.name(first) + "(";
+    for (size_t i = 0; i < argument_types.size(); ++i)
+    {
+        if (i > 0)
+            signature += ", ";
+        signature += types.to_string(argument_types[i], symbols);
+    }
+    signature += ")";
+
+    create_error(position, (ambiguous ? "Ambiguous call " : "No matching function for call ") + signature);
+    return invalid_id;
+}
+
+symbol_id type_checker::find_member(type_id user, const std::string& name)
+{
+    name_id member_name = symbols.names.find(name);
+    if (member_name == invalid_id)
+        return invalid_id;
+
+    // the member scope chain contains the bases, but ends in the global scope
+    scope_id current = symbols.get(types.get(user).symbol).member_scope;
+    while (current != invalid_id && symbols.get_scope(current).kind == scope_kind::type)
+    {
+        symbol_id id = symbols.lookup_local(current, member_name);
+        if (id != invalid_id)
+            return id;
+        current = symbols.get_scope(current).parent;
+    }
+    return invalid_id;
+}
+
+int32_t type_checker::conversion_cost(type_id from, type_id to) const
+{
+    if (from == to || from == error_type || to == error_type)
+        return 0;
+    // only widening is implicit, f32 to i32 truncates and needs an explicit as i32
+    if (from == i32_type && to == f32_type)
+        return 1;
+    if (types.is_user(from) && types.is_user(to))
+        return types.inheritance_distance(from, to);
+    return -1;
+}
+
+void type_checker::convert(unique_ptr<expression>& child, type_id to)
+{
+    if (!child)
+        return;
+
+    type_id from = child->type;
+    if (conversion_cost(from, to) < 0)
+    {
+        create_error(child->source_position, "Can not convert " + types.to_string(from, symbols) + " to " + types.to_string(to, symbols));
+        return;
+    }
+
+    // references to derived types are used as they are
+    if (from != to && types.is_numeric(from) && types.is_numeric(to))
+        child = make_cast(std::move(child), to);
+}
+
+unique_ptr<expression> type_checker::make_cast(unique_ptr<expression> expr, type_id to)
+{
+    source_code_position position = expr->source_position;
+
+    unique_ptr<type_name> target = std::make_unique<type_name>(position, types.to_string(to, symbols));
+    target->type                 = to;
+
+    unique_ptr<expression> cast = std::make_unique<expression>(position, expression_type::cast);
+    cast->type                  = to;
+    cast->expressions.push_back(std::move(expr));
+    cast->expressions.push_back(std::move(target));
+    return cast;
+}
+
+bool type_checker::is_assignable(expression& expr)
+{
+    switch (expr.expr_type)
+    {
+    case expression_type::identifier:
+    {
+        symbol_id sym = static_cast<identifier&>(expr).symbol;
+        if (sym == invalid_id)
+            return true; // reported by the name_resolver
+        symbol_kind kind = symbols.get(sym).kind;
+        return kind == symbol_kind::global_variable || kind == symbol_kind::local_variable || kind == symbol_kind::parameter || kind == symbol_kind::member;
+    }
+    case expression_type::array_access:
+    case expression_type::member_access:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool type_checker::is_static_context(symbol_id function)
+{
+    return function != invalid_id && symbols.get(function).kind == symbol_kind::static_method;
+}
+
+void type_checker::create_error(const source_code_position& position, const std::string& msg)
+{
+    m_errors.push_back(semantic_error{ position, msg });
+}
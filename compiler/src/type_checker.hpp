@@ -0,0 +1,76 @@
+//! \file      type_checker.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef TYPE_CHECKER_HPP
+#define TYPE_CHECKER_HPP
+
+#include "ast.hpp"
+#include "symbol_table.hpp"
+#include "type_table.hpp"
+
+// Annotates every expression with a type id, resolves overloads and inserts explicit casts for implicit conversions.
+// Runs after the name_resolver, the visitor parameter is the function the expression is part of.
+class type_checker : public base_visitor<ast_node, type_id, symbol_id>
+{
+  public:
+    type_checker(symbol_table& symbols, type_table& types);
+    ~type_checker() = default;
+
+    // returns false if there were type errors
+    bool check(expression& program);
+
+    type_id visit(ast_node& node, symbol_id function);
+    type_id visit(expression& expr, symbol_id function);
+    type_id visit(identifier& ident, symbol_id function);
+    type_id visit(type_name& tp_name, symbol_id function);
+    type_id visit(integer_literal& literal, symbol_id function);
+    type_id visit(floating_point_literal& literal, symbol_id function);
+    type_id visit(string_literal& literal, symbol_id function);
+    type_id visit(boolean_literal& literal, symbol_id function);
+
+    const semantic_error_list& errors() const
+    {
+        return m_errors;
+    }
+
+  private:
+    void declare_types(expression& program);
+    void declare_user_type(expression& type_decl);
+
+    type_id type_of_type_name(expression* tp_name);
+    type_id type_of_function(expression& function_decl);
+    bool constant_integer(expression* expr, int32_t& value);
+
+    type_id check_child(unique_ptr<expression>& child, symbol_id function);
+    type_id check_function(expression& function_decl);
+    type_id check_assign(expression& assign, symbol_id function);
+    type_id check_operator(expression& expr, symbol_id function);
+    type_id check_call(expression& call, symbol_id function);
+    type_id check_dump(expression& call);
+    type_id check_instantiation(expression& inst, symbol_id function);
+    type_id check_member_access(expression& access, symbol_id function);
+
+    // picks the cheapest overload in the chain starting at first, returns invalid_id if none or several fit
+    symbol_id resolve_overload(symbol_id first, const std::vector<type_id>& argument_types, const source_code_position& position);
+    symbol_id find_member(type_id user, const std::string& name);
+
+    // -1 if there is no implicit conversion
+    int32_t conversion_cost(type_id from, type_id to) const;
+    // wraps the child in a cast if needed, reports an error if there is no implicit conversion
+    void convert(unique_ptr<expression>& child, type_id to);
+    unique_ptr<expression> make_cast(unique_ptr<expression> expr, type_id to);
+
+    bool is_assignable(expression& expr);
+    bool is_static_context(symbol_id function);
+
+    void create_error(const source_code_position& position, const std::string& msg);
+
+    symbol_table& symbols;
+    type_table& types;
+    semantic_error_list m_errors;
+};
+
+#endif TYPE_CHECKER_HPP
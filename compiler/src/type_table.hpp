@@ -0,0 +1,190 @@
+//! \file      type_table.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef TYPE_TABLE_HPP
+#define TYPE_TABLE_HPP
+
+#include "symbol_table.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+using type_id = int32_t;
+
+#define TYPE_KIND_ENUMERATION(op) op(error) op(unit) op(i32) op(f32) op(boolean) op(str) op(array) op(function) op(user)
+
+#define op(x) x,
+enum class type_kind
+{
+    TYPE_KIND_ENUMERATION(op)
+};
+#undef op
+
+// primitive types are interned first, in this order
+static constexpr type_id error_type = 0;
+static constexpr type_id unit_type  = 1;
+static constexpr type_id i32_type   = 2;
+static constexpr type_id f32_type   = 3;
+static constexpr type_id bool_type  = 4;
+static constexpr type_id str_type   = 5;
+
+struct type_info
+{
+    type_info(type_kind kind)
+        : kind(kind)
+    {
+    }
+
+    type_kind kind;
+    type_id element  = invalid_id;   // arrays
+    int32_t length   = 0;            // arrays
+    type_id result   = invalid_id;   // functions
+    std::vector<type_id> parameters; // functions
+    symbol_id symbol = invalid_id;   // user types
+    type_id base     = invalid_id;   // user types
+    std::vector<symbol_id> fields;   // user types, members of the bases first
+};
+
+// Interns types, structurally equal types share one id, so types can be compared as integers.
+class type_table
+{
+  public:
+    type_table()
+    {
+        intern(type_info{ type_kind::error });
+        intern(type_info{ type_kind::unit });
+        intern(type_info{ type_kind::i32 });
+        intern(type_info{ type_kind::f32 });
+        intern(type_info{ type_kind::boolean });
+        intern(type_info{ type_kind::str });
+    }
+    ~type_table() = default;
+
+    type_id array_of(type_id element, int32_t length)
+    {
+        type_info info{ type_kind::array };
+        info.element = element;
+        info.length  = length;
+        return intern(std::move(info));
+    }
+
+    type_id function_of(const std::vector<type_id>& parameters, type_id result)
+    {
+        type_info info{ type_kind::function };
+        info.parameters = parameters;
+        info.result     = result;
+        return intern(std::move(info));
+    }
+
+    // one type per user type symbol, base and fields are filled by the type_checker
+    type_id user(symbol_id symbol)
+    {
+        type_info info{ type_kind::user };
+        info.symbol = symbol;
+        return intern(std::move(info));
+    }
+
+    type_info& get(type_id id)
+    {
+        return types[id];
+    }
+
+    const type_info& get(type_id id) const
+    {
+        return types[id];
+    }
+
+    size_t size() const
+    {
+        return types.size();
+    }
+
+    bool is_numeric(type_id id) const
+    {
+        return id == i32_type || id == f32_type;
+    }
+
+    bool is_user(type_id id) const
+    {
+        return id >= 0 && types[id].kind == type_kind::user;
+    }
+
+    // number of inheritance steps from derived to base, -1 if base is not a base of derived
+    int32_t inheritance_distance(type_id derived, type_id base) const
+    {
+        int32_t distance = 0;
+        while (derived != invalid_id)
+        {
+            if (derived == base)
+                return distance;
+            derived = types[derived].base;
+            ++distance;
+        }
+        return -1;
+    }
+
+    std::string to_string(type_id id, const symbol_table& symbols) const
+    {
+        if (id < 0)
+            return "<unknown>";
+
+        const type_info& info = types[id];
+        switch (info.kind)
+        {
+        case type_kind::error:
+            return "<error>";
+        case type_kind::unit:
+            return "()";
+        case type_kind::i32:
+            return "i32";
+        case type_kind::f32:
+            return "f32";
+        case type_kind::boolean:
+            return "bool";
+        case type_kind::str:
+            return "str";
+        case type_kind::array:
+            return to_string(info.element, symbols) + "[" + std::to_string(info.length) + "]";
+        case type_kind::function:
+        {
+            std::string result = "(";
+            for (size_t i = 0; i < info.parameters.size(); ++i)
+            {
+                if (i > 0)
+                    result += ", ";
+                result += to_string(info.parameters[i], symbols);
+            }
+            return result + ") -> " + to_string(info.result, symbols);
+        }
+        case type_kind::user:
+            return symbols.name(info.symbol);
+        default:
+            return "<unknown>";
+        }
+    }
+
+  private:
+    type_id intern(type_info&& info)
+    {
+        // structural key, user types are identified by their symbol
+        std::vector<int32_t> key = { static_cast<int32_t>(info.kind), info.element, info.length, info.result, info.symbol };
+        key.insert(key.end(), info.parameters.begin(), info.parameters.end());
+
+        auto it = interned.find(key);
+        if (it != interned.end())
+            return it->second;
+
+        type_id id = static_cast<type_id>(types.size());
+        types.push_back(std::move(info));
+        interned.emplace(std::move(key), id);
+        return id;
+    }
+
+    std::map<std::vector<int32_t>, type_id> interned;
+    std::vector<type_info> types;
+};
+
+#endif TYPE_TABLE_HPP
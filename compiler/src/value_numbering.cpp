@@ -0,0 +1,265 @@
+//! \file      value_numbering.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "value_numbering.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+// memory a load can read from: a global, a field of any object or an element of any array
+using alias_class = std::pair<int32_t, int32_t>;
+
+static alias_class alias_of(const ir_instruction& instr)
+{
+    switch (instr.opcode)
+    {
+    case ir_opcode::load_global:
+    case ir_opcode::store_global:
+        return { 0, instr.immediate };
+    case ir_opcode::load_field:
+    case ir_opcode::store_field:
+        return { 1, instr.immediate };
+    default:
+        return { 2, 0 };
+    }
+}
+
+// every write gives its alias class a new version, loads of the same version read the same value
+struct memory_state
+{
+    int32_t epoch = 0; // version of the classes not written since the last merge or call
+    std::map<alias_class, int32_t> versions;
+
+    int32_t version(alias_class alias) const
+    {
+        auto it = versions.find(alias);
+        return it == versions.end() ? epoch : it->second;
+    }
+};
+
+static bool is_commutative(ir_opcode opcode)
+{
+    return opcode == ir_opcode::add || opcode == ir_opcode::mul || opcode == ir_opcode::eq || opcode == ir_opcode::ne;
+}
+
+static std::vector<int64_t> key_of(const ir_instruction& instr, int64_t extra)
+{
+    int32_t fbits = 0;
+    std::memcpy(&fbits, &instr.fimmediate, sizeof(fbits));
+
+    std::vector<int64_t> key = { static_cast<int64_t>(instr.opcode), static_cast<int64_t>(instr.type), instr.immediate, instr.aux, fbits, extra };
+    key.insert(key.end(), instr.operands.begin(), instr.operands.end());
+    if (is_commutative(instr.opcode))
+        std::sort(key.end() - instr.operands.size(), key.end());
+    return key;
+}
+
+// i32 and boolean operations on constants, with the wrapping semantics of the runtime
+static bool fold(const ir_function& function, const ir_instruction& instr, int32_t& result)
+{
+    if ((instr.type != ir_type::i32 && instr.type != ir_type::boolean) || instr.operands.empty() || instr.operands.size() > 2)
+        return false;
+
+    uint32_t c[2] = { 0, 0 };
+    for (size_t i = 0; i < instr.operands.size(); ++i)
+    {
+        const ir_instruction& operand = function.values[instr.operands[i]];
+        if (operand.opcode != ir_opcode::constant || (operand.type != ir_type::i32 && operand.type != ir_type::boolean))
+            return false;
+        c[i] = static_cast<uint32_t>(operand.immediate);
+    }
+
+    int32_t a = static_cast<int32_t>(c[0]);
+    int32_t b = static_cast<int32_t>(c[1]);
+    switch (instr.opcode)
+    {
+    case ir_opcode::add:
+        result = static_cast<int32_t>(c[0] + c[1]);
+        return true;
+    case ir_opcode::sub:
+        result = static_cast<int32_t>(c[0] - c[1]);
+        return true;
+    case ir_opcode::mul:
+        result = static_cast<int32_t>(c[0] * c[1]);
+        return true;
+    case ir_opcode::div:
+    case ir_opcode::mod:
+        // division by zero traps at run time
+        if (b == 0)
+            return false;
+        if (b == -1)
+            result = instr.opcode == ir_opcode::div ? static_cast<int32_t>(0u - c[0]) : 0;
+        else
+            result = instr.opcode == ir_opcode::div ? a / b : a % b;
+        return true;
+    case ir_opcode::neg:
+        result = static_cast<int32_t>(0u - c[0]);
+        return true;
+    case ir_opcode::eq:
+        result = a == b;
+        return true;
+    case ir_opcode::ne:
+        result = a != b;
+        return true;
+    case ir_opcode::lt:
+        result = a < b;
+        return true;
+    case ir_opcode::gt:
+        result = a > b;
+        return true;
+    case ir_opcode::le:
+        result = a <= b;
+        return true;
+    case ir_opcode::ge:
+        result = a >= b;
+        return true;
+    case ir_opcode::lnot:
+        result = a ? 0 : 1;
+        return true;
+    default:
+        return false;
+    }
+}
+
+size_t number_values(ir_function& function, const dominator_tree& dominators, effect_analysis& effects)
+{
+    std::map<std::vector<int64_t>, std::vector<value_id>> table;
+    std::vector<memory_state> states(function.blocks.size());
+    int32_t next_version = 0;
+    size_t replaced      = 0;
+
+    // values from other paths have equal keys too, only a dominating one can be reused
+    auto lookup = [&](const std::vector<int64_t>& key, block_id block) {
+        auto it = table.find(key);
+        if (it != table.end())
+        {
+            for (value_id candidate : it->second)
+            {
+                if (dominators.dominates(function.values[candidate].block, block))
+                    return candidate;
+            }
+        }
+        return no_value;
+    };
+
+    for (block_id block : dominators.reverse_postorder())
+    {
+        // a block entered only from its immediate dominator sees the memory its dominator left
+        memory_state memory;
+        const std::vector<block_id>& predecessors = function.blocks[block].predecessors;
+        if (predecessors.size() == 1 && predecessors[0] == dominators.immediate_dominator(block))
+            memory = states[predecessors[0]];
+        else
+            memory.epoch = ++next_version;
+
+        for (value_id value : std::vector<value_id>(function.blocks[block].instructions))
+        {
+            ir_instruction& instr = function.values[value];
+            if (instr.type == ir_type::vi32 || instr.type == ir_type::vf32)
+                continue;
+
+            int32_t folded = 0;
+            if (fold(function, instr, folded))
+            {
+                instr.opcode    = ir_opcode::constant;
+                instr.immediate = folded;
+                instr.operands.clear();
+                effects.invalidate(value);
+                ++replaced;
+            }
+
+            if (instr.opcode == ir_opcode::select && function.values[instr.operands[0]].opcode == ir_opcode::constant)
+            {
+                function.replace_all_uses(value, instr.operands[function.values[instr.operands[0]].immediate ? 1 : 2]);
+                function.remove(value);
+                ++replaced;
+                continue;
+            }
+
+            const ir_instruction& index = instr.operands.empty() ? instr : function.values[instr.operands[0]];
+            if (instr.opcode == ir_opcode::check_bounds && index.opcode == ir_opcode::constant && index.immediate >= 0 && index.immediate < instr.aux)
+            {
+                function.remove(value);
+                ++replaced;
+                continue;
+            }
+
+            // allocations are never null
+            if (instr.opcode == ir_opcode::check_null && (index.opcode == ir_opcode::new_object || index.opcode == ir_opcode::new_array))
+            {
+                function.remove(value);
+                ++replaced;
+                continue;
+            }
+
+            int64_t extra = 0;
+            switch (instr.opcode)
+            {
+            case ir_opcode::store_global:
+            case ir_opcode::store_field:
+            case ir_opcode::store_element:
+            {
+                alias_class alias      = alias_of(instr);
+                memory.versions[alias] = ++next_version;
+
+                // a load right after the store reads the stored value
+                ir_instruction load;
+                load.opcode    = instr.opcode == ir_opcode::store_global ? ir_opcode::load_global : instr.opcode == ir_opcode::store_field ? ir_opcode::load_field : ir_opcode::load_element;
+                load.type      = function.values[instr.operands.back()].type;
+                load.immediate = instr.immediate;
+                load.operands.assign(instr.operands.begin(), instr.operands.end() - 1);
+                table[key_of(load, next_version)].push_back(instr.operands.back());
+                continue;
+            }
+            case ir_opcode::store_vector:
+                memory.versions[alias_of(instr)] = ++next_version;
+                continue;
+            case ir_opcode::call:
+            case ir_opcode::call_method:
+                if ((effects.summary(value) & effect_writes_memory) != 0)
+                {
+                    memory.epoch = ++next_version;
+                    memory.versions.clear();
+                }
+                if (effects.summary(value) != effect_none)
+                    continue;
+                break;
+            case ir_opcode::load_global:
+            case ir_opcode::load_field:
+            case ir_opcode::load_element:
+                extra = memory.version(alias_of(instr));
+                break;
+            case ir_opcode::phi:
+                extra = block;
+                break;
+            case ir_opcode::div:
+            case ir_opcode::mod:
+            case ir_opcode::check_bounds:
+            case ir_opcode::check_null:
+                // a second trap on the same operands can not happen
+                break;
+            default:
+                if (instr.is_terminator() || effects.summary(value) != effect_none)
+                    continue;
+                break;
+            }
+
+            std::vector<int64_t> key = key_of(instr, extra);
+            value_id existing        = lookup(key, block);
+            if (existing == no_value)
+            {
+                table[key].push_back(value);
+                continue;
+            }
+
+            function.replace_all_uses(value, existing);
+            function.remove(value);
+            ++replaced;
+        }
+        states[block] = memory;
+    }
+    return replaced;
+}
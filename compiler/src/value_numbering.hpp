@@ -0,0 +1,21 @@
+//! \file      value_numbering.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef VALUE_NUMBERING_HPP
+#define VALUE_NUMBERING_HPP
+
+#include "dominator_tree.hpp"
+#include "effect_analysis.hpp"
+#include "ir.hpp"
+
+// Global value numbering over the dominator tree.
+// Pure instructions computing the same value as a dominating one are replaced by it, constant operands are folded.
+// Loads are reused until an instruction writing memory they can read from, stored values are forwarded to later loads.
+// Calls of pure functions are numbered like pure instructions.
+// Returns the number of replaced and folded instructions.
+size_t number_values(ir_function& function, const dominator_tree& dominators, effect_analysis& effects);
+
+#endif VALUE_NUMBERING_HPP
@@ -0,0 +1,239 @@
+//! \file      vectorizer.cpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#include "vectorizer.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+int32_t native_vector_width()
+{
+#if defined(__AVX2__)
+    return 8;
+#else
+    return 4; // sse2 is part of every x86-64 target
+#endif
+}
+
+static ir_type vector_type(ir_type type)
+{
+    return type == ir_type::f32 ? ir_type::vf32 : ir_type::vi32;
+}
+
+static bool is_lane_type(ir_type type)
+{
+    return type == ir_type::i32 || type == ir_type::f32;
+}
+
+// the body may only read and write elements at the index of the loop and combine them lane by lane
+static bool is_element_wise(const ir_function& function, const ir_loop& loop, const induction_variable& iv, block_id body)
+{
+    auto is_invariant = [&](value_id value) { return !std::binary_search(loop.blocks.begin(), loop.blocks.end(), function.values[value].block); };
+
+    std::unordered_set<value_id> lanes;
+    bool stores = false;
+    for (value_id value : function.blocks[body].instructions)
+    {
+        const ir_instruction& instr = function.values[value];
+        if (value == iv.next || instr.opcode == ir_opcode::jump)
+            continue;
+
+        size_t first = 0;
+        switch (instr.opcode)
+        {
+        case ir_opcode::load_element:
+        case ir_opcode::store_element:
+            if (instr.operands[1] != iv.phi || !is_invariant(instr.operands[0]))
+                return false;
+            if (!is_lane_type(instr.opcode == ir_opcode::load_element ? instr.type : function.values[instr.operands[2]].type))
+                return false;
+            first  = instr.opcode == ir_opcode::load_element ? instr.operands.size() : 2;
+            stores = stores || instr.opcode == ir_opcode::store_element;
+            break;
+        case ir_opcode::add:
+        case ir_opcode::sub:
+        case ir_opcode::mul:
+        case ir_opcode::neg:
+            if (!is_lane_type(instr.type))
+                return false;
+            break;
+        case ir_opcode::div:
+            // integer division traps and has no vector instruction
+            if (instr.type != ir_type::f32)
+                return false;
+            break;
+        case ir_opcode::convert:
+            if (instr.type != ir_type::f32 || function.values[instr.operands[0]].type != ir_type::i32)
+                return false;
+            break;
+        default:
+            return false;
+        }
+
+        for (size_t i = first; i < instr.operands.size(); ++i)
+        {
+            if (!lanes.count(instr.operands[i]) && !is_invariant(instr.operands[i]))
+                return false;
+        }
+        lanes.insert(value);
+    }
+    return stores;
+}
+
+static value_id append(ir_function& function, block_id block, ir_instruction&& instr)
+{
+    instr.block    = block;
+    value_id value = function.add_value(std::move(instr));
+    function.blocks[block].instructions.push_back(value);
+    return value;
+}
+
+static value_id insert_before_terminator(ir_function& function, block_id block, ir_instruction&& instr)
+{
+    instr.block                         = block;
+    value_id value                      = function.add_value(std::move(instr));
+    std::vector<value_id>& instructions = function.blocks[block].instructions;
+    instructions.insert(instructions.end() - 1, value);
+    return value;
+}
+
+static ir_instruction make_instruction(ir_opcode opcode, ir_type type, std::vector<value_id> operands, int32_t immediate = 0)
+{
+    ir_instruction instr;
+    instr.opcode    = opcode;
+    instr.type      = type;
+    instr.operands  = std::move(operands);
+    instr.immediate = immediate;
+    return instr;
+}
+
+// preheader -> vector header <-> vector body, vector header -> header <-> body -> exit
+static void vectorize_loop(ir_function& function, const ir_loop& loop, const induction_variable& iv, block_id body, int32_t limit, int32_t width)
+{
+    block_id preheader     = loop.preheader;
+    block_id vector_header = function.add_block();
+    block_id vector_body   = function.add_block();
+
+    value_id index = append(function, vector_header, make_instruction(ir_opcode::phi, ir_type::i32, {}));
+    value_id end   = insert_before_terminator(function, preheader, make_instruction(ir_opcode::constant, ir_type::i32, {}, limit));
+    value_id step  = insert_before_terminator(function, preheader, make_instruction(ir_opcode::constant, ir_type::i32, {}, width));
+    value_id test  = append(function, vector_header, make_instruction(ir_opcode::lt, ir_type::boolean, { index, end }));
+
+    ir_instruction branch = make_instruction(ir_opcode::branch, ir_type::unit, { test });
+    branch.targets[0]     = vector_body;
+    branch.targets[1]     = loop.header;
+    append(function, vector_header, std::move(branch));
+
+    // invariant operands are broadcast to all lanes once
+    std::unordered_map<value_id, value_id> vectors;
+    auto vector_operand = [&](value_id value) {
+        auto it = vectors.find(value);
+        if (it != vectors.end())
+            return it->second;
+
+        ir_instruction splat = make_instruction(ir_opcode::splat, vector_type(function.values[value].type), { value });
+        splat.aux            = function.vector_registers++;
+        value_id broadcast   = insert_before_terminator(function, preheader, std::move(splat));
+        vectors[value]       = broadcast;
+        return broadcast;
+    };
+
+    for (value_id value : std::vector<value_id>(function.blocks[body].instructions))
+    {
+        ir_instruction instr = function.values[value];
+        if (value == iv.next || instr.opcode == ir_opcode::jump)
+            continue;
+
+        if (instr.opcode == ir_opcode::store_element)
+        {
+            ir_instruction store = make_instruction(ir_opcode::store_vector, ir_type::unit, { instr.operands[0], index, vector_operand(instr.operands[2]) });
+            store.position       = instr.position;
+            append(function, vector_body, std::move(store));
+            continue;
+        }
+
+        ir_instruction vector = make_instruction(instr.opcode, vector_type(instr.type), {});
+        vector.position       = instr.position;
+        vector.aux            = function.vector_registers++;
+        if (instr.opcode == ir_opcode::load_element)
+        {
+            vector.opcode   = ir_opcode::load_vector;
+            vector.operands = { instr.operands[0], index };
+        }
+        else
+        {
+            for (value_id operand : instr.operands)
+                vector.operands.push_back(vector_operand(operand));
+        }
+        vectors[value] = append(function, vector_body, std::move(vector));
+    }
+
+    value_id next       = append(function, vector_body, make_instruction(ir_opcode::add, ir_type::i32, { index, step }));
+    ir_instruction jump = make_instruction(ir_opcode::jump, ir_type::unit, {});
+    jump.targets[0]     = vector_header;
+    append(function, vector_body, std::move(jump));
+
+    function.values[index].operands             = { iv.init, next };
+    function.blocks[vector_header].predecessors = { preheader, vector_body };
+    function.blocks[vector_body].predecessors   = { vector_header };
+
+    ir_instruction& entry = function.values[function.blocks[preheader].instructions.back()];
+    for (block_id& target : entry.targets)
+    {
+        if (target == loop.header)
+            target = vector_header;
+    }
+
+    // the remainder loop starts where the vector loop stopped
+    std::vector<block_id>& predecessors        = function.blocks[loop.header].predecessors;
+    size_t entering                            = std::find(predecessors.begin(), predecessors.end(), preheader) - predecessors.begin();
+    predecessors[entering]                     = vector_header;
+    function.values[iv.phi].operands[entering] = index;
+}
+
+size_t vectorize_loops(ir_function& function, const loop_analysis& loops, int32_t width)
+{
+    if (width <= 1)
+        return 0;
+
+    size_t vectorized = 0;
+    for (int32_t l = 0; l < static_cast<int32_t>(loops.loops().size()); ++l)
+    {
+        const ir_loop& loop = loops.loops()[l];
+        if (loop.preheader == -1 || loop.blocks.size() != 2 || loop.latches.size() != 1 || loop.latches[0] == loop.header)
+            continue;
+
+        block_id body = loop.latches[0];
+        if (function.blocks[body].predecessors.size() != 1)
+            continue;
+
+        // only the induction variable, its test and the branch in the header
+        const std::vector<value_id>& header = function.blocks[loop.header].instructions;
+        std::vector<induction_variable> ivs = loops.induction_variables(function, l);
+        if (header.size() != 3 || ivs.size() != 1 || ivs[0].step != 1 || header[0] != ivs[0].phi)
+            continue;
+
+        const induction_variable& iv     = ivs[0];
+        const ir_instruction& test       = function.values[header[1]];
+        const ir_instruction& terminator = function.values[header[2]];
+        if (test.opcode != ir_opcode::lt || test.operands[0] != iv.phi || terminator.opcode != ir_opcode::branch || terminator.operands[0] != header[1] || terminator.targets[0] != body)
+            continue;
+
+        const ir_instruction& init  = function.values[iv.init];
+        const ir_instruction& bound = function.values[test.operands[1]];
+        if (init.opcode != ir_opcode::constant || bound.opcode != ir_opcode::constant || init.immediate < 0)
+            continue;
+
+        int64_t trip_count = static_cast<int64_t>(bound.immediate) - init.immediate;
+        if (trip_count < width || !is_element_wise(function, loop, iv, body))
+            continue;
+
+        int32_t limit = static_cast<int32_t>(init.immediate + trip_count / width * width);
+        vectorize_loop(function, loop, iv, body, limit, width);
+        ++vectorized;
+    }
+    return vectorized;
+}
@@ -0,0 +1,21 @@
+//! \file      vectorizer.hpp
+//! \author    Paul Himmler
+//! \version   1.0
+//! \date      2022
+//! \copyright Apache License 2.0
+
+#ifndef VECTORIZER_HPP
+#define VECTORIZER_HPP
+
+#include "ir.hpp"
+#include "loop_analysis.hpp"
+
+// lanes of the widest i32 and f32 vectors the compiling machine supports
+int32_t native_vector_width();
+
+// Vectorizes innermost loops counting from a constant to a constant bound, whose body only
+// combines elements at the index of the loop into elements at the same index.
+// The vector loop runs width elements per iteration, the original loop handles the remainder.
+size_t vectorize_loops(ir_function& function, const loop_analysis& loops, int32_t width);
+
+#endif VECTORIZER_HPP